@@ -20,6 +20,7 @@
 #include "nccl_ofi_topo.h"
 #include "nccl_ofi_idpool.h"
 #include "nccl_ofi_mr.h"
+#include "nccl_ofi_numa.h"
 #include "nccl_ofi_spinlock.h"
 #include "ofi/resource_wrapper.h"
 
@@ -48,8 +49,9 @@
  */
 #define MIN_TAG_BITS_FOR_RING_ID	(32 + 1)
 
-/* Maximum number of grouped receives */
-#define NCCL_OFI_MAX_RECVS	1
+/* Maximum number of grouped receives supported by any protocol. The
+ * number advertised to NCCL is protocol specific. */
+#define NCCL_OFI_MAX_RECVS	8
 
 /*
  * This defines a higher value than maximum inflight requests supported by NCCL
@@ -59,15 +61,6 @@
  */
 #define NCCL_OFI_MAX_REQUESTS	(128)
 
-/*
- * Number of send requests that can be active at any given time.  In
- * the case of supporting NCCL_OFI_MAX_RECVS grouped receives for each
- * receive request, which means the number of send requests that must
- * be supported is actually larger than the number of receive
- * requests.
- */
-#define NCCL_OFI_MAX_SEND_REQUESTS (NCCL_OFI_MAX_REQUESTS * NCCL_OFI_MAX_RECVS)
-
 /* Flush read size (bytes) */
 #define NCCL_OFI_FLUSH_SIZE             (4ULL)
 
@@ -352,6 +345,11 @@ class nccl_net_ofi_device_t {
 	 */
 	bool need_mr_rkey_pool;
 
+	/* NUMA node closest to the device's NICs, or
+	 * NCCL_OFI_NUMA_NODE_ANY if unknown. Resources of the device
+	 * are allocated on this node. */
+	int numa_node = NCCL_OFI_NUMA_NODE_ANY;
+
 	/* Lock for concurrency since domains can be shared by
 	 * multiple entities. */
 	std::mutex device_lock;
@@ -819,6 +817,28 @@ class nccl_net_ofi_plugin_t {
  */
 int nccl_net_ofi_create_plugin(nccl_net_ofi_plugin_t **plugin_p);
 
+/*
+ * @brief	Configure huge page backing of MR buffers
+ *
+ * Reads the OFI_NCCL_MR_BUFFER_HUGEPAGES parameter and determines the huge
+ * page size. Huge pages are disabled if their size cannot be determined.
+ * Requires system_page_size to be set.
+ */
+void nccl_net_ofi_mr_buffer_init(void);
+
+/*
+ * @brief	Round up the size of an MR buffer to the pages backing it
+ *
+ * Sizes of at least half a huge page are rounded up to a multiple of the
+ * huge page size if huge pages are enabled, and other sizes to a multiple
+ * of the system memory page size.
+ *
+ * @param	size
+ *		Requested size of the memory region
+ * @return	Size to pass to nccl_net_ofi_alloc_mr_buffer()
+ */
+size_t nccl_net_ofi_mr_buffer_size(size_t size);
+
 /*
  * @brief	Allocate memory region for memory registration
  *
@@ -828,16 +848,23 @@ int nccl_net_ofi_create_plugin(nccl_net_ofi_plugin_t **plugin_p);
  * full memory pages. For more information, see functions
  * `register_internal_mr_buffers()` and `reg_internal_mr_ep()`.
  *
+ * Memory regions whose size is a multiple of the huge page size are backed
+ * by huge pages and aligned to the huge page size if huge pages are enabled.
+ *
  * To free deallocate the memory region, function
  * nccl_net_ofi_dealloc_mr_buffer() must be used.
  *
  * @param	size
  *		Size of the memory region. Must be a multiple of system memory page size.
+ * @param	numa_node
+ *		NUMA node to place the memory region on. Defaults to the node of
+ *		the calling thread's NUMA scope (see nccl_ofi_numa.h).
  * @return	Pointer to memory region. Memory region is aligned to system memory page size.
  * @return	0, on success
  *		error, on others
  */
-int nccl_net_ofi_alloc_mr_buffer(size_t size, void **ptr);
+int nccl_net_ofi_alloc_mr_buffer(size_t size, void **ptr,
+				 int numa_node = nccl_ofi_numa_current_node());
 
 /*
  * @brief	Deallocate memory region allocated by function nccl_net_ofi_alloc_mr_buffer()
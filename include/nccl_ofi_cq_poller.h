@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#ifndef NCCL_OFI_CQ_POLLER_H_
+#define NCCL_OFI_CQ_POLLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/*
+ * Completion queue polling of the rails of an endpoint
+ *
+ * A poll reads the completion queues of the rails round-robin, one batch
+ * at a time, until every queue is drained or the completion budget of the
+ * poll is spent. Each poll starts one rail after the previous one, so no
+ * rail is always read first. A rail left with completions when the budget
+ * ran out is read again by the next poll.
+ *
+ * The size of the batches read from a rail doubles, up to the maximum,
+ * when a read fills the batch, and halves, down to the minimum, when a
+ * read returns less than half of it.
+ *
+ * The caller must ensure serialized access.
+ */
+class nccl_ofi_cq_poller {
+public:
+	/* Polling state and statistics of a rail */
+	struct rail {
+		/* Number of entries read from the queue at once */
+		size_t batch_size;
+		/* Whether the queue was drained in the current poll */
+		bool drained;
+		/* Number of reads, and of reads returning no entry */
+		uint64_t num_reads;
+		uint64_t num_empty_reads;
+		/* Number of entries read */
+		uint64_t num_compls;
+		/* Number of polls stopped by the budget before the queue
+		 * was drained */
+		uint64_t num_budget_stops;
+	};
+
+	/*
+	 * @brief	Construct polling of `num_rails' rails
+	 *
+	 * @param	min_batch_size
+	 *		Smallest and initial batch size
+	 * @param	max_batch_size
+	 *		Largest batch size
+	 * @param	budget
+	 *		Maximum number of entries read by a poll, or 0 to
+	 *		drain the queues
+	 */
+	nccl_ofi_cq_poller(int num_rails, size_t min_batch_size,
+			   size_t max_batch_size, size_t budget);
+
+	/* Start a poll */
+	void begin_poll();
+
+	/*
+	 * @brief	Rail to read next in the current poll
+	 *
+	 * @return	rail ID, or -1 if the poll is complete
+	 */
+	int next_rail();
+
+	/* Number of entries to read from a rail */
+	size_t batch_size(int rail_id) const
+	{
+		if (budget != 0 && remaining_budget < rails[rail_id].batch_size) {
+			return remaining_budget;
+		}
+		return rails[rail_id].batch_size;
+	}
+
+	/*
+	 * @brief	Report a read from the queue of a rail
+	 *
+	 * @param	requested
+	 *		Number of entries that were requested
+	 * @param	num_compls
+	 *		Number of entries read
+	 * @param	drained
+	 *		Whether the queue holds no more entries
+	 */
+	void report_read(int rail_id, size_t requested, size_t num_compls, bool drained);
+
+	/* Number of entries read by the current or last poll */
+	size_t num_poll_compls() const
+	{
+		return poll_compls;
+	}
+
+	/* Largest batch size, to size the buffer of entries */
+	size_t max_batch_size() const
+	{
+		return max_batch;
+	}
+
+	std::vector<rail> rails;
+
+private:
+	int num_rails;
+	size_t min_batch;
+	size_t max_batch;
+	size_t budget;
+
+	/* Budget left in, and entries read by, the current poll */
+	size_t remaining_budget;
+	size_t poll_compls;
+	/* Rail the next poll starts at */
+	int start_rail;
+	/* Rail the current poll reads next */
+	int cur_rail;
+};
+
+#endif  // End NCCL_OFI_CQ_POLLER_H_
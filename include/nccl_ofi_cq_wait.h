@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#ifndef NCCL_OFI_CQ_WAIT_H_
+#define NCCL_OFI_CQ_WAIT_H_
+
+#include <poll.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <rdma/fabric.h>
+#include <rdma/fi_eq.h>
+
+/*
+ * Blocking on the completion queues of an idle endpoint
+ *
+ * With OFI_NCCL_CQ_WAIT, completion queues are created with a file
+ * descriptor wait object when the provider supports it. Once an endpoint
+ * processed no completion for a spin window, waiting for a request blocks
+ * in poll() on the wait objects of all completion queues of the endpoint
+ * for up to a timeout, instead of spinning. fi_trywait() makes sure no
+ * completion is pending before blocking.
+ *
+ * The caller must ensure serialized access, except to wait().
+ */
+class nccl_ofi_cq_wait {
+public:
+	/* Clock returning a monotonic time in nanoseconds */
+	typedef uint64_t (*clock_fn_t)(void);
+
+	/*
+	 * @param	spin_ns
+	 *		Time without completions after which waits block
+	 * @param	timeout_ms
+	 *		Longest time a wait blocks
+	 * @param	clock_fn
+	 *		Clock used to time the spin window. NULL selects
+	 *		std::chrono::steady_clock.
+	 */
+	nccl_ofi_cq_wait(uint64_t spin_ns, int timeout_ms, clock_fn_t clock_fn = NULL);
+
+	/*
+	 * @brief	Add a completion queue created with a file descriptor
+	 *		wait object
+	 *
+	 * @return	0, on success
+	 *		negative errno, if the wait object is not available
+	 */
+	int add_cq(struct fid_fabric *fabric, struct fid_cq *cq);
+
+	/*
+	 * @brief	Report a progress call
+	 *
+	 * @param	num_compls
+	 *		Number of completions the call processed
+	 */
+	void report_progress(size_t num_compls);
+
+	/* Whether the last progress calls processed no completion for
+	 * the spin window */
+	bool spin_window_expired();
+
+	/* Whether waits block, as completion queues have wait objects
+	 * and the spin window expired */
+	bool should_block()
+	{
+		return !cq_fids.empty() && spin_window_expired();
+	}
+
+	/*
+	 * @brief	Check that no completion is pending before blocking
+	 *
+	 * Must be called while holding the lock serializing accesses to
+	 * the completion queues.
+	 *
+	 * @return	0, if wait() may block
+	 *		-FI_EAGAIN, if completions are pending
+	 *		negative errno, on error
+	 */
+	int trywait();
+
+	/*
+	 * @brief	Block until a completion queue may have completions,
+	 *		or the timeout expires
+	 *
+	 * Called after trywait() returned 0. Does not require serialized
+	 * access, so the caller can release its locks while blocking.
+	 *
+	 * @return	0, on success
+	 *		negative errno, on error
+	 */
+	int wait() const;
+
+	/*
+	 * @brief	trywait(), then wait() unless completions are pending
+	 *
+	 * @return	0, on success
+	 *		negative errno, on error
+	 */
+	int block();
+
+private:
+	clock_fn_t clock_fn;
+	uint64_t spin_ns;
+	int timeout_ms;
+
+	/* Time since which no completion was processed, or 0 if the last
+	 * progress call processed completions */
+	uint64_t idle_since_ns;
+
+	std::vector<struct fid_fabric *> fabrics;
+	std::vector<struct fid *> cq_fids;
+	std::vector<struct pollfd> pollfds;
+};
+
+#endif  // End NCCL_OFI_CQ_WAIT_H_
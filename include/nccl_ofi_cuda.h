@@ -50,6 +50,14 @@ int nccl_net_ofi_gpu_mem_free(void *ptr);
  */
 int nccl_net_ofi_gpu_mem_copy_host_to_device(void *dst, void *src, size_t size);
 
+/*
+ * @brief wraps cuMemGetAddressRange(), returning the bounds of the
+ * allocation containing ptr
+ * @return	0 on success
+ *		-EINVAL on error
+ */
+int nccl_net_ofi_gpu_get_address_range(void *ptr, uintptr_t *base, size_t *size);
+
 /*
  * @brief Uses cuMemGetHandleForAddressRange() to obtain
  * the fd and offset for a dma buf. In case CU_MEM_RANGE_FLAG_DMA_BUF_MAPPING_TYPE_PCIE
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#ifndef NCCL_OFI_EAGER_THRESHOLD_H_
+#define NCCL_OFI_EAGER_THRESHOLD_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Eager threshold of a send communicator, learned online
+ *
+ * Eager sends save the wait for the receiver's control message, but cost
+ * an rx buffer and a copy at the receiver. The threshold is updated after
+ * every epoch of messages:
+ *
+ * - It is halved when the control message usually arrived before the
+ *   message was sent, as rendezvous is then ready without waiting, or
+ *   when eager sends take much longer to complete than the fastest ones
+ *   observed, which happens when the peer runs out of posted rx buffers.
+ * - It is doubled, up to the maximum, when control messages usually
+ *   arrive after the message was sent, and messages above the threshold
+ *   waited for them longer than an eager send takes.
+ *
+ * Only the waits of messages not sent eagerly, from their first attempt
+ * until their control message arrived, drive growth. The delay between
+ * posting an eager message and the arrival of its control message is
+ * tracked separately: once a message is sent eagerly, nothing waits for
+ * its control message.
+ *
+ * The caller must ensure serialized access.
+ */
+class nccl_ofi_eager_threshold {
+public:
+	/* Clock returning a monotonic time in nanoseconds */
+	typedef uint64_t (*clock_fn_t)(void);
+
+	/*
+	 * @brief	Construct a threshold starting at `initial_size'
+	 *
+	 * @param	initial_size
+	 *		Initial threshold
+	 * @param	max_size
+	 *		Largest threshold, bounded by the size of eager rx
+	 *		buffers. May be larger than initial_size.
+	 * @param	clock_fn
+	 *		Clock used to time waits. NULL selects
+	 *		std::chrono::steady_clock.
+	 */
+	nccl_ofi_eager_threshold(ssize_t initial_size, ssize_t max_size,
+				 clock_fn_t clock_fn = NULL);
+
+	/* Messages up to this size may be sent eagerly */
+	ssize_t threshold() const
+	{
+		return cur_size;
+	}
+
+	/*
+	 * @brief	Report a call to send() for the next message
+	 *
+	 * Called again when NCCL retries the send of a message that was
+	 * not posted.
+	 *
+	 * @param	ctrl_ready
+	 *		Whether the control message of the message arrived
+	 */
+	void report_attempt(bool ctrl_ready);
+
+	/*
+	 * @brief	Report that the next message was posted, eagerly or
+	 *		not
+	 */
+	void report_posted();
+
+	/*
+	 * @brief	Report that the control message of an eager message
+	 *		arrived `delay_ns' after the message was posted
+	 */
+	void report_eager_ctrl_delay(uint64_t delay_ns);
+
+	/*
+	 * @brief	Report the completion of an eager send `latency_ns'
+	 *		after it was posted
+	 */
+	void report_eager_completion(uint64_t latency_ns);
+
+	uint64_t now() const
+	{
+		return clock_fn();
+	}
+
+	/* Average time messages not sent eagerly waited for their control
+	 * message */
+	double ctrl_wait_ns;
+	/* Average delay between posting an eager message and the arrival
+	 * of its control message */
+	double eager_ctrl_delay_ns;
+	/* Average and lowest completion latency of eager sends */
+	double eager_latency_ns;
+	double min_eager_latency_ns;
+
+private:
+	void end_epoch();
+
+	clock_fn_t clock_fn;
+	ssize_t max_size;
+	ssize_t cur_size;
+
+	/* Whether a message was attempted but not posted yet, and the
+	 * time of its first attempt if its control message was missing */
+	bool msg_pending;
+	bool msg_waiting;
+	uint64_t msg_start_ns;
+
+	/* Statistics of the current epoch */
+	unsigned int num_msgs;
+	unsigned int num_ctrl_ready;
+	unsigned int num_ctrl_waits;
+	double epoch_ctrl_wait_ns;
+	unsigned int num_eager_compls;
+	double epoch_eager_latency_ns;
+};
+
+#endif  // End NCCL_OFI_EAGER_THRESHOLD_H_
@@ -8,6 +8,9 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include <mutex>
+#include <vector>
+
 #include "nccl_ofi.h"
 #include "nccl_ofi_log.h"
 #include "nccl_ofi_memcheck.h"
@@ -20,6 +23,9 @@
  * of the freelist interface
  */
 class nccl_ofi_freelist {
+protected:
+	struct nccl_ofi_freelist_block_t;
+
 public:
 	/*
 	 * Freelist element structure
@@ -28,6 +34,26 @@ class nccl_ofi_freelist {
 		void *ptr;
 		void *mr_handle;
 		struct fl_entry *next;
+		/* Block the entry belongs to */
+		struct nccl_ofi_freelist_block_t *block;
+	};
+
+	/*
+	 * Freelist statistics
+	 */
+	struct stats {
+		/* Entries currently allocated from the system, and in use */
+		size_t num_allocated_entries;
+		size_t num_in_use_entries;
+		/* Size of the block memory currently allocated */
+		size_t memory_size;
+		/* High watermarks of the values above */
+		size_t peak_allocated_entries;
+		size_t peak_in_use_entries;
+		size_t peak_memory_size;
+		/* Blocks and entries released by trimming */
+		size_t num_trimmed_blocks;
+		size_t num_trimmed_entries;
 	};
 
 	/*
@@ -105,12 +131,15 @@ class nccl_ofi_freelist {
 	 * The user can optionally enable leak detection.  If enabled, the freelist will
 	 * check for memory leaks when the freelist is finalized, and print a warning if
 	 * memory has leaked.
+	 *
+	 * Entries are aligned to entry_alignment, which must be a power of two,
+	 * e.g. to the alignment of the type constructed in them.
 	 */
 	nccl_ofi_freelist(size_t entry_size, size_t initial_entry_count,
 			  size_t increase_entry_count, size_t max_entry_count,
 			  nccl_ofi_freelist_entry_init_fn entry_init_fn,
 			  nccl_ofi_freelist_entry_fini_fn entry_fini_fn, const char *name,
-			  bool enable_leak_detection);
+			  bool enable_leak_detection, size_t entry_alignment = 1);
 
 	/* Initialize "complex" freelist structure
 	 *
@@ -189,6 +218,12 @@ class nccl_ofi_freelist {
 		}
 
 		this->num_in_use_entries++;
+		if (this->num_in_use_entries > this->peak_in_use_entries) {
+			this->peak_in_use_entries = this->num_in_use_entries;
+		}
+		if (entry->block->num_in_use++ == 0) {
+			this->num_idle_blocks--;
+		}
 
 		return entry;
 	}
@@ -212,8 +247,56 @@ class nccl_ofi_freelist {
 		nccl_net_ofi_mem_noaccess(entry->ptr, user_entry_size);
 
 		this->num_in_use_entries--;
+		if (--entry->block->num_in_use == 0) {
+			this->num_idle_blocks++;
+		}
+	}
+
+	/*
+	 * Release fully idle blocks, deregistering and unmapping their
+	 * memory, until at most max_free_entries entries are free or no
+	 * idle block is left. Most recently added blocks are released
+	 * first. The caller must ensure serialized access to protect the
+	 * freelist.
+	 *
+	 * @return	Number of blocks released
+	 */
+	size_t trim(size_t max_free_entries);
+
+	/*
+	 * Release fully idle blocks if more than the trim watermark entries
+	 * are free, down to watermark / 2 free entries. Cheap when there is
+	 * nothing to release, so that owners can call it periodically, e.g.
+	 * while idle, instead of entry_free() paying for deregistration. The
+	 * caller must ensure serialized access to protect the freelist.
+	 *
+	 * @return	Number of blocks released
+	 */
+	size_t trim_excess()
+	{
+		if (OFI_LIKELY(this->trim_watermark == 0) || this->num_idle_blocks == 0 ||
+		    this->num_allocated_entries - this->num_in_use_entries <= this->trim_watermark) {
+			return 0;
+		}
+		return trim(this->trim_watermark / 2);
 	}
 
+	/*
+	 * Set the number of free entries above which trim_excess() releases
+	 * fully idle blocks, down to watermark / 2 free entries. 0 disables
+	 * trimming. Freelists that cannot grow back are never trimmed.
+	 */
+	void set_trim_watermark(size_t watermark)
+	{
+		this->trim_watermark = (this->increase_entry_count > 0) ? watermark : 0;
+	}
+
+	/*
+	 * Return current, peak and trimmed statistics of the freelist. The
+	 * caller must ensure serialized access to protect the freelist.
+	 */
+	void get_stats(struct stats *stats_p) const;
+
 	/*
 	 * Set memcheck guards of freelist entry's user data to accessible but undefined
 	 */
@@ -244,16 +327,21 @@ class nccl_ofi_freelist {
 	/* Internal function, which grows the freelist */
 	int add(size_t num_entries);
 
+	/* Internal function, which finalizes the entries of a block and
+	 * releases its memory. The block must not be linked anymore. */
+	void release_block(struct nccl_ofi_freelist_block_t *block);
+
 	/*
 	 * @brief	Returns size of buffer memory
 	 *
 	 * The buffer memory stores entry_count entries. Since the buffer memory needs
-	 * to cover full memory pages, the size is rounded up to page size.
+	 * to cover full memory pages, the size is rounded up to page size, or to
+	 * huge page size for large blocks if huge pages are enabled.
 	 */
 	size_t freelist_buffer_mem_size_full_pages(size_t entry_count)
 	{
 		size_t buffer_mem_size = (this->entry_size * entry_count);
-		return NCCL_OFI_ROUND_UP(buffer_mem_size, system_page_size);
+		return nccl_net_ofi_mr_buffer_size(buffer_mem_size);
 	}
 
 	/*
@@ -293,6 +381,10 @@ class nccl_ofi_freelist {
 		void *mr_handle;
 		fl_entry *entries;
 		size_t num_entries;
+		/* Entries of the block not on the free list */
+		size_t num_in_use;
+		/* Set while the block is being released by trim() */
+		bool trimmed;
 	};
 
 	size_t entry_size;
@@ -302,6 +394,23 @@ class nccl_ofi_freelist {
 	size_t max_entry_count;
 	size_t increase_entry_count;
 
+	/* NUMA node of the scope the freelist was created in, used for
+	 * all blocks */
+	int numa_node;
+
+	/* Blocks with no entry in use */
+	size_t num_idle_blocks;
+	/* Number of free entries triggering trimming, 0 if disabled */
+	size_t trim_watermark;
+
+	/* Statistics, see struct stats */
+	size_t memory_size;
+	size_t peak_allocated_entries;
+	size_t peak_in_use_entries;
+	size_t peak_memory_size;
+	size_t num_trimmed_blocks;
+	size_t num_trimmed_entries;
+
 	fl_entry *entries;
 	struct nccl_ofi_freelist_block_t *blocks;
 
@@ -321,4 +430,196 @@ class nccl_ofi_freelist {
 };
 
 
+/*
+ * Thread-safe freelist with per-thread magazines
+ *
+ * Unlike nccl_ofi_freelist, entry_alloc() and entry_free() may be called
+ * concurrently without external serialization. Each thread allocates from
+ * and frees to magazines, bounded stacks of free entries private to the
+ * thread, and only takes the depot lock to exchange a full magazine for an
+ * empty one or the reverse. The depot holds full magazines and the underlying
+ * freelist, which grows as usual, including memory registration through
+ * regmr_fn, under the depot lock. Memory registration callbacks must
+ * therefore not allocate from the same freelist.
+ *
+ * Entries cached in the magazines of a thread are not available to other
+ * threads, so with max_entry_count set, an allocation may fail while up to
+ * 2 * magazine_size entries per thread are free. Threads beyond the first
+ * MAX_THREADS threads alive at a time allocate from the depot directly.
+ */
+class nccl_ofi_freelist_mt : public nccl_ofi_freelist {
+public:
+	/* Maximum number of threads with their own magazines */
+	static constexpr size_t MAX_THREADS = 64;
+
+	/*
+	 * Initialize "simple" thread-safe freelist structure. Arguments are
+	 * those of the nccl_ofi_freelist constructor, and the number of
+	 * entries in a magazine.
+	 */
+	nccl_ofi_freelist_mt(size_t entry_size, size_t initial_entry_count,
+			     size_t increase_entry_count, size_t max_entry_count,
+			     size_t magazine_size,
+			     nccl_ofi_freelist_entry_init_fn entry_init_fn,
+			     nccl_ofi_freelist_entry_fini_fn entry_fini_fn, const char *name,
+			     bool enable_leak_detection, size_t entry_alignment = 1);
+
+	/*
+	 * Initialize "complex" thread-safe freelist structure, with memory
+	 * registration of the blocks of entries.
+	 */
+	nccl_ofi_freelist_mt(size_t entry_size, size_t initial_entry_count,
+			     size_t increase_entry_count, size_t max_entry_count,
+			     size_t magazine_size,
+			     nccl_ofi_freelist_entry_init_fn entry_init_fn,
+			     nccl_ofi_freelist_entry_fini_fn entry_fini_fn,
+			     nccl_ofi_freelist_regmr_fn regmr_fn,
+			     nccl_ofi_freelist_deregmr_fn deregmr_fn, void *regmr_opaque,
+			     size_t entry_alignment, const char *name,
+			     bool enable_leak_detection);
+
+	/*
+	 * Finalize (free) a thread-safe freelist. No thread may use the
+	 * freelist anymore.
+	 */
+	~nccl_ofi_freelist_mt();
+
+	/* Allocate a new freelist item
+	 *
+	 * Same as nccl_ofi_freelist::entry_alloc(), without the need for
+	 * external serialization.
+	 */
+	fl_entry *entry_alloc()
+	{
+		fl_entry *entry;
+		magazine_slot *slot = thread_slot();
+
+		if (OFI_UNLIKELY(slot == NULL)) {
+			std::lock_guard<std::mutex> lock(depot_lock);
+			entry = nccl_ofi_freelist::entry_alloc();
+			if (entry != NULL) {
+				unslotted_in_use++;
+			}
+			return entry;
+		}
+
+		if (OFI_UNLIKELY(slot->loaded_count == 0) && !reload(slot)) {
+			return NULL;
+		}
+
+		entry = slot->loaded;
+		nccl_net_ofi_mem_defined_unaligned(entry, sizeof(*entry));
+		slot->loaded = entry->next;
+		slot->loaded_count--;
+		slot->in_use++;
+
+		if (this->entry_init_fn) {
+			entry_set_defined(entry->ptr);
+		} else {
+			entry_set_undefined(entry->ptr);
+		}
+
+		return entry;
+	}
+
+	/* Release a freelist item
+	 *
+	 * Same as nccl_ofi_freelist::entry_free(), without the need for
+	 * external serialization. The entry may be released by another
+	 * thread than the one which allocated it.
+	 */
+	void entry_free(fl_entry *entry)
+	{
+		magazine_slot *slot = thread_slot();
+
+		assert(entry);
+
+		if (OFI_UNLIKELY(slot == NULL)) {
+			std::lock_guard<std::mutex> lock(depot_lock);
+			nccl_ofi_freelist::entry_free(entry);
+			unslotted_in_use--;
+			return;
+		}
+
+		if (OFI_UNLIKELY(slot->loaded_count == magazine_size)) {
+			unload(slot);
+		}
+
+		nccl_net_ofi_mem_noaccess(entry->ptr, this->entry_size - MEMCHECK_REDZONE_SIZE);
+		entry->next = slot->loaded;
+		slot->loaded = entry;
+		slot->loaded_count++;
+		slot->in_use--;
+	}
+
+	/*
+	 * Same as nccl_ofi_freelist::trim_excess(), without the need for
+	 * external serialization. Full magazines of the depot are returned
+	 * to the underlying freelist first, entries cached by threads are
+	 * not.
+	 */
+	size_t trim_excess();
+
+private:
+	/* A magazine is a list of entries linked through fl_entry::next */
+	struct magazine {
+		fl_entry *head;
+		size_t count;
+	};
+
+	/*
+	 * Magazines of a thread. The thread allocates from and frees to the
+	 * loaded magazine, and swaps it with the previous one before going to
+	 * the depot, so that alternating allocations and releases around a
+	 * magazine boundary do not hit the depot every time.
+	 */
+	struct alignas(NCCL_OFI_DEFAULT_CPU_CACHE_LINE_SIZE) magazine_slot {
+		fl_entry *loaded;
+		size_t loaded_count;
+		fl_entry *previous;
+		size_t previous_count;
+		/* Entries allocated minus entries released by the thread. May
+		 * be negative when entries are released by other threads. */
+		ssize_t in_use;
+	};
+
+	void init_magazines(size_t magazine_size);
+
+	/* Index of the calling thread in the magazine slots, or MAX_THREADS */
+	static size_t thread_index()
+	{
+		if (OFI_UNLIKELY(cached_thread_index == MAX_THREADS + 1)) {
+			cached_thread_index = acquire_thread_index();
+		}
+		return cached_thread_index;
+	}
+	static size_t acquire_thread_index();
+	static inline thread_local size_t cached_thread_index = MAX_THREADS + 1;
+
+	magazine_slot *thread_slot()
+	{
+		size_t index = thread_index();
+		return (index < MAX_THREADS) ? &slots[index] : NULL;
+	}
+
+	/* Refill the loaded magazine of slot. Returns false if the freelist is
+	 * exhausted. */
+	bool reload(magazine_slot *slot);
+
+	/* Make room in the full loaded magazine of slot */
+	void unload(magazine_slot *slot);
+
+	size_t magazine_size;
+
+	/* Magazine slots, indexed by thread index */
+	std::vector<magazine_slot> slots;
+
+	/* Protects full_magazines, the underlying freelist and
+	 * unslotted_in_use */
+	std::mutex depot_lock;
+	std::vector<magazine> full_magazines;
+	/* Entries in use allocated by threads without slot */
+	size_t unslotted_in_use;
+};
+
 #endif // End NCCL_OFI_FREELIST_H
@@ -85,4 +85,16 @@ class nccl_ofi_gdrcopy_ctx : public nccl_ofi_device_copy {
 	int get_version(uint32_t *major, uint32_t *minor);
 };
 
+/**
+ * Get singleton instance of the device copy context shared across all
+ * communicators (GIN, and RDMA eager copies).
+ *
+ * @throw std::runtime_error if the GDRCopy library cannot be loaded
+ */
+inline nccl_ofi_device_copy &get_device_copy()
+{
+	static nccl_ofi_gdrcopy_ctx instance;
+	return instance;
+}
+
 #endif  // End NCCL_OFI_GDRCOPY_H_
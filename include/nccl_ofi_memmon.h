@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#ifndef NCCL_OFI_MEMMON_H_
+#define NCCL_OFI_MEMMON_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Host memory unmap monitor
+ *
+ * The monitor observes calls releasing or replacing the pages of a host
+ * address range (munmap(), mremap(), madvise() with MADV_DONTNEED, MADV_FREE
+ * or MADV_REMOVE, and brk()/sbrk() shrinking the heap) and appends the
+ * affected ranges to a process-wide invalidation log. Consumers, such as the
+ * MR cache, keep a position in the log and drop state covering the ranges
+ * published since they last looked.
+ *
+ * Ranges are published before the intercepted call releases the memory, so a
+ * consumer checking the log after the call returned always sees them.
+ *
+ * Calls are intercepted by redirecting the GOT slots of these functions in
+ * every object loaded in the process. Calls libc makes internally, such as
+ * free() releasing an mmap()ed chunk or trimming the heap, do not go through
+ * a GOT and are not observed. Objects loaded after the monitor was installed
+ * are only patched by the next call to nccl_ofi_memmon_refresh().
+ */
+
+/**
+ * Function called for each range read from the invalidation log
+ */
+typedef void (*nccl_ofi_memmon_range_fn)(void *opaque, uintptr_t addr, size_t len);
+
+/**
+ * Install the monitor, if not done already
+ *
+ * @return 0, on success
+ *	   -ENOTSUP, if the platform does not support the monitor
+ */
+int nccl_ofi_memmon_init(void);
+
+/**
+ * Patch objects loaded since the monitor was installed or last refreshed
+ */
+void nccl_ofi_memmon_refresh(void);
+
+/**
+ * Current position of the end of the invalidation log
+ */
+uint64_t nccl_ofi_memmon_seq(void);
+
+/**
+ * Publish an invalidated range to the log
+ *
+ * Called by the interception hooks, and may be called by the plugin for
+ * memory released through other means.
+ */
+void nccl_ofi_memmon_invalidate(const void *addr, size_t len);
+
+/**
+ * Call fn for each range published after position *seq, and advance *seq to
+ * the end of the log. fn is called without any monitor lock held and may
+ * release memory itself.
+ *
+ * @return 0, on success
+ *	   -EOVERFLOW, if ranges were overwritten before being read, in which
+ *	   case the consumer must assume all of its memory was invalidated
+ */
+int nccl_ofi_memmon_consume(uint64_t *seq, nccl_ofi_memmon_range_fn fn, void *opaque);
+
+#endif  // End NCCL_OFI_MEMMON_H_
@@ -13,7 +13,14 @@
 #include <stdint.h>
 #include <sys/uio.h>
 
+#include <atomic>
+#include <map>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+
 #include <rdma/fi_domain.h>
+#include "nccl_ofi_dlist.h"
 #include "nccl_ofi_math.h"
 #include "nccl_ofi_log.h"
 
@@ -186,27 +193,96 @@ static inline void nccl_ofi_mr_ckey_fill_mr_attrs(nccl_ofi_mr_ckey_ref ckey, str
 typedef struct nccl_ofi_reg_entry {
 	uintptr_t addr;
 	size_t pages;
-	int refcnt;
+	/* Incremented by concurrent readers of the lookup fast path. Only
+	 * drops to zero with the index write lock held. */
+	std::atomic<int> refcnt;
 	void *handle;
 	nccl_net_ofi_ep_t *ep;
+	bool is_endpoint_mr;
+	/* True if the entry is reachable through the interval index. Entries
+	 * whose range is covered by a later, larger registration are dropped
+	 * from the index but stay alive until their last reference is gone. */
+	bool indexed;
+	/* True if the registration may stay cached once its refcnt drops to
+	 * zero, when lazy deregistration is enabled */
+	bool retain_idle;
+	/* Link in the LRU list of idle (zero refcnt) entries */
+	nccl_ofi_dlist_node lru_node;
 } nccl_ofi_reg_entry_t;
 
+/**
+ * Function called by the cache to deregister the handle of an idle entry it
+ * evicts. Only used when lazy deregistration is enabled.
+ *
+ * @return 0 on success, non-zero on error
+ */
+typedef int (*nccl_ofi_mr_cache_dereg_fn)(void *opaque, void *handle);
+
+/**
+ * Key of the interval index: endpoint (or NULL when MRs are not
+ * endpoint-scoped) and page-aligned start address of the entry.
+ */
+typedef std::pair<nccl_net_ofi_ep_t *, uintptr_t> nccl_ofi_mr_cache_index_key_t;
+
 /**
  * Device-specific memory registration cache.
+ *
+ * Indexed entries of one endpoint never contain each other, so ordering them
+ * by start address also orders them by end address. The only candidate for a
+ * lookup is then the entry with the greatest start address not above the
+ * requested one, which the ordered index finds in O(log n). Deletion goes
+ * through the handle map and does not need to search the index.
+ *
+ * Locking: callers hold lock around the lookup, registration and insertion of
+ * a missing entry, and around deletion. Internally, index_lock protects the
+ * cache structures, so that nccl_ofi_mr_cache_lookup_shared() can serve hits
+ * on entries in use concurrently, without taking lock.
  */
 typedef struct nccl_ofi_mr_cache {
-	nccl_ofi_reg_entry_t **slots;
+	std::map<nccl_ofi_mr_cache_index_key_t, nccl_ofi_reg_entry_t *> index;
+	std::unordered_map<void *, nccl_ofi_reg_entry_t *> handles;
 	size_t system_page_size;
-	size_t size;
-	size_t used;
-	uint32_t hit_count;
+	std::atomic<uint32_t> hit_count;
 	uint32_t miss_count;
+
+	/* Lazy deregistration. Entries whose refcnt drops to zero are kept
+	 * registered in idle_lru (least recently used first) until the idle
+	 * budget is exceeded. */
+	bool lazy_dereg;
+	size_t max_idle_entries;
+	size_t max_idle_bytes;
+	nccl_ofi_mr_cache_dereg_fn dereg_fn;
+	void *dereg_opaque;
+	nccl_ofi_dlist idle_lru;
+	size_t idle_entries;
+	size_t idle_bytes;
+	/* Hits on idle entries, which saved a registration */
+	uint32_t idle_hit_count;
+	/* Idle entries deregistered by the cache */
+	uint32_t eviction_count;
+
+	/* Invalidation by the memory unmap monitor. Ranges published by the
+	 * monitor after memmon_seq are applied before the next lookup or
+	 * insertion. */
+	bool monitored;
+	uint64_t memmon_seq;
+	/* Entries dropped because their memory was released */
+	uint32_t invalidation_count;
+
+	/* Maximum size of a registration merged from adjacent or overlapping
+	 * ones, 0 if merging is disabled */
+	size_t max_merge_size;
+	/* Registrations merged with existing entries */
+	uint32_t merge_count;
+
 	pthread_mutex_t lock;
+	std::shared_mutex index_lock;
 } nccl_ofi_mr_cache_t;
 
 /**
  * Create a new mr cache. Both then initial number of entries and the system
- * page size must be greater than zero.
+ * page size must be greater than zero. The initial number of entries is used
+ * to size the handle map.
  * @return a new mr cache, or NULL if an allocation error occurred
  */
 nccl_ofi_mr_cache_t *nccl_ofi_mr_cache_init(size_t init_num_entries,
@@ -214,36 +290,142 @@ nccl_ofi_mr_cache_t *nccl_ofi_mr_cache_init(size_t init_num_entries,
 
 /**
  * Finalize mr cache
+ *
+ * Idle entries must have been released with nccl_ofi_mr_cache_purge_idle()
+ * before, while their registrations can still be deregistered.
  */
 void nccl_ofi_mr_cache_finalize(nccl_ofi_mr_cache_t *cache);
 
+/**
+ * Enable lazy deregistration
+ *
+ * Once enabled, entries inserted with retain_idle set are not deleted when
+ * their refcnt drops to zero but are kept as idle entries, so that a later
+ * lookup of the same range does not need a new registration. Idle entries are
+ * evicted in LRU order, deregistering their handle with dereg_fn, when there
+ * are more than max_idle_entries of them or they cover more than
+ * max_idle_bytes. A zero limit means no limit.
+ *
+ * Entries of endpoint-scoped MRs are never kept idle, as the endpoint they
+ * belong to may go away.
+ */
+void nccl_ofi_mr_cache_enable_lazy_dereg(nccl_ofi_mr_cache_t *cache,
+					 size_t max_idle_entries,
+					 size_t max_idle_bytes,
+					 nccl_ofi_mr_cache_dereg_fn dereg_fn,
+					 void *dereg_opaque);
+
+/**
+ * Enable invalidation of entries by the memory unmap monitor
+ *
+ * Installs the monitor if needed. Once enabled, entries overlapping host
+ * memory released through a monitored call are removed from the cache before
+ * the next lookup. If the invalidation log overflowed, all entries are
+ * removed. The monitor does not observe memory libc releases internally,
+ * such as free() unmapping a chunk or trimming the heap, so it does not make
+ * keeping idle registrations of host memory safe; callers do not insert host
+ * memory with retain_idle.
+ *
+ * @return 0, on success
+ *	   -ENOTSUP, if the monitor is not supported
+ */
+int nccl_ofi_mr_cache_enable_monitor(nccl_ofi_mr_cache_t *cache);
+
+/**
+ * Remove entries overlapping the range [addr, addr + len) from the cache
+ *
+ * Invalidated idle entries are evicted. Invalidated entries still in use are
+ * removed from the index and deleted once their refcnt drops to zero, at which
+ * point the caller deregisters them.
+ */
+void nccl_ofi_mr_cache_invalidate(nccl_ofi_mr_cache_t *cache, uintptr_t addr, size_t len);
+
+/**
+ * Enable merging of registrations
+ *
+ * Once enabled, nccl_ofi_mr_cache_merge_key() extends the range of a missing
+ * key to the entries it overlaps or is adjacent to, up to max_merge_size
+ * bytes. A single registration then serves all of these ranges.
+ */
+void nccl_ofi_mr_cache_enable_merge(nccl_ofi_mr_cache_t *cache, size_t max_merge_size);
+
+/**
+ * Compute the range to register for a missing iovec key
+ *
+ * The range of ckey is extended to cover the indexed entries of the same
+ * endpoint which overlap it or are adjacent to it, and lie within
+ * [bound_addr, bound_addr + bound_len). The bounds must be those of the
+ * allocation ckey belongs to: entries of different allocations may be
+ * released independently, and a merged registration must not outlive the
+ * memory of any of its parts. Once the merged key is registered and inserted,
+ * the entries it covers are dropped from the index and lookups of any of the
+ * ranges return the merged registration. Entries still in use are released
+ * through their own handles, as usual.
+ *
+ * Called with the cache lock held.
+ * @return true if merged_ckey was set to a range larger than ckey,
+ *	   false otherwise
+ */
+bool nccl_ofi_mr_cache_merge_key(nccl_ofi_mr_cache_t *cache, nccl_ofi_mr_ckey_ref ckey,
+				 bool is_endpoint_mr, uintptr_t bound_addr, size_t bound_len,
+				 nccl_ofi_mr_ckey_t *merged_ckey);
+
+/**
+ * Evict all idle entries, deregistering their handles
+ *
+ * @return 0, on success
+ *	   non-zero, if deregistering any of the handles failed
+ */
+int nccl_ofi_mr_cache_purge_idle(nccl_ofi_mr_cache_t *cache);
+
 /**
  * Lookup a cache entry matching the given address and size
  * Input addr and size are rounded up to enclosing page boundaries.
- * If entry is found, refcnt is increased
+ * If entry is found, refcnt is increased. An idle entry is made active again.
  * @return mr handle if found, or NULL if not found
  */
 void *nccl_ofi_mr_cache_lookup_entry(nccl_ofi_mr_cache_t *cache, nccl_ofi_mr_ckey_ref ckey,
 				     bool is_endpoint_mr);
 
+/**
+ * Lookup a cache entry in use matching the given address and size, without
+ * holding the cache lock
+ *
+ * Hits on entries with a non-zero refcnt only take index_lock in shared mode
+ * and increment the refcnt atomically, so concurrent callers do not serialize.
+ * Misses, hits on idle entries and lookups with pending invalidations return
+ * NULL, and the caller falls back to nccl_ofi_mr_cache_lookup_entry() with
+ * the cache lock held.
+ * @return mr handle if found, or NULL
+ */
+void *nccl_ofi_mr_cache_lookup_shared(nccl_ofi_mr_cache_t *cache, nccl_ofi_mr_ckey_ref ckey,
+				      bool is_endpoint_mr);
+
 /**
  * Insert a new cache entry with the given address and size
  * Input addr and size are rounded up to enclosing page boundaries.
+ * Existing entries covered by the new entry are removed from the index, so
+ * that later lookups are served by the new entry. Covered idle entries are
+ * evicted. If retain_idle is set and lazy deregistration is enabled, the
+ * entry is kept idle instead of being deleted once unused.
  * @return 0, on success
  *	   -ENOMEM, on allocation failure
  *	   -EEXIST, if matching entry already exists in cache
  */
 int nccl_ofi_mr_cache_insert_entry(nccl_ofi_mr_cache_t *cache, nccl_ofi_mr_ckey_ref ckey,
-				   bool is_endpoint_mr, void *handle);
+				   bool is_endpoint_mr, bool retain_idle, void *handle);
 
 /**
  * Decrement refcnt of entry with given handle. If refcnt was reduced to 0,
- * delete entry from cache. Return value indicates whether entry was deleted
- * from cache (in which case, caller should deregister the handle).
+ * delete entry from cache, or keep it as idle entry with lazy deregistration.
+ * Return value indicates whether entry was deleted from cache (in which case,
+ * caller should deregister the handle). Keeping an entry idle may evict other
+ * idle entries, which are deregistered by the cache.
  *
- * @return 0, on success, and reg was not deleted (refcnt not zero)
+ * @return 0, on success, and reg was not deleted (refcnt not zero, or
+ *	      entry kept idle)
  *	   1, on success, and reg was deleted (refcnt was zero)
- *	   -ENOENT, if no matching entry was found
+ *	   -ENOENT, if no matching entry was found, or entry is idle
  */
 int nccl_ofi_mr_cache_del_entry(nccl_ofi_mr_cache_t *cache, void *handle);
 
@@ -5,16 +5,15 @@
 #ifndef NCCL_OFI_MSGBUFF_H_
 #define NCCL_OFI_MSGBUFF_H_
 
+#include <atomic>
 #include <cstdint>
-#include <mutex>
-#include <vector>
+#include <memory>
 
 /**
  * A "modified circular buffer" used to track in-flight (or INPROGRESS) messages.
  * Messages are identified by a wrapping sequence number (with bit width chosen during
- * initialization). The buffer maintains two pointers: msg_next and msg_last_incomplete.
- *   - msg_next: one after inserted message with highest sequence number
- *   - msg_last_incomplete: not-completed message with lowest sequence number
+ * initialization). The buffer maintains one pointer, msg_last_incomplete: the
+ * not-completed message with lowest sequence number.
  *
  * The msgbuff features a custom number of bits used for the sequence numbers.
  * The space of all sequence numbers is divided in 3 contiguous, moving sections:
@@ -36,6 +35,13 @@
  *
  * The buffer for in-flight messages stores void* elements: the user of the buffer is
  * responsible for managing the memory of buffer elements.
+ *
+ * The buffer is lock-free. Each slot has an atomic state word holding the sequence
+ * number, element type and status of the message stored in it, so a slot is
+ * claimed for a message with a single compare-and-swap; concurrent inserts of the
+ * same message (e.g. by recv() and by the arrival of an eager message) see exactly
+ * one winner. Sequence numbers of section 1 whose slot does not hold them are not
+ * started.
  */
 
 /* Enumeration to keep track of different msg statuses. */
@@ -68,16 +74,6 @@ typedef enum {
 	NCCL_OFI_MSGBUFF_BUFF
 } nccl_ofi_msgbuff_elemtype_t;
 
-/* Internal buffer storage type, used to keep status of elements currently stored in
- * buffer */
-typedef struct {
-	// Status of message: COMPLETED, INPROGRESS, or NOTSTARTED
-	nccl_ofi_msgbuff_status_t stat;
-	// Type of element
-	nccl_ofi_msgbuff_elemtype_t type;
-	void *elem;
-} nccl_ofi_msgbuff_elem_t;
-
 class nccl_ofi_msgbuff {
 public:
 	/**
@@ -150,20 +146,68 @@ class nccl_ofi_msgbuff {
 	nccl_ofi_msgbuff_result_t complete(uint16_t msg_index,
 					   nccl_ofi_msgbuff_status_t *msg_idx_status);
 
+	/**
+	 * Remove an in-progress message element, so that the message is not
+	 * started anymore. Only valid if no other party knows about the
+	 * element yet, e.g. to withdraw a request whose posting failed.
+	 *
+	 * @param msg_index sequence number of the message
+	 * @param msg_idx_status output: message status, if return value is INVALID_IDX
+	 *
+	 * @return NCCL_OFI_MSGBUFF_SUCCESS, NCCL_OFI_MSGBUFF_INVALID_IDX, or NCCL_OFI_MSGBUFF_ERROR
+	 */
+	nccl_ofi_msgbuff_result_t remove(uint16_t msg_index,
+					 nccl_ofi_msgbuff_status_t *msg_idx_status);
+
 private:
+	/* Status of a slot, in the low bits of its state word */
+	enum slot_status : uint32_t {
+		/* No message was stored in the slot yet */
+		SLOT_EMPTY = 0,
+		/* The slot is being updated; its element is not valid */
+		SLOT_BUSY = 1,
+		SLOT_INPROGRESS = 2,
+		SLOT_COMPLETED = 3,
+	};
+
+	struct slot {
+		/* Sequence number, element type and status of the message
+		 * stored in the slot, see make_state() */
+		std::atomic<uint32_t> state;
+		std::atomic<void *> elem;
+	};
+
+	static uint32_t make_state(uint16_t seq, nccl_ofi_msgbuff_elemtype_t type, slot_status status)
+	{
+		return ((uint32_t)seq << 3) | ((uint32_t)type << 2) | (uint32_t)status;
+	}
+	static uint16_t state_seq(uint32_t state)
+	{
+		return (uint16_t)(state >> 3);
+	}
+	static nccl_ofi_msgbuff_elemtype_t state_type(uint32_t state)
+	{
+		return (nccl_ofi_msgbuff_elemtype_t)((state >> 2) & 1);
+	}
+	static slot_status state_status(uint32_t state)
+	{
+		return (slot_status)(state & 3);
+	}
+
 	uint16_t distance(uint16_t front, uint16_t back) const;
-	uint16_t num_inflight() const;
-	nccl_ofi_msgbuff_elem_t &buff_idx(uint16_t idx);
-	const nccl_ofi_msgbuff_elem_t &buff_idx(uint16_t idx) const;
-	nccl_ofi_msgbuff_status_t get_idx_status(uint16_t msg_index) const;
+	slot &buff_idx(uint16_t idx);
+	uint32_t load_state(slot &s);
+	nccl_ofi_msgbuff_status_t get_idx_status(uint16_t msg_index, uint32_t *state);
+	bool update_slot(slot &s, uint32_t state, void *elem, nccl_ofi_msgbuff_elemtype_t type,
+			 slot_status status);
 
-	std::vector<nccl_ofi_msgbuff_elem_t> buff;
+	std::unique_ptr<slot[]> buff;
 	uint16_t max_inprogress;
 	uint16_t field_size;
 	uint16_t field_mask;
-	uint16_t msg_last_incomplete;
-	uint16_t msg_next;
-	std::mutex lock;
+	/* Not-completed message with lowest sequence number; only moved
+	 * forward by complete() */
+	std::atomic<uint16_t> msg_last_incomplete;
 };
 
 #endif // End NCCL_OFI_MSGBUFF_H_
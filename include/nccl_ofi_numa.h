@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#ifndef NCCL_OFI_NUMA_H_
+#define NCCL_OFI_NUMA_H_
+
+#include <stddef.h>
+
+/*
+ * NUMA placement of plugin memory
+ *
+ * Memory the NIC DMAs into should be local to the NIC. Code creating the
+ * resources of a device (domains, endpoints, communicators) runs inside an
+ * nccl_ofi_numa_scope for the NUMA node of the device: allocations made by
+ * the thread in the scope, including memory allocated by libfabric, prefer
+ * that node, and freelists created in the scope keep binding the blocks they
+ * add later to it.
+ *
+ * Placement is a preference: allocations fall back to other nodes when the
+ * local one is exhausted. Nothing is done for threads whose memory policy
+ * was set by the application, or if OFI_NCCL_NUMA_LOCAL_ALLOC is disabled.
+ */
+
+/* NUMA node value meaning no particular node */
+#define NCCL_OFI_NUMA_NODE_ANY (-1)
+
+/*
+ * @brief	NUMA node preferred by the scope the calling thread runs in
+ *
+ * @return	NUMA node, or NCCL_OFI_NUMA_NODE_ANY outside of a scope
+ */
+int nccl_ofi_numa_current_node(void);
+
+/*
+ * @brief	Bind memory pages that were not touched yet to a NUMA node
+ *
+ * The binding is a preference. Does nothing if numa_node is
+ * NCCL_OFI_NUMA_NODE_ANY or NUMA local allocation is disabled.
+ *
+ * @param	ptr
+ *		Page aligned start of the memory
+ * @param	size
+ *		Size of the memory
+ * @return	0, on success or if the binding is not supported
+ *		error, on others
+ */
+int nccl_ofi_numa_bind(void *ptr, size_t size, int numa_node);
+
+/*
+ * Scope in which the calling thread prefers a NUMA node
+ *
+ * Scopes nest; the previous preference is restored when the scope ends.
+ */
+class nccl_ofi_numa_scope {
+public:
+	explicit nccl_ofi_numa_scope(int numa_node);
+	~nccl_ofi_numa_scope();
+
+	nccl_ofi_numa_scope(const nccl_ofi_numa_scope &) = delete;
+	nccl_ofi_numa_scope &operator=(const nccl_ofi_numa_scope &) = delete;
+
+private:
+	int prev_node;
+	/* Whether the scope changed the memory policy of the thread */
+	bool set_policy;
+};
+
+#endif  // End NCCL_OFI_NUMA_H_
@@ -80,6 +80,18 @@ ofi_av_result nccl_ofi_ofiutils_av_create(ofi_domain_ptr &domain);
  */
 ofi_cq_result nccl_ofi_ofiutils_cq_create(ofi_domain_ptr &domain, struct fi_cq_attr *cq_attr);
 
+/**
+ * @brief	Create a completion queue with a file descriptor wait object
+ *		if OFI_NCCL_CQ_WAIT is enabled and the provider supports it,
+ *		or without wait object otherwise
+ *
+ * @param domain:	Domain handle
+ * @param cq_attr:	CQ attributes. wait_obj is set to the wait object
+ *			the queue was created with.
+ * @return		Result containing error code and completion queue pointer
+ */
+ofi_cq_result nccl_ofi_ofiutils_cq_create_waitable(ofi_domain_ptr &domain, struct fi_cq_attr *cq_attr);
+
 /**
  * @brief	Register memory region with libfabric using fi_mr_regattr
  *
@@ -97,12 +97,152 @@ OFI_NCCL_PARAM(bool, mr_cache_disable, "MR_CACHE_DISABLE",
 #endif
 		);
 
+/*
+ * Keep registrations of device buffers NCCL deregisters in the MR cache, so
+ * that registering the same buffer again does not require a new registration
+ * with the device. Registrations of host memory are never kept, as pages
+ * freed through malloc() can be reused at the same address without any
+ * observable unmap. Only safe if the application does not free and
+ * reallocate registered device memory while the plugin is in use, which is
+ * why this is disabled by default.
+ */
+OFI_NCCL_PARAM(bool, mr_cache_lazy_dereg, "MR_CACHE_LAZY_DEREG", false);
+
+/*
+ * Monitor munmap(), mremap(), madvise() and brk() calls of the process and
+ * drop MR cache entries overlapping host memory that is released, before the
+ * address range can be reused. Calls are intercepted by rewriting the GOT of
+ * loaded objects, which does not cover memory libc releases internally, such
+ * as large blocks passed to free(), so this is a best-effort safeguard and
+ * does not make lazy deregistration of host memory safe. All entries are
+ * dropped if more ranges were released than the monitor could record.
+ */
+OFI_NCCL_PARAM(bool, mr_cache_monitor, "MR_CACHE_MONITOR", false);
+
+/*
+ * Maximum size of a GPU memory registration formed by merging a new
+ * registration with cached registrations of the same allocation it overlaps
+ * or is adjacent to. Merging reduces the number of MRs the NIC has to track.
+ * Only applies to the RDMA protocol, for buffers not registered through
+ * DMA-BUF. 0 disables merging.
+ */
+OFI_NCCL_PARAM(size_t, mr_cache_merge_max_size, "MR_CACHE_MERGE_MAX_SIZE", 0);
+
+/*
+ * Maximum number of unused registrations kept by the MR cache of a domain with
+ * lazy deregistration. Least recently used registrations are released first.
+ * 0 means no limit.
+ */
+OFI_NCCL_PARAM(size_t, mr_cache_max_idle_entries, "MR_CACHE_MAX_IDLE_ENTRIES", 1024);
+
+/*
+ * Maximum number of bytes covered by unused registrations kept by the MR cache
+ * of a domain with lazy deregistration. 0 means no limit.
+ */
+OFI_NCCL_PARAM(size_t, mr_cache_max_idle_size, "MR_CACHE_MAX_IDLE_SIZE", (1UL << 30));
+
+/*
+ * Back internal registered buffers (freelist blocks) with huge pages, so that
+ * a single registration covers more entries and the NIC needs fewer
+ * translation entries. Valid options are NONE, THP (transparent huge pages,
+ * requested with madvise()) and HUGETLB (pages from the hugetlbfs pool,
+ * falling back to transparent huge pages when the pool is exhausted).
+ * Freelist blocks of at least half a huge page are grown in units of huge
+ * pages.
+ */
+OFI_NCCL_PARAM_VALUE_SET(HUGEPAGES, (NONE)(THP)(HUGETLB))
+OFI_NCCL_PARAM(HUGEPAGES, mr_buffer_hugepages, "MR_BUFFER_HUGEPAGES", HUGEPAGES::NONE)
+
+/*
+ * Number of free entries above which the rx buffer freelists of an RDMA
+ * endpoint deregister and unmap blocks with no entry in use, until half as
+ * many entries are free. Returns memory pinned by bursts of traffic to the
+ * system. Trimming runs when polling the completion queues of the endpoint
+ * finds nothing, not while buffers are released. 0 disables trimming.
+ */
+OFI_NCCL_PARAM(size_t, freelist_trim_watermark, "FREELIST_TRIM_WATERMARK", 0);
+
+/*
+ * Place memory of a device (rx buffers, flush buffers, request freelists and
+ * memory libfabric allocates while creating domains and endpoints) on the
+ * NUMA node closest to the device's NIC, as reported by hwloc. Placement is a
+ * preference, and is skipped for threads the application bound to NUMA nodes
+ * itself.
+ */
+OFI_NCCL_PARAM(bool, numa_local_alloc, "NUMA_LOCAL_ALLOC", true);
+
 /*
  * Maximum number of cq entries to read in a single call to
  * fi_cq_read.
  */
 OFI_NCCL_PARAM(size_t, cq_read_count, "CQ_READ_COUNT", 4);
 
+/*
+ * Maximum number of cq entries to read in a single call to fi_cq_read on
+ * the rails of RDMA endpoints. The number read starts at
+ * OFI_NCCL_CQ_READ_COUNT and grows up to this value while reads return
+ * as many entries as requested.
+ */
+OFI_NCCL_PARAM(size_t, cq_read_max_count, "CQ_READ_MAX_COUNT", 64);
+
+/*
+ * Maximum number of cq entries an RDMA endpoint processes per progress
+ * call, across all rails, before returning to the caller. Entries left
+ * are processed by the next call. 0 drains the completion queues.
+ */
+OFI_NCCL_PARAM(size_t, cq_poll_budget, "CQ_POLL_BUDGET", 256);
+
+/*
+ * Run a progress thread per RDMA device. The thread processes completions
+ * and retries pending requests of the device's endpoints in the
+ * background, whenever no application thread holds or waits for the
+ * endpoint, so that NCCL calls mostly find them processed. Application
+ * threads then leave completion processing to the thread.
+ */
+OFI_NCCL_PARAM(bool, progress_thread, "PROGRESS_THREAD", false);
+
+/*
+ * CPU the progress thread of each device is pinned to. -1 picks one of the
+ * CPUs local to the device's NICs, counting from the last one so as to
+ * stay clear of application threads, and different for every device where
+ * possible. The thread is not pinned if the topology does not tell.
+ */
+OFI_NCCL_PARAM(int, progress_thread_cpu, "PROGRESS_THREAD_CPU", -1);
+
+/*
+ * Number of polls without progress after which the progress thread sleeps
+ * between polls
+ */
+OFI_NCCL_PARAM(unsigned int, progress_thread_spin_count, "PROGRESS_THREAD_SPIN_COUNT", 1000);
+
+/*
+ * Longest sleep, in microseconds, of the progress thread between polls
+ * without progress. Sleeps start at a microsecond and double.
+ */
+OFI_NCCL_PARAM(unsigned int, progress_thread_max_sleep_us, "PROGRESS_THREAD_MAX_SLEEP_US", 50);
+
+/*
+ * Create completion queues with a file descriptor wait object, if the
+ * provider supports it, and block on them instead of spinning once an
+ * endpoint is idle. Waiting for a receive (RDMA protocol) or any request
+ * (SENDRECV protocol) then blocks for up to OFI_NCCL_CQ_WAIT_TIMEOUT_MS
+ * once the endpoint processed no completion for OFI_NCCL_CQ_WAIT_SPIN_US.
+ * Disabled by OFI_NCCL_PROGRESS_THREAD, whose thread drains the queues.
+ */
+OFI_NCCL_PARAM(bool, cq_wait, "CQ_WAIT", false);
+
+/*
+ * Time in microseconds an endpoint spins without completions before
+ * blocking on its completion queues
+ */
+OFI_NCCL_PARAM(unsigned int, cq_wait_spin_us, "CQ_WAIT_SPIN_US", 1000);
+
+/*
+ * Longest time in milliseconds a call blocks on the completion queues, as
+ * NCCL needs the call to return to progress other operations
+ */
+OFI_NCCL_PARAM(int, cq_wait_timeout_ms, "CQ_WAIT_TIMEOUT_MS", 1);
+
 /*
  * Maximum number of iterations for GIN CQ processing loop.
  */
@@ -165,6 +305,17 @@ OFI_NCCL_PARAM(unsigned long int, min_stripe_size, "MIN_STRIPE_SIZE", (128 * 102
  */
 OFI_NCCL_PARAM(unsigned long int, sched_max_small_msg_size, "SCHED_MAX_SMALL_RR_SIZE", 64);
 
+/*
+ * Scheduler striping messages across the rails of the RDMA protocol. Valid
+ * options are THRESHOLD, which stripes messages equally across a number of
+ * rails derived from OFI_NCCL_MIN_STRIPE_SIZE, and ADAPTIVE, which sizes
+ * stripes from the bytes outstanding on each rail, the rate at which writes
+ * complete and the rate at which posts return EAGAIN, so that slower or
+ * congested rails get less data.
+ */
+OFI_NCCL_PARAM_VALUE_SET(SCHEDULER, (THRESHOLD)(ADAPTIVE))
+OFI_NCCL_PARAM(SCHEDULER, scheduler, "SCHEDULER", SCHEDULER::THRESHOLD)
+
 /*
  * Deprecated value to control both eager and control bounce counts.
  */
@@ -179,6 +330,21 @@ OFI_NCCL_PARAM_REMOVED(size_t, rdma_max_posted_bounce_buffers,
 		       "RDMA_MAX_POSTED_BOUNCE_BUFFERS", 0,
 		       "Please use OFI_NCCL_RDMA_MAX_POSTED_CONTROL_BUFFERS or OFI_NCCL_RDMA_MAX_POSTED_EAGER_BUFFERS.");
 
+/*
+ * Track the health of the rails of RDMA endpoints. Rails reporting completion
+ * errors, rails whose posts keep returning EAGAIN while other rails do not,
+ * and rails whose completion latency is an outlier are avoided by the
+ * scheduler and for control messages until a cool-down period ends, after
+ * which they are probed with traffic again.
+ */
+OFI_NCCL_PARAM(bool, rail_health, "RAIL_HEALTH", true);
+
+/*
+ * Cool-down period, in milliseconds, for which a degraded rail is avoided. The
+ * period doubles every time a rail fails probing, up to 64 times this value.
+ */
+OFI_NCCL_PARAM(size_t, rail_health_cooldown_ms, "RAIL_HEALTH_COOLDOWN_MS", 100);
+
 /*
  * Minimum eager rx buffers posted per endpoint. The plugin will attempt to post
  * more rx buffers if we dip below this threshold, allocating new rx buffers if
@@ -208,6 +374,28 @@ OFI_NCCL_PARAM(size_t, rdma_min_posted_control_buffers, "RDMA_MIN_POSTED_CONTROL
  */
 OFI_NCCL_PARAM(size_t, rdma_max_posted_control_buffers, "RDMA_MAX_POSTED_CONTROL_BUFFERS", 32);
 
+/*
+ * Size the number of eager and control rx buffers posted to each rail by
+ * the consumption of the rail, between OFI_NCCL_RDMA_RX_BUFF_WINDOW_FLOOR
+ * and the RDMA_MAX_POSTED_*_BUFFERS limit, instead of always posting the
+ * limit. The minimum parameters then scale with the window. An idle
+ * rail halves its window every epoch, and the rx buffer memory above the
+ * windows is released.
+ */
+OFI_NCCL_PARAM(bool, rdma_rx_buff_autoscale, "RDMA_RX_BUFF_AUTOSCALE", true);
+
+/*
+ * Number of eager, and of control, rx buffers posted per endpoint while
+ * the endpoint is idle, when rx buffer autoscaling is enabled
+ */
+OFI_NCCL_PARAM(size_t, rdma_rx_buff_window_floor, "RDMA_RX_BUFF_WINDOW_FLOOR", 16);
+
+/*
+ * Time in microseconds over which the consumption of rx buffers of a rail
+ * is measured to size its window
+ */
+OFI_NCCL_PARAM(unsigned int, rdma_rx_buff_window_epoch_us, "RDMA_RX_BUFF_WINDOW_EPOCH_US", 1000);
+
 /*
  * Whether to spread the control message across multiple rails in round robin fashion or
  * send it consistenly on one rail.
@@ -226,6 +414,83 @@ OFI_NCCL_PARAM(float, net_latency, "NET_LATENCY", 0.0);
  */
 OFI_NCCL_PARAM(int, eager_max_size, "EAGER_MAX_SIZE", 8192);
 
+/*
+ * Let each send communicator learn its eager threshold from how early
+ * control messages arrive and how long eager sends take to complete, when
+ * using RDMA protocol. The threshold starts at the eager message size limit
+ * and stays within OFI_NCCL_EAGER_ADAPTIVE_MAX_SIZE.
+ */
+OFI_NCCL_PARAM(bool, eager_adaptive, "EAGER_ADAPTIVE", false);
+
+/*
+ * Largest eager threshold learned with OFI_NCCL_EAGER_ADAPTIVE, which lets
+ * the threshold rise above the eager message size limit when control
+ * messages are slow to arrive. Eager rx buffers are sized for it, so it
+ * must be set to the same value on all ranks, and must not exceed
+ * OFI_NCCL_MIN_STRIPE_SIZE. Smaller values, including the default -1, use
+ * the eager message size limit.
+ */
+OFI_NCCL_PARAM(int, eager_adaptive_max_size, "EAGER_ADAPTIVE_MAX_SIZE", -1);
+
+/*
+ * Copy eager messages received into host buffers with memcpy instead of a
+ * loopback RDMA read through the NIC.
+ */
+OFI_NCCL_PARAM(bool, eager_host_copy, "EAGER_HOST_COPY", true);
+
+/*
+ * Copy eager messages up to this size received into CUDA buffers with
+ * GDRCopy instead of a loopback RDMA read. CUDA buffers are mapped with
+ * GDRCopy when registered, which consumes BAR space, so this is disabled
+ * (0) by default.
+ */
+OFI_NCCL_PARAM(size_t, eager_device_copy_max_size, "EAGER_DEVICE_COPY_MAX_SIZE", 0);
+
+/*
+ * Maximum number of buffers NCCL may group into a single receive when using
+ * RDMA protocol (capped to 8). The sender matches the tags of its sends
+ * against the buffers of a group, which requires the receiver's control
+ * message, so eager messages are disabled when this is larger than 1. Must
+ * be set to the same value on all ranks; connections between ranks using
+ * different values are refused.
+ */
+OFI_NCCL_PARAM(unsigned int, rdma_max_group_receives, "RDMA_MAX_GROUP_RECEIVES", 1);
+
+/*
+ * Send compact RDMA control messages, which refer to mr keys the sender
+ * already received instead of carrying them, and write control messages
+ * inline, without a registered buffer or a completion, when they fit the
+ * provider's inject size.
+ */
+OFI_NCCL_PARAM(bool, rdma_compact_ctrl_msg, "RDMA_COMPACT_CTRL_MSG", true);
+
+/*
+ * Open RDMA domains with FI_THREAD_SAFE threading instead of
+ * FI_THREAD_COMPLETION. Sends then post their operations to the provider
+ * without the endpoint lock, so they do not wait for the thread processing
+ * the completions of the endpoint, such as the progress thread.
+ */
+OFI_NCCL_PARAM(bool, rdma_thread_safe_domain, "RDMA_THREAD_SAFE_DOMAIN", false);
+
+/*
+ * Maximum number of RDMA control messages of consecutive receives written
+ * to the sender with a single RDMA write. Control messages are held back
+ * until the batch is full, the sender's mailbox wraps around, or the
+ * endpoint makes progress (a request is tested, or a send waits for a
+ * control message) OFI_NCCL_RDMA_CTRL_BATCH_TIMEOUT_US after the first
+ * message was queued. This delays control messages by up to the time to
+ * the next progress of the endpoint, so batching is disabled by default
+ * (1).
+ */
+OFI_NCCL_PARAM(unsigned int, rdma_ctrl_batch_max, "RDMA_CTRL_BATCH_MAX", 1);
+
+/*
+ * Time in microseconds RDMA control messages may be held back for
+ * batching. With 0, batches are written the next time the endpoint makes
+ * progress, so only receives posted back-to-back are batched.
+ */
+OFI_NCCL_PARAM(unsigned int, rdma_ctrl_batch_timeout_us, "RDMA_CTRL_BATCH_TIMEOUT_US", 0);
+
 /*
  * Decide whether or not mutexes should default to errorcheck mode.
  * Defaults to no, unless debugging is enabled, in which case it
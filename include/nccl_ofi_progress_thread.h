@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#ifndef NCCL_OFI_PROGRESS_THREAD_H_
+#define NCCL_OFI_PROGRESS_THREAD_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Backoff of a polling loop
+ *
+ * The loop busy-polls while polls make progress and for a number of idle
+ * polls after that. Further idle polls are separated by sleeps starting at
+ * a microsecond and doubling up to the maximum.
+ */
+class nccl_ofi_progress_backoff {
+public:
+	nccl_ofi_progress_backoff(unsigned int spin_count, uint64_t max_sleep_ns);
+
+	/*
+	 * @brief	Report a poll
+	 *
+	 * @param	progressed
+	 *		Whether the poll made progress
+	 * @return	time to sleep before the next poll, in nanoseconds
+	 */
+	uint64_t report_poll(bool progressed);
+
+private:
+	unsigned int spin_count;
+	uint64_t max_sleep_ns;
+
+	/* Idle polls since the last progress */
+	unsigned int num_idle;
+	uint64_t sleep_ns;
+};
+
+/*
+ * Background thread making progress on registered objects
+ *
+ * The thread calls the progress function of every registered object in
+ * turn, yielding between polls while progress is made and backing off
+ * when idle. Progress functions must not block on locks taken by
+ * application threads, and should skip objects application threads wait
+ * for, so they do not delay them.
+ */
+class nccl_ofi_progress_thread {
+public:
+	/* Make progress on `ctx'. Returns the number of completions
+	 * processed, or a negative errno value on failure. */
+	typedef int (*progress_fn_t)(void *ctx);
+
+	/*
+	 * @brief	Start a progress thread
+	 *
+	 * @param	cpu
+	 *		CPU to pin the thread to, or -1
+	 * @param	spin_count
+	 *		Number of idle polls before the thread sleeps
+	 * @param	max_sleep_ns
+	 *		Longest sleep between idle polls
+	 */
+	nccl_ofi_progress_thread(int cpu, unsigned int spin_count, uint64_t max_sleep_ns);
+
+	/* Stop and join the thread */
+	~nccl_ofi_progress_thread();
+
+	nccl_ofi_progress_thread(const nccl_ofi_progress_thread &) = delete;
+	nccl_ofi_progress_thread &operator=(const nccl_ofi_progress_thread &) = delete;
+
+	/* Start making progress on `ctx' */
+	void add(void *ctx, progress_fn_t fn);
+
+	/*
+	 * @brief	Stop making progress on `ctx'
+	 *
+	 * Once this returns, the progress function is neither running
+	 * on `ctx' nor called again.
+	 */
+	void remove(void *ctx);
+
+private:
+	struct target {
+		void *ctx;
+		progress_fn_t fn;
+		/* Whether the progress function failed, after which the
+		 * object is left to the application threads */
+		bool failed;
+	};
+
+	void run(int cpu);
+
+	nccl_ofi_progress_backoff backoff;
+
+	/* Protects targets. Held by the thread while it polls them. */
+	std::mutex lock;
+	std::vector<target> targets;
+
+	/* Wakes the thread from sleeps when it must stop */
+	std::mutex stop_lock;
+	std::condition_variable stop_cond;
+	std::atomic<bool> stop;
+
+	std::thread thread;
+};
+
+#endif  // End NCCL_OFI_PROGRESS_THREAD_H_
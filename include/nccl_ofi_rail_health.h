@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#ifndef NCCL_OFI_RAIL_HEALTH_H_
+#define NCCL_OFI_RAIL_HEALTH_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+/*
+ * Health tracking of the rails of an endpoint
+ *
+ * A rail is degraded when a completion reports an error, when posts to
+ * the rail keep returning -FI_EAGAIN, or when its completion latency
+ * becomes an outlier compared to the fastest rail. Degraded rails are
+ * not usable for a cool-down period. After the cool-down, the rail is
+ * probed with traffic again: it becomes healthy after enough successful
+ * completions, or is degraded again with a doubled cool-down.
+ *
+ * At least one rail is always usable. The caller must ensure serialized
+ * access.
+ */
+class nccl_ofi_rail_health {
+public:
+	/* Clock returning a monotonic time in nanoseconds */
+	typedef uint64_t (*clock_fn_t)(void);
+
+	enum rail_state {
+		RAIL_HEALTHY,
+		RAIL_DEGRADED,
+		RAIL_PROBING,
+	};
+
+	/* Health of a rail */
+	struct rail {
+		rail_state state;
+		/* Average fraction of posts returning -FI_EAGAIN */
+		double eagain_rate;
+		/* Average completion latency */
+		double latency_ns;
+		/* Number of latency samples since the rail became usable */
+		unsigned int num_latency_samples;
+		/* Successful completions since the rail started probing */
+		unsigned int num_probe_compls;
+		/* Time at which a degraded rail starts probing */
+		uint64_t degraded_until_ns;
+		/* Cool-down applied the next time the rail is degraded */
+		uint64_t cooldown_ns;
+		/* Number of times the rail was degraded */
+		unsigned int num_degraded;
+	};
+
+	/*
+	 * @brief	Construct health tracking for `num_rails' rails
+	 *
+	 * @param	clock_fn
+	 *		Clock used to time cool-downs. NULL selects
+	 *		std::chrono::steady_clock.
+	 */
+	nccl_ofi_rail_health(int num_rails, clock_fn_t clock_fn = NULL);
+
+	/*
+	 * @brief	Report a completion with error on a rail
+	 *
+	 * @return	true, if the set of usable rails changed
+	 */
+	bool report_error(int rail_id);
+
+	/*
+	 * @brief	Report that posting an operation to a rail returned
+	 *		-FI_EAGAIN
+	 *
+	 * @return	true, if the set of usable rails changed
+	 */
+	bool report_eagain(int rail_id);
+
+	/*
+	 * @brief	Report a successful completion on a rail
+	 *
+	 * @param	start_ns
+	 *		Time the operation was started, or 0 if unknown
+	 *
+	 * @return	true, if the set of usable rails changed
+	 */
+	bool report_completion(int rail_id, uint64_t start_ns);
+
+	/*
+	 * @brief	Start probing degraded rails whose cool-down ended
+	 *
+	 * @return	true, if the set of usable rails changed
+	 */
+	bool update();
+
+	/* Bitmask of the rails that may be used */
+	uint64_t usable_rails() const
+	{
+		return usable_mask;
+	}
+
+	/* Whether any rail is degraded */
+	bool has_degraded_rails() const
+	{
+		return num_degraded_rails != 0;
+	}
+
+	uint64_t now() const
+	{
+		return clock_fn();
+	}
+
+	std::vector<rail> rails;
+
+private:
+	bool degrade(int rail_id, const char *reason);
+
+	clock_fn_t clock_fn;
+	uint64_t usable_mask;
+	int num_degraded_rails;
+	uint64_t base_cooldown_ns;
+	uint64_t max_cooldown_ns;
+};
+
+#endif  // End NCCL_OFI_RAIL_HEALTH_H_
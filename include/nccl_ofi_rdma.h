@@ -9,15 +9,26 @@
 #include <rdma/fabric.h>
 
 #include <array>
+#include <atomic>
 #include <deque>
+#include <memory>
+#include <mutex>
 
 #include "nccl_ofi.h"
 #include "cm/nccl_ofi_cm.h"
+#include "nccl_ofi_device_copy.h"
+#include "nccl_ofi_dlist.h"
+#include "nccl_ofi_eager_threshold.h"
 #include "nccl_ofi_ep_addr_list.h"
 #include "nccl_ofi_freelist.h"
 #include "nccl_ofi_idpool.h"
 #include "nccl_ofi_log.h"
 #include "nccl_ofi_msgbuff.h"
+#include "nccl_ofi_rail_health.h"
+#include "nccl_ofi_cq_poller.h"
+#include "nccl_ofi_cq_wait.h"
+#include "nccl_ofi_progress_thread.h"
+#include "nccl_ofi_rx_window.h"
 #include "nccl_ofi_scheduler.h"
 #include "nccl_ofi_topo.h"
 #include "nccl_ofi_ofiutils.h"
@@ -101,6 +112,8 @@ typedef enum nccl_net_ofi_rdma_req_type {
 	NCCL_OFI_RDMA_EAGER_RX_BUFF,
 	/* Flush request */
 	NCCL_OFI_RDMA_FLUSH,
+	/* Grouped receive request. Parent of one NCCL_OFI_RDMA_RECV per buffer */
+	NCCL_OFI_RDMA_RECV_GROUP,
 	/* Invalid type */
 	NCCL_OFI_RDMA_INVALID_TYPE,
 } nccl_net_ofi_rdma_req_type_t;
@@ -135,7 +148,10 @@ class nccl_net_ofi_rdma_mr_handle_t : public nccl_net_ofi_mr_handle_t {
 	nccl_net_ofi_rdma_mr_handle_t(size_t num_rails_arg)
 		: nccl_net_ofi_mr_handle_t(0),
 		  num_rails(num_rails_arg),
-		  base_addr(0)
+		  base_addr(0),
+		  type(0),
+		  device_copy_handle(NULL),
+		  device_copy_base(0)
 	{
 	}
 
@@ -153,12 +169,74 @@ class nccl_net_ofi_rdma_mr_handle_t : public nccl_net_ofi_mr_handle_t {
 
 	/* Base address of the registered memory region for offset calculation */
 	uintptr_t base_addr;
+
+	/* Type of the registered memory (NCCL_PTR_*) */
+	int type;
+
+	/* Device copy registration of a CUDA memory region, used to copy
+	   eager data with the CPU; NULL if not registered */
+	nccl_ofi_device_copy::RegHandle *device_copy_handle;
+
+	/* Address of the memory registered as `device_copy_handle' */
+	uintptr_t device_copy_base;
 };
 
 /* @brief Control message Flags
- * Currently a single flag to set receive completion optional
  */
+/* Receive completion is optional */
 #define NCCL_OFI_RDMA_FLAG_RECV_COMPLETION_OPT (1 << 0)
+/* Compact control message: only the header was written, and the
+ * destination buffer is given relative to an entry of the MR key table */
+#define NCCL_OFI_RDMA_FLAG_COMPACT (1 << 1)
+/* Full control message that also defines entry `key_idx' of the MR key
+ * table */
+#define NCCL_OFI_RDMA_FLAG_KEY_DEFINE (1 << 2)
+
+/*
+ * Number of entries of the MR key table of a communicator
+ *
+ * The receiver defines an entry with a full control message, recording
+ * the mr keys and the buffer offset of the message. Once a write of the
+ * sender shows that the sender read this control message, later control
+ * messages for buffers with the same mr keys are compact: they only
+ * refer to the entry and give the offset of their buffer relative to the
+ * buffer offset of the entry. A key defining control message never
+ * makes the receive completion optional, so that the write shows up in
+ * the completion queue of the receiver.
+ */
+#define NCCL_OFI_CTRL_KEY_TABLE_SIZE (16)
+
+/*
+ * @brief Control message header
+ *
+ * Part of the control message written by all control messages. Compact
+ * control messages only write the header, which is small enough to be
+ * written inline.
+ */
+typedef struct nccl_net_ofi_ctrl_msg_hdr {
+	/* Destination buffer offset relative to the buffer offset of MR
+	 * key table entry `key_idx' (compact control messages) */
+	int32_t buff_delta;
+
+	/* Destination buffer len */
+	uint32_t buff_len;
+
+	/* MR key table entry (compact, or key defining control messages) */
+	uint8_t key_idx;
+
+	/* NCCL_OFI_RDMA_FLAG_* */
+	uint8_t flags;
+
+	uint8_t padding[4];
+
+	/* Control message sequence number. The is also used as the
+	* ready bit to indicate that the control message has been posted.
+	* It is last, so that it is written last.
+	*/
+	uint16_t msg_seq_num;
+} nccl_net_ofi_ctrl_msg_hdr_t;
+static_assert(sizeof(nccl_net_ofi_ctrl_msg_hdr_t) == 16,
+	      "Wrong size for RDMA Control message header");
 
 /*
  * @brief Control messages
@@ -166,6 +244,8 @@ class nccl_net_ofi_rdma_mr_handle_t : public nccl_net_ofi_mr_handle_t {
  * The control message contains the destination buffer address, mr keys,
  * message sequence number and padding to align it to cache line size.
  * It is used by the receiver to post the control message to the sender.
+ * Compact control messages only write the header at the end of the
+ * message.
  */
 typedef struct nccl_net_ofi_ctrl_msg {
 
@@ -174,24 +254,21 @@ typedef struct nccl_net_ofi_ctrl_msg {
 	 * For offset mode, this is the offset from the MR base address. */
 	uintptr_t buff_offset;
 
-	/* mr keys to write to the destination buffer.
-	* TODO: We are currently burning 32B for the mr_key and this needs to
-	* be reduced further to ensure that the control msg write is inlined */
+	/* mr keys to write to the destination buffer */
 	uint64_t mr_key[MAX_NUM_RAILS];
 
-	/* Destination buffer len */
-	uint32_t buff_len;
+	/* Tag of the receive buffer, matched against the tag of the send
+	 * when the buffer is part of a grouped receive */
+	int32_t tag;
 
-	/* Flags to indicate if recv completion is optional or not */
-	uint16_t flags;
+	/* Number of buffers of the grouped receive this buffer belongs to,
+	 * 1 for an ungrouped receive. The buffers of a group have
+	 * consecutive sequence numbers. */
+	uint16_t group_size;
 
-	/* Control message sequence number. The is also used as the
-	* ready bit to indicate that the control message has been posted.
-	*/
-	uint16_t msg_seq_num;
+	uint8_t padding[2];
 
-	/* Padding to ensure we are aligned to cache line*/
-	uint8_t cache_line_padding[16];
+	nccl_net_ofi_ctrl_msg_hdr_t hdr;
 } nccl_net_ofi_ctrl_msg_t;
 /* Assert to make sure that the control message on the wire
  * is of cache line size */
@@ -203,6 +280,22 @@ static inline size_t nccl_net_ofi_rdma_ctrl_msg_size()
 	return sizeof(nccl_net_ofi_ctrl_msg_t);
 }
 
+/*
+ * @brief	Entry of the MR key table of a communicator
+ */
+typedef struct nccl_net_ofi_ctrl_key_entry {
+	/* Buffer offset of the control message that defined the entry */
+	uintptr_t buff_offset;
+
+	uint64_t mr_key[MAX_NUM_RAILS];
+
+	/* Receiver only: sequence number of the control message that
+	 * defined the entry, and whether the sender read it */
+	uint16_t msg_seq_num;
+	bool acked;
+	bool valid;
+} nccl_net_ofi_ctrl_key_entry_t;
+
 /*
  * The ctrl mailbox size is set to 2 * NCCL_OFI_MAX_REQUESTS to ensure that
  * the sender's mailobox is never overwritten. The logic is as follows:
@@ -244,6 +337,18 @@ typedef struct nccl_net_ofi_flush_data {
    need to be 128B aligned */
 #define EAGER_RX_BUFFER_ALIGNMENT 128
 
+/* Number of requests in a magazine of the request freelists. Requests are
+   allocated by the posting thread and may be released by the thread calling
+   test() or by the one draining the completion queues. */
+#define RDMA_REQ_FL_MAGAZINE_SIZE 8
+
+/* Magazines of other threads may hold up to 2 * RDMA_REQ_FL_MAGAZINE_SIZE
+   free requests each, see nccl_ofi_freelist_mt. Request freelists are sized
+   above the limit of inflight requests accordingly, which is enforced by
+   the communicators. */
+#define RDMA_REQ_FL_MAX_ENTRIES(max_reqs) \
+	((max_reqs) + 2 * RDMA_REQ_FL_MAGAZINE_SIZE * nccl_ofi_freelist_mt::MAX_THREADS)
+
 class nccl_net_ofi_rdma_device_t;
 class nccl_net_ofi_rdma_domain_t;
 class nccl_net_ofi_rdma_ep_t;
@@ -316,6 +421,8 @@ typedef struct {
 	/* Schedule used to transfer this request. We save the pointer to
 	 * reference it when transferring the request over network. */
 	nccl_net_ofi_schedule_t *schedule;
+	/* Storage of `schedule', so that sends do not allocate schedules */
+	nccl_net_ofi_schedule_buf<MAX_NUM_RAILS> schedule_buf;
 	/* Total number of completions. Expect one completion for receiving the
 	 * control message and one completion for each send segment. */
 	int total_num_compls;
@@ -328,6 +435,9 @@ typedef struct {
 	 * True to use fi_write instead of fi_writedata in send() 
 	 */
 	bool no_target_completion;
+	/* Time an eager message was posted, if the communicator learns its
+	 * eager threshold */
+	uint64_t eager_post_ns;
 #if HAVE_NVTX_TRACING
 	nvtxRangeId_t trace_id;
 	nvtxRangeId_t seg_trace_id[MAX_NUM_RAILS];
@@ -375,6 +485,17 @@ typedef struct {
 	nccl_net_ofi_rdma_req *recv_segms_req;
 	/* (Eager messages) pointer to eager local copy request */
 	nccl_net_ofi_rdma_req *eager_copy_req;
+	/* MR key table entry defined by the control message, or -1 */
+	int ctrl_key_idx;
+	/* Control messages written with the one of this request, if it
+	 * heads a batch: next request of the batch and number of messages */
+	nccl_net_ofi_rdma_req *ctrl_batch_next;
+	uint16_t ctrl_batch_len;
+	/* Control rail of the last attempt to write the control message */
+	uint16_t ctrl_rail_id;
+	/* Grouped receive the request is part of, or NULL. Its state is
+	 * updated whenever the state of the request is. */
+	nccl_net_ofi_rdma_req *group_req;
 	/* Total number of completions. Expect one send ctrl
 	 * completion and one completion that indicates that all
 	 * segments have arrived.
@@ -388,6 +509,16 @@ typedef struct {
 #endif
 } rdma_req_recv_data_t;
 
+/*
+ * @brief	Data of request responsible for a grouped receive
+ */
+typedef struct {
+	/* Number of buffers in the group */
+	int num_recvs;
+	/* Receive requests, one per buffer */
+	nccl_net_ofi_rdma_req *recv_reqs[NCCL_OFI_MAX_RECVS];
+} rdma_req_recv_group_data_t;
+
 /*
  * @brief	Data of request responsible for flush operatoin
  */
@@ -422,18 +553,22 @@ struct nccl_net_ofi_rdma_req_ctx_list {
 };
 
 /*
- * @brief	RDMA request
+ * @brief	Fields of an RDMA request accessed by every completion and test
+ *
+ * Completions are processed under the endpoint lock, but test() checks
+ * the state, and reads the size once the state is completed, without
+ * it. Completion handlers update size and ncompls before they set the
+ * state to completed.
  */
-class nccl_net_ofi_rdma_req : public nccl_net_ofi_req {
-public:
-	nccl_net_ofi_rdma_req();
-	
-	int test(int *done, int *size_p) override;
+struct nccl_net_ofi_rdma_req_hot {
+	/* State of request */
+	std::atomic<nccl_net_ofi_rdma_req_state_t> state;
 
-	nccl_net_ofi_rdma_req_ctx_list ctx;
+	/* Type of request */
+	nccl_net_ofi_rdma_req_type_t type;
 
-	/* Associated Comm object */
-	nccl_net_ofi_comm *comm;
+	/* Number of arrived request completions */
+	std::atomic<int> ncompls;
 
 	/* Associated Device ID */
 	int dev_id;
@@ -441,13 +576,36 @@ class nccl_net_ofi_rdma_req : public nccl_net_ofi_req {
 	/* Message sequence number */
 	uint16_t msg_seq_num;
 
-	/* Number of arrived request completions */
-	int ncompls;
+	/* Size of completed request */
+	std::atomic<size_t> size;
+
+	/* Associated Comm object */
+	nccl_net_ofi_comm *comm;
+
+	/* Backpointer to freelist element */
+	nccl_ofi_freelist::fl_entry *elem;
+};
+
+/*
+ * @brief	RDMA request
+ *
+ * Requests are cache line aligned. The hot fields fill the first cache
+ * line, after the vtable pointer, followed by the data of the request
+ * type, and by the contexts of the rails, which only Libfabric accesses
+ * while the operations are in flight.
+ */
+class alignas(NCCL_OFI_DEFAULT_CPU_CACHE_LINE_SIZE) nccl_net_ofi_rdma_req
+	: public nccl_net_ofi_req, public nccl_net_ofi_rdma_req_hot {
+public:
+	nccl_net_ofi_rdma_req();
+	
+	int test(int *done, int *size_p) override;
 
 	union {
 		rdma_req_rma_op_data_t rma_op_data;
 		rdma_req_send_data_t send_data;
 		rdma_req_recv_data_t recv_data;
+		rdma_req_recv_group_data_t recv_group_data;
 		rdma_req_send_close_data_t send_close_data;
 		rdma_req_eager_copy_data_t eager_copy_data;
 		rdma_req_recv_segms_data_t recv_segms_data;
@@ -455,23 +613,7 @@ class nccl_net_ofi_rdma_req : public nccl_net_ofi_req {
 		rdma_req_rx_buff_data_t rx_buff_data;
 	};
 
-	/* Size of completed request */
-	size_t size;
-
-	/*
-	 * Protect updating critical fields such as size and ncompls when
-	 * network xfer happened over multiple rails
-	 */
-	pthread_mutex_t req_lock;
-
-	/* State of request */
-	nccl_net_ofi_rdma_req_state_t state;
-
-	/* Type of request */
-	nccl_net_ofi_rdma_req_type_t type;
-
-	/* Backpointer to freelist element */
-	nccl_ofi_freelist::fl_entry *elem;
+	nccl_net_ofi_rdma_req_ctx_list ctx;
 
 	/* Deinitialzie and free request. This function returns error
 	 * in cases where cleanup fails. This function may also return
@@ -481,6 +623,16 @@ class nccl_net_ofi_rdma_req : public nccl_net_ofi_req {
 
 };
 
+/* The hot fields follow the vtable pointer of nccl_net_ofi_req, the
+ * primary base, in the first cache line */
+static_assert(sizeof(void *) + sizeof(nccl_net_ofi_rdma_req_hot) <=
+	      NCCL_OFI_DEFAULT_CPU_CACHE_LINE_SIZE,
+	      "Hot fields of nccl_net_ofi_rdma_req must fit in its first cache line");
+static_assert(alignof(nccl_net_ofi_rdma_req) == NCCL_OFI_DEFAULT_CPU_CACHE_LINE_SIZE,
+	      "nccl_net_ofi_rdma_req must be cache line aligned");
+static_assert(sizeof(nccl_net_ofi_rdma_req) <= 10 * NCCL_OFI_DEFAULT_CPU_CACHE_LINE_SIZE,
+	      "nccl_net_ofi_rdma_req grew beyond 10 cache lines");
+
 /*
  * Rdma endpoint name
  *
@@ -516,9 +668,13 @@ typedef struct nccl_ofi_rdma_connection_info {
 	uint64_t ctrl_addr;
 	uint64_t ctrl_mr_key[MAX_NUM_RAILS];
 
+	/* Maximum number of grouped receives. Eager messages are disabled
+	 * when grouping is enabled, so both sides must agree on it */
+	uint16_t max_group_receives;
+
 } nccl_ofi_rdma_connection_info_t;
 /* Since this is a message on the wire, check that it has the expected size */
-static_assert(sizeof(nccl_ofi_rdma_connection_info_t) == 560,
+static_assert(sizeof(nccl_ofi_rdma_connection_info_t) == 568,
 			  "Wrong size for RDMA connect message");
 
 /*
@@ -560,7 +716,7 @@ class nccl_net_ofi_rdma_send_comm : public nccl_net_ofi_send_comm {
 	uint64_t num_inflight_reqs;
 	uint64_t num_inflight_writes;
 
-	nccl_ofi_freelist *nccl_ofi_reqs_fl;
+	nccl_ofi_freelist_mt *nccl_ofi_reqs_fl;
 
 	/* Comm ID provided by the local endpoint */
 	uint32_t local_comm_id;
@@ -570,6 +726,10 @@ class nccl_net_ofi_rdma_send_comm : public nccl_net_ofi_send_comm {
 
 	uint16_t next_msg_seq_num;
 
+	/* Buffers of the grouped receive starting at next_msg_seq_num
+	 * that were already matched by a send */
+	uint32_t group_matched_mask;
+
 	/* Number of rails */
 	uint16_t num_rails;
 	/* Number of control rails */
@@ -586,6 +746,20 @@ class nccl_net_ofi_rdma_send_comm : public nccl_net_ofi_send_comm {
 
 	bool comm_active;
 
+	/*
+	 * Serializes send(), write() and test() of the communicator's
+	 * requests. It is taken before the endpoint lock, which is only
+	 * held while Libfabric resources or state shared with completion
+	 * handlers are accessed, so threads driving different
+	 * communicators of an endpoint do not wait for each other outside
+	 * of these sections.
+	 *
+	 * Its holder may wait for the endpoint lock, so it is a mutex:
+	 * another thread calling on the communicator sleeps instead of
+	 * spinning behind it.
+	 */
+	std::mutex comm_lock;
+
 	/* Fixed-size array of communicator data rails */
 	std::array<nccl_net_ofi_rdma_send_comm_rail_t, MAX_NUM_RAILS> data_rails;
 	/* Fixed-size array of control communicator rails */
@@ -599,6 +773,19 @@ class nccl_net_ofi_rdma_send_comm : public nccl_net_ofi_send_comm {
 
 	/* Sender's control mailbox mr_handle */
 	nccl_net_ofi_rdma_mr_handle_t *ctrl_mr_handle;
+
+	/* MR key table defined by the receiver's control messages */
+	std::array<nccl_net_ofi_ctrl_key_entry_t, NCCL_OFI_CTRL_KEY_TABLE_SIZE> ctrl_key_table;
+
+	/* Eager threshold learned online, or NULL if the endpoint's eager
+	 * send size is used */
+	nccl_ofi_eager_threshold *eager_threshold;
+
+	/* Eager sends whose message was sent, but whose control message
+	 * did not arrive yet. Whoever processes the completions of the
+	 * endpoint completes them once it arrives. */
+	std::deque<nccl_net_ofi_rdma_req *> eager_ctrl_reqs;
+	nccl_ofi_dlist_node eager_ctrl_node;
 };
 
 
@@ -657,7 +844,13 @@ class nccl_net_ofi_rdma_recv_comm : public nccl_net_ofi_recv_comm {
 			  size_t size,
 			  nccl_net_ofi_rdma_mr_handle_t *buff_mr_handle,
 			  nccl_net_ofi_rdma_req **ret_req,
-			  bool recv_completion_optional);
+			  bool recv_completion_optional,
+			  int tag, uint16_t group_size);
+    int recv_group(int n, void **buffers, size_t *sizes, int *tags,
+		   nccl_net_ofi_rdma_mr_handle_t **mr_handles,
+		   nccl_net_ofi_req **base_req, bool recv_completion_optional);
+    int queue_ctrl_msg(nccl_net_ofi_rdma_req *req);
+    int flush_ctrl_batch(bool force);
 
 	/* CM receiver for connection establishment */
 	nccl_ofi_cm_receiver *receiver;
@@ -670,7 +863,7 @@ class nccl_net_ofi_rdma_recv_comm : public nccl_net_ofi_recv_comm {
 	 */
 	uint64_t num_pending_flush_comps;
 
-	nccl_ofi_freelist *nccl_ofi_reqs_fl;
+	nccl_ofi_freelist_mt *nccl_ofi_reqs_fl;
 
 	/* Comm ID provided by the local endpoint */
 	uint32_t local_comm_id;
@@ -704,6 +897,13 @@ class nccl_net_ofi_rdma_recv_comm : public nccl_net_ofi_recv_comm {
 
 	bool comm_active;
 
+	/*
+	 * Serializes recv(), flush(), read() and test() of the
+	 * communicator's requests. Taken before the endpoint lock, see
+	 * nccl_net_ofi_rdma_send_comm::comm_lock.
+	 */
+	std::mutex comm_lock;
+
 	/* Fixed-size array of communicator data rails */
 	std::array<nccl_net_ofi_rdma_recv_comm_rail_t, MAX_NUM_RAILS> data_rails;
 	/* Fixed-size array of control communicator rails */
@@ -720,6 +920,24 @@ class nccl_net_ofi_rdma_recv_comm : public nccl_net_ofi_recv_comm {
 	/* Addr and key of remote control mailbox */
 	uint64_t remote_mailbox_addr;
 	std::array<uint64_t, MAX_NUM_RAILS> remote_mr_key;
+
+	/* MR key table shared with the sender, and next entry to replace */
+	std::array<nccl_net_ofi_ctrl_key_entry_t, NCCL_OFI_CTRL_KEY_TABLE_SIZE> ctrl_key_table;
+	uint8_t ctrl_key_next;
+
+	/* Number of control messages that defined an MR key table entry
+	 * and that were made compact */
+	uint64_t num_ctrl_key_define;
+	uint64_t num_ctrl_key_compact;
+
+	/* Receive requests whose control messages are held back to be
+	 * written with a single RDMA write, and the time the first one was
+	 * queued. The requests are linked through their receive data. */
+	nccl_net_ofi_rdma_req *ctrl_batch_head;
+	nccl_net_ofi_rdma_req *ctrl_batch_tail;
+	uint64_t ctrl_batch_start_ns;
+	/* Link in the endpoint's list of communicators with a batch */
+	nccl_ofi_dlist_node ctrl_batch_node;
 };
 
 
@@ -808,11 +1026,16 @@ class nccl_net_ofi_rdma_domain_t : public nccl_net_ofi_domain_t {
 	 *		MR cache key reference
 	 * @param	type
 	 *		Type of MR
+	 * @param	retain_idle
+	 *		Whether the MR cache may keep the registration once
+	 *		unused. Must be false for memory the plugin releases
+	 *		itself after deregistration.
 	 *
 	 * @return	Memory registration handle
 	 */
 	int reg_mr(nccl_ofi_mr_ckey_ref ckey,
 		   int type,
+		   bool retain_idle,
 		   nccl_net_ofi_rdma_mr_handle_t **mhandle);
 
 	/**
@@ -892,6 +1115,10 @@ class nccl_net_ofi_rdma_domain_t : public nccl_net_ofi_domain_t {
 	/* The flush buffer */
 	nccl_net_ofi_rdma_flush_buffer_t flush_buff;
 
+	/* Device copy context used for eager copies into CUDA buffers, or
+	   NULL if these use RDMA reads */
+	nccl_ofi_device_copy *device_copy;
+
 	/* List of endpoints and set of addresses they have connections to */
 	nccl_ofi_ep_addr_list_t ep_addr_list;
 
@@ -947,6 +1174,11 @@ class nccl_net_ofi_rdma_domain_t : public nccl_net_ofi_domain_t {
 	 *		Memory registration handle
 	 */
 	void dereg_mr_on_device(nccl_net_ofi_rdma_mr_handle_t *mr_handle);
+
+	/**
+	 * @brief	MR cache callback deregistering evicted idle entries
+	 */
+	static int mr_cache_dereg_fn(void *domain_void_ptr, void *handle);
 };
 
 class nccl_net_ofi_rdma_cq_rail_t {
@@ -1007,10 +1239,18 @@ class nccl_net_ofi_rdma_ep_rail_t {
 
 	/* Number of rx buffers posted */
 	size_t num_rx_buff_posted;
-	/* Minimum posted rx buffers (see RDMA_MIN_POSTED_BOUNCE_BUFFERS) */
+	/* Minimum posted rx buffers (see RDMA_MIN_POSTED_BOUNCE_BUFFERS),
+	 * scaled with the window when autoscaling */
 	size_t min_rx_buff_posted;
-	/* Maximum posted rx buffers (see RDMA_MAX_POSTED_BOUNCE_BUFFERS) */
+	/* Maximum posted rx buffers (see RDMA_MAX_POSTED_BOUNCE_BUFFERS),
+	 * the current window when autoscaling */
 	size_t max_rx_buff_posted;
+	/* Window of posted rx buffers, if autoscaling (see
+	 * RDMA_RX_BUFF_AUTOSCALE) */
+	std::unique_ptr<nccl_ofi_rx_window> rx_window;
+	/* Set when the window shrank, until the buffers posted above it
+	 * were consumed and the rx buffer freelist was trimmed */
+	bool rx_buff_trim_pending;
 	/* Mutex for rx buffer operations */
 	pthread_mutex_t rx_buff_mutex;
 
@@ -1019,6 +1259,19 @@ class nccl_net_ofi_rdma_ep_rail_t {
 						      nccl_net_ofi_rdma_ep_rail_t *rail);
 };
 
+/*
+ * @brief	Requests of an endpoint waiting for resources of a rail
+ *
+ * Control messages, close messages and rx buffer reposts are retried
+ * before data transfers, as the peer and the rail itself wait on them.
+ */
+typedef struct {
+	/* Control messages, close messages and rx buffer reposts */
+	std::deque<nccl_net_ofi_rdma_req *> prio_queue;
+	/* Data transfers */
+	std::deque<nccl_net_ofi_rdma_req *> data_queue;
+} nccl_net_ofi_rdma_pending_queues_t;
+
 /**
  * @brief	RDMA Endpoint
  *
@@ -1150,10 +1403,23 @@ class nccl_net_ofi_rdma_ep_t : public nccl_net_ofi_ep_t {
 	int decrease_rx_buff_cnt(nccl_net_ofi_rdma_ep_rail_t *rail);
 
 	/**
-	 * Attempt to post all requests in the pending requests queue.
+	 * Put a request in the pending queue of the rail it waits for.
 	 *
-	 * Requests are put in the pending reqs queue when the network is busy, i.e., a
+	 * Requests are put in the pending queues when the network is busy, i.e., a
 	 * Libfabric operation returns FI_EAGAIN.
+	 */
+	void add_pending_req(nccl_net_ofi_rdma_req *req);
+
+	/**
+	 * @brief	Whether requests are waiting in the pending queues
+	 */
+	bool has_pending_reqs();
+
+	/**
+	 * Attempt to post the requests in the pending queues.
+	 *
+	 * The queue of each rail is retried in order, high priority requests
+	 * first, until a request hits FI_EAGAIN again on that rail.
 	 *
 	 * @return zero on success, negative errno value on non-success.
 	 */
@@ -1163,11 +1429,49 @@ class nccl_net_ofi_rdma_ep_t : public nccl_net_ofi_ep_t {
 	 * @brief	Process completion entries for the given completion queue.
 	 *		This also updates several request fileds like size, status, etc
 	 *
+	 * Rails are read round-robin until their queues are drained or the
+	 * budget of OFI_NCCL_CQ_POLL_BUDGET entries is spent.
+	 *
 	 * @return	0, on success
 	 *		error, on others
 	 */
 	int ofi_process_cq();
 
+	/**
+	 * @brief	Write the control message batches of the receive
+	 *		communicators of the endpoint that are due
+	 *
+	 * Batches are otherwise only written when tested through their own
+	 * communicator, while the sender may wait for them.
+	 *
+	 * @return	0, on success
+	 *		error, on others
+	 */
+	int flush_ctrl_batches();
+
+	/**
+	 * @brief	Complete the eager sends of the endpoint whose control
+	 *		message arrived
+	 *
+	 * Control messages are written to the sender's mailbox without a
+	 * completion, so they are polled along with the completion queues.
+	 *
+	 * @return	0, on success
+	 *		error, on others
+	 */
+	int process_eager_ctrl_sends();
+
+	/**
+	 * @brief	Shrink the rx buffer windows of idle rails, and trim
+	 *		the rx buffer freelists once their windows shrank
+	 *
+	 * Windows otherwise only shrink when buffers are consumed, and the
+	 * freelists only when a trim watermark is set, so an endpoint idle
+	 * after a burst would keep its peak buffers. Caller must hold
+	 * ep_lock.
+	 */
+	void shrink_idle_rx_windows();
+
 	int handle_rx_eagain(nccl_net_ofi_rdma_ep_rail_t *rail,
 			     nccl_net_ofi_rdma_req *req,
 			     size_t num_buffs_failed);
@@ -1262,17 +1566,28 @@ class nccl_net_ofi_rdma_ep_t : public nccl_net_ofi_ep_t {
 	/* Array of `num_rails` cq rails */
 	std::vector<nccl_net_ofi_rdma_cq_rail_t> cq_rails;
 
-	/* Pending requests queue */
-	std::deque<nccl_net_ofi_rdma_req *> pending_reqs_queue;
-	/* Lock for `pending_reqs_queue` */
+	/* Array of `num_rails` queues of requests waiting for resources,
+	 * by the rail they wait for */
+	std::vector<nccl_net_ofi_rdma_pending_queues_t> pending_reqs_queues;
+	/* Number of requests in `pending_reqs_queues` */
+	size_t num_pending_reqs = 0;
+	/* Lock for `pending_reqs_queues` */
 	pthread_mutex_t pending_reqs_lock;
 
+	/* Receive communicators with control messages queued for batching,
+	 * see nccl_net_ofi_rdma_recv_comm::queue_ctrl_msg() */
+	nccl_ofi_dlist ctrl_batch_comms;
+
+	/* Send communicators with eager sends waiting for their control
+	 * message, see process_eager_ctrl_sends() */
+	nccl_ofi_dlist eager_ctrl_comms;
+
 	/* Free list of ctrl rx buffers */
 	nccl_ofi_freelist *ctrl_rx_buff_fl = nullptr;
 	/* Free list of eager rx buffers */
 	nccl_ofi_freelist *eager_rx_buff_fl = nullptr;
 	/* Free list of rx buffer requests */
-	nccl_ofi_freelist *rx_buff_reqs_fl = nullptr;
+	nccl_ofi_freelist_mt *rx_buff_reqs_fl = nullptr;
 	/* Size of ctrl rx buffers */
 	size_t ctrl_rx_buff_size;
 	/* Size of eager rx buffers.  Will be -1 if eager is entirely
@@ -1288,6 +1603,9 @@ class nccl_net_ofi_rdma_ep_t : public nccl_net_ofi_ep_t {
 	 * disabled.
 	 */
 	ssize_t eager_send_size;
+	/* Largest eager threshold a send communicator may learn, at least
+	 * eager_send_size. Eager rx buffers are sized for it. */
+	ssize_t eager_threshold_max_size;
 
 	/**
 	 * Associated connection manager
@@ -1305,6 +1623,23 @@ class nccl_net_ofi_rdma_ep_t : public nccl_net_ofi_ep_t {
 	/* Message scheduler */
 	nccl_net_ofi_scheduler *scheduler = nullptr;
 
+	/* Health of the rails, NULL if rail health tracking is disabled.
+	 * Control rails share the health of the data rail with the same
+	 * index. */
+	nccl_ofi_rail_health *rail_health = nullptr;
+
+	/* Polling of the completion queues of the rails */
+	nccl_ofi_cq_poller *cq_poller = nullptr;
+
+	/* Blocking on the completion queues of the rails, or NULL if
+	 * disabled or a queue has no wait object */
+	nccl_ofi_cq_wait *cq_wait = nullptr;
+
+	/* Whether the progress thread of the device processes the
+	 * completions of the endpoint. Cleared if it fails to, leaving
+	 * them to application threads. */
+	std::atomic<bool> progress_thread_owned = false;
+
 protected:
 	/**
 	 * @brief	Initialize rx buffer data of endpoint
@@ -1510,6 +1845,9 @@ class nccl_net_ofi_rdma_device_t : public nccl_net_ofi_device_t {
 	/* ID pool */
 	nccl_ofi_idpool_t comm_idpool;
 
+	/* Progress thread of the endpoints, NULL if disabled */
+	nccl_ofi_progress_thread *progress_thread = nullptr;
+
 #if HAVE_NVTX_TRACING
 	nvtxDomainHandle_t nvtx_domain[MAX_NUM_RAILS];
 #endif
@@ -51,6 +51,14 @@ int nccl_net_ofi_gpu_mem_free(void *ptr);
  */
 int nccl_net_ofi_gpu_mem_copy_host_to_device(void *dst, void *src, size_t size);
 
+/*
+ * @brief wraps hipMemGetAddressRange(), returning the bounds of the
+ * allocation containing ptr
+ * @return	0 on success
+ *		-EINVAL on error
+ */
+int nccl_net_ofi_gpu_get_address_range(void *ptr, uintptr_t *base, size_t *size);
+
 /*
  * @brief Obtain the fd and offset for a dma buf.
  * The ptr and size provided as input must be aligned to page size
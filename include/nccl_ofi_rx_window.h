@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#ifndef NCCL_OFI_RX_WINDOW_H_
+#define NCCL_OFI_RX_WINDOW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Demand-driven size of the rx buffers posted to a rail
+ *
+ * The window is the number of rx buffers a rail keeps posted. It starts
+ * at the floor and follows the consumption of the rail between the floor
+ * and the ceiling:
+ *
+ * - A consumption that leaves no buffer posted doubles the window at
+ *   once, as messages arriving now have no buffer to land in.
+ * - At the end of each epoch, the window should hold the buffers
+ *   consumed in an epoch, and twice the most buffers the rail was
+ *   missing at once (buffers held by unexpected eager messages). A
+ *   larger demand grows the window to it. A demand below half of the
+ *   window halves the window, but not below the demand, so a rail
+ *   returns to the floor over a few epochs once traffic stops.
+ *
+ * An epoch also ends when the rail is found idle past its end (see
+ * report_idle()), so an idle rail shrinks back to the floor without
+ * traffic. Posted buffers are only given back when they are consumed,
+ * so the number of posted buffers follows a smaller window as traffic
+ * consumes them.
+ *
+ * The caller must ensure serialized access.
+ */
+class nccl_ofi_rx_window {
+public:
+	/* Clock returning a monotonic time in nanoseconds */
+	typedef uint64_t (*clock_fn_t)(void);
+
+	/*
+	 * @param	floor
+	 *		Smallest window
+	 * @param	ceiling
+	 *		Largest window
+	 * @param	ceiling_low_watermark
+	 *		Number of posted buffers below which a rail with the
+	 *		largest window posts more buffers. Smaller windows
+	 *		scale it down proportionally.
+	 * @param	epoch_ns
+	 *		Length of the epochs over which consumption is measured
+	 * @param	clock_fn
+	 *		Clock used to time epochs. NULL selects
+	 *		std::chrono::steady_clock.
+	 */
+	nccl_ofi_rx_window(size_t floor, size_t ceiling, size_t ceiling_low_watermark,
+			   uint64_t epoch_ns, clock_fn_t clock_fn = NULL);
+
+	/*
+	 * @brief	Report that a posted buffer was consumed
+	 *
+	 * @param	num_posted
+	 *		Number of buffers still posted after the consumption
+	 *
+	 * @return	true, if the window changed
+	 */
+	bool report_consumed(size_t num_posted);
+
+	/*
+	 * @brief	End the current epoch if it is over, without a
+	 *		consumption. Cheap otherwise, so that owners can call it
+	 *		periodically, e.g. while idle.
+	 *
+	 * @return	true, if the window changed
+	 */
+	bool report_idle();
+
+	/* Number of buffers to keep posted */
+	size_t size() const
+	{
+		return window;
+	}
+
+	/* Number of posted buffers below which more buffers are posted */
+	size_t low_watermark() const;
+
+	/* Largest window so far */
+	size_t peak_size() const
+	{
+		return peak_window;
+	}
+
+	/* Buffers consumed per second in the last complete epoch */
+	double consume_rate() const
+	{
+		return last_rate;
+	}
+
+	/* Number of buffers consumed */
+	uint64_t num_consumed;
+	/* Number of consumptions that left no buffer posted */
+	uint64_t num_underruns;
+	/* Number of times the window grew, and shrank */
+	uint64_t num_grows;
+	uint64_t num_shrinks;
+
+private:
+	void end_epoch(uint64_t now_ns);
+	void resize(size_t new_window);
+
+	clock_fn_t clock_fn;
+	size_t floor;
+	size_t ceiling;
+	size_t ceiling_low_watermark;
+	uint64_t epoch_ns;
+
+	size_t window;
+	size_t peak_window;
+	double last_rate;
+
+	/* Start of the current epoch, or 0 before the first consumption */
+	uint64_t epoch_start_ns;
+	/* Buffers consumed in the current epoch */
+	size_t epoch_consumed;
+	/* Most buffers missing from the window in the current epoch */
+	size_t epoch_peak_missing;
+};
+
+#endif  // End NCCL_OFI_RX_WINDOW_H_
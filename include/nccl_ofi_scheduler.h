@@ -8,6 +8,8 @@
 #include <stdint.h>
 #include <pthread.h>
 
+#include <vector>
+
 #include "nccl_ofi_freelist.h"
 
 /*
@@ -36,14 +38,38 @@ typedef struct nccl_net_ofi_schedule {
 	/* Number of transfer information entries set by the scheduler */
 	size_t num_xfer_infos;
 
-	/* Backpointer to freelist element (for cleanup) */
+	/* Backpointer to freelist element (for cleanup). NULL for
+	 * schedules in storage owned by the caller. */
 	nccl_ofi_freelist::fl_entry *elem;
 
+	/* Creation time and bitmask of the stripes whose completion was
+	 * not reported yet. Only maintained by schedulers that use
+	 * feedback. */
+	uint64_t start_ns;
+	uint64_t pending_stripes;
+
 	/* Array of transfer information structs. The array has at
 	 * least 'num_xfer_infos' entries. */
 	nccl_net_ofi_xfer_info_t rail_xfer_infos[];
 } nccl_net_ofi_schedule_t;
 
+/*
+ * @brief	Storage for a schedule of at most `N' stripes
+ *
+ * Lets callers keep schedules in their own structures (or on the
+ * stack) instead of allocating them from the scheduler.
+ */
+template <int N>
+struct nccl_net_ofi_schedule_buf {
+	alignas(nccl_net_ofi_schedule_t) unsigned char buf[sizeof(nccl_net_ofi_schedule_t)
+							   + N * sizeof(nccl_net_ofi_xfer_info_t)];
+
+	nccl_net_ofi_schedule_t *get()
+	{
+		return reinterpret_cast<nccl_net_ofi_schedule_t *>(buf);
+	}
+};
+
 /*
  * @brief	Base scheduler class
  */
@@ -54,7 +80,7 @@ class nccl_net_ofi_scheduler {
 	 *
 	 * @param	num_rails
 	 *		Number of rails that the scheduler should use.
-	 *		This parameter must be the same as the parameter used to invoke
+	 *		This parameter must be at least the parameter used to invoke
 	 *		the `get_schedule' method later.
 	 */
 	nccl_net_ofi_scheduler(int num_rails);
@@ -72,10 +98,80 @@ class nccl_net_ofi_scheduler {
 	 * @return	schedule, on success
 	 *		NULL, on others
 	 */
-	virtual nccl_net_ofi_schedule_t *get_schedule(size_t size, int num_rails) = 0;
+	nccl_net_ofi_schedule_t *get_schedule(size_t size, int num_rails);
+
+	/*
+	 * @brief	Create schedule for a message in storage owned by the caller
+	 *
+	 *		The schedule must still be released with
+	 *		nccl_net_ofi_release_schedule(), which does not free it.
+	 *
+	 * @param	size
+	 *		Size of the message in bytes
+	 * @param	num_rails
+	 *		Number of rails
+	 * @param	storage
+	 *		Storage for a schedule of at least `num_rails' stripes
+	 *
+	 * @return	schedule, placed in `storage'
+	 */
+	nccl_net_ofi_schedule_t *get_schedule(size_t size, int num_rails,
+					      nccl_net_ofi_schedule_t *storage);
+
+	/*
+	 * @brief	Set the stripes of a schedule for a message
+	 *
+	 *		The caller must ensure serialized access.
+	 */
+	virtual void set_schedule(size_t size, int num_rails, nccl_net_ofi_schedule_t *schedule) = 0;
+
+	/*
+	 * @brief	Report that the stripe of a schedule sent over a rail
+	 *		completed
+	 *
+	 *		Only called if `wants_feedback' is set. The caller must
+	 *		ensure serialized access.
+	 */
+	virtual void notify_completion(nccl_net_ofi_schedule_t *, uint16_t) {}
+
+	/*
+	 * @brief	Report that posting a stripe to a rail returned -FI_EAGAIN
+	 *
+	 *		Only called if `wants_feedback' is set. The caller must
+	 *		ensure serialized access.
+	 */
+	virtual void notify_eagain(uint16_t) {}
+
+	/*
+	 * @brief	Drop feedback state of a schedule that is released
+	 *		before all its stripes completed
+	 */
+	virtual void retire_schedule(nccl_net_ofi_schedule_t *) {}
+
+	/*
+	 * @brief	Set the rails schedules should avoid
+	 *
+	 *		Messages are only scheduled on excluded rails if all
+	 *		rails they may use are excluded. The caller must ensure
+	 *		serialized access.
+	 *
+	 * @param	mask
+	 *		Bitmask of rail ids
+	 */
+	void set_excluded_rails(uint64_t mask)
+	{
+		excluded_rails = mask;
+	}
 
 	/* Freelist of schedules */
 	nccl_ofi_freelist *schedule_fl;
+
+	/* Bitmask of the rails to avoid */
+	uint64_t excluded_rails;
+
+	/* Whether the transport should report completions and
+	 * -FI_EAGAIN returns of the stripes it posts */
+	bool wants_feedback;
 };
 
 /*
@@ -95,7 +191,7 @@ class nccl_net_ofi_threshold_scheduler : public nccl_net_ofi_scheduler {
 	nccl_net_ofi_threshold_scheduler(int num_rails);
 
 	/*
-	 * @brief	Create schedule for a message by multiplexing message or
+	 * @brief	Set schedule for a message by multiplexing message or
 	 *		assigning the message round-robin depending on the message size
 	 *
 	 *		The caller must ensure serialized access.
@@ -103,13 +199,12 @@ class nccl_net_ofi_threshold_scheduler : public nccl_net_ofi_scheduler {
 	 * @param	size
 	 *		Size of the message in bytes
 	 * @param	num_rails
-	 *		Number of rails. This parameter must match the number of rails
+	 *		Number of rails. Must not exceed the number of rails
 	 *		provided to the scheduler initialization routine.
-	 *
-	 * @return	schedule, on success
-	 *		NULL, on others
+	 * @param	schedule
+	 *		Schedule to set
 	 */
-	nccl_net_ofi_schedule_t *get_schedule(size_t size, int num_rails) override;
+	void set_schedule(size_t size, int num_rails, nccl_net_ofi_schedule_t *schedule) override;
 
 	/* Round robin counter */
 	unsigned int rr_small_counter;
@@ -131,7 +226,115 @@ class nccl_net_ofi_threshold_scheduler : public nccl_net_ofi_scheduler {
 	 *
 	 * @return	The adjusted number of stripes
 	 */
-	inline int get_num_stripes(size_t size, int num_rails);
+	int get_num_stripes(size_t size, int num_rails);
+
+	/*
+	 * Precomputed layout of the stripes of messages for a number of
+	 * rails. Layouts only depend on the size class of a message
+	 * (the number of `min_stripe_size' units it spans, up to the
+	 * number of rails) and on the round-robin phase, so they are
+	 * computed once when the scheduler is created and never modified.
+	 */
+	struct schedule_table {
+		/* Number of stripes, indexed by size class */
+		std::vector<uint16_t> num_stripes;
+		/* Rails of the stripes, indexed by phase * num_rails + stripe */
+		std::vector<uint16_t> rail_ids;
+		/* Phase following a schedule, indexed by phase * (num_rails + 1)
+		 * + number of stripes */
+		std::vector<uint16_t> next_phase;
+	};
+
+	/* Tables for 1 to the number of rails of the scheduler, indexed by
+	 * number of rails minus one */
+	std::vector<schedule_table> tables;
+
+private:
+	/* log2 of `min_stripe_size' if it is a power of two, -1 otherwise */
+	int min_stripe_shift;
+};
+
+/*
+ * @brief 	The adaptive scheduler
+ *
+ * Messages smaller than `max_small_msg_size' bytes are assigned
+ * round-robin. Larger messages are split so that all their stripes are
+ * expected to complete at the same time: each rail is modeled by the
+ * bytes it has outstanding and by its service rate, measured from
+ * write completions, and reduced by the rate at which posts to the
+ * rail return -FI_EAGAIN. Congested or slower rails therefore get
+ * smaller stripes, or none at all.
+ *
+ * The completion latency of every rail is tracked for diagnostics.
+ */
+class nccl_net_ofi_adaptive_scheduler : public nccl_net_ofi_scheduler {
+public:
+	/* Clock returning a monotonic time in nanoseconds */
+	typedef uint64_t (*clock_fn_t)(void);
+
+	/*
+	 * @brief	Construct adaptive scheduler
+	 *
+	 * @param	num_rails
+	 *		Number of rails
+	 * @param	clock_fn
+	 *		Clock used to time completions. NULL selects
+	 *		std::chrono::steady_clock.
+	 */
+	nccl_net_ofi_adaptive_scheduler(int num_rails, clock_fn_t clock_fn = NULL);
+
+	/*
+	 * @brief	Set schedule for a message from the feedback of
+	 *		the rails
+	 *
+	 *		The caller must ensure serialized access.
+	 *
+	 * @param	size
+	 *		Size of the message in bytes
+	 * @param	num_rails
+	 *		Number of rails. Must not exceed the number of rails
+	 *		provided to the scheduler initialization routine.
+	 * @param	schedule
+	 *		Schedule to set
+	 */
+	void set_schedule(size_t size, int num_rails, nccl_net_ofi_schedule_t *schedule) override;
+
+	void notify_completion(nccl_net_ofi_schedule_t *schedule, uint16_t rail_id) override;
+	void notify_eagain(uint16_t rail_id) override;
+	void retire_schedule(nccl_net_ofi_schedule_t *schedule) override;
+
+	/* Feedback state of a rail */
+	struct rail_state {
+		/* Bytes scheduled on the rail that did not complete yet */
+		size_t outstanding_bytes;
+		/* Average service rate in bytes per nanosecond; 0 until
+		 * the first completion */
+		double rate;
+		/* Average time from scheduling to completion of a stripe */
+		double latency_ns;
+		/* Average fraction of posts returning -FI_EAGAIN */
+		double eagain_rate;
+		/* Time of the last completion */
+		uint64_t last_completion_ns;
+	};
+
+	/*
+	 * @brief	Rate a rail is expected to drain its outstanding bytes at
+	 */
+	double effective_rate(int rail_id, int num_rails) const;
+
+	std::vector<rail_state> rails;
+
+	/* Round robin counters */
+	unsigned int rr_small_counter;
+	unsigned int rr_counter;
+	/* threshold for small messages */
+	size_t max_small_msg_size;
+	/* Minimum size of a stripe */
+	size_t min_stripe_size;
+
+private:
+	clock_fn_t clock_fn;
 };
 
 /*
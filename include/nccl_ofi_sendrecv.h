@@ -9,6 +9,7 @@
 
 #include "cm/nccl_ofi_cm.h"
 #include "nccl_ofi.h"
+#include "nccl_ofi_cq_wait.h"
 #include "nccl_ofi_freelist.h"
 #include "nccl_ofi_log.h"
 #include "ofi/resource_wrapper.h"
@@ -296,6 +297,10 @@ class nccl_net_ofi_sendrecv_ep_t : public nccl_net_ofi_ep_t {
 	/* Completion Queue handle */
 	ofi_cq_ptr cq;
 
+	/* Blocking on the completion queue, or NULL if the queue has no
+	 * wait object */
+	nccl_ofi_cq_wait *cq_wait = nullptr;
+
 	/**
 	 * Connection manager for this domain
 	 *
@@ -11,7 +11,7 @@
 // A BasicLockable spinlock without many features
 class CAPABILITY("mutex") nccl_ofi_spinlock {
 public	:
-	nccl_ofi_spinlock() : val(false)
+	nccl_ofi_spinlock() : val(false), num_waiters(0)
 	{
 		std::atomic_thread_fence(std::memory_order_release);
 	}
@@ -29,6 +29,11 @@ public	:
 
 	void lock() ACQUIRE()
 	{
+		if (this->trylock()) {
+			return;
+		}
+
+		num_waiters.fetch_add(1, std::memory_order_relaxed);
 		while (!this->trylock()) {
 			while (val.load()) {
 #if defined(__x86_64__)
@@ -38,6 +43,15 @@ public	:
 #endif
 			}
 		}
+		num_waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+
+	// Whether a thread is spinning in lock(), so that opportunistic
+	// holders can leave the lock to it
+	bool has_waiters() const
+	{
+		return num_waiters.load(std::memory_order_relaxed) != 0;
 	}
 
 
@@ -49,6 +63,7 @@ public	:
 
 private:
 	std::atomic<bool> val;
+	std::atomic<unsigned int> num_waiters;
 };
 
 #endif
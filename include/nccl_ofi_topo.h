@@ -6,6 +6,7 @@
 #define NCCL_NET_OFI_TOPO_H_
 
 #include <hwloc.h>
+#include <sched.h>
 #include <rdma/fabric.h>
 
 /*
@@ -335,4 +336,37 @@ int nccl_ofi_topo_write_nccl_topology(nccl_ofi_topo_t *topo, FILE *file);
  */
 bool nccl_ofi_topo_has_efa_ena_devices(nccl_ofi_topo_t* topo);
 
+/*
+ * @brief	Return the NUMA node closest to a NIC
+ *
+ * The NUMA node is the first one local to the closest non-I/O ancestor
+ * of the NIC's PCI device. No node is reported for NICs only attached to
+ * the machine as a whole.
+ *
+ * @param	topo
+ *		The topology
+ * @param	info
+ *		Libfabric NIC info struct
+ * @return	OS index of the NUMA node, if found
+ *		-1, on others
+ */
+int nccl_ofi_topo_get_numa_node(nccl_ofi_topo_t *topo, struct fi_info *info);
+
+/*
+ * @brief	Return the CPUs local to a NIC
+ *
+ * The CPUs are those of the closest non-I/O ancestor of the NIC's PCI
+ * device, as for nccl_ofi_topo_get_numa_node().
+ *
+ * @param	topo
+ *		The topology
+ * @param	info
+ *		Libfabric NIC info struct
+ * @param	cpus
+ *		Output, set of local CPUs
+ * @return	0, if found
+ *		-1, on others
+ */
+int nccl_ofi_topo_get_local_cpus(nccl_ofi_topo_t *topo, struct fi_info *info, cpu_set_t *cpus);
+
 #endif // End NCCL_NET_OFI_TOPO_H_
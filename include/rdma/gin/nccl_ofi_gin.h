@@ -14,15 +14,6 @@
 #include "nccl_ofi_gdrcopy.h"
 #include "nccl_ofi_tracepoint.h"
 
-/**
- * Get singleton instance of the device copy context shared across all GIN communicators.
- */
-inline nccl_ofi_device_copy &get_device_copy()
-{
-	static nccl_ofi_gdrcopy_ctx instance;
-	return instance;
-}
-
 /**
  * The listen communicator which implements GIN API's nccl_ofi_gin_listen() and
  * nccl_ofi_gin_connect() functionality
@@ -167,6 +167,8 @@ ncclResult_t nccl_net_ofi_listen(int dev_id, void *handle, void **lComm,
 			NCCL_OFI_WARN("Error accessing device %i.", dev_id);
 			return check_return(ncclInternalError);
 		}
+		nccl_ofi_numa_scope numa_scope(device->numa_node);
+
 		/* Validate Handle */
 		if (OFI_UNLIKELY(handle == nullptr)) {
 			NCCL_OFI_WARN("Provided handle is nullptr");
@@ -238,12 +240,14 @@ ncclResult_t nccl_net_ofi_connect(int dev_id, void *handle, void **sComm, int tr
 	std::shared_ptr<nccl_net_ofi_ep_t> ep;
 	int ret = 0;
 	try {
+		nccl_net_ofi_device_t *device = plugin->get_device(dev_id);
+		if (device == nullptr) {
+			NCCL_OFI_WARN("Error accessing device %i.", dev_id);
+			return check_return(ncclInternalError);
+		}
+		nccl_ofi_numa_scope numa_scope(device->numa_node);
+
 		if (ofi_handle->state.comm == nullptr) {
-			nccl_net_ofi_device_t *device = plugin->get_device(dev_id);
-			if (device == nullptr) {
-				NCCL_OFI_WARN("Error accessing device %i.", dev_id);
-				return check_return(ncclInternalError);
-			}
 
 			ep = device->get_ep(domain_key, nccl_net_ofi_gettid());
 			if (OFI_UNLIKELY(ep == nullptr)) {
@@ -311,6 +315,9 @@ ncclResult_t nccl_net_ofi_accept(void *lComm, void **rComm)
 		reinterpret_cast<nccl_net_ofi_recv_comm **>(rComm);
 	int ret = 0;
 	try {
+		nccl_net_ofi_device_t *device = plugin->get_device(listen_comm->dev_id);
+		nccl_ofi_numa_scope numa_scope((device != nullptr) ? device->numa_node
+						   : NCCL_OFI_NUMA_NODE_ANY);
 		ret = listen_comm->accept(recv_comm);
 	}
 	catch (const std::exception &e) {
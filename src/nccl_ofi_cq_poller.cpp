@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+
+#include "nccl_ofi_cq_poller.h"
+
+nccl_ofi_cq_poller::nccl_ofi_cq_poller(int num_rails_arg, size_t min_batch_size,
+				       size_t max_batch_size, size_t budget_arg)
+	: num_rails(num_rails_arg),
+	  min_batch(std::max(min_batch_size, (size_t)1)),
+	  max_batch(std::max(max_batch_size, min_batch)),
+	  budget(budget_arg),
+	  remaining_budget(budget_arg),
+	  poll_compls(0),
+	  start_rail(0),
+	  cur_rail(0)
+{
+	rails.resize(num_rails_arg);
+	for (rail &r : rails) {
+		r.batch_size = min_batch;
+		r.drained = false;
+		r.num_reads = 0;
+		r.num_empty_reads = 0;
+		r.num_compls = 0;
+		r.num_budget_stops = 0;
+	}
+}
+
+void nccl_ofi_cq_poller::begin_poll()
+{
+	for (rail &r : rails) {
+		r.drained = false;
+	}
+	this->remaining_budget = this->budget;
+	this->poll_compls = 0;
+	this->cur_rail = this->start_rail;
+	this->start_rail = (this->start_rail + 1) % this->num_rails;
+}
+
+int nccl_ofi_cq_poller::next_rail()
+{
+	if (this->budget != 0 && this->remaining_budget == 0) {
+		for (rail &r : rails) {
+			if (!r.drained) {
+				r.num_budget_stops++;
+				r.drained = true;
+			}
+		}
+		return -1;
+	}
+
+	for (int i = 0; i < this->num_rails; i++) {
+		int rail_id = this->cur_rail;
+
+		this->cur_rail = (this->cur_rail + 1) % this->num_rails;
+		if (!rails[rail_id].drained) {
+			return rail_id;
+		}
+	}
+
+	return -1;
+}
+
+void nccl_ofi_cq_poller::report_read(int rail_id, size_t requested, size_t num_compls, bool drained)
+{
+	rail &r = rails[rail_id];
+
+	r.num_reads++;
+	r.num_compls += num_compls;
+	this->poll_compls += num_compls;
+	if (num_compls == 0) {
+		r.num_empty_reads++;
+	}
+	r.drained = drained;
+
+	if (this->budget != 0) {
+		this->remaining_budget -= std::min(num_compls, this->remaining_budget);
+	}
+
+	/* Reads cut short by the budget say nothing about the depth of
+	 * the queue */
+	if (requested != r.batch_size) {
+		return;
+	}
+
+	if (num_compls >= requested) {
+		/* The queue may hold more entries than the batch */
+		r.batch_size = std::min(r.batch_size * 2, this->max_batch);
+	} else if (num_compls < r.batch_size / 2) {
+		r.batch_size = std::max(r.batch_size / 2, this->min_batch);
+	}
+}
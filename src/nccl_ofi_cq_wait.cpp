@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "nccl_ofi_cq_wait.h"
+#include "nccl_ofi_log.h"
+
+static uint64_t steady_clock_ns(void)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+nccl_ofi_cq_wait::nccl_ofi_cq_wait(uint64_t spin_ns_arg, int timeout_ms_arg, clock_fn_t clock_fn_arg)
+	: clock_fn(clock_fn_arg ? clock_fn_arg : steady_clock_ns),
+	  spin_ns(spin_ns_arg),
+	  timeout_ms(timeout_ms_arg),
+	  idle_since_ns(0)
+{
+}
+
+int nccl_ofi_cq_wait::add_cq(struct fid_fabric *fabric, struct fid_cq *cq)
+{
+	int fd = -1;
+
+	int ret = fi_control(&cq->fid, FI_GETWAIT, &fd);
+	if (ret != 0) {
+		return ret;
+	}
+
+	this->fabrics.push_back(fabric);
+	this->cq_fids.push_back(&cq->fid);
+	this->pollfds.push_back({fd, POLLIN, 0});
+
+	return 0;
+}
+
+void nccl_ofi_cq_wait::report_progress(size_t num_compls)
+{
+	if (num_compls > 0) {
+		this->idle_since_ns = 0;
+	} else if (this->idle_since_ns == 0) {
+		this->idle_since_ns = this->clock_fn();
+	}
+}
+
+bool nccl_ofi_cq_wait::spin_window_expired()
+{
+	if (this->idle_since_ns == 0) {
+		return false;
+	}
+	return this->clock_fn() - this->idle_since_ns >= this->spin_ns;
+}
+
+int nccl_ofi_cq_wait::trywait()
+{
+	for (size_t i = 0; i < this->cq_fids.size(); i++) {
+		int ret = fi_trywait(this->fabrics[i], &this->cq_fids[i], 1);
+		if (ret == -FI_EAGAIN) {
+			/* Completions are pending */
+			return ret;
+		} else if (ret != 0) {
+			NCCL_OFI_WARN("fi_trywait failed. RC: %d, ERROR: %s", ret, fi_strerror(-ret));
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+int nccl_ofi_cq_wait::wait() const
+{
+	/* poll() writes the returned events, so poll a copy to let
+	 * concurrent waiters share the descriptors */
+	std::vector<struct pollfd> fds(this->pollfds);
+
+	int ret = poll(fds.data(), fds.size(), this->timeout_ms);
+	if (ret < 0 && errno != EINTR) {
+		ret = -errno;
+		NCCL_OFI_WARN("poll on completion queues failed: %s", strerror(-ret));
+		return ret;
+	}
+
+	return 0;
+}
+
+int nccl_ofi_cq_wait::block()
+{
+	int ret = this->trywait();
+	if (ret == -FI_EAGAIN) {
+		return 0;
+	} else if (ret != 0) {
+		return ret;
+	}
+
+	return this->wait();
+}
@@ -85,6 +85,7 @@ DECLARE_CUDA_FUNCTION(cuPointerGetAttributes, 7000);
 DECLARE_CUDA_FUNCTION(cuMemAlloc, 3020);
 DECLARE_CUDA_FUNCTION(cuMemFree, 3020);
 DECLARE_CUDA_FUNCTION(cuMemcpy, 4000);
+DECLARE_CUDA_FUNCTION(cuMemGetAddressRange, 3020);
 
 int nccl_net_ofi_gpu_init(void)
 {
@@ -155,6 +156,7 @@ int nccl_net_ofi_gpu_init(void)
 	RESOLVE_CUDA_FUNCTION(cuMemAlloc, 3020);
 	RESOLVE_CUDA_FUNCTION(cuMemFree, 3020);
 	RESOLVE_CUDA_FUNCTION(cuMemcpy, 4000);
+	RESOLVE_CUDA_FUNCTION(cuMemGetAddressRange, 3020);
 
 	cu_ret = pfn_cuDriverGetVersion(&driverVersion);
 	if (cu_ret != CUDA_SUCCESS) {
@@ -218,6 +220,18 @@ int nccl_net_ofi_gpu_mem_copy_host_to_device(void *dst, void *src, size_t size)
 	return ret == CUDA_SUCCESS ? 0 : -EINVAL;
 }
 
+int nccl_net_ofi_gpu_get_address_range(void *ptr, uintptr_t *base, size_t *size)
+{
+	CUdeviceptr d_base;
+	CUresult ret = pfn_cuMemGetAddressRange(&d_base, size, (CUdeviceptr)ptr);
+	if (ret != CUDA_SUCCESS) {
+		return -EINVAL;
+	}
+
+	*base = (uintptr_t)d_base;
+	return 0;
+}
+
 int nccl_net_ofi_gpu_get_dma_buf_fd(void *aligned_ptr, size_t aligned_size, int *fd, size_t *offset)
 {
 #if HAVE_CUDA_DMABUF_SUPPORT
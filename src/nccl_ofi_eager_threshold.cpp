@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "nccl_ofi_eager_threshold.h"
+#include "nccl_ofi_log.h"
+
+/* Number of messages after which the threshold is updated */
+#define EAGER_THRESHOLD_EPOCH_MSGS (32)
+
+/* Weight of a new sample in the moving averages */
+#define EAGER_THRESHOLD_EWMA_WEIGHT (1.0 / 8)
+
+/* Smallest non-zero threshold */
+#define EAGER_THRESHOLD_MIN_SIZE (256)
+
+/* Shrink if at least this fraction of control messages arrived before
+ * the message was sent ... */
+#define EAGER_THRESHOLD_CTRL_READY_HIGH (0.9)
+/* ... and only grow if at most this fraction did */
+#define EAGER_THRESHOLD_CTRL_READY_LOW (0.5)
+
+/* Grow if messages above the threshold waited for their control message
+ * this factor longer than an eager send takes */
+#define EAGER_THRESHOLD_WAIT_FACTOR (2.0)
+
+/* Eager sends are slow if their average latency in an epoch exceeds the
+ * lowest latency observed by this factor ... */
+#define EAGER_THRESHOLD_LATENCY_FACTOR (4.0)
+/* ... and this absolute latency */
+#define EAGER_THRESHOLD_LATENCY_MIN_NS (20000.0)
+/* Number of eager completions in an epoch needed to judge latency */
+#define EAGER_THRESHOLD_LATENCY_MIN_SAMPLES (4)
+
+static uint64_t steady_clock_ns(void)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline double ewma(double avg, double sample)
+{
+	/* The first sample initializes the average */
+	if (avg == 0.0) {
+		return sample;
+	}
+	return avg + EAGER_THRESHOLD_EWMA_WEIGHT * (sample - avg);
+}
+
+nccl_ofi_eager_threshold::nccl_ofi_eager_threshold(ssize_t initial_size_arg, ssize_t max_size_arg,
+						   clock_fn_t clock_fn_arg)
+	: ctrl_wait_ns(0.0),
+	  eager_ctrl_delay_ns(0.0),
+	  eager_latency_ns(0.0),
+	  min_eager_latency_ns(0.0),
+	  clock_fn(clock_fn_arg ? clock_fn_arg : steady_clock_ns),
+	  max_size(std::max(max_size_arg, initial_size_arg)),
+	  cur_size(initial_size_arg),
+	  msg_pending(false),
+	  msg_waiting(false),
+	  msg_start_ns(0),
+	  num_msgs(0),
+	  num_ctrl_ready(0),
+	  num_ctrl_waits(0),
+	  epoch_ctrl_wait_ns(0.0),
+	  num_eager_compls(0),
+	  epoch_eager_latency_ns(0.0)
+{
+}
+
+void nccl_ofi_eager_threshold::report_attempt(bool ctrl_ready)
+{
+	if (!this->msg_pending) {
+		/* First attempt of the message */
+		this->msg_pending = true;
+		this->num_msgs++;
+		if (ctrl_ready) {
+			this->num_ctrl_ready++;
+		} else {
+			this->msg_waiting = true;
+			this->msg_start_ns = this->clock_fn();
+		}
+	} else if (this->msg_waiting && ctrl_ready) {
+		/* The message waited for its control message */
+		double wait = (double)(this->clock_fn() - this->msg_start_ns);
+
+		this->msg_waiting = false;
+		this->ctrl_wait_ns = ewma(this->ctrl_wait_ns, wait);
+		this->epoch_ctrl_wait_ns += wait;
+		this->num_ctrl_waits++;
+	}
+}
+
+void nccl_ofi_eager_threshold::report_posted()
+{
+	/* A message posted eagerly while waiting does not wait anymore */
+	this->msg_pending = false;
+	this->msg_waiting = false;
+
+	if (this->num_msgs >= EAGER_THRESHOLD_EPOCH_MSGS) {
+		this->end_epoch();
+	}
+}
+
+void nccl_ofi_eager_threshold::report_eager_ctrl_delay(uint64_t delay_ns)
+{
+	this->eager_ctrl_delay_ns = ewma(this->eager_ctrl_delay_ns, (double)delay_ns);
+}
+
+void nccl_ofi_eager_threshold::report_eager_completion(uint64_t latency_ns)
+{
+	double latency = (double)latency_ns;
+
+	this->eager_latency_ns = ewma(this->eager_latency_ns, latency);
+	if (this->min_eager_latency_ns == 0.0 || latency < this->min_eager_latency_ns) {
+		this->min_eager_latency_ns = latency;
+	}
+	this->epoch_eager_latency_ns += latency;
+	this->num_eager_compls++;
+}
+
+void nccl_ofi_eager_threshold::end_epoch()
+{
+	double ctrl_ready_rate = (double)this->num_ctrl_ready / this->num_msgs;
+	bool slow_eager = false;
+	ssize_t new_size = this->cur_size;
+
+	if (this->num_eager_compls >= EAGER_THRESHOLD_LATENCY_MIN_SAMPLES) {
+		double latency = this->epoch_eager_latency_ns / this->num_eager_compls;
+		slow_eager = latency > EAGER_THRESHOLD_LATENCY_MIN_NS &&
+			latency > EAGER_THRESHOLD_LATENCY_FACTOR * this->min_eager_latency_ns;
+	}
+
+	if (ctrl_ready_rate >= EAGER_THRESHOLD_CTRL_READY_HIGH || slow_eager) {
+		new_size = this->cur_size / 2;
+		if (new_size < EAGER_THRESHOLD_MIN_SIZE) {
+			new_size = 0;
+		}
+	} else if (ctrl_ready_rate <= EAGER_THRESHOLD_CTRL_READY_LOW && this->num_ctrl_waits > 0 &&
+		   this->epoch_ctrl_wait_ns / this->num_ctrl_waits >
+		   EAGER_THRESHOLD_WAIT_FACTOR * this->eager_latency_ns) {
+		/* Without eager latency samples, waiting is always longer */
+		new_size = std::min(std::max(this->cur_size * 2, (ssize_t)EAGER_THRESHOLD_MIN_SIZE),
+				    this->max_size);
+	}
+
+	if (new_size != this->cur_size) {
+		NCCL_OFI_TRACE(NCCL_NET, "Eager threshold %zd -> %zd (ctrl ready %.2f, wait %.0f ns, "
+			       "eager %.0f ns, eager ctrl delay %.0f ns%s)",
+			       this->cur_size, new_size, ctrl_ready_rate, this->ctrl_wait_ns,
+			       this->eager_latency_ns, this->eager_ctrl_delay_ns, slow_eager ? ", slow" : "");
+		this->cur_size = new_size;
+	}
+
+	this->num_msgs = 0;
+	this->num_ctrl_ready = 0;
+	this->num_ctrl_waits = 0;
+	this->epoch_ctrl_wait_ns = 0.0;
+	this->num_eager_compls = 0;
+	this->epoch_eager_latency_ns = 0.0;
+}
@@ -9,11 +9,14 @@
 #include <errno.h>
 #include <stdexcept>
 #include <stdlib.h>
+#include <mutex>
+#include <vector>
 
 #include "nccl_ofi.h"
 #include "nccl_ofi_freelist.h"
 #include "nccl_ofi_log.h"
 #include "nccl_ofi_math.h"
+#include "nccl_ofi_param.h"
 
 
 void nccl_ofi_freelist::init_internal(size_t entry_size_arg,
@@ -64,6 +67,16 @@ void nccl_ofi_freelist::init_internal(size_t entry_size_arg,
 	this->entries = NULL;
 	this->blocks = NULL;
 
+	this->numa_node = nccl_ofi_numa_current_node();
+	this->num_idle_blocks = 0;
+	this->trim_watermark = 0;
+	this->memory_size = 0;
+	this->peak_allocated_entries = 0;
+	this->peak_in_use_entries = 0;
+	this->peak_memory_size = 0;
+	this->num_trimmed_blocks = 0;
+	this->num_trimmed_entries = 0;
+
 	this->have_reginfo = have_reginfo_arg;
 	this->regmr_fn = regmr_fn_arg;
 	this->deregmr_fn = deregmr_fn_arg;
@@ -81,6 +94,8 @@ void nccl_ofi_freelist::init_internal(size_t entry_size_arg,
 		NCCL_OFI_WARN("Allocating initial freelist entries failed: %d", ret);
 		throw std::runtime_error("freelist initial allocation failed");
 	}
+
+	set_trim_watermark(ofi_nccl_freelist_trim_watermark());
 }
 
 
@@ -91,7 +106,8 @@ nccl_ofi_freelist::nccl_ofi_freelist(size_t entry_size_arg,
 				     nccl_ofi_freelist_entry_init_fn entry_init_fn_arg,
 				     nccl_ofi_freelist_entry_fini_fn entry_fini_fn_arg,
 				     const char *name_arg,
-				     bool enable_leak_detection_arg)
+				     bool enable_leak_detection_arg,
+				     size_t entry_alignment_arg)
 {
 	init_internal(entry_size_arg,
 		      initial_entry_count_arg,
@@ -103,7 +119,7 @@ nccl_ofi_freelist::nccl_ofi_freelist(size_t entry_size_arg,
 		      NULL,
 		      NULL,
 		      NULL,
-		      1,
+		      entry_alignment_arg,
 		      name_arg,
 		      enable_leak_detection_arg);
 }
@@ -140,63 +156,138 @@ nccl_ofi_freelist::nccl_ofi_freelist(size_t entry_size_arg,
 
 nccl_ofi_freelist::~nccl_ofi_freelist()
 {
-	int ret;
-
 	while (this->blocks) {
 		struct nccl_ofi_freelist_block_t *block = this->blocks;
-		nccl_net_ofi_mem_defined(block, sizeof(struct nccl_ofi_freelist_block_t));
-		void *memory = block->memory;
-		size_t size = block->memory_size;
 		this->blocks = block->next;
+		release_block(block);
+	}
 
-		if (this->entry_fini_fn != NULL) {
-			for (size_t i = 0; i < block->num_entries; ++i) {
-				nccl_ofi_freelist::fl_entry *entry = &block->entries[i];
+	this->entry_size = 0;
+	this->entries = NULL;
 
-				/**
-				 * Mark the memory as defined before calling the fini function
-				 * It was initialized previously by entry_init_fn
-				 */
-				this->entry_set_defined(entry->ptr);
+	if (this->num_trimmed_blocks > 0) {
+		NCCL_OFI_TRACE(NCCL_NET, "%s freelist: peak of %zu entries (%zu bytes), %zu entries in %zu blocks trimmed",
+			       this->name, this->peak_allocated_entries, this->peak_memory_size,
+			       this->num_trimmed_entries, this->num_trimmed_blocks);
+	}
 
-				this->entry_fini_fn(entry->ptr);
-			}
-		}
+	if (this->enable_leak_detection && this->num_in_use_entries > 0) {
+		NCCL_OFI_WARN("%s freelist: there are %lu in-use entries that are not released",
+			      this->name, this->num_in_use_entries);
+	}
+}
 
-		/* note: the base of the allocation and the memory
-		   pointer are the same (that is, the block structure
-		   itself is located at the end of the allocation.  See
-		   note in freelist_add for reasoning */
-		if (this->deregmr_fn) {
-			ret = this->deregmr_fn(block->mr_handle);
-			if (ret != 0) {
-				NCCL_OFI_WARN("Could not deregister freelist buffer %p with handle %p",
-					      memory, block->mr_handle);
-			}
+
+void nccl_ofi_freelist::release_block(struct nccl_ofi_freelist_block_t *block)
+{
+	int ret;
+	void *memory = block->memory;
+	size_t size = block->memory_size;
+
+	if (this->entry_fini_fn != NULL) {
+		for (size_t i = 0; i < block->num_entries; ++i) {
+			nccl_ofi_freelist::fl_entry *entry = &block->entries[i];
+
+			/**
+			 * Mark the memory as defined before calling the fini function
+			 * It was initialized previously by entry_init_fn
+			 */
+			this->entry_set_defined(entry->ptr);
+
+			this->entry_fini_fn(entry->ptr);
 		}
+	}
 
-		/* Reset memcheck guards of block memory. This step
-		 * needs to be performed manually since reallocation
-		 * of the same memory via mmap() is invisible to
-		 * ASAN. */
-		nccl_net_ofi_mem_undefined(memory, size);
-		ret = nccl_net_ofi_dealloc_mr_buffer(memory, size);
+	if (this->deregmr_fn) {
+		ret = this->deregmr_fn(block->mr_handle);
 		if (ret != 0) {
-			NCCL_OFI_WARN("Unable to deallocate MR buffer(%d)", ret);
+			NCCL_OFI_WARN("Could not deregister freelist buffer %p with handle %p",
+				      memory, block->mr_handle);
 		}
+	}
 
-		free(block->entries);
-		block->entries = NULL;
-		free(block);
+	/* Reset memcheck guards of block memory. This step
+	 * needs to be performed manually since reallocation
+	 * of the same memory via mmap() is invisible to
+	 * ASAN. */
+	nccl_net_ofi_mem_undefined(memory, size);
+	ret = nccl_net_ofi_dealloc_mr_buffer(memory, size);
+	if (ret != 0) {
+		NCCL_OFI_WARN("Unable to deallocate MR buffer(%d)", ret);
 	}
 
-	this->entry_size = 0;
-	this->entries = NULL;
+	free(block->entries);
+	block->entries = NULL;
+	free(block);
+}
 
-	if (this->enable_leak_detection && this->num_in_use_entries > 0) {
-		NCCL_OFI_WARN("%s freelist: there are %lu in-use entries that are not released",
-			      this->name, this->num_in_use_entries);
+
+size_t nccl_ofi_freelist::trim(size_t max_free_entries)
+{
+	size_t num_free = this->num_allocated_entries - this->num_in_use_entries;
+	struct nccl_ofi_freelist_block_t **block_p = &this->blocks;
+	struct nccl_ofi_freelist_block_t *trimmed = NULL;
+	size_t num_trimmed = 0;
+
+	/* Unlink idle blocks */
+	while (*block_p != NULL && num_free > max_free_entries && this->num_idle_blocks > 0) {
+		struct nccl_ofi_freelist_block_t *block = *block_p;
+		if (block->num_in_use > 0) {
+			block_p = &block->next;
+			continue;
+		}
+
+		*block_p = block->next;
+		block->trimmed = true;
+		block->next = trimmed;
+		trimmed = block;
+
+		num_free -= block->num_entries;
+		this->num_allocated_entries -= block->num_entries;
+		this->memory_size -= block->memory_size;
+		this->num_idle_blocks--;
+		this->num_trimmed_entries += block->num_entries;
+		num_trimmed++;
+	}
+
+	if (trimmed == NULL) {
+		return 0;
+	}
+
+	/* All entries of idle blocks are on the free list */
+	fl_entry **entry_p = &this->entries;
+	while (*entry_p != NULL) {
+		if ((*entry_p)->block->trimmed) {
+			*entry_p = (*entry_p)->next;
+		} else {
+			entry_p = &(*entry_p)->next;
+		}
 	}
+
+	while (trimmed != NULL) {
+		struct nccl_ofi_freelist_block_t *block = trimmed;
+		trimmed = block->next;
+		release_block(block);
+	}
+
+	this->num_trimmed_blocks += num_trimmed;
+	NCCL_OFI_TRACE(NCCL_NET, "%s freelist: trimmed %zu idle blocks, %zu entries left",
+		       this->name, num_trimmed, this->num_allocated_entries);
+
+	return num_trimmed;
+}
+
+
+void nccl_ofi_freelist::get_stats(struct stats *stats_p) const
+{
+	stats_p->num_allocated_entries = this->num_allocated_entries;
+	stats_p->num_in_use_entries = this->num_in_use_entries;
+	stats_p->memory_size = this->memory_size;
+	stats_p->peak_allocated_entries = this->peak_allocated_entries;
+	stats_p->peak_in_use_entries = this->peak_in_use_entries;
+	stats_p->peak_memory_size = this->peak_memory_size;
+	stats_p->num_trimmed_blocks = this->num_trimmed_blocks;
+	stats_p->num_trimmed_entries = this->num_trimmed_entries;
 }
 
 
@@ -229,7 +320,19 @@ int nccl_ofi_freelist::add(size_t num_entries)
 	   buffers are more likely to be page aligned (or aligned to
 	   their size, as the case may be). */
 	block_mem_size = freelist_buffer_mem_size_full_pages(allocation_count);
-	ret = nccl_net_ofi_alloc_mr_buffer(block_mem_size, (void **)&buffer);
+
+	/* Blocks rounded up to huge pages have room for many more entries
+	 * than requested. Use all of it, so that a single registration
+	 * serves as many entries as possible. */
+	if (block_mem_size > NCCL_OFI_ROUND_UP(this->entry_size * allocation_count, system_page_size)) {
+		allocation_count = block_mem_size / this->entry_size;
+		if (this->max_entry_count > 0 &&
+		    this->max_entry_count - this->num_allocated_entries < allocation_count) {
+			allocation_count = this->max_entry_count - this->num_allocated_entries;
+		}
+	}
+
+	ret = nccl_net_ofi_alloc_mr_buffer(block_mem_size, (void **)&buffer, this->numa_node);
 	if (OFI_UNLIKELY(ret != 0)) {
 		NCCL_OFI_WARN("freelist extension allocation failed (%d)", ret);
 		return ret;
@@ -292,6 +395,7 @@ int nccl_ofi_freelist::add(size_t num_entries)
 			entry->mr_handle = NULL;
 		}
 		entry->ptr = buffer;
+		entry->block = block;
 		entry->next = this->entries;
 
 		this->entries = entry;
@@ -309,8 +413,11 @@ int nccl_ofi_freelist::add(size_t num_entries)
 		buffer += user_entry_size;
 	}
 
-	/* Block structure will not be accessed until freelist is destroyed */
-	nccl_net_ofi_mem_noaccess(block, sizeof(struct nccl_ofi_freelist_block_t));
+	this->num_idle_blocks++;
+	this->memory_size += block_mem_size;
+	this->peak_allocated_entries = std::max(this->peak_allocated_entries,
+						this->num_allocated_entries);
+	this->peak_memory_size = std::max(this->peak_memory_size, this->memory_size);
 
 	return 0;
 
@@ -330,3 +437,220 @@ int nccl_ofi_freelist::add(size_t num_entries)
 	}
 	return ret;
 }
+
+
+/* Thread indexes of threads that exited, available for reuse */
+static std::mutex thread_index_lock;
+static std::vector<size_t> free_thread_indexes;
+static size_t next_thread_index = 0;
+
+/* Returns the thread index of a thread to the pool when the thread exits */
+struct freelist_mt_thread_index {
+	size_t index = nccl_ofi_freelist_mt::MAX_THREADS;
+
+	~freelist_mt_thread_index()
+	{
+		if (index < nccl_ofi_freelist_mt::MAX_THREADS) {
+			std::lock_guard<std::mutex> lock(thread_index_lock);
+			free_thread_indexes.push_back(index);
+		}
+	}
+};
+static thread_local freelist_mt_thread_index thread_index_owner;
+
+
+size_t nccl_ofi_freelist_mt::acquire_thread_index()
+{
+	std::lock_guard<std::mutex> lock(thread_index_lock);
+	size_t index = MAX_THREADS;
+
+	if (!free_thread_indexes.empty()) {
+		index = free_thread_indexes.back();
+		free_thread_indexes.pop_back();
+	} else if (next_thread_index < MAX_THREADS) {
+		index = next_thread_index++;
+	} else {
+		NCCL_OFI_INFO(NCCL_NET, "Too many threads for freelist magazines, using the shared depot");
+	}
+
+	thread_index_owner.index = index;
+	return index;
+}
+
+
+nccl_ofi_freelist_mt::nccl_ofi_freelist_mt(size_t entry_size_arg,
+					   size_t initial_entry_count_arg,
+					   size_t increase_entry_count_arg,
+					   size_t max_entry_count_arg,
+					   size_t magazine_size_arg,
+					   nccl_ofi_freelist_entry_init_fn entry_init_fn_arg,
+					   nccl_ofi_freelist_entry_fini_fn entry_fini_fn_arg,
+					   const char *name_arg,
+					   bool enable_leak_detection_arg,
+					   size_t entry_alignment_arg)
+	: nccl_ofi_freelist(entry_size_arg,
+			    initial_entry_count_arg,
+			    increase_entry_count_arg,
+			    max_entry_count_arg,
+			    entry_init_fn_arg,
+			    entry_fini_fn_arg,
+			    name_arg,
+			    enable_leak_detection_arg,
+			    entry_alignment_arg)
+{
+	init_magazines(magazine_size_arg);
+}
+
+
+nccl_ofi_freelist_mt::nccl_ofi_freelist_mt(size_t entry_size_arg,
+					   size_t initial_entry_count_arg,
+					   size_t increase_entry_count_arg,
+					   size_t max_entry_count_arg,
+					   size_t magazine_size_arg,
+					   nccl_ofi_freelist_entry_init_fn entry_init_fn_arg,
+					   nccl_ofi_freelist_entry_fini_fn entry_fini_fn_arg,
+					   nccl_ofi_freelist_regmr_fn regmr_fn_arg,
+					   nccl_ofi_freelist_deregmr_fn deregmr_fn_arg,
+					   void *regmr_opaque_arg,
+					   size_t entry_alignment_arg,
+					   const char *name_arg,
+					   bool enable_leak_detection_arg)
+	: nccl_ofi_freelist(entry_size_arg,
+			    initial_entry_count_arg,
+			    increase_entry_count_arg,
+			    max_entry_count_arg,
+			    entry_init_fn_arg,
+			    entry_fini_fn_arg,
+			    regmr_fn_arg,
+			    deregmr_fn_arg,
+			    regmr_opaque_arg,
+			    entry_alignment_arg,
+			    name_arg,
+			    enable_leak_detection_arg)
+{
+	init_magazines(magazine_size_arg);
+}
+
+
+void nccl_ofi_freelist_mt::init_magazines(size_t magazine_size_arg)
+{
+	if (magazine_size_arg == 0) {
+		NCCL_OFI_WARN("%s freelist: magazine size must be positive", this->name);
+		throw std::runtime_error("freelist magazine size must be positive");
+	}
+
+	this->magazine_size = magazine_size_arg;
+	this->slots.assign(MAX_THREADS, magazine_slot{});
+	this->unslotted_in_use = 0;
+}
+
+
+nccl_ofi_freelist_mt::~nccl_ofi_freelist_mt()
+{
+	ssize_t in_use = this->unslotted_in_use;
+
+	/* Entries in magazines and in the depot are free. Memory of all
+	 * entries is released by the blocks of the underlying freelist. */
+	for (auto &slot : this->slots) {
+		in_use += slot.in_use;
+	}
+	assert(in_use >= 0);
+	this->num_in_use_entries = in_use;
+}
+
+
+bool nccl_ofi_freelist_mt::reload(magazine_slot *slot)
+{
+	assert(slot->loaded_count == 0);
+
+	if (slot->previous_count > 0) {
+		std::swap(slot->loaded, slot->previous);
+		std::swap(slot->loaded_count, slot->previous_count);
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lock(this->depot_lock);
+
+	if (!this->full_magazines.empty()) {
+		magazine &mag = this->full_magazines.back();
+		slot->loaded = mag.head;
+		slot->loaded_count = mag.count;
+		this->full_magazines.pop_back();
+		return true;
+	}
+
+	/* Fill a magazine from the underlying freelist, growing it if it has
+	 * no free entry left */
+	while (slot->loaded_count < this->magazine_size) {
+		if (!this->entries) {
+			if (slot->loaded_count > 0) {
+				break;
+			}
+			int ret = add(this->increase_entry_count);
+			if (ret != 0) {
+				NCCL_OFI_WARN("Could not extend freelist: %d", ret);
+				return false;
+			}
+		}
+
+		fl_entry *entry = this->entries;
+		this->entries = entry->next;
+		if (entry->block->num_in_use++ == 0) {
+			this->num_idle_blocks--;
+		}
+		entry->next = slot->loaded;
+		slot->loaded = entry;
+		slot->loaded_count++;
+		this->num_in_use_entries++;
+	}
+	this->peak_in_use_entries = std::max(this->peak_in_use_entries,
+					     this->num_in_use_entries);
+
+	return true;
+}
+
+
+size_t nccl_ofi_freelist_mt::trim_excess()
+{
+	if (OFI_LIKELY(this->trim_watermark == 0)) {
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(this->depot_lock);
+
+	for (magazine &mag : this->full_magazines) {
+		fl_entry *entry = mag.head;
+		while (entry != NULL) {
+			nccl_net_ofi_mem_defined_unaligned(entry, sizeof(*entry));
+			fl_entry *next = entry->next;
+			nccl_ofi_freelist::entry_free(entry);
+			entry = next;
+		}
+	}
+	this->full_magazines.clear();
+
+	return nccl_ofi_freelist::trim_excess();
+}
+
+
+void nccl_ofi_freelist_mt::unload(magazine_slot *slot)
+{
+	assert(slot->loaded_count == this->magazine_size);
+
+	/* The previous magazine is either empty or full */
+	if (slot->previous_count == 0) {
+		std::swap(slot->loaded, slot->previous);
+		std::swap(slot->loaded_count, slot->previous_count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->depot_lock);
+		this->full_magazines.push_back({slot->previous, slot->previous_count});
+	}
+
+	slot->previous = slot->loaded;
+	slot->previous_count = slot->loaded_count;
+	slot->loaded = NULL;
+	slot->loaded_count = 0;
+}
@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <errno.h>
+#include <link.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "nccl_ofi_log.h"
+#include "nccl_ofi_math.h"
+#include "nccl_ofi_memmon.h"
+#include "nccl_ofi_spinlock.h"
+
+#if defined(__x86_64__)
+#define MEMMON_R_JUMP_SLOT R_X86_64_JUMP_SLOT
+#define MEMMON_R_GLOB_DAT R_X86_64_GLOB_DAT
+#elif defined(__aarch64__)
+#define MEMMON_R_JUMP_SLOT R_AARCH64_JUMP_SLOT
+#define MEMMON_R_GLOB_DAT R_AARCH64_GLOB_DAT
+#endif
+
+/* Number of ranges the invalidation log holds before overwriting unread
+ * ones. Must be a power of two. */
+#define MEMMON_LOG_SIZE (4096)
+
+/* Number of ranges copied out of the log at once by consumers */
+#define MEMMON_CONSUME_BATCH (64)
+
+struct memmon_range {
+	uintptr_t addr;
+	size_t len;
+};
+
+/* Invalidation log. Producers run in the interception hooks, so the critical
+ * sections must not call anything that could be intercepted itself. */
+static nccl_ofi_spinlock log_lock;
+static struct memmon_range log_ranges[MEMMON_LOG_SIZE];
+static std::atomic<uint64_t> log_head(0);
+
+void nccl_ofi_memmon_invalidate(const void *addr, size_t len)
+{
+	if (len == 0) {
+		return;
+	}
+
+	log_lock.lock();
+	uint64_t head = log_head.load(std::memory_order_relaxed);
+	log_ranges[head & (MEMMON_LOG_SIZE - 1)] = { (uintptr_t)addr, len };
+	log_head.store(head + 1, std::memory_order_release);
+	log_lock.unlock();
+}
+
+uint64_t nccl_ofi_memmon_seq(void)
+{
+	return log_head.load(std::memory_order_acquire);
+}
+
+int nccl_ofi_memmon_consume(uint64_t *seq, nccl_ofi_memmon_range_fn fn, void *opaque)
+{
+	struct memmon_range batch[MEMMON_CONSUME_BATCH];
+
+	while (true) {
+		size_t num = 0;
+
+		log_lock.lock();
+		uint64_t head = log_head.load(std::memory_order_relaxed);
+		if (head - *seq > MEMMON_LOG_SIZE) {
+			*seq = head;
+			log_lock.unlock();
+			return -EOVERFLOW;
+		}
+		while (*seq != head && num < MEMMON_CONSUME_BATCH) {
+			batch[num++] = log_ranges[*seq & (MEMMON_LOG_SIZE - 1)];
+			(*seq)++;
+		}
+		log_lock.unlock();
+
+		if (num == 0) {
+			return 0;
+		}
+
+		for (size_t i = 0; i < num; i++) {
+			fn(opaque, batch[i].addr, batch[i].len);
+		}
+	}
+}
+
+#if defined(MEMMON_R_JUMP_SLOT)
+
+/* Functions the hooks forward to */
+static int (*real_munmap)(void *, size_t);
+static void *(*real_mremap)(void *, size_t, size_t, int, ...);
+static int (*real_madvise)(void *, size_t, int);
+static int (*real_brk)(void *);
+static void *(*real_sbrk)(intptr_t);
+
+/* Serializes installation and patching */
+static std::mutex patch_mutex;
+static bool installed = false;
+/* Number of objects loaded in the process when objects were last patched */
+static unsigned long long patched_adds = 0;
+
+
+static int hook_munmap(void *addr, size_t len)
+{
+	nccl_ofi_memmon_invalidate(addr, len);
+	return real_munmap(addr, len);
+}
+
+static void *hook_mremap(void *old_addr, size_t old_size, size_t new_size, int flags, ...)
+{
+	void *new_addr = NULL;
+
+	/* Pages may move, or be dropped when shrinking */
+	nccl_ofi_memmon_invalidate(old_addr, old_size);
+
+#ifdef MREMAP_FIXED
+	if (flags & MREMAP_FIXED) {
+		va_list ap;
+		va_start(ap, flags);
+		new_addr = va_arg(ap, void *);
+		va_end(ap);
+
+		/* Existing mappings at the target are replaced */
+		nccl_ofi_memmon_invalidate(new_addr, new_size);
+		return real_mremap(old_addr, old_size, new_size, flags, new_addr);
+	}
+#endif
+
+	return real_mremap(old_addr, old_size, new_size, flags, new_addr);
+}
+
+static int hook_madvise(void *addr, size_t len, int advice)
+{
+	switch (advice) {
+	case MADV_DONTNEED:
+#ifdef MADV_FREE
+	case MADV_FREE:
+#endif
+#ifdef MADV_REMOVE
+	case MADV_REMOVE:
+#endif
+		nccl_ofi_memmon_invalidate(addr, len);
+		break;
+	default:
+		break;
+	}
+
+	return real_madvise(addr, len, advice);
+}
+
+static int hook_brk(void *addr)
+{
+	uintptr_t cur = (uintptr_t)real_sbrk(0);
+
+	if ((uintptr_t)addr < cur) {
+		nccl_ofi_memmon_invalidate(addr, cur - (uintptr_t)addr);
+	}
+
+	return real_brk(addr);
+}
+
+static void *hook_sbrk(intptr_t increment)
+{
+	if (increment < 0) {
+		uintptr_t cur = (uintptr_t)real_sbrk(0);
+		nccl_ofi_memmon_invalidate((void *)(cur + increment), (size_t)(-increment));
+	}
+
+	return real_sbrk(increment);
+}
+
+struct memmon_hook {
+	const char *name;
+	void *hook;
+	void **real;
+};
+
+static struct memmon_hook hooks[] = {
+	{ "munmap", (void *)hook_munmap, (void **)&real_munmap },
+	{ "mremap", (void *)hook_mremap, (void **)&real_mremap },
+	{ "madvise", (void *)hook_madvise, (void **)&real_madvise },
+	{ "brk", (void *)hook_brk, (void **)&real_brk },
+	{ "sbrk", (void *)hook_sbrk, (void **)&real_sbrk },
+};
+
+/* Dynamic section addresses are relocated in place by the loader on most
+ * platforms, but not all */
+static inline uintptr_t dyn_ptr(const struct dl_phdr_info *info, ElfW(Addr) ptr)
+{
+	return (ptr < info->dlpi_addr) ? info->dlpi_addr + ptr : ptr;
+}
+
+/**
+ * Redirect a GOT slot to its hook. Slots in the RELRO segment are read-only
+ * once the object is relocated.
+ */
+static int patch_slot(void **slot, void *hook, uintptr_t relro_start, uintptr_t relro_end)
+{
+	uintptr_t slot_addr = (uintptr_t)slot;
+
+	if (*slot == hook) {
+		return 0;
+	}
+
+	if (slot_addr < relro_start || slot_addr >= relro_end) {
+		*slot = hook;
+		return 0;
+	}
+
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	void *page = (void *)NCCL_OFI_ROUND_DOWN(slot_addr, page_size);
+	if (mprotect(page, page_size, PROT_READ | PROT_WRITE) != 0) {
+		return -errno;
+	}
+	*slot = hook;
+	mprotect(page, page_size, PROT_READ);
+	return 0;
+}
+
+static void patch_relocs(const struct dl_phdr_info *info, const ElfW(Rela) *relocs, size_t relocs_size,
+			 const ElfW(Sym) *symtab, const char *strtab,
+			 uintptr_t relro_start, uintptr_t relro_end)
+{
+	for (size_t i = 0; i < relocs_size / sizeof(ElfW(Rela)); i++) {
+		unsigned long type = ELF64_R_TYPE(relocs[i].r_info);
+		if (type != MEMMON_R_JUMP_SLOT && type != MEMMON_R_GLOB_DAT) {
+			continue;
+		}
+
+		const char *name = strtab + symtab[ELF64_R_SYM(relocs[i].r_info)].st_name;
+		for (auto &hook : hooks) {
+			if (strcmp(name, hook.name) != 0) {
+				continue;
+			}
+			void **slot = (void **)(info->dlpi_addr + relocs[i].r_offset);
+			int ret = patch_slot(slot, hook.hook, relro_start, relro_end);
+			if (ret != 0) {
+				NCCL_OFI_WARN("Memory monitor failed to patch %s in %s: %s",
+					      name, info->dlpi_name, strerror(-ret));
+			}
+			break;
+		}
+	}
+}
+
+static int patch_object(struct dl_phdr_info *info, size_t size, void *data)
+{
+	const ElfW(Dyn) *dyn = NULL;
+	uintptr_t relro_start = 0, relro_end = 0;
+
+	/* The vDSO has no relocations worth looking at */
+	if (strstr(info->dlpi_name, "linux-vdso") != NULL) {
+		return 0;
+	}
+
+	for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+		if (phdr->p_type == PT_DYNAMIC) {
+			dyn = (const ElfW(Dyn) *)(info->dlpi_addr + phdr->p_vaddr);
+		} else if (phdr->p_type == PT_GNU_RELRO) {
+			relro_start = info->dlpi_addr + phdr->p_vaddr;
+			relro_end = relro_start + phdr->p_memsz;
+		}
+	}
+	if (dyn == NULL) {
+		return 0;
+	}
+
+	const ElfW(Sym) *symtab = NULL;
+	const char *strtab = NULL;
+	const ElfW(Rela) *jmprel = NULL, *rela = NULL;
+	size_t jmprel_size = 0, rela_size = 0;
+	bool plt_rela = true;
+
+	for (; dyn->d_tag != DT_NULL; dyn++) {
+		switch (dyn->d_tag) {
+		case DT_SYMTAB:
+			symtab = (const ElfW(Sym) *)dyn_ptr(info, dyn->d_un.d_ptr);
+			break;
+		case DT_STRTAB:
+			strtab = (const char *)dyn_ptr(info, dyn->d_un.d_ptr);
+			break;
+		case DT_JMPREL:
+			jmprel = (const ElfW(Rela) *)dyn_ptr(info, dyn->d_un.d_ptr);
+			break;
+		case DT_PLTRELSZ:
+			jmprel_size = dyn->d_un.d_val;
+			break;
+		case DT_PLTREL:
+			plt_rela = (dyn->d_un.d_val == DT_RELA);
+			break;
+		case DT_RELA:
+			rela = (const ElfW(Rela) *)dyn_ptr(info, dyn->d_un.d_ptr);
+			break;
+		case DT_RELASZ:
+			rela_size = dyn->d_un.d_val;
+			break;
+		default:
+			break;
+		}
+	}
+	if (symtab == NULL || strtab == NULL) {
+		return 0;
+	}
+
+	if (jmprel != NULL && plt_rela) {
+		patch_relocs(info, jmprel, jmprel_size, symtab, strtab, relro_start, relro_end);
+	}
+	if (rela != NULL) {
+		patch_relocs(info, rela, rela_size, symtab, strtab, relro_start, relro_end);
+	}
+
+	return 0;
+}
+
+static int read_adds(struct dl_phdr_info *info, size_t size, void *data)
+{
+	*(unsigned long long *)data = info->dlpi_adds;
+	return 1;
+}
+
+static unsigned long long loaded_objects(void)
+{
+	unsigned long long adds = 0;
+	dl_iterate_phdr(read_adds, &adds);
+	return adds;
+}
+
+static void patch_all(void)
+{
+	patched_adds = loaded_objects();
+	dl_iterate_phdr(patch_object, NULL);
+}
+
+int nccl_ofi_memmon_init(void)
+{
+	std::lock_guard<std::mutex> lock(patch_mutex);
+
+	if (installed) {
+		return 0;
+	}
+
+	for (auto &hook : hooks) {
+		void *real = dlsym(RTLD_DEFAULT, hook.name);
+		if (real == NULL) {
+			NCCL_OFI_WARN("Memory monitor could not resolve %s", hook.name);
+			return -ENOTSUP;
+		}
+		*hook.real = real;
+	}
+
+	patch_all();
+	installed = true;
+
+	NCCL_OFI_INFO(NCCL_INIT | NCCL_NET, "Memory unmap monitor installed");
+	return 0;
+}
+
+void nccl_ofi_memmon_refresh(void)
+{
+	std::lock_guard<std::mutex> lock(patch_mutex);
+
+	if (!installed || loaded_objects() == patched_adds) {
+		return;
+	}
+
+	patch_all();
+}
+
+#else
+
+int nccl_ofi_memmon_init(void)
+{
+	NCCL_OFI_WARN("Memory unmap monitor is not supported on this platform");
+	return -ENOTSUP;
+}
+
+void nccl_ofi_memmon_refresh(void)
+{
+}
+
+#endif
@@ -7,6 +7,11 @@
 #include <errno.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+
+#include "nccl_ofi_memmon.h"
 #include "nccl_ofi_mr.h"
 #include "nccl_ofi_pthread.h"
 
@@ -25,40 +30,34 @@ nccl_ofi_mr_cache_t *nccl_ofi_mr_cache_init(size_t init_num_entries,
 		goto error;
 	}
 
-	ret_cache = (nccl_ofi_mr_cache_t *)calloc(1, sizeof(*ret_cache));
-	if (!ret_cache) {
-		NCCL_OFI_WARN("Could not allocate memory for cache");
-		goto error;
-	}
-
-	ret_cache->slots = (nccl_ofi_reg_entry_t **)calloc(init_num_entries, sizeof(*ret_cache->slots));
-	if (!ret_cache->slots) {
-		NCCL_OFI_WARN("Could not allocate memory for cache slots");
-		goto error;
-	}
+	ret_cache = new nccl_ofi_mr_cache_t();
 
 	if (nccl_net_ofi_mutex_init(&ret_cache->lock, NULL)) {
 		goto error;
 	}
 	/*
 	 * System page size isn't reflective of the GDR mappings. We're not trying to map a
-	 * whole page, but just to find an interval that makes an array-based cache manageable.
+	 * whole page, but just to find an interval that keeps the cache index manageable.
 	 */
 	ret_cache->system_page_size = mr_cache_page_size;
-	ret_cache->size = init_num_entries;
-	ret_cache->used = 0;
+	ret_cache->handles.reserve(init_num_entries);
 	ret_cache->hit_count = 0;
 	ret_cache->miss_count = 0;
+	ret_cache->lazy_dereg = false;
+	ret_cache->idle_entries = 0;
+	ret_cache->idle_bytes = 0;
+	ret_cache->idle_hit_count = 0;
+	ret_cache->eviction_count = 0;
+	ret_cache->monitored = false;
+	ret_cache->memmon_seq = 0;
+	ret_cache->invalidation_count = 0;
+	ret_cache->max_merge_size = 0;
+	ret_cache->merge_count = 0;
 
 	return ret_cache;
 
 error:
-	if (ret_cache) {
-		if (ret_cache->slots) {
-			free(ret_cache->slots);
-		}
-		free(ret_cache);
-	}
+	delete ret_cache;
 	return NULL;
 }
 
@@ -67,38 +66,241 @@ void nccl_ofi_mr_cache_finalize(nccl_ofi_mr_cache_t *cache)
 	assert(cache);
 
 	NCCL_OFI_INFO(NCCL_NET,
-		      "MR cache %d hits %d misses",
-		      cache->hit_count,
-		      cache->miss_count);
+		      "MR cache %d hits (%d on idle entries) %d misses %d evictions %d invalidations %d merges",
+		      cache->hit_count.load(),
+		      cache->idle_hit_count,
+		      cache->miss_count,
+		      cache->eviction_count,
+		      cache->invalidation_count,
+		      cache->merge_count);
+
+	if (cache->idle_entries != 0) {
+		NCCL_OFI_WARN("MR cache finalized with %zu idle entries still registered",
+			      cache->idle_entries);
+	}
 
 	nccl_net_ofi_mutex_destroy(&cache->lock);
 
-	free(cache->slots);
+	for (auto &it : cache->handles) {
+		delete it.second;
+	}
+
+	delete cache;
+}
+
+void nccl_ofi_mr_cache_enable_lazy_dereg(nccl_ofi_mr_cache_t *cache,
+					 size_t max_idle_entries,
+					 size_t max_idle_bytes,
+					 nccl_ofi_mr_cache_dereg_fn dereg_fn,
+					 void *dereg_opaque)
+{
+	assert(cache);
+	assert(dereg_fn);
+
+	cache->lazy_dereg = true;
+	cache->max_idle_entries = max_idle_entries;
+	cache->max_idle_bytes = max_idle_bytes;
+	cache->dereg_fn = dereg_fn;
+	cache->dereg_opaque = dereg_opaque;
+
+	NCCL_OFI_INFO(NCCL_INIT | NCCL_NET,
+		      "MR cache lazy deregistration enabled, up to %zu idle entries and %zu idle bytes",
+		      max_idle_entries, max_idle_bytes);
+}
+
+static inline size_t entry_bytes(nccl_ofi_mr_cache_t *cache, nccl_ofi_reg_entry_t *entry)
+{
+	return entry->pages * cache->system_page_size;
+}
+
+static inline nccl_ofi_mr_cache_index_key_t entry_index_key(nccl_ofi_reg_entry_t *entry)
+{
+	return nccl_ofi_mr_cache_index_key_t(entry->is_endpoint_mr ? entry->ep : nullptr,
+					     entry->addr);
+}
+
+/**
+ * Remove an entry from all cache structures and free it. Caller is
+ * responsible for deregistering the handle.
+ */
+static void remove_entry(nccl_ofi_mr_cache_t *cache, nccl_ofi_reg_entry_t *entry)
+{
+	if (entry->indexed) {
+		auto index_it = cache->index.find(entry_index_key(entry));
+		assert(index_it != cache->index.end() && index_it->second == entry);
+		cache->index.erase(index_it);
+	}
+
+	if (entry->lru_node.on_list()) {
+		entry->lru_node.remove();
+		cache->idle_entries--;
+		cache->idle_bytes -= entry_bytes(cache, entry);
+	}
+
+	cache->handles.erase(entry->handle);
+	delete entry;
+}
+
+/**
+ * Evict an idle entry and deregister its handle
+ */
+static int evict_entry(nccl_ofi_mr_cache_t *cache, nccl_ofi_reg_entry_t *entry)
+{
+	void *handle = entry->handle;
+
+	assert(entry->refcnt == 0);
+	assert(cache->dereg_fn);
+
+	NCCL_OFI_TRACE(NCCL_NET, "Evicting idle MR handle %p in cache entry at %p",
+		       handle, (void *)entry->addr);
 
-	free(cache);
+	remove_entry(cache, entry);
+	cache->eviction_count++;
+
+	int ret = cache->dereg_fn(cache->dereg_opaque, handle);
+	if (OFI_UNLIKELY(ret != 0)) {
+		NCCL_OFI_WARN("Failed to deregister evicted MR handle %p: %d", handle, ret);
+	}
+	return ret;
 }
 
 /**
- * Grow cache to 2x its current size
+ * Evict least recently used idle entries until the idle budget is met
  */
-static int nccl_ofi_mr_cache_grow(nccl_ofi_mr_cache_t *cache)
+static void evict_over_budget(nccl_ofi_mr_cache_t *cache)
+{
+	while ((cache->max_idle_entries != 0 && cache->idle_entries > cache->max_idle_entries) ||
+	       (cache->max_idle_bytes != 0 && cache->idle_bytes > cache->max_idle_bytes)) {
+		nccl_ofi_dlist_node *node = cache->idle_lru.front();
+		if (OFI_UNLIKELY(node == nullptr)) {
+			assert(false);
+			break;
+		}
+		(void)evict_entry(cache, nccl_ofi_dlist_entry(node, &nccl_ofi_reg_entry_t::lru_node));
+	}
+}
+
+int nccl_ofi_mr_cache_purge_idle(nccl_ofi_mr_cache_t *cache)
 {
-	void *ptr;
 	int ret = 0;
-	cache->size *= 2;
-	NCCL_OFI_TRACE(NCCL_NET, "Growing cache to size %zu", cache->size);
-	ptr = realloc(cache->slots, cache->size * sizeof(*cache->slots));
-	if (!ptr) {
-		NCCL_OFI_WARN("Unable to grow cache");
-		ret = -ENOMEM;
-		goto out;
+	nccl_ofi_dlist_node *node;
+	std::lock_guard<std::shared_mutex> index_guard(cache->index_lock);
+
+	while ((node = cache->idle_lru.front()) != nullptr) {
+		int rc = evict_entry(cache, nccl_ofi_dlist_entry(node, &nccl_ofi_reg_entry_t::lru_node));
+		if (rc != 0 && ret == 0) {
+			ret = rc;
+		}
 	}
-	cache->slots = (nccl_ofi_reg_entry_t **)ptr;
 
-out:
 	return ret;
 }
 
+int nccl_ofi_mr_cache_enable_monitor(nccl_ofi_mr_cache_t *cache)
+{
+	assert(cache);
+
+	int ret = nccl_ofi_memmon_init();
+	if (ret != 0) {
+		return ret;
+	}
+
+	cache->monitored = true;
+	cache->memmon_seq = nccl_ofi_memmon_seq();
+	return 0;
+}
+
+/**
+ * Drop an invalidated entry from the index, and evict it if idle
+ */
+static void invalidate_entry(nccl_ofi_mr_cache_t *cache, nccl_ofi_reg_entry_t *entry)
+{
+	NCCL_OFI_TRACE(NCCL_NET, "Invalidating MR handle %p in cache entry at %p",
+		       entry->handle, (void *)entry->addr);
+
+	entry->indexed = false;
+	cache->invalidation_count++;
+	if (entry->refcnt == 0) {
+		(void)evict_entry(cache, entry);
+	}
+}
+
+static void invalidate_range(nccl_ofi_mr_cache_t *cache, uintptr_t addr, size_t len)
+{
+	uintptr_t end = addr + len;
+	auto it = cache->index.begin();
+
+	/*
+	 * Entries of each endpoint are ordered by both start and end address,
+	 * so the entries overlapping the range are a contiguous run. Entries
+	 * may partly overlap each other, so several entries beginning at or
+	 * before addr can reach past it: the run starts at the first of them,
+	 * found by walking back until an entry ends at or before addr.
+	 */
+	while (it != cache->index.end()) {
+		nccl_net_ofi_ep_t *ep = it->first.first;
+
+		it = cache->index.upper_bound(nccl_ofi_mr_cache_index_key_t(ep, addr));
+		while (it != cache->index.begin()) {
+			auto prev = std::prev(it);
+			if (prev->first.first != ep ||
+			    prev->second->addr + entry_bytes(cache, prev->second) <= addr) {
+				break;
+			}
+			it = prev;
+		}
+
+		while (it != cache->index.end() && it->first.first == ep && it->second->addr < end) {
+			nccl_ofi_reg_entry_t *entry = it->second;
+			it = cache->index.erase(it);
+			invalidate_entry(cache, entry);
+		}
+
+		it = cache->index.upper_bound(nccl_ofi_mr_cache_index_key_t(ep, UINTPTR_MAX));
+	}
+}
+
+void nccl_ofi_mr_cache_invalidate(nccl_ofi_mr_cache_t *cache, uintptr_t addr, size_t len)
+{
+	std::lock_guard<std::shared_mutex> index_guard(cache->index_lock);
+	invalidate_range(cache, addr, len);
+}
+
+static void invalidate_range_cb(void *opaque, uintptr_t addr, size_t len)
+{
+	invalidate_range((nccl_ofi_mr_cache_t *)opaque, addr, len);
+}
+
+/**
+ * Drop all entries, as any of them may cover released memory
+ */
+static void invalidate_all(nccl_ofi_mr_cache_t *cache)
+{
+	auto it = cache->index.begin();
+	while (it != cache->index.end()) {
+		nccl_ofi_reg_entry_t *entry = it->second;
+		it = cache->index.erase(it);
+		invalidate_entry(cache, entry);
+	}
+}
+
+/**
+ * Apply the ranges released since the cache last checked the monitor
+ */
+static inline void sync_invalidations(nccl_ofi_mr_cache_t *cache)
+{
+	if (!cache->monitored || nccl_ofi_memmon_seq() == cache->memmon_seq) {
+		return;
+	}
+
+	if (nccl_ofi_memmon_consume(&cache->memmon_seq, invalidate_range_cb, cache) == -EOVERFLOW) {
+		/* The log wrapped: ranges were lost, so no entry can be
+		 * trusted anymore */
+		NCCL_OFI_INFO(NCCL_NET, "MR cache missed memory invalidations, dropping all entries");
+		invalidate_all(cache);
+	}
+}
+
 static inline void compute_page_address(uintptr_t addr,
 					size_t size,
 					uintptr_t system_page_size,
@@ -109,12 +311,101 @@ static inline void compute_page_address(uintptr_t addr,
 	*pages = (addr + size - (*page_addr) + system_page_size - 1) / system_page_size; /* Number of pages in buffer */
 }
 
+static inline nccl_ofi_mr_cache_index_key_t index_key(nccl_ofi_mr_ckey_ref ckey,
+						      bool is_endpoint_mr,
+						      uintptr_t page_addr)
+{
+	return nccl_ofi_mr_cache_index_key_t(is_endpoint_mr ? ckey->ep : nullptr, page_addr);
+}
+
+/**
+ * Return true if entry covers the pages [page_addr, page_addr + pages)
+ */
+static inline bool entry_covers(nccl_ofi_mr_cache_t *cache,
+				nccl_ofi_reg_entry_t *entry,
+				uintptr_t page_addr,
+				size_t pages)
+{
+	return (page_addr >= entry->addr) &&
+	       ((page_addr - entry->addr) / cache->system_page_size + pages) <= entry->pages;
+}
+
+/**
+ * Find the indexed entry covering the pages [page_addr, page_addr + pages)
+ * for the endpoint of key, or NULL if there is none.
+ *
+ * Indexed entries of an endpoint are disjoint in the containment sense, so the
+ * entry with the greatest start address not above page_addr also has the
+ * greatest end address among all candidates.
+ */
+static nccl_ofi_reg_entry_t *find_covering_entry(nccl_ofi_mr_cache_t *cache,
+						 const nccl_ofi_mr_cache_index_key_t &key,
+						 size_t pages)
+{
+	auto it = cache->index.upper_bound(key);
+	if (it == cache->index.begin()) {
+		return NULL;
+	}
+	--it;
+
+	if (it->first.first != key.first ||
+	    !entry_covers(cache, it->second, key.second, pages)) {
+		return NULL;
+	}
+
+	return it->second;
+}
+
 void *nccl_ofi_mr_cache_lookup_entry(nccl_ofi_mr_cache_t *cache,
 				     nccl_ofi_mr_ckey_ref ckey,
 				     bool is_endpoint_mr)
 {
 	uintptr_t page_addr;
 	size_t pages;
+	std::lock_guard<std::shared_mutex> index_guard(cache->index_lock);
+
+	sync_invalidations(cache);
+
+	compute_page_address(nccl_ofi_mr_ckey_baseaddr(ckey),
+			     nccl_ofi_mr_ckey_len(ckey),
+			     (uintptr_t)cache->system_page_size,
+			     &page_addr,
+			     &pages);
+
+	nccl_ofi_reg_entry_t *entry =
+		find_covering_entry(cache, index_key(ckey, is_endpoint_mr, page_addr), pages);
+	if (entry == NULL) {
+		/* cache missed */
+		cache->miss_count++;
+		return NULL;
+	}
+
+	/* cache hit */
+	cache->hit_count++;
+	NCCL_OFI_TRACE(NCCL_NET,
+		       "Found MR handle %p for %ld(%s) in cache entry at %p",
+		       entry->handle,
+		       nccl_ofi_mr_ckey_baseaddr(ckey),
+		       nccl_ofi_mr_ckey_type_str(ckey),
+		       (void *)entry->addr);
+	if (entry->refcnt == 0) {
+		/* Revive idle entry */
+		entry->lru_node.remove();
+		cache->idle_entries--;
+		cache->idle_bytes -= entry_bytes(cache, entry);
+		cache->idle_hit_count++;
+	}
+	entry->refcnt++;
+	return entry->handle;
+}
+
+void *nccl_ofi_mr_cache_lookup_shared(nccl_ofi_mr_cache_t *cache,
+				      nccl_ofi_mr_ckey_ref ckey,
+				      bool is_endpoint_mr)
+{
+	uintptr_t page_addr;
+	size_t pages;
+	void *handle = NULL;
 
 	compute_page_address(nccl_ofi_mr_ckey_baseaddr(ckey),
 			     nccl_ofi_mr_ckey_len(ckey),
@@ -122,42 +413,130 @@ void *nccl_ofi_mr_cache_lookup_entry(nccl_ofi_mr_cache_t *cache,
 			     &page_addr,
 			     &pages);
 
-	for (size_t slot = 0;; slot++) {
-		assert(slot <= cache->used && slot <= cache->size);
-
-		if (slot == cache->used ||
-		    page_addr < cache->slots[slot]->addr) {
-			/* cache missed */
-			cache->miss_count++;
-			return NULL;
-		} else if (is_endpoint_mr && (ckey->ep != cache->slots[slot]->ep)) {
-                        continue;
-		} else if ((page_addr >= cache->slots[slot]->addr) &&
-			   ((page_addr - cache->slots[slot]->addr) /
-				    cache->system_page_size +
-			    pages) <= cache->slots[slot]->pages) {
-			/* cache hit */
-			cache->hit_count++;
-			NCCL_OFI_TRACE(NCCL_NET,
-			               "Found MR handle %p for %ld(%s) in cache slot %zu",
-			               cache->slots[slot]->handle,
-			               nccl_ofi_mr_ckey_baseaddr(ckey),
-			               nccl_ofi_mr_ckey_type_str(ckey),
-			               slot);
-			cache->slots[slot]->refcnt++;
-			return cache->slots[slot]->handle;
+	std::shared_lock<std::shared_mutex> index_guard(cache->index_lock);
+
+	if (cache->monitored && nccl_ofi_memmon_seq() != cache->memmon_seq) {
+		/* Pending invalidations are applied by the locked path */
+		return NULL;
+	}
+
+	nccl_ofi_reg_entry_t *entry =
+		find_covering_entry(cache, index_key(ckey, is_endpoint_mr, page_addr), pages);
+	/* Reviving an idle entry updates the LRU list, which is left to the
+	 * locked path. The refcnt of an entry in use cannot drop to zero while
+	 * the index is shared. */
+	if (entry != NULL && entry->refcnt.load(std::memory_order_relaxed) > 0) {
+		entry->refcnt.fetch_add(1, std::memory_order_relaxed);
+		cache->hit_count.fetch_add(1, std::memory_order_relaxed);
+		handle = entry->handle;
+	}
+
+	return handle;
+}
+
+void nccl_ofi_mr_cache_enable_merge(nccl_ofi_mr_cache_t *cache, size_t max_merge_size)
+{
+	assert(cache);
+
+	cache->max_merge_size = max_merge_size;
+
+	NCCL_OFI_INFO(NCCL_INIT | NCCL_NET,
+		      "MR cache merging of registrations enabled, up to %zu bytes",
+		      max_merge_size);
+}
+
+bool nccl_ofi_mr_cache_merge_key(nccl_ofi_mr_cache_t *cache,
+				 nccl_ofi_mr_ckey_ref ckey,
+				 bool is_endpoint_mr,
+				 uintptr_t bound_addr,
+				 size_t bound_len,
+				 nccl_ofi_mr_ckey_t *merged_ckey)
+{
+	uintptr_t page_addr;
+	size_t pages;
+
+	if (cache->max_merge_size == 0 || ckey->type != NCCL_OFI_MR_CKEY_IOVEC) {
+		return false;
+	}
+
+	compute_page_address(nccl_ofi_mr_ckey_baseaddr(ckey),
+			     nccl_ofi_mr_ckey_len(ckey),
+			     (uintptr_t)cache->system_page_size,
+			     &page_addr,
+			     &pages);
+
+	std::lock_guard<std::shared_mutex> index_guard(cache->index_lock);
+
+	/* Do not merge with entries whose memory is gone */
+	sync_invalidations(cache);
+
+	const nccl_ofi_mr_cache_index_key_t key = index_key(ckey, is_endpoint_mr, page_addr);
+	uintptr_t start = page_addr;
+	uintptr_t end = page_addr + pages * cache->system_page_size;
+	uintptr_t bound_end = bound_addr + bound_len;
+
+	if (start < bound_addr || end > bound_end) {
+		return false;
+	}
+
+	/* Entries ending at or after start, walking down */
+	auto it = cache->index.upper_bound(key);
+	while (it != cache->index.begin()) {
+		auto prev = std::prev(it);
+		nccl_ofi_reg_entry_t *entry = prev->second;
+		if (prev->first.first != key.first ||
+		    entry->addr + entry_bytes(cache, entry) < start ||
+		    entry->addr < bound_addr ||
+		    end - entry->addr > cache->max_merge_size) {
+			break;
+		}
+		start = std::min(start, entry->addr);
+		it = prev;
+	}
+
+	/* Entries starting at or before end, walking up */
+	for (; it != cache->index.end() && it->first.first == key.first && it->second->addr <= end; ++it) {
+		nccl_ofi_reg_entry_t *entry = it->second;
+		uintptr_t entry_end = entry->addr + entry_bytes(cache, entry);
+		if (entry_end > bound_end ||
+		    std::max(end, entry_end) - start > cache->max_merge_size) {
+			break;
 		}
+		end = std::max(end, entry_end);
 	}
+
+	if (start == page_addr && end == page_addr + pages * cache->system_page_size) {
+		return false;
+	}
+
+	NCCL_OFI_TRACE(NCCL_NET, "Merging registration of %p size %zu into %p size %zu",
+		       (void *)nccl_ofi_mr_ckey_baseaddr(ckey), (size_t)nccl_ofi_mr_ckey_len(ckey),
+		       (void *)start, (size_t)(end - start));
+
+	*merged_ckey = *ckey;
+	merged_ckey->iovec.iov_base = (void *)start;
+	merged_ckey->iovec.iov_len = end - start;
+	cache->merge_count++;
+	return true;
 }
 
 int nccl_ofi_mr_cache_insert_entry(nccl_ofi_mr_cache_t *cache,
 				   nccl_ofi_mr_ckey_ref ckey,
 				   bool is_endpoint_mr,
+				   bool retain_idle,
 				   void *handle)
 {
 	uintptr_t page_addr;
 	size_t pages;
-	int ret = 0;
+
+	if (cache->monitored) {
+		/* Objects loaded since the last registration may release
+		 * memory too */
+		nccl_ofi_memmon_refresh();
+	}
+
+	std::lock_guard<std::shared_mutex> index_guard(cache->index_lock);
+	sync_invalidations(cache);
 
 	compute_page_address((uintptr_t)nccl_ofi_mr_ckey_baseaddr(ckey),
 	                     nccl_ofi_mr_ckey_len(ckey),
@@ -165,118 +544,109 @@ int nccl_ofi_mr_cache_insert_entry(nccl_ofi_mr_cache_t *cache,
 	                     &page_addr,
 	                     &pages);
 
-	for (size_t slot = 0;; slot++) {
-		assert(slot <= cache->used && slot <= cache->size);
+	const nccl_ofi_mr_cache_index_key_t key = index_key(ckey, is_endpoint_mr, page_addr);
 
-		if (slot == cache->used ||
-		    page_addr < cache->slots[slot]->addr) {
-			/* cache missed */
+	if (find_covering_entry(cache, key, pages) != NULL) {
+		/* cache hit */
+		NCCL_OFI_WARN("Entry already exists for input (%s) base %lu size %zu",
+		              nccl_ofi_mr_ckey_type_str(ckey),
+		              nccl_ofi_mr_ckey_baseaddr(ckey),
+		              nccl_ofi_mr_ckey_len(ckey));
+		return -EEXIST;
+	}
 
-			/* grow the cache if needed */
-			if (cache->used == cache->size) {
-				ret = nccl_ofi_mr_cache_grow(cache);
-				if (ret != 0) {
-					goto out;
-				}
-			}
+	if (cache->handles.count(handle) != 0) {
+		NCCL_OFI_WARN("MR handle %p is already in the cache", handle);
+		return -EEXIST;
+	}
 
-			assert(cache->slots);
-			memmove(cache->slots + slot + 1,
-				cache->slots + slot,
-				(cache->used - slot) *
-					sizeof(nccl_ofi_reg_entry_t *));
-			cache->slots[slot] = (nccl_ofi_reg_entry_t *)calloc(
-				1,
-				sizeof(nccl_ofi_reg_entry_t));
-			if (!cache->slots[slot]) {
-				NCCL_OFI_WARN("Failed to allocate new slot");
-				ret = -ENOMEM;
-				goto out;
-			}
+	nccl_ofi_reg_entry_t *entry = new nccl_ofi_reg_entry_t();
 
-			nccl_ofi_reg_entry_t *entry = cache->slots[slot];
-
-			entry->addr = page_addr;
-			entry->pages = pages;
-			entry->refcnt = 1;
-			entry->handle = handle;
-			entry->ep = ckey->ep;
-
-			cache->used++;
-			NCCL_OFI_TRACE(NCCL_NET,
-			               "Inserted MR handle %p for %ld(%s) in cache slot %zu",
-			               handle,
-			               nccl_ofi_mr_ckey_baseaddr(ckey),
-			               nccl_ofi_mr_ckey_type_str(ckey),
-			               slot);
-			goto out;
-		} else if ((!(is_endpoint_mr && (cache->slots[slot]->ep != ckey->ep))) &&
-			   (page_addr >= cache->slots[slot]->addr) &&
-			   ((page_addr - cache->slots[slot]->addr) /
-				    cache->system_page_size +
-			    pages) <= cache->slots[slot]->pages) {
-			/* cache hit */
-			NCCL_OFI_WARN("Entry already exists for input (%s) base %lu size %zu",
-			              nccl_ofi_mr_ckey_type_str(ckey),
-			              nccl_ofi_mr_ckey_baseaddr(ckey),
-			              nccl_ofi_mr_ckey_len(ckey));
-			ret = -EEXIST;
-			goto out;
+	entry->addr = page_addr;
+	entry->pages = pages;
+	entry->refcnt = 1;
+	entry->handle = handle;
+	entry->ep = ckey->ep;
+	entry->is_endpoint_mr = is_endpoint_mr;
+	entry->indexed = true;
+	entry->retain_idle = retain_idle && !is_endpoint_mr;
+
+	/*
+	 * Drop entries covered by the new one from the index. They start at or
+	 * after page_addr and, being ordered by end address as well, form a
+	 * contiguous run of the index. Covered idle entries cannot be reached
+	 * anymore and are evicted.
+	 */
+	auto it = cache->index.lower_bound(key);
+	while (it != cache->index.end() && it->first.first == key.first &&
+	       entry_covers(cache, entry, it->second->addr, it->second->pages)) {
+		nccl_ofi_reg_entry_t *covered = it->second;
+		NCCL_OFI_TRACE(NCCL_NET,
+			       "MR handle %p is covered by MR handle %p, removing it from the index",
+			       covered->handle,
+			       handle);
+		covered->indexed = false;
+		it = cache->index.erase(it);
+		if (covered->refcnt == 0) {
+			(void)evict_entry(cache, covered);
 		}
 	}
 
-out:
-	return ret;
-}
+	cache->index.emplace_hint(it, key, entry);
+	cache->handles.emplace(handle, entry);
 
-static int nccl_ofi_mr_cache_lookup_handle(nccl_ofi_mr_cache_t *cache,
-					   void *handle)
-{
-	for (size_t i = 0; i < cache->used; i++) {
-		if (handle == cache->slots[i]->handle) {
-			return i;
-		}
-	}
-	return -1;
+	NCCL_OFI_TRACE(NCCL_NET,
+	               "Inserted MR handle %p for %ld(%s) in cache entry at %p",
+	               handle,
+	               nccl_ofi_mr_ckey_baseaddr(ckey),
+	               nccl_ofi_mr_ckey_type_str(ckey),
+	               (void *)entry->addr);
+
+	return 0;
 }
 
 int nccl_ofi_mr_cache_del_entry(nccl_ofi_mr_cache_t *cache, void *handle)
 {
-	int slot = -1;
-	int ret = 0;
-
-	slot = nccl_ofi_mr_cache_lookup_handle(cache, handle);
-	if (slot < 0) {
+	std::lock_guard<std::shared_mutex> index_guard(cache->index_lock);
+	auto it = cache->handles.find(handle);
+	if (it == cache->handles.end() || it->second->refcnt == 0) {
 		NCCL_OFI_WARN("Did not find entry to delete");
-		ret = -ENOENT;
-		goto out;
+		return -ENOENT;
 	}
 
+	nccl_ofi_reg_entry_t *entry = it->second;
+
 	/* Keep entry alive for other users */
-	if (--cache->slots[slot]->refcnt) {
+	if (--entry->refcnt) {
 		NCCL_OFI_TRACE(
 			NCCL_NET,
-			"Decremented refcnt for MR handle %p in cache slot %d",
+			"Decremented refcnt for MR handle %p in cache entry at %p",
 			handle,
-			slot);
-		goto out;
+			(void *)entry->addr);
+		return 0;
 	}
 
-	/* Free this entry and defrag cache */
-	free(cache->slots[slot]);
-	memmove(cache->slots + slot,
-		cache->slots + slot + 1,
-		(cache->used - slot - 1) * sizeof(nccl_ofi_reg_entry_t *));
-	--cache->used;
+	if (cache->lazy_dereg && entry->retain_idle && entry->indexed) {
+		/* Keep registration for later lookups */
+		cache->idle_lru.push_back(&entry->lru_node);
+		cache->idle_entries++;
+		cache->idle_bytes += entry_bytes(cache, entry);
+		NCCL_OFI_TRACE(NCCL_NET,
+			       "MR handle %p in cache entry at %p is idle",
+			       handle,
+			       (void *)entry->addr);
+
+		evict_over_budget(cache);
+		return 0;
+	}
 
 	NCCL_OFI_TRACE(NCCL_NET,
-		       "Removed MR handle %p in cache slot %d",
+		       "Removed MR handle %p in cache entry at %p",
 		       handle,
-		       slot);
+		       (void *)entry->addr);
 
-	/* Signal to caller to deregister handle */
-	ret = 1;
+	remove_entry(cache, entry);
 
-out:
-	return ret;
+	/* Signal to caller to deregister handle */
+	return 1;
 }
@@ -7,22 +7,28 @@
 #include <cassert>
 #include <cstdint>
 #include <stdexcept>
+#include <thread>
 
 #include "nccl_ofi_msgbuff.h"
 #include "nccl_ofi_log.h"
 
 nccl_ofi_msgbuff::nccl_ofi_msgbuff(uint16_t max_inprogress_arg, uint16_t bit_width, uint16_t start_seq)
-	: buff(max_inprogress_arg),
+	: buff(new slot[max_inprogress_arg]),
 	  max_inprogress(max_inprogress_arg),
 	  field_size((uint16_t)(1 << bit_width)),
 	  field_mask((uint16_t)(1 << bit_width) - 1),
-	  msg_last_incomplete(start_seq),
-	  msg_next(start_seq)
+	  msg_last_incomplete(start_seq)
 {
 	if (this->max_inprogress == 0 || this->field_size <= 2 * this->max_inprogress) {
 		throw std::invalid_argument("Invalid msgbuff parameters: max_inprogress="
 			+ std::to_string(this->max_inprogress) + " bit_width=" + std::to_string(bit_width));
 	}
+
+	for (uint16_t i = 0; i < this->max_inprogress; i++) {
+		this->buff[i].state.store(make_state(0, NCCL_OFI_MSGBUFF_REQ, SLOT_EMPTY),
+					  std::memory_order_relaxed);
+		this->buff[i].elem.store(NULL, std::memory_order_relaxed);
+	}
 }
 
 uint16_t nccl_ofi_msgbuff::distance(uint16_t front, uint16_t back) const
@@ -30,88 +36,121 @@ uint16_t nccl_ofi_msgbuff::distance(uint16_t front, uint16_t back) const
 	return (front < back ? this->field_size : 0) + front - back;
 }
 
-uint16_t nccl_ofi_msgbuff::num_inflight() const
-{
-	return this->distance(this->msg_next, this->msg_last_incomplete);
-}
-
-nccl_ofi_msgbuff_elem_t &nccl_ofi_msgbuff::buff_idx(uint16_t idx)
+nccl_ofi_msgbuff::slot &nccl_ofi_msgbuff::buff_idx(uint16_t idx)
 {
 	return this->buff[idx % this->max_inprogress];
 }
 
-const nccl_ofi_msgbuff_elem_t &nccl_ofi_msgbuff::buff_idx(uint16_t idx) const
+uint32_t nccl_ofi_msgbuff::load_state(slot &s)
 {
-	return this->buff[idx % this->max_inprogress];
+	uint32_t state = s.state.load(std::memory_order_acquire);
+
+	/* Updates of a slot only last a few stores, wait for them */
+	while (OFI_UNLIKELY(state_status(state) == SLOT_BUSY)) {
+		std::this_thread::yield();
+		state = s.state.load(std::memory_order_acquire);
+	}
+	return state;
 }
 
-nccl_ofi_msgbuff_status_t nccl_ofi_msgbuff::get_idx_status(uint16_t msg_index) const
+nccl_ofi_msgbuff_status_t nccl_ofi_msgbuff::get_idx_status(uint16_t msg_index, uint32_t *state)
 {
-	/* Test for INPROGRESS: index is between msg_last_incomplete (inclusive) and msg_next
-	 * (exclusive) */
-	if (this->distance(msg_index, this->msg_last_incomplete) <
-	    this->distance(this->msg_next, this->msg_last_incomplete)) {
-		return this->buff_idx(msg_index).stat;
+	/* Read the slot before the tail: a slot reused by a later message implies the
+	 * tail moved past the message it held before */
+	*state = this->load_state(this->buff_idx(msg_index));
+	uint16_t last_incomplete = this->msg_last_incomplete.load(std::memory_order_acquire);
+
+	/* Index is in the in-flight section: the slot tells whether the message was
+	 * started */
+	if (this->distance(msg_index, last_incomplete) < this->max_inprogress) {
+		uint16_t seq = state_seq(*state);
+
+		if (state_status(*state) == SLOT_EMPTY) {
+			return NCCL_OFI_MSGBUFF_NOTSTARTED;
+		}
+		if (seq == msg_index) {
+			return (state_status(*state) == SLOT_COMPLETED) ?
+				NCCL_OFI_MSGBUFF_COMPLETED : NCCL_OFI_MSGBUFF_INPROGRESS;
+		}
+		/* Slot holds a message that already left the in-flight section */
+		if (this->distance(seq, last_incomplete) >= this->max_inprogress) {
+			return NCCL_OFI_MSGBUFF_NOTSTARTED;
+		}
+		/* Slot is held by another in-flight message, only possible when the
+		 * buffer size does not divide the range of sequence numbers */
+		return NCCL_OFI_MSGBUFF_UNAVAILABLE;
 	}
 
 	/* Test for COMPLETED: index is within max_inprogress below msg_last_incomplete, including
 	 * wraparound */
-	if (msg_index != this->msg_last_incomplete &&
-	    this->distance(this->msg_last_incomplete, msg_index) <= this->max_inprogress) {
+	if (msg_index != last_incomplete &&
+	    this->distance(last_incomplete, msg_index) <= this->max_inprogress) {
 		return NCCL_OFI_MSGBUFF_COMPLETED;
 	}
 
-	/* Test for NOTSTARTED: index is >= msg_next and there is room in the buffer */
-	if (this->distance(msg_index, this->msg_next) <
-	    this->distance(this->max_inprogress, this->num_inflight())) {
-		return NCCL_OFI_MSGBUFF_NOTSTARTED;
-	}
-
 	/* If none of the above apply, then we do not have space to store this message */
 	return NCCL_OFI_MSGBUFF_UNAVAILABLE;
 }
 
+bool nccl_ofi_msgbuff::update_slot(slot &s, uint32_t state, void *elem,
+				   nccl_ofi_msgbuff_elemtype_t type, slot_status status)
+{
+	uint16_t seq = state_seq(state);
+
+	/* Claim the slot, so that readers never see an element that does not
+	 * match the type */
+	if (!s.state.compare_exchange_strong(state, make_state(seq, type, SLOT_BUSY),
+					     std::memory_order_acquire)) {
+		return false;
+	}
+	s.elem.store(elem, std::memory_order_relaxed);
+	s.state.store(make_state(seq, type, status), std::memory_order_release);
+	return true;
+}
+
 nccl_ofi_msgbuff_result_t nccl_ofi_msgbuff::insert(uint16_t msg_index, void *elem,
 						    nccl_ofi_msgbuff_elemtype_t type,
 						    nccl_ofi_msgbuff_status_t *msg_idx_status)
 {
-	std::lock_guard<std::mutex> guard(this->lock);
-
-	*msg_idx_status = this->get_idx_status(msg_index);
-
-	if (*msg_idx_status == NCCL_OFI_MSGBUFF_NOTSTARTED) {
-		this->buff_idx(msg_index).stat = NCCL_OFI_MSGBUFF_INPROGRESS;
-		this->buff_idx(msg_index).elem = elem;
-		this->buff_idx(msg_index).type = type;
-		/* Update msg_next ptr */
-		while (this->distance(msg_index, this->msg_next) <= this->max_inprogress) {
-			if (this->msg_next != msg_index) {
-				this->buff_idx(this->msg_next).stat = NCCL_OFI_MSGBUFF_NOTSTARTED;
-				this->buff_idx(this->msg_next).elem = NULL;
-			}
-			this->msg_next = (this->msg_next + 1) & this->field_mask;
+	slot &s = this->buff_idx(msg_index);
+	uint32_t state;
+
+	while (true) {
+		*msg_idx_status = this->get_idx_status(msg_index, &state);
+		if (*msg_idx_status != NCCL_OFI_MSGBUFF_NOTSTARTED) {
+			return NCCL_OFI_MSGBUFF_INVALID_IDX;
+		}
+
+		/* Rewrite the sequence number of the free slot while claiming it. On
+		 * failure, another thread changed the slot; look again. */
+		uint32_t free_state = state;
+		if (s.state.compare_exchange_strong(free_state,
+						    make_state(msg_index, type, SLOT_BUSY),
+						    std::memory_order_acquire)) {
+			break;
 		}
-		return NCCL_OFI_MSGBUFF_SUCCESS;
 	}
 
-	return NCCL_OFI_MSGBUFF_INVALID_IDX;
+	s.elem.store(elem, std::memory_order_relaxed);
+	s.state.store(make_state(msg_index, type, SLOT_INPROGRESS), std::memory_order_release);
+	return NCCL_OFI_MSGBUFF_SUCCESS;
 }
 
 nccl_ofi_msgbuff_result_t nccl_ofi_msgbuff::replace(uint16_t msg_index, void *elem,
 						     nccl_ofi_msgbuff_elemtype_t type,
 						     nccl_ofi_msgbuff_status_t *msg_idx_status)
 {
-	std::lock_guard<std::mutex> guard(this->lock);
+	slot &s = this->buff_idx(msg_index);
+	uint32_t state;
 
-	*msg_idx_status = this->get_idx_status(msg_index);
-
-	if (*msg_idx_status == NCCL_OFI_MSGBUFF_INPROGRESS) {
-		this->buff_idx(msg_index).elem = elem;
-		this->buff_idx(msg_index).type = type;
-		return NCCL_OFI_MSGBUFF_SUCCESS;
-	}
+	do {
+		*msg_idx_status = this->get_idx_status(msg_index, &state);
+		if (*msg_idx_status != NCCL_OFI_MSGBUFF_INPROGRESS) {
+			return NCCL_OFI_MSGBUFF_INVALID_IDX;
+		}
+	} while (!this->update_slot(s, state, elem, type, SLOT_INPROGRESS));
 
-	return NCCL_OFI_MSGBUFF_INVALID_IDX;
+	return NCCL_OFI_MSGBUFF_SUCCESS;
 }
 
 nccl_ofi_msgbuff_result_t nccl_ofi_msgbuff::retrieve(uint16_t msg_index, void **elem,
@@ -123,14 +162,23 @@ nccl_ofi_msgbuff_result_t nccl_ofi_msgbuff::retrieve(uint16_t msg_index, void **
 		return NCCL_OFI_MSGBUFF_ERROR;
 	}
 
-	std::lock_guard<std::mutex> guard(this->lock);
+	slot &s = this->buff_idx(msg_index);
+	uint32_t state;
 
-	*msg_idx_status = this->get_idx_status(msg_index);
+	while (true) {
+		*msg_idx_status = this->get_idx_status(msg_index, &state);
+		if (*msg_idx_status != NCCL_OFI_MSGBUFF_INPROGRESS) {
+			break;
+		}
 
-	if (*msg_idx_status == NCCL_OFI_MSGBUFF_INPROGRESS) {
-		*elem = this->buff_idx(msg_index).elem;
-		*type = this->buff_idx(msg_index).type;
-		return NCCL_OFI_MSGBUFF_SUCCESS;
+		/* The element is only valid if the slot did not change while
+		 * reading it */
+		void *slot_elem = s.elem.load(std::memory_order_acquire);
+		if (s.state.load(std::memory_order_relaxed) == state) {
+			*elem = slot_elem;
+			*type = state_type(state);
+			return NCCL_OFI_MSGBUFF_SUCCESS;
+		}
 	}
 
 	if (*msg_idx_status == NCCL_OFI_MSGBUFF_UNAVAILABLE) {
@@ -140,27 +188,61 @@ nccl_ofi_msgbuff_result_t nccl_ofi_msgbuff::retrieve(uint16_t msg_index, void **
 	return NCCL_OFI_MSGBUFF_INVALID_IDX;
 }
 
-nccl_ofi_msgbuff_result_t nccl_ofi_msgbuff::complete(uint16_t msg_index,
-						     nccl_ofi_msgbuff_status_t *msg_idx_status)
+nccl_ofi_msgbuff_result_t nccl_ofi_msgbuff::remove(uint16_t msg_index,
+						   nccl_ofi_msgbuff_status_t *msg_idx_status)
 {
-	std::lock_guard<std::mutex> guard(this->lock);
+	slot &s = this->buff_idx(msg_index);
+	uint32_t state;
+
+	do {
+		*msg_idx_status = this->get_idx_status(msg_index, &state);
+		if (*msg_idx_status != NCCL_OFI_MSGBUFF_INPROGRESS) {
+			if (*msg_idx_status == NCCL_OFI_MSGBUFF_UNAVAILABLE) {
+				/* UNAVAILABLE really only applies to insert, so return NOTSTARTED here */
+				*msg_idx_status = NCCL_OFI_MSGBUFF_NOTSTARTED;
+			}
+			return NCCL_OFI_MSGBUFF_INVALID_IDX;
+		}
+	} while (!this->update_slot(s, state, NULL, state_type(state), SLOT_EMPTY));
 
-	*msg_idx_status = this->get_idx_status(msg_index);
+	return NCCL_OFI_MSGBUFF_SUCCESS;
+}
 
-	if (*msg_idx_status == NCCL_OFI_MSGBUFF_INPROGRESS) {
-		this->buff_idx(msg_index).stat = NCCL_OFI_MSGBUFF_COMPLETED;
-		this->buff_idx(msg_index).elem = NULL;
-		/* Move up tail msg_last_incomplete ptr */
-		while (this->msg_last_incomplete != this->msg_next &&
-		       this->buff_idx(this->msg_last_incomplete).stat == NCCL_OFI_MSGBUFF_COMPLETED) {
-			this->msg_last_incomplete = (this->msg_last_incomplete + 1) & this->field_mask;
+nccl_ofi_msgbuff_result_t nccl_ofi_msgbuff::complete(uint16_t msg_index,
+						     nccl_ofi_msgbuff_status_t *msg_idx_status)
+{
+	slot &s = this->buff_idx(msg_index);
+	uint32_t state;
+
+	while (true) {
+		*msg_idx_status = this->get_idx_status(msg_index, &state);
+		if (*msg_idx_status != NCCL_OFI_MSGBUFF_INPROGRESS) {
+			if (*msg_idx_status == NCCL_OFI_MSGBUFF_UNAVAILABLE) {
+				/* UNAVAILABLE really only applies to insert, so return NOTSTARTED here */
+				*msg_idx_status = NCCL_OFI_MSGBUFF_NOTSTARTED;
+			}
+			return NCCL_OFI_MSGBUFF_INVALID_IDX;
+		}
+		if (this->update_slot(s, state, NULL, state_type(state), SLOT_COMPLETED)) {
+			break;
 		}
-		return NCCL_OFI_MSGBUFF_SUCCESS;
 	}
 
-	if (*msg_idx_status == NCCL_OFI_MSGBUFF_UNAVAILABLE) {
-		/* UNAVAILABLE really only applies to insert, so return NOTSTARTED here */
-		*msg_idx_status = NCCL_OFI_MSGBUFF_NOTSTARTED;
+	/* Move up tail msg_last_incomplete ptr. Completers of other messages may
+	 * race with us; whoever wins the compare-and-swap moves it by one. */
+	uint16_t last_incomplete = this->msg_last_incomplete.load(std::memory_order_acquire);
+	while (true) {
+		uint32_t tail_state = this->load_state(this->buff_idx(last_incomplete));
+		if (state_seq(tail_state) != last_incomplete ||
+		    state_status(tail_state) != SLOT_COMPLETED) {
+			break;
+		}
+		uint16_t next = (last_incomplete + 1) & this->field_mask;
+		if (this->msg_last_incomplete.compare_exchange_weak(last_incomplete, next,
+								    std::memory_order_acq_rel)) {
+			last_incomplete = next;
+		}
 	}
-	return NCCL_OFI_MSGBUFF_INVALID_IDX;
+
+	return NCCL_OFI_MSGBUFF_SUCCESS;
 }
@@ -6,6 +6,7 @@
 #include "config.h"
 
 #include <algorithm>
+#include <atomic>
 #include <limits.h>
 #include <mutex>
 #include <stdio.h>
@@ -88,6 +89,155 @@ size_t system_page_size = 0;
 /* Alignment used for MR cache and key creation */
 size_t mr_cache_alignment = 0;
 
+/* Huge page mode of MR buffers */
+static HUGEPAGES mr_buffer_hugepages = HUGEPAGES::NONE;
+
+/* Size of the huge pages backing MR buffers, 0 if huge pages are not used */
+static size_t mr_buffer_huge_page_size = 0;
+
+/*
+ * @brief	Read a size in bytes from a sysfs file
+ *
+ * @return	Size, or 0 if the file could not be read
+ */
+static size_t read_sysfs_size(const char *path)
+{
+	unsigned long long val = 0;
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		return 0;
+	}
+	if (fscanf(file, "%llu", &val) != 1) {
+		val = 0;
+	}
+	fclose(file);
+	return (size_t)val;
+}
+
+/*
+ * @brief	Default size of hugetlbfs pages, as reported by /proc/meminfo
+ *
+ * @return	Size, or 0 if the size could not be determined
+ */
+static size_t hugetlb_page_size(void)
+{
+	char line[256];
+	unsigned long long kib = 0;
+	FILE *file = fopen("/proc/meminfo", "r");
+	if (file == NULL) {
+		return 0;
+	}
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (sscanf(line, "Hugepagesize: %llu kB", &kib) == 1) {
+			break;
+		}
+	}
+	fclose(file);
+	return (size_t)kib * 1024;
+}
+
+void nccl_net_ofi_mr_buffer_init(void)
+{
+	size_t huge_page_size = 0;
+
+	assert(system_page_size > 0);
+
+	mr_buffer_hugepages = ofi_nccl_mr_buffer_hugepages();
+	switch (mr_buffer_hugepages) {
+	case HUGEPAGES::HUGETLB:
+		huge_page_size = hugetlb_page_size();
+		break;
+	case HUGEPAGES::THP:
+		huge_page_size = read_sysfs_size("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+		break;
+	case HUGEPAGES::NONE:
+		break;
+	}
+
+	if (mr_buffer_hugepages != HUGEPAGES::NONE &&
+	    (huge_page_size <= system_page_size ||
+	     !NCCL_OFI_IS_POWER_OF_TWO(huge_page_size))) {
+		NCCL_OFI_INFO(NCCL_INIT | NCCL_NET,
+			      "Huge pages are not available, using regular pages for MR buffers");
+		mr_buffer_hugepages = HUGEPAGES::NONE;
+		huge_page_size = 0;
+	}
+
+	mr_buffer_huge_page_size = huge_page_size;
+	if (mr_buffer_huge_page_size > 0) {
+		NCCL_OFI_INFO(NCCL_INIT | NCCL_NET, "Using %s pages of %zu bytes for MR buffers",
+			      (mr_buffer_hugepages == HUGEPAGES::HUGETLB) ? "hugetlb" : "transparent huge",
+			      mr_buffer_huge_page_size);
+	}
+}
+
+size_t nccl_net_ofi_mr_buffer_size(size_t size)
+{
+	assert(system_page_size > 0);
+
+	/* Rounding small buffers up to a huge page would waste most of it */
+	if (mr_buffer_huge_page_size > 0 && size >= mr_buffer_huge_page_size / 2) {
+		return NCCL_OFI_ROUND_UP(size, mr_buffer_huge_page_size);
+	}
+	return NCCL_OFI_ROUND_UP(size, system_page_size);
+}
+
+/*
+ * @brief	Map a huge page aligned MR buffer backed by huge pages
+ *
+ * Tries the hugetlbfs pool first if requested, and falls back to
+ * transparent huge pages. Transparent huge pages are best effort: the
+ * kernel backs the buffer with regular pages if it cannot provide huge ones.
+ */
+static int alloc_huge_mr_buffer(size_t size, void **ptr)
+{
+	static std::atomic<bool> hugetlb_fallback_logged(false);
+	static std::atomic<bool> thp_unavailable_logged(false);
+	size_t huge_page_size = mr_buffer_huge_page_size;
+
+	if (mr_buffer_hugepages == HUGEPAGES::HUGETLB) {
+		*ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANON | MAP_HUGETLB, -1, 0);
+		if (*ptr != MAP_FAILED) {
+			return 0;
+		}
+		if (!hugetlb_fallback_logged.exchange(true)) {
+			NCCL_OFI_INFO(NCCL_NET, "Unable to map hugetlb pages (%d %s), falling back to transparent huge pages",
+				      errno, strerror(errno));
+		}
+	}
+
+	/* Transparent huge pages only back huge page aligned ranges. Map
+	 * an extra huge page and trim the mapping to an aligned range. */
+	size_t map_size = size + huge_page_size;
+	void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (OFI_UNLIKELY(map == MAP_FAILED)) {
+		*ptr = NULL;
+		return -errno;
+	}
+
+	uintptr_t map_addr = (uintptr_t)map;
+	uintptr_t aligned_addr = NCCL_OFI_ROUND_UP(map_addr, huge_page_size);
+	size_t head = aligned_addr - map_addr;
+	size_t tail = map_size - head - size;
+	if (head > 0) {
+		munmap(map, head);
+	}
+	if (tail > 0) {
+		munmap((void *)(aligned_addr + size), tail);
+	}
+
+	*ptr = (void *)aligned_addr;
+	if (madvise(*ptr, size, MADV_HUGEPAGE) != 0) {
+		if (!thp_unavailable_logged.exchange(true)) {
+			NCCL_OFI_INFO(NCCL_NET, "Transparent huge pages are not available (%d %s)",
+				      errno, strerror(errno));
+		}
+	}
+	return 0;
+}
+
 /*
  * @brief	Allocate memory region for memory registration
  *
@@ -100,26 +250,42 @@ size_t mr_cache_alignment = 0;
  * To free deallocate the memory region, function
  * nccl_net_ofi_dealloc_mr_buffer() must be used.
  *
+ * Memory regions whose size is a multiple of the huge page size are backed
+ * by huge pages and aligned to the huge page size if huge pages are enabled.
+ *
  * @param	size
  *		Size of the memory region. Must be a multiple of system memory page size.
  * @return	Pointer to memory region. Memory region is aligned to system memory page size.
  * @return	0, on success
  *		error, on others
  */
-int nccl_net_ofi_alloc_mr_buffer(size_t size, void **ptr)
+int nccl_net_ofi_alloc_mr_buffer(size_t size, void **ptr, int numa_node)
 {
+	bool mapped = false;
+
 	assert(system_page_size > 0);
 	assert(NCCL_OFI_IS_ALIGNED(size, system_page_size));
 
-	*ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
-		    MAP_PRIVATE | MAP_ANON, -1, 0);
-	if (OFI_UNLIKELY(*ptr == MAP_FAILED)) {
-		NCCL_OFI_WARN("Unable to map MR buffer (%d %s)",
-			      errno, strerror(errno));
-		*ptr = NULL;
-		return -errno;
+	if (mr_buffer_huge_page_size > 0 &&
+	    NCCL_OFI_IS_ALIGNED(size, mr_buffer_huge_page_size)) {
+		mapped = (alloc_huge_mr_buffer(size, ptr) == 0);
+	}
+
+	if (!mapped) {
+		*ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANON, -1, 0);
+		if (OFI_UNLIKELY(*ptr == MAP_FAILED)) {
+			NCCL_OFI_WARN("Unable to map MR buffer (%d %s)",
+				      errno, strerror(errno));
+			*ptr = NULL;
+			return -errno;
+		}
 	}
 	assert(NCCL_OFI_IS_PTR_ALIGNED(*ptr, system_page_size));
+
+	/* No page was touched yet, so the binding applies to all pages.
+	 * Failing to bind is not fatal, the memory is merely remote. */
+	nccl_ofi_numa_bind(*ptr, size, numa_node);
 	return 0;
 }
 
@@ -183,6 +349,8 @@ int nccl_net_ofi_create_plugin(nccl_net_ofi_plugin_t **plugin_p)
 	 */
 	mr_cache_alignment = std::min(system_page_size, NCCL_OFI_CACHE_PAGE_SIZE);
 
+	nccl_net_ofi_mr_buffer_init();
+
 #if HAVE_GPU
 	ret = nccl_net_ofi_gpu_init();
 	if (ret != 0) {
@@ -458,8 +626,9 @@ static int set_nic_props_default(int dev_id, struct fi_info *nic_prov,
 	props->latency = ofi_nccl_net_latency.get();
 
 	/*
-	 * Maximum number of grouped receives. Currently, we set it to 1 to
+	 * Maximum number of grouped receives. By default, we set it to 1 to
 	 * maintain single send/recv semantics (similar to NCCL versions < v2.12).
+	 * Protocols supporting grouped receives override it.
 	 *
 	 * Grouped receives are useful for alltoall collectives where one
 	 * receiver is expected to receive from multiple remote GPUs using
@@ -467,7 +636,7 @@ static int set_nic_props_default(int dev_id, struct fi_info *nic_prov,
 	 * impacted with this feature as NCCL doesn't aggregate receives from
 	 * same source.
 	 */
-	props->max_group_receives = NCCL_OFI_MAX_RECVS;
+	props->max_group_receives = 1;
 
 	if (support_gdr == GDR_SUPPORTED) {
 		props->hmem_support = true;
@@ -853,6 +1022,14 @@ nccl_net_ofi_domain_t::nccl_net_ofi_domain_t(nccl_net_ofi_device_t *device_arg,
 			NCCL_OFI_WARN("Unable to initialize domain mr cache");
 			throw std::runtime_error("base domain constructor: mr cache init failed");
 		}
+
+		if (ofi_nccl_mr_cache_monitor() &&
+		    nccl_ofi_mr_cache_enable_monitor(this->mr_cache) != 0) {
+			NCCL_OFI_WARN("Unable to enable memory monitor of domain mr cache");
+			nccl_ofi_mr_cache_finalize(this->mr_cache);
+			this->mr_cache = nullptr;
+			throw std::runtime_error("base domain constructor: mr cache monitor init failed");
+		}
 	}
 
 	if (this->device->need_mr_rkey_pool) {
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "nccl_ofi_log.h"
+#include "nccl_ofi_numa.h"
+#include "nccl_ofi_param.h"
+
+/* Number of nodes covered by the node masks passed to the kernel */
+#define NUMA_MASK_NODES (1024)
+#define NUMA_MASK_LONGS (NUMA_MASK_NODES / (8 * sizeof(unsigned long)))
+
+/* NUMA node preferred by the innermost scope of the thread */
+static thread_local int current_node = NCCL_OFI_NUMA_NODE_ANY;
+
+/* Set once the kernel rejected a memory policy call, to log it only once */
+static std::atomic<bool> failure_logged(false);
+
+static void log_failure(const char *call, int err)
+{
+	if (!failure_logged.exchange(true)) {
+		NCCL_OFI_INFO(NCCL_INIT | NCCL_NET, "NUMA local allocation disabled, %s failed: %s",
+			      call, strerror(err));
+	}
+}
+
+static bool numa_enabled(void)
+{
+	return ofi_nccl_numa_local_alloc() && !failure_logged.load(std::memory_order_relaxed);
+}
+
+static bool fill_mask(unsigned long *mask, int numa_node)
+{
+	if (numa_node < 0 || numa_node >= NUMA_MASK_NODES) {
+		return false;
+	}
+	memset(mask, 0, NUMA_MASK_LONGS * sizeof(unsigned long));
+	mask[numa_node / (8 * sizeof(unsigned long))] |= 1UL << (numa_node % (8 * sizeof(unsigned long)));
+	return true;
+}
+
+static int set_thread_policy(int numa_node)
+{
+	unsigned long mask[NUMA_MASK_LONGS];
+	long ret;
+
+	if (numa_node == NCCL_OFI_NUMA_NODE_ANY) {
+		ret = syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+	} else {
+		if (!fill_mask(mask, numa_node)) {
+			return -EINVAL;
+		}
+		ret = syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, NUMA_MASK_NODES + 1);
+	}
+	if (ret != 0) {
+		int err = errno;
+		log_failure("set_mempolicy()", err);
+		return -err;
+	}
+	return 0;
+}
+
+int nccl_ofi_numa_current_node(void)
+{
+	return current_node;
+}
+
+int nccl_ofi_numa_bind(void *ptr, size_t size, int numa_node)
+{
+	unsigned long mask[NUMA_MASK_LONGS];
+
+	if (numa_node == NCCL_OFI_NUMA_NODE_ANY || !numa_enabled()) {
+		return 0;
+	}
+	if (!fill_mask(mask, numa_node)) {
+		return -EINVAL;
+	}
+
+	if (syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, mask, NUMA_MASK_NODES + 1, 0) != 0) {
+		int err = errno;
+		log_failure("mbind()", err);
+		return -err;
+	}
+	return 0;
+}
+
+nccl_ofi_numa_scope::nccl_ofi_numa_scope(int numa_node)
+	: prev_node(current_node), set_policy(false)
+{
+	if (numa_node == NCCL_OFI_NUMA_NODE_ANY || numa_node == prev_node || !numa_enabled()) {
+		return;
+	}
+
+	/* Outside of any scope, keep a policy set by the application */
+	if (prev_node == NCCL_OFI_NUMA_NODE_ANY) {
+		int mode = MPOL_DEFAULT;
+		if (syscall(SYS_get_mempolicy, &mode, NULL, 0, NULL, 0) != 0) {
+			log_failure("get_mempolicy()", errno);
+			return;
+		}
+		if (mode != MPOL_DEFAULT) {
+			return;
+		}
+	}
+
+	if (set_thread_policy(numa_node) != 0) {
+		return;
+	}
+	current_node = numa_node;
+	set_policy = true;
+}
+
+nccl_ofi_numa_scope::~nccl_ofi_numa_scope()
+{
+	if (!set_policy) {
+		return;
+	}
+	current_node = prev_node;
+	set_thread_policy(prev_node);
+}
@@ -453,6 +453,38 @@ ofi_cq_result nccl_ofi_ofiutils_cq_create(ofi_domain_ptr &domain, struct fi_cq_a
 }
 
 
+/**
+ * @brief	Create a completion queue, with a wait object if enabled and
+ *		supported
+ */
+ofi_cq_result nccl_ofi_ofiutils_cq_create_waitable(ofi_domain_ptr &domain, struct fi_cq_attr *cq_attr)
+{
+	static bool unsupported_logged = false;
+
+	cq_attr->wait_obj = FI_WAIT_NONE;
+	if (ofi_nccl_cq_wait()) {
+		struct fid_cq *raw_cq = nullptr;
+
+		cq_attr->wait_obj = FI_WAIT_FD;
+		int ret = fi_cq_open(domain.get(), cq_attr, &raw_cq, NULL);
+		if (ret == 0) {
+			return ofi_cq_result(make_ofi_cq_ptr(raw_cq));
+		}
+
+		if (!unsupported_logged) {
+			NCCL_OFI_INFO(NCCL_INIT | NCCL_NET,
+				      "Completion queues without wait object, as the provider "
+				      "does not support them. RC: %d, ERROR: %s",
+				      ret, fi_strerror(-ret));
+			unsupported_logged = true;
+		}
+		cq_attr->wait_obj = FI_WAIT_NONE;
+	}
+
+	return nccl_ofi_ofiutils_cq_create(domain, cq_attr);
+}
+
+
 /**
  * @brief	Register memory region with libfabric using fi_mr_regattr
  */
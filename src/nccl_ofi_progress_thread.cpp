@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "nccl_ofi_log.h"
+#include "nccl_ofi_progress_thread.h"
+
+/* First sleep once the loop stopped spinning */
+#define PROGRESS_MIN_SLEEP_NS (1000)
+
+nccl_ofi_progress_backoff::nccl_ofi_progress_backoff(unsigned int spin_count_arg,
+						     uint64_t max_sleep_ns_arg)
+	: spin_count(spin_count_arg),
+	  max_sleep_ns(max_sleep_ns_arg),
+	  num_idle(0),
+	  sleep_ns(0)
+{
+}
+
+uint64_t nccl_ofi_progress_backoff::report_poll(bool progressed)
+{
+	if (progressed) {
+		this->num_idle = 0;
+		this->sleep_ns = 0;
+		return 0;
+	}
+
+	if (this->num_idle < this->spin_count) {
+		this->num_idle++;
+		return 0;
+	}
+
+	if (this->sleep_ns == 0) {
+		this->sleep_ns = PROGRESS_MIN_SLEEP_NS;
+	} else {
+		this->sleep_ns *= 2;
+	}
+	this->sleep_ns = std::min(this->sleep_ns, this->max_sleep_ns);
+
+	return this->sleep_ns;
+}
+
+nccl_ofi_progress_thread::nccl_ofi_progress_thread(int cpu, unsigned int spin_count,
+						   uint64_t max_sleep_ns)
+	: backoff(spin_count, max_sleep_ns),
+	  stop(false),
+	  thread(&nccl_ofi_progress_thread::run, this, cpu)
+{
+}
+
+nccl_ofi_progress_thread::~nccl_ofi_progress_thread()
+{
+	{
+		std::lock_guard guard(this->stop_lock);
+		this->stop = true;
+	}
+	this->stop_cond.notify_all();
+	this->thread.join();
+}
+
+void nccl_ofi_progress_thread::add(void *ctx, progress_fn_t fn)
+{
+	std::lock_guard guard(this->lock);
+	this->targets.push_back({ctx, fn, false});
+}
+
+void nccl_ofi_progress_thread::remove(void *ctx)
+{
+	std::lock_guard guard(this->lock);
+	this->targets.erase(std::remove_if(this->targets.begin(), this->targets.end(),
+					   [ctx](const target &t) { return t.ctx == ctx; }),
+			    this->targets.end());
+}
+
+void nccl_ofi_progress_thread::run(int cpu)
+{
+	if (cpu >= 0) {
+		cpu_set_t cpus;
+
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if (ret != 0) {
+			NCCL_OFI_WARN("Unable to pin progress thread to CPU %d: %s",
+				      cpu, strerror(ret));
+		}
+	}
+
+	while (!this->stop.load(std::memory_order_relaxed)) {
+		bool progressed = false;
+
+		{
+			std::lock_guard guard(this->lock);
+			for (target &t : this->targets) {
+				if (t.failed) {
+					continue;
+				}
+				int ret = t.fn(t.ctx);
+				if (OFI_UNLIKELY(ret < 0)) {
+					NCCL_OFI_WARN("Progress thread failed to make progress on %p: %d. "
+						      "Leaving it to application threads.", t.ctx, ret);
+					t.failed = true;
+				} else if (ret > 0) {
+					progressed = true;
+				}
+			}
+		}
+
+		uint64_t sleep_ns = this->backoff.report_poll(progressed);
+		if (sleep_ns == 0) {
+			/* Leave the CPU and the objects to application
+			 * threads between polls, even while busy */
+			std::this_thread::yield();
+		} else {
+			std::unique_lock guard(this->stop_lock);
+			this->stop_cond.wait_for(guard, std::chrono::nanoseconds(sleep_ns),
+						 [this] { return this->stop.load(); });
+		}
+	}
+}
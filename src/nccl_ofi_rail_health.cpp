@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <stdexcept>
+
+#include "nccl_ofi_log.h"
+#include "nccl_ofi_param.h"
+#include "nccl_ofi_rail_health.h"
+
+/* Weight of a new sample in the moving averages */
+#define RAIL_HEALTH_EWMA_WEIGHT (1.0 / 16)
+
+/* A rail is saturated if this fraction of its posts return EAGAIN ... */
+#define RAIL_HEALTH_EAGAIN_RATE (0.75)
+/* ... while another usable rail stays below this fraction */
+#define RAIL_HEALTH_EAGAIN_OTHER_RATE (0.25)
+
+/* A rail is a latency outlier if its average completion latency exceeds
+ * the one of the fastest other rail by this factor ... */
+#define RAIL_HEALTH_LATENCY_FACTOR (8.0)
+/* ... and this absolute latency */
+#define RAIL_HEALTH_LATENCY_MIN_NS (1000000.0)
+/* Number of samples needed before latencies are compared */
+#define RAIL_HEALTH_LATENCY_MIN_SAMPLES (8)
+
+/* Successful completions after which a probed rail is healthy again */
+#define RAIL_HEALTH_PROBE_COMPLS (16)
+
+/* Maximum cool-down, relative to the configured cool-down */
+#define RAIL_HEALTH_MAX_COOLDOWN_FACTOR (64)
+
+static uint64_t steady_clock_ns(void)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline double ewma(double avg, double sample)
+{
+	return avg + RAIL_HEALTH_EWMA_WEIGHT * (sample - avg);
+}
+
+nccl_ofi_rail_health::nccl_ofi_rail_health(int num_rails, clock_fn_t clock_fn_arg)
+	: clock_fn(clock_fn_arg ? clock_fn_arg : steady_clock_ns),
+	  num_degraded_rails(0)
+{
+	if (num_rails <= 0 || num_rails > 64) {
+		throw std::runtime_error("Rail health tracking supports 1 to 64 rails");
+	}
+
+	this->base_cooldown_ns = ofi_nccl_rail_health_cooldown_ms() * 1000000ULL;
+	this->max_cooldown_ns = this->base_cooldown_ns * RAIL_HEALTH_MAX_COOLDOWN_FACTOR;
+	this->usable_mask = (num_rails == 64) ? ~0ULL : ((1ULL << num_rails) - 1);
+	this->rails.resize(num_rails, rail{RAIL_HEALTHY, 0.0, 0.0, 0, 0, 0, this->base_cooldown_ns, 0});
+}
+
+bool nccl_ofi_rail_health::degrade(int rail_id, const char *reason)
+{
+	rail &r = this->rails[rail_id];
+	uint64_t mask = 1ULL << rail_id;
+
+	if (r.state == RAIL_DEGRADED) {
+		return false;
+	}
+	if ((this->usable_mask & ~mask) == 0) {
+		/* Keep the last usable rail */
+		return false;
+	}
+
+	uint64_t now_ns = this->clock_fn();
+	if (r.state == RAIL_PROBING) {
+		/* Failed probe; back off further */
+		r.cooldown_ns = std::min(r.cooldown_ns * 2, this->max_cooldown_ns);
+	}
+	r.state = RAIL_DEGRADED;
+	r.degraded_until_ns = now_ns + r.cooldown_ns;
+	r.num_degraded++;
+	this->usable_mask &= ~mask;
+	this->num_degraded_rails++;
+
+	NCCL_OFI_INFO(NCCL_NET, "Rail %d degraded (%s), avoiding it for %lu ms",
+		      rail_id, reason, (unsigned long)(r.cooldown_ns / 1000000));
+	return true;
+}
+
+bool nccl_ofi_rail_health::report_error(int rail_id)
+{
+	return this->degrade(rail_id, "completion error");
+}
+
+bool nccl_ofi_rail_health::report_eagain(int rail_id)
+{
+	rail &r = this->rails[rail_id];
+
+	r.eagain_rate = ewma(r.eagain_rate, 1.0);
+	if (r.state == RAIL_DEGRADED || r.eagain_rate < RAIL_HEALTH_EAGAIN_RATE) {
+		return false;
+	}
+
+	/* Only a rail saturated while others are not is degraded; the
+	 * endpoint being busy as a whole is not a rail problem */
+	for (size_t other = 0; other < this->rails.size(); other++) {
+		if ((int)other != rail_id && (this->usable_mask & (1ULL << other)) &&
+		    this->rails[other].eagain_rate < RAIL_HEALTH_EAGAIN_OTHER_RATE) {
+			return this->degrade(rail_id, "saturated");
+		}
+	}
+	return false;
+}
+
+bool nccl_ofi_rail_health::report_completion(int rail_id, uint64_t start_ns)
+{
+	rail &r = this->rails[rail_id];
+
+	r.eagain_rate = ewma(r.eagain_rate, 0.0);
+
+	if (start_ns != 0) {
+		double latency_ns = (double)(this->clock_fn() - start_ns);
+		r.latency_ns = r.num_latency_samples ? ewma(r.latency_ns, latency_ns) : latency_ns;
+		r.num_latency_samples++;
+
+		if (r.state != RAIL_DEGRADED &&
+		    r.num_latency_samples >= RAIL_HEALTH_LATENCY_MIN_SAMPLES &&
+		    r.latency_ns > RAIL_HEALTH_LATENCY_MIN_NS) {
+			for (size_t other = 0; other < this->rails.size(); other++) {
+				const rail &o = this->rails[other];
+				if ((int)other != rail_id && (this->usable_mask & (1ULL << other)) &&
+				    o.num_latency_samples >= RAIL_HEALTH_LATENCY_MIN_SAMPLES &&
+				    r.latency_ns > RAIL_HEALTH_LATENCY_FACTOR * o.latency_ns) {
+					return this->degrade(rail_id, "latency outlier");
+				}
+			}
+		}
+	}
+
+	if (r.state == RAIL_PROBING && ++r.num_probe_compls >= RAIL_HEALTH_PROBE_COMPLS) {
+		r.state = RAIL_HEALTHY;
+		r.cooldown_ns = this->base_cooldown_ns;
+		NCCL_OFI_INFO(NCCL_NET, "Rail %d healthy again", rail_id);
+	}
+
+	return false;
+}
+
+bool nccl_ofi_rail_health::update()
+{
+	bool changed = false;
+
+	if (this->num_degraded_rails == 0) {
+		return false;
+	}
+
+	uint64_t now_ns = this->clock_fn();
+	for (size_t rail_id = 0; rail_id < this->rails.size(); rail_id++) {
+		rail &r = this->rails[rail_id];
+		if (r.state != RAIL_DEGRADED || now_ns < r.degraded_until_ns) {
+			continue;
+		}
+
+		/* Probe the rail again, with fresh statistics */
+		r.state = RAIL_PROBING;
+		r.eagain_rate = 0.0;
+		r.latency_ns = 0.0;
+		r.num_latency_samples = 0;
+		r.num_probe_compls = 0;
+		this->usable_mask |= 1ULL << rail_id;
+		this->num_degraded_rails--;
+		changed = true;
+
+		NCCL_OFI_TRACE(NCCL_NET, "Probing rail %zu", rail_id);
+	}
+
+	return changed;
+}
@@ -4,6 +4,7 @@
 #include "config.h"
 
 #include <algorithm>
+#include <chrono>
 #include <deque>
 #include <stdexcept>
 
@@ -28,12 +29,17 @@
 #include "nccl_ofi_rdma.h"
 #include "nccl_ofi_math.h"
 #include "nccl_ofi_tracepoint.h"
+#include "nccl_ofi_rail_health.h"
+#include "nccl_ofi_cq_poller.h"
+#include "nccl_ofi_cq_wait.h"
+#include "nccl_ofi_progress_thread.h"
 #include "nccl_ofi_scheduler.h"
 #include "nccl_ofi_topo.h"
 #include "nccl_ofi_memcheck.h"
 #include "nccl_ofi_ofiutils.h"
 #include "nccl_ofi_pthread.h"
 #include "nccl_ofi_dmabuf.h"
+#include "nccl_ofi_gdrcopy.h"
 #include "nccl_ofi_mr.h"
 
 /* Message buffer size -- maximum span of simultaneous inflight messages */
@@ -133,19 +139,25 @@ static ssize_t flush_sentinel_size;
 
 static bool early_completion = false;
 
+/* Whether the provider serializes the operations posted to a domain, so
+ * that sends post them without the endpoint lock */
+static bool thread_safe_domain = false;
+
 /* Function prototypes */
 static int send_progress(nccl_net_ofi_rdma_req *req);
 
 static int receive_progress(nccl_net_ofi_rdma_req *req, bool add_to_pending);
 
+static int complete_eager_send(nccl_net_ofi_rdma_send_comm *s_comm, nccl_net_ofi_rdma_req *req);
+
 static int post_rx_buffer(nccl_net_ofi_rdma_req *req,
 			      nccl_net_ofi_rdma_ep_rail_t *ep_rail,
 			      bool set_fi_more);
 
-static nccl_net_ofi_rdma_req *allocate_req(nccl_ofi_freelist *fl);
+static nccl_net_ofi_rdma_req *allocate_req(nccl_ofi_freelist_mt *fl);
 
 static inline int free_base_req(uint64_t *num_inflight_reqs,
-				nccl_ofi_freelist *nccl_ofi_reqs_fl,
+				nccl_ofi_freelist_mt *nccl_ofi_reqs_fl,
 				nccl_net_ofi_rdma_req *req,
 				bool dec_inflight_reqs);
 
@@ -393,6 +405,28 @@ static inline size_t ofi_info_list_length(struct fi_info *info_list)
 }
 
 
+/*
+ * @brief	Number of buffers NCCL may group into a single receive
+ */
+static inline unsigned int rdma_max_group_receives()
+{
+	return std::clamp(ofi_nccl_rdma_max_group_receives(), 1U, (unsigned int)NCCL_OFI_MAX_RECVS);
+}
+
+/*
+ * @brief	Number of send requests a send communicator supports at any
+ *		given time
+ *
+ * Each buffer of a grouped receive is matched by its own send, so the
+ * number of sends in flight may exceed the number of receive requests by
+ * the group size. Without grouping, eager sends must not run ahead of the
+ * receiver's message buffer window.
+ */
+static inline unsigned int rdma_max_send_requests()
+{
+	return NCCL_OFI_MAX_REQUESTS * rdma_max_group_receives();
+}
+
 int nccl_net_ofi_rdma_device_t::get_properties(nccl_ofi_properties_t *props)
 {
 	int ret;
@@ -417,6 +451,7 @@ int nccl_net_ofi_rdma_device_t::get_properties(nccl_ofi_properties_t *props)
 	}
 
 	props->rma_supported = 1;
+	props->max_group_receives = rdma_max_group_receives();
 	assert(is_max_write_inline_size_initialized);
 	props->max_write_inline_size = max_write_inline_size;
 
@@ -501,6 +536,42 @@ static inline rdma_req_flush_data_t *get_flush_data(nccl_net_ofi_rdma_req *req)
 	return &req->flush_data;
 }
 
+/*
+ * @brief	Return grouped receive data struct of grouped receive request
+ */
+static inline rdma_req_recv_group_data_t *get_recv_group_data(nccl_net_ofi_rdma_req *req) {
+	assert(req->type == NCCL_OFI_RDMA_RECV_GROUP);
+	return &req->recv_group_data;
+}
+
+/*
+ * @brief	Derive the state of a grouped receive from its receive requests
+ *
+ * Called by the completion handlers whenever the state of one of its
+ * receive requests changes.
+ */
+static inline void update_recv_group_state(nccl_net_ofi_rdma_req *req)
+{
+	rdma_req_recv_group_data_t *recv_group_data = get_recv_group_data(req);
+	bool completed = true;
+
+	for (int i = 0; i < recv_group_data->num_recvs; i++) {
+		nccl_net_ofi_rdma_req *recv_req = recv_group_data->recv_reqs[i];
+
+		if (OFI_UNLIKELY(recv_req->state == NCCL_OFI_RDMA_REQ_ERROR)) {
+			req->state = NCCL_OFI_RDMA_REQ_ERROR;
+			return;
+		}
+		if (recv_req->state != NCCL_OFI_RDMA_REQ_COMPLETED) {
+			completed = false;
+		}
+	}
+
+	if (completed) {
+		req->state = NCCL_OFI_RDMA_REQ_COMPLETED;
+	}
+}
+
 /*
  * @brief	Set state of request and potential parent requests to error
  *
@@ -509,12 +580,21 @@ static inline rdma_req_flush_data_t *get_flush_data(nccl_net_ofi_rdma_req *req)
  */
 static inline void set_request_state_to_error(nccl_net_ofi_rdma_req *req)
 {
+	nccl_net_ofi_rdma_req *recv_req = NULL;
+
 	req->state = NCCL_OFI_RDMA_REQ_ERROR;
 
 	/* Set state of parent requests to error as well */
 	if (req->type == NCCL_OFI_RDMA_RECV_SEGMS) {
 		rdma_req_recv_segms_data_t *recv_segms_data = get_recv_segms_data(req);
-		recv_segms_data->recv_req->state = NCCL_OFI_RDMA_REQ_ERROR;
+		recv_req = recv_segms_data->recv_req;
+		recv_req->state = NCCL_OFI_RDMA_REQ_ERROR;
+	} else if (req->type == NCCL_OFI_RDMA_RECV) {
+		recv_req = req;
+	}
+
+	if (recv_req != NULL && get_recv_data(recv_req)->group_req != NULL) {
+		update_recv_group_state(get_recv_data(recv_req)->group_req);
 	}
 }
 
@@ -525,7 +605,10 @@ static inline void set_request_state_to_error(nccl_net_ofi_rdma_req *req)
  * Note that the request state is only updated if the request state
  * does not track an error already.
  *
- * This function is guarded by the request lock.
+ * Completions are processed under the endpoint lock. The size and
+ * completion count are atomic and updated before the state, so test()
+ * reads the final size without the endpoint lock once it sees the
+ * request completed.
  *
  * To update the state of subrequests, use the subrequest specific
  * update functions.
@@ -544,7 +627,6 @@ static inline int inc_req_completion(nccl_net_ofi_rdma_req *req,
 {
 	int ret = 0;
 	int ncompls;
-	nccl_net_ofi_mutex_lock(&req->req_lock);
 
 	req->size += size;
 	ncompls = ++(req->ncompls);
@@ -557,9 +639,11 @@ static inline int inc_req_completion(nccl_net_ofi_rdma_req *req,
 
 		/* Trace this completion */
 		NCCL_OFI_TRACE_COMPLETIONS(req->dev_id, req->type, req, req);
-	}
 
-	nccl_net_ofi_mutex_unlock(&req->req_lock);
+		if (req->type == NCCL_OFI_RDMA_RECV && get_recv_data(req)->group_req != NULL) {
+			update_recv_group_state(get_recv_data(req)->group_req);
+		}
+	}
 
 	return -ret;
 }
@@ -570,10 +654,6 @@ static inline int inc_req_completion(nccl_net_ofi_rdma_req *req,
  * Set eager copy ctrl request to completed. Furthermore, increment
  * completions of parent request (receive request).
  *
- * Modifications of the eager copy request are guarded by the eager copy req's
- * lock.  Modifications of the receive request are guarded by the receive
- * request's lock.
- *
  * @param	req
  *		Eager copy request
  *		size
@@ -589,14 +669,10 @@ static inline int set_eager_copy_completed(nccl_net_ofi_rdma_req *req)
 	nccl_net_ofi_rdma_req *recv_req = eager_copy_data->recv_req;
 	rdma_req_recv_data_t *recv_data = get_recv_data(recv_req);
 
-	nccl_net_ofi_mutex_lock(&req->req_lock);
-
 	/* Set send ctrl request completed */
 	req->ncompls = 1;
 	req->state = NCCL_OFI_RDMA_REQ_COMPLETED;
 
-	nccl_net_ofi_mutex_unlock(&req->req_lock);
-
 	/* Get size of received data */
 	rdma_req_rx_buff_data_t *rx_buff_data = get_rx_buff_data(eager_copy_data->eager_rx_buff_req);
 	size_t size = rx_buff_data->recv_len;
@@ -620,10 +696,6 @@ static inline int set_eager_copy_completed(nccl_net_ofi_rdma_req *req)
  * Control write for receive request is completed so increment
  * completions.
  *
- * Modifications of the send control request are guarded by the send
- * control request's lock.  Modifications of the receive request are
- * guarded by the receive request's lock.
- *
  * @param	req
  *		Receive request
  * @return	0, on success
@@ -644,6 +716,27 @@ static inline int set_write_ctrl_completed(nccl_net_ofi_rdma_req *req)
 	return inc_req_completion(req, 0, recv_data->total_num_compls);
 }
 
+/*
+ * @brief	Set the control messages of a batch as delivered
+ *
+ * @param	req
+ *		Receive request heading the batch
+ */
+static inline int set_write_ctrl_batch_completed(nccl_net_ofi_rdma_req *req, uint16_t rail_id)
+{
+	int ret = 0;
+
+	while (req != NULL && ret == 0) {
+		nccl_net_ofi_rdma_req *next = get_recv_data(req)->ctrl_batch_next;
+
+		NCCL_OFI_TRACE_WRITE_CTRL_END(req->dev_id, rail_id, req->comm, req, req->msg_seq_num);
+		ret = set_write_ctrl_completed(req);
+		req = next;
+	}
+
+	return ret;
+}
+
 /*
  * @brief	Increment segment completions of receive segment request
  *
@@ -651,10 +744,6 @@ static inline int set_write_ctrl_completed(nccl_net_ofi_rdma_req *req)
  * all segments arrived, increment completions of parent request
  * (receive request).
  *
- * Modifications of the receive segment request are guarded by the
- * receive segment request's lock.  Modifications of the receive
- * request are guarded by the receive request's lock.
- *
  * @param	req
  *		Receive request
  * @param	size
@@ -670,8 +759,6 @@ static inline int inc_recv_seg_completion(nccl_net_ofi_rdma_req *req,
 	assert(req->type == NCCL_OFI_RDMA_RECV_SEGMS);
 	int ret = 0;
 	bool segms_received;
-	
-	nccl_net_ofi_mutex_lock(&req->req_lock);
 
 	/* Sum up segment sizes */
 	req->size += size;
@@ -691,21 +778,78 @@ static inline int inc_recv_seg_completion(nccl_net_ofi_rdma_req *req,
 		/* Total number of completions have arrived */
 		req->state = NCCL_OFI_RDMA_REQ_COMPLETED;
 
-		/* Release lock of receive segment request before
-		 * receive request is set to completed to avoid
-		 * unlocking receive segment request after it has been
-		 * freed in `test()` */
-		nccl_net_ofi_mutex_unlock(&req->req_lock);
-		
-		/* Add completion to parent request */
+		/* Add completion to parent request. The receive segment
+		 * request may be freed by `test()' once the receive
+		 * request is completed, so it is not accessed after. */
 		ret = inc_req_completion(recv_req, req->size, recv_data->total_num_compls);
-	} else {
-		nccl_net_ofi_mutex_unlock(&req->req_lock);
 	}
 
 	return ret;
 }
 
+/*
+ * @brief	Let the scheduler avoid the rails the endpoint considers degraded
+ */
+static inline void apply_rail_health(nccl_net_ofi_rdma_ep_t *ep)
+{
+	ep->scheduler->set_excluded_rails(~ep->rail_health->usable_rails());
+}
+
+/*
+ * @brief	Record the start time of a schedule, if rail health tracking
+ *		needs it and the scheduler did not set it
+ */
+static inline void schedule_set_start_time(nccl_net_ofi_rdma_ep_t *ep, nccl_net_ofi_schedule_t *schedule)
+{
+	if (ep->rail_health && !ep->scheduler->wants_feedback) {
+		schedule->start_ns = ep->rail_health->now();
+	}
+}
+
+/*
+ * @brief	Report successful completion of an operation on a rail to
+ *		the rail health tracking of the endpoint and, for stripes of
+ *		send requests, to the scheduler if the scheduler uses feedback
+ *
+ * @param	schedule
+ *		Schedule of the send request, or NULL for other operations
+ */
+static inline void rail_notify_completion(nccl_net_ofi_rdma_ep_t *ep,
+					  nccl_net_ofi_schedule_t *schedule,
+					  uint16_t rail_id)
+{
+	if (ep->rail_health &&
+	    ep->rail_health->report_completion(rail_id, schedule ? schedule->start_ns : 0)) {
+		apply_rail_health(ep);
+	}
+	if (ep->scheduler->wants_feedback && schedule != NULL) {
+		ep->scheduler->notify_completion(schedule, rail_id);
+	}
+}
+
+/*
+ * @brief	Report that posting an operation to a rail returned -FI_EAGAIN
+ */
+static inline void rail_notify_eagain(nccl_net_ofi_rdma_ep_t *ep, uint16_t rail_id)
+{
+	if (ep->rail_health && ep->rail_health->report_eagain(rail_id)) {
+		apply_rail_health(ep);
+	}
+	if (ep->scheduler->wants_feedback) {
+		ep->scheduler->notify_eagain(rail_id);
+	}
+}
+
+/*
+ * @brief	Report a completion with error on a rail
+ */
+static inline void rail_notify_error(nccl_net_ofi_rdma_ep_t *ep, uint16_t rail_id)
+{
+	if (ep->rail_health && ep->rail_health->report_error(rail_id)) {
+		apply_rail_health(ep);
+	}
+}
+
 static inline int update_send_data_from_remote(nccl_net_ofi_rdma_send_comm *s_comm,
 				 nccl_net_ofi_rdma_req *req)
 {
@@ -717,28 +861,39 @@ static inline int update_send_data_from_remote(nccl_net_ofi_rdma_send_comm *s_co
 
 	rdma_req_send_data_t *send_data = get_send_data(req);
 	uint16_t slot = req->msg_seq_num % NCCL_OFI_CTRL_MAILBOX_SIZE;
-
-	send_data->remote_buff_offset = s_comm->ctrl_mailbox[slot].buff_offset;
-	send_data->remote_len = s_comm->ctrl_mailbox[slot].buff_len;
+	nccl_net_ofi_ctrl_msg_t *ctrl_msg = &s_comm->ctrl_mailbox[slot];
+	const uint64_t *mr_key = ctrl_msg->mr_key;
+
+	if (ctrl_msg->hdr.flags & NCCL_OFI_RDMA_FLAG_COMPACT) {
+		/* Destination buffer is relative to an MR key table entry */
+		nccl_net_ofi_ctrl_key_entry_t *entry = &s_comm->ctrl_key_table[ctrl_msg->hdr.key_idx];
+		send_data->remote_buff_offset = entry->buff_offset + (intptr_t)ctrl_msg->hdr.buff_delta;
+		mr_key = entry->mr_key;
+	} else {
+		send_data->remote_buff_offset = ctrl_msg->buff_offset;
+		if (ctrl_msg->hdr.flags & NCCL_OFI_RDMA_FLAG_KEY_DEFINE) {
+			nccl_net_ofi_ctrl_key_entry_t *entry = &s_comm->ctrl_key_table[ctrl_msg->hdr.key_idx];
+			entry->buff_offset = ctrl_msg->buff_offset;
+			memcpy(entry->mr_key, ctrl_msg->mr_key, sizeof(entry->mr_key));
+		}
+	}
+	send_data->remote_len = ctrl_msg->hdr.buff_len;
 
 	for (uint16_t rail_id = 0; rail_id != ep->num_rails; ++rail_id) {
-		send_data->remote_mr_key[rail_id] = s_comm->ctrl_mailbox[slot].mr_key[rail_id];
+		send_data->remote_mr_key[rail_id] = mr_key[rail_id];
 	}
 
 	/* If recv buffer is smaller than send buffer, we reduce the size of the send req */
-	nccl_net_ofi_mutex_lock(&req->req_lock);
 	if (send_data->remote_len < send_data->buff_len) {
 		NCCL_OFI_TRACE(NCCL_NET, "Remote recv buffer (%zu) smaller than send buffer (%zu)",
 			       send_data->remote_len, send_data->buff_len);
 		req->size = send_data->remote_len;
 		send_data->buff_len = send_data->remote_len;
 	}
-	nccl_net_ofi_mutex_unlock(&req->req_lock);
 
-	send_data->schedule = scheduler->get_schedule(send_data->buff_len, device->num_rails);
-	if (OFI_UNLIKELY(send_data->schedule == NULL)) {
-		return -EINVAL;
-	}
+	send_data->schedule = scheduler->get_schedule(send_data->buff_len, device->num_rails,
+						      send_data->schedule_buf.get());
+	schedule_set_start_time(ep, send_data->schedule);
 
 	/* Set expected number of completions */
 	send_data->total_num_compls = send_data->schedule->num_xfer_infos;
@@ -746,7 +901,7 @@ static inline int update_send_data_from_remote(nccl_net_ofi_rdma_send_comm *s_co
 	send_data->wdata =
 		GET_RDMA_WRITE_IMM_DATA(s_comm->remote_comm_id, req->msg_seq_num, send_data->schedule->num_xfer_infos);
 
-	if (s_comm->ctrl_mailbox[slot].flags & NCCL_OFI_RDMA_FLAG_RECV_COMPLETION_OPT)
+	if (ctrl_msg->hdr.flags & NCCL_OFI_RDMA_FLAG_RECV_COMPLETION_OPT)
 		send_data->no_target_completion = true;
 	return 0;
 }
@@ -764,28 +919,41 @@ int nccl_net_ofi_rdma_ep_t::check_post_rx_buffers_rail(nccl_net_ofi_rdma_ep_rail
 }
 
 
-int nccl_net_ofi_rdma_ep_t::repost_rx_buff(nccl_net_ofi_rdma_req *rx_buff_req)
+/*
+ * @brief	Remove a consumed rx buffer from the posted count of its rail,
+ *		and apply the window of the rail if the consumption resized it
+ *
+ * Caller must hold rail->rx_buff_mutex.
+ */
+static inline void rx_buff_consumed(nccl_net_ofi_rdma_ep_rail_t *rail)
 {
-	int ret = 0;
-
-	/* First, repost this rx buffer */
-	ret = send_progress(rx_buff_req);
-	if (ret == -FI_EAGAIN) {
-		/* Add to pending reqs queue */
-		nccl_net_ofi_mutex_lock(&this->pending_reqs_lock);
-		this->pending_reqs_queue.push_back(rx_buff_req);
-		nccl_net_ofi_mutex_unlock(&this->pending_reqs_lock);
-		NCCL_OFI_TRACE_PENDING_INSERT(rx_buff_req);
+	assert(rail->num_rx_buff_posted > 0);
+	rail->num_rx_buff_posted--;
 
-		return 0;
-	} else if (OFI_UNLIKELY(ret != 0)) {
-		return ret;
+	if (rail->rx_window && rail->rx_window->report_consumed(rail->num_rx_buff_posted)) {
+		if (rail->rx_window->size() < rail->max_rx_buff_posted) {
+			rail->rx_buff_trim_pending = true;
+		}
+		rail->max_rx_buff_posted = rail->rx_window->size();
+		rail->min_rx_buff_posted = rail->rx_window->low_watermark();
+		NCCL_OFI_TRACE(NCCL_NET, "Rail %u rx buffer window resized to %zu (refill below %zu)",
+			       rail->rail_id, rail->max_rx_buff_posted, rail->min_rx_buff_posted);
 	}
+}
 
+
+int nccl_net_ofi_rdma_ep_t::repost_rx_buff(nccl_net_ofi_rdma_req *rx_buff_req)
+{
 	rdma_req_rx_buff_data_t *rx_buff_data = get_rx_buff_data(rx_buff_req);
+	nccl_net_ofi_rdma_ep_rail_t *rail = rx_buff_data->rail;
+
+	nccl_net_ofi_mutex_lock(&rail->rx_buff_mutex);
+	rx_buff_consumed(rail);
+	nccl_net_ofi_mutex_unlock(&rail->rx_buff_mutex);
 
-	/* Next, check the posted count and post more buffers if needed. */
-	return this->check_post_rx_buffers_rail(rx_buff_data->rail);
+	/* Repost this rx buffer, unless the window of the rail shrank,
+	 * and post more buffers if needed */
+	return check_post_rx_buff_req(rx_buff_req);
 }
 
 
@@ -793,8 +961,7 @@ int nccl_net_ofi_rdma_ep_t::decrease_rx_buff_cnt(nccl_net_ofi_rdma_ep_rail_t *ra
 {
 	nccl_net_ofi_mutex_lock(&rail->rx_buff_mutex);
 
-	assert(rail->num_rx_buff_posted > 0);
-	rail->num_rx_buff_posted--;
+	rx_buff_consumed(rail);
 
 	nccl_net_ofi_mutex_unlock(&rail->rx_buff_mutex);
 
@@ -1078,6 +1245,18 @@ static inline int handle_write_comp(struct fi_cq_data_entry *cq_entry, nccl_net_
 	rdma_req_recv_data_t *recv_data = get_recv_data(req);
 	nccl_net_ofi_rdma_req *recv_segms_req = recv_data->recv_segms_req;
 
+	if (recv_data->ctrl_key_idx >= 0) {
+		/* The sender wrote the data, so it read the control message
+		 * and knows the MR key table entry it defined, unless a
+		 * later control message defined the entry again */
+		nccl_net_ofi_rdma_recv_comm *r_comm = (nccl_net_ofi_rdma_recv_comm *)req->comm;
+		nccl_net_ofi_ctrl_key_entry_t *entry = &r_comm->ctrl_key_table[recv_data->ctrl_key_idx];
+		if (entry->msg_seq_num == req->msg_seq_num) {
+			entry->acked = true;
+		}
+		recv_data->ctrl_key_idx = -1;
+	}
+
 	uint64_t total_segms = GET_NUM_SEG_FROM_IMM(cq_entry->data);
 
 	ret = inc_recv_seg_completion(recv_segms_req, cq_entry->len, total_segms);
@@ -1175,6 +1354,8 @@ static const char *req_type_str(nccl_net_ofi_rdma_req_type_t type)
 		return "FLUSH";
 	case NCCL_OFI_RDMA_EAGER_COPY:
 		return "EAGER_COPY";
+	case NCCL_OFI_RDMA_RECV_GROUP:
+		return "RECV_GROUP";
 	case NCCL_OFI_RDMA_INVALID_TYPE:
 		return "INVALID";
 	default:
@@ -1191,7 +1372,7 @@ static const char *nccl_net_ofi_req_str(nccl_net_ofi_rdma_req *req)
 	static char buf[256];
 	snprintf(buf, sizeof(buf), "{ dev: %d, size: %zu, state: %s, type: %s }",
 		 req->dev_id,
-		 req->size,
+		 req->size.load(),
 		 req_state_str(req->state),
 		 req_type_str(req->type)
 		);
@@ -1260,7 +1441,18 @@ int nccl_net_ofi_rdma_context::handle_cq_entry(struct fi_cq_entry *cq_entry_base
 			NCCL_OFI_TRACE_EAGER_SEND_COMPLETE(req->dev_id, rail_id, req->comm, req->msg_seq_num, req);
 			send_data = get_send_data(req);
 			assert(send_data->eager);
+			rail_notify_completion((nccl_net_ofi_rdma_ep_t *)req->comm->ep.get(),
+					       send_data->schedule, rail_id);
+			nccl_ofi_eager_threshold *eager_threshold =
+				((nccl_net_ofi_rdma_send_comm *)req->comm)->eager_threshold;
+			if (eager_threshold) {
+				eager_threshold->report_eager_completion(eager_threshold->now() -
+									 send_data->eager_post_ns);
+			}
 			ret = inc_req_completion(req, 0, send_data->total_num_compls);
+			if (ret == 0) {
+				ret = complete_eager_send((nccl_net_ofi_rdma_send_comm *)req->comm, req);
+			}
 		} else if (req->type == NCCL_OFI_RDMA_SEND_CLOSE) {
 			ret = inc_req_completion(req, sizeof(nccl_net_ofi_rdma_close_msg_t), 1);
 		} else {
@@ -1283,6 +1475,8 @@ int nccl_net_ofi_rdma_context::handle_cq_entry(struct fi_cq_entry *cq_entry_base
 								req);
 
 			send_data = get_send_data(req);
+			rail_notify_completion((nccl_net_ofi_rdma_ep_t *)req->comm->ep.get(),
+					       send_data->schedule, rail_id);
 			ret = inc_req_completion(req, 0, send_data->total_num_compls);
 			break;
 		}
@@ -1295,8 +1489,8 @@ int nccl_net_ofi_rdma_context::handle_cq_entry(struct fi_cq_entry *cq_entry_base
 		}
 		case NCCL_OFI_RDMA_RECV: {
 			/* Recv ctrl message write completion */
-			NCCL_OFI_TRACE_WRITE_CTRL_END(req->dev_id, rail_id, req->comm, req, req->msg_seq_num);
-			ret = set_write_ctrl_completed(req);
+			rail_notify_completion((nccl_net_ofi_rdma_ep_t *)req->comm->ep.get(), NULL, rail_id);
+			ret = set_write_ctrl_batch_completed(req, rail_id);
 			break;
 		}
 		case NCCL_OFI_RDMA_READ:
@@ -1522,65 +1716,166 @@ static int receive_progress(nccl_net_ofi_rdma_req *req, bool add_to_pending)
 		/* Extract ep */
 		nccl_net_ofi_rdma_ep_t *ep = (nccl_net_ofi_rdma_ep_t *)r_comm->ep.get();
 		/* Place in pending requests queue for next try */
-		nccl_net_ofi_mutex_lock(&ep->pending_reqs_lock);
-		ep->pending_reqs_queue.push_back(req);
-		nccl_net_ofi_mutex_unlock(&ep->pending_reqs_lock);
+		ep->add_pending_req(req);
 		rc = 0;
-
-		NCCL_OFI_TRACE_PENDING_INSERT(req);
 	}
 
 	return rc;
 }
 
 
+/*
+ * @brief	Rail a request that hit FI_EAGAIN waits for
+ *
+ * This is the rail the next attempt to post the request starts on.
+ */
+static uint16_t pending_req_rail_id(nccl_net_ofi_rdma_req *req)
+{
+	switch (req->type) {
+		case NCCL_OFI_RDMA_SEND: {
+			rdma_req_send_data_t *send_data = get_send_data(req);
+			nccl_net_ofi_schedule_t *schedule = send_data->schedule;
+			size_t xfer_idx = send_data->eager ? 0 : send_data->xferred_rail_id;
+			if (schedule == NULL || xfer_idx >= schedule->num_xfer_infos) {
+				return 0;
+			}
+			return schedule->rail_xfer_infos[xfer_idx].rail_id;
+		}
+		case NCCL_OFI_RDMA_CTRL_RX_BUFF:
+		case NCCL_OFI_RDMA_EAGER_RX_BUFF:
+			return get_rx_buff_data(req)->rail->rail_id;
+		case NCCL_OFI_RDMA_EAGER_COPY: {
+			rdma_req_eager_copy_data_t *eager_copy_data = get_eager_copy_data(req);
+			return get_rx_buff_data(eager_copy_data->eager_rx_buff_req)->rail->rail_id;
+		}
+		case NCCL_OFI_RDMA_RECV:
+			return get_recv_data(req)->ctrl_rail_id;
+		case NCCL_OFI_RDMA_WRITE:
+		case NCCL_OFI_RDMA_READ:
+		case NCCL_OFI_RDMA_FLUSH:
+		case NCCL_OFI_RDMA_SEND_CLOSE:
+		default:
+			/* Posted on rail 0, or on all rails starting with 0 */
+			return 0;
+	}
+}
+
+/*
+ * @brief	Whether a pending request is retried before data transfers
+ */
+static inline bool pending_req_is_prio(nccl_net_ofi_rdma_req *req)
+{
+	return req->type == NCCL_OFI_RDMA_RECV ||
+		req->type == NCCL_OFI_RDMA_SEND_CLOSE ||
+		req->type == NCCL_OFI_RDMA_CTRL_RX_BUFF ||
+		req->type == NCCL_OFI_RDMA_EAGER_RX_BUFF;
+}
+
+/*
+ * @brief	Put a request in the pending queue of its rail
+ *
+ * @param	front
+ *		Put the request at the front of the queue, for a retry
+ *		that hit FI_EAGAIN again
+ *
+ * @return	rail ID of the queue
+ */
+static uint16_t pending_queues_insert(nccl_net_ofi_rdma_ep_t *ep,
+				      nccl_net_ofi_rdma_req *req, bool front)
+{
+	uint16_t rail_id = pending_req_rail_id(req);
+	assert(rail_id < ep->num_rails);
+	nccl_net_ofi_rdma_pending_queues_t *queues = &ep->pending_reqs_queues[rail_id];
+	std::deque<nccl_net_ofi_rdma_req *> *queue =
+		pending_req_is_prio(req) ? &queues->prio_queue : &queues->data_queue;
+
+	nccl_net_ofi_mutex_lock(&ep->pending_reqs_lock);
+	if (front) {
+		queue->push_front(req);
+	} else {
+		queue->push_back(req);
+	}
+	ep->num_pending_reqs++;
+	nccl_net_ofi_mutex_unlock(&ep->pending_reqs_lock);
+
+	return rail_id;
+}
+
+
+void nccl_net_ofi_rdma_ep_t::add_pending_req(nccl_net_ofi_rdma_req *req)
+{
+	pending_queues_insert(this, req, false);
+	NCCL_OFI_TRACE_PENDING_INSERT(req);
+}
+
+
+bool nccl_net_ofi_rdma_ep_t::has_pending_reqs()
+{
+	nccl_net_ofi_mutex_lock(&this->pending_reqs_lock);
+	bool has_reqs = (this->num_pending_reqs != 0);
+	nccl_net_ofi_mutex_unlock(&this->pending_reqs_lock);
+
+	return has_reqs;
+}
+
+
 int nccl_net_ofi_rdma_ep_t::process_pending_reqs()
 {
 	int rc = 0;
 
-	while (true) {
-		nccl_net_ofi_rdma_req *req = NULL;
-		nccl_net_ofi_mutex_lock(&this->pending_reqs_lock);
-		if (!this->pending_reqs_queue.empty()) {
-			req = this->pending_reqs_queue.front();
-			this->pending_reqs_queue.pop_front();
-		}
-		nccl_net_ofi_mutex_unlock(&this->pending_reqs_lock);
-		if (req == NULL) { break; }
-
-		switch (req->type) {
-			case NCCL_OFI_RDMA_WRITE:
-			case NCCL_OFI_RDMA_SEND:
-			case NCCL_OFI_RDMA_CTRL_RX_BUFF:
-			case NCCL_OFI_RDMA_EAGER_RX_BUFF:
-				rc = send_progress(req);
-				break;
-			case NCCL_OFI_RDMA_READ:
-			case NCCL_OFI_RDMA_EAGER_COPY:
-			case NCCL_OFI_RDMA_RECV:
-			case NCCL_OFI_RDMA_FLUSH:
-				rc = receive_progress(req, false);
-				break;
-			case NCCL_OFI_RDMA_RECV_SEGMS:
-			case NCCL_OFI_RDMA_SEND_CLOSE:
-			case NCCL_OFI_RDMA_INVALID_TYPE:
-			default:
-				NCCL_OFI_WARN("Unexpected type: %d", req->type);
-				return -EINVAL;
-		}
+	for (uint16_t rail_id = 0; rail_id < this->num_rails; rail_id++) {
+		nccl_net_ofi_rdma_pending_queues_t *queues = &this->pending_reqs_queues[rail_id];
 
-		if ((rc != 0) && (rc != -FI_EAGAIN)) {
-			NCCL_OFI_WARN("Unable to post request; RC: %d", rc);
-			break;
-		} else if (rc == -FI_EAGAIN) {
-			/* Put the request in the front of the queue and try again later */
+		while (true) {
+			nccl_net_ofi_rdma_req *req = NULL;
 			nccl_net_ofi_mutex_lock(&this->pending_reqs_lock);
-			this->pending_reqs_queue.push_front(req);
+			std::deque<nccl_net_ofi_rdma_req *> *queue =
+				queues->prio_queue.empty() ? &queues->data_queue : &queues->prio_queue;
+			if (!queue->empty()) {
+				req = queue->front();
+				queue->pop_front();
+				this->num_pending_reqs--;
+			}
 			nccl_net_ofi_mutex_unlock(&this->pending_reqs_lock);
-			rc = 0;
-			break;
+			if (req == NULL) { break; }
+
+			switch (req->type) {
+				case NCCL_OFI_RDMA_WRITE:
+				case NCCL_OFI_RDMA_SEND:
+				case NCCL_OFI_RDMA_CTRL_RX_BUFF:
+				case NCCL_OFI_RDMA_EAGER_RX_BUFF:
+					rc = send_progress(req);
+					break;
+				case NCCL_OFI_RDMA_READ:
+				case NCCL_OFI_RDMA_EAGER_COPY:
+				case NCCL_OFI_RDMA_RECV:
+				case NCCL_OFI_RDMA_FLUSH:
+				case NCCL_OFI_RDMA_SEND_CLOSE:
+					rc = receive_progress(req, false);
+					break;
+				case NCCL_OFI_RDMA_RECV_SEGMS:
+				case NCCL_OFI_RDMA_INVALID_TYPE:
+				default:
+					NCCL_OFI_WARN("Unexpected type: %d", req->type);
+					return -EINVAL;
+			}
+
+			if ((rc != 0) && (rc != -FI_EAGAIN)) {
+				NCCL_OFI_WARN("Unable to post request; RC: %d", rc);
+				return rc;
+			} else if (rc == -FI_EAGAIN) {
+				/* Put the request back in front of the queue of the
+				 * rail it now waits for. A multi-rail send may have
+				 * progressed to another rail. */
+				rc = 0;
+				if (pending_queues_insert(this, req, true) == rail_id) {
+					/* This rail is still busy, try again later */
+					break;
+				}
+				continue;
+			}
+			NCCL_OFI_TRACE_PENDING_REMOVE(req);
 		}
-		NCCL_OFI_TRACE_PENDING_REMOVE(req);
 	}
 	return rc;
 }
@@ -1622,75 +1917,131 @@ static inline int rdma_process_error_entry(struct fi_cq_err_entry *err_entry, st
 }
 
 
-static int ofi_process_cq_rail(nccl_net_ofi_rdma_device_t *device, nccl_net_ofi_rdma_cq_rail_t *rail)
+/*
+ * @brief	Read a batch of entries from the completion queue of a rail
+ *		and process them
+ *
+ * @param	count
+ *		Maximum number of entries to read
+ * @param	num_compls
+ *		Number of entries read, including error entries
+ * @param	drained
+ *		Whether the queue holds no more entries
+ */
+static int ofi_process_cq_rail(nccl_net_ofi_rdma_ep_t *ep, nccl_net_ofi_rdma_device_t *device,
+			       nccl_net_ofi_rdma_cq_rail_t *rail,
+			       struct fi_cq_data_entry *cqe_buffers, size_t count,
+			       size_t *num_compls, bool *drained)
 {
-	struct fi_cq_data_entry cqe_buffers[cq_read_count];
 	ssize_t rc = 0;
 	int ret = 0;
 
-	while (true) {
-		/* Receive completions for the given endpoint */
-		rc = fi_cq_read(rail->cq.get(), cqe_buffers, cq_read_count);
-		if (rc > 0) {
-			ret = rdma_process_completions(cqe_buffers, rc, device, rail->rail_id);
-			if (OFI_UNLIKELY(ret != 0))
-				goto exit;
-		} else if (OFI_UNLIKELY(rc == -FI_EAVAIL)) {
+	*num_compls = 0;
+	*drained = false;
+
+	/* Receive completions for the given endpoint */
+	rc = fi_cq_read(rail->cq.get(), cqe_buffers, count);
+	if (rc > 0) {
+		*num_compls = rc;
+		/* A short read emptied the queue */
+		*drained = ((size_t)rc < count);
+		ret = rdma_process_completions(cqe_buffers, rc, device, rail->rail_id);
+	} else if (OFI_UNLIKELY(rc == -FI_EAVAIL)) {
+		/*
+		 * On call to fi_cq_readerr, Libfabric requires some members of
+		 * err_entry to be zero-initialized or point to valid data.  For
+		 * simplicity, just zero out the whole struct.
+		 */
+		struct fi_cq_err_entry err_entry = { };
+
+		ret = fi_cq_readerr(rail->cq.get(), &err_entry, 0);
+		if (OFI_UNLIKELY(ret == -FI_EAGAIN)) {
 			/*
-			 * On call to fi_cq_readerr, Libfabric requires some members of
-			 * err_entry to be zero-initialized or point to valid data.  For
-			 * simplicity, just zero out the whole struct.
+			 * Error not available yet.
+			 * fi_cq_read will keep returning -FI_EAVAIL so just bail out and try again later.
 			 */
-			struct fi_cq_err_entry err_entry = { };
-
-			ret = fi_cq_readerr(rail->cq.get(), &err_entry, 0);
-			if (OFI_UNLIKELY(ret == -FI_EAGAIN)) {
-				/*
-				 * Error not available yet.
-				 * fi_cq_read will keep returning -FI_EAVAIL so just bail out and try again later.
-				 */
-				ret = 0;
-				break;
-			} else if (OFI_UNLIKELY(ret < 0)) {
-				NCCL_OFI_WARN("Unable to read from fi_cq_readerr. RC: %d. Error: %s",
-					      ret, fi_strerror(-ret));
-				goto exit;
-			}
+			*drained = true;
+			return 0;
+		} else if (OFI_UNLIKELY(ret < 0)) {
+			NCCL_OFI_WARN("Unable to read from fi_cq_readerr. RC: %d. Error: %s",
+				      ret, fi_strerror(-ret));
+			return ret;
+		}
 
-			ret = rdma_process_error_entry(&err_entry, rail->cq.get(), rail->rail_id);
-			if (ret != 0) {
-				goto exit;
-			}
-		} else if (rc == -FI_EAGAIN) {
-			/* No completions to process */
-			break;
-		} else {
-			NCCL_OFI_WARN("Unable to retrieve completion queue entries. RC: %zd, ERROR: %s",
-				      rc, fi_strerror(-rc));
-			ret = -EINVAL;
-			goto exit;
+		*num_compls = 1;
+		if (err_entry.err != FI_ECANCELED) {
+			rail_notify_error(ep, rail->rail_id);
 		}
+
+		ret = rdma_process_error_entry(&err_entry, rail->cq.get(), rail->rail_id);
+	} else if (rc == -FI_EAGAIN) {
+		/* No completions to process */
+		*drained = true;
+	} else {
+		NCCL_OFI_WARN("Unable to retrieve completion queue entries. RC: %zd, ERROR: %s",
+			      rc, fi_strerror(-rc));
+		ret = -EINVAL;
 	}
 
-exit:
 	return ret;
 }
 
 
 int nccl_net_ofi_rdma_ep_t::ofi_process_cq()
 {
-	int ret;
+	int ret = 0;
+	int rail_id;
 
 	nccl_net_ofi_rdma_domain_t *domain_ptr = rdma_endpoint_get_domain();
 	nccl_net_ofi_rdma_device_t *device = domain_ptr->rdma_domain_get_device();
+	nccl_ofi_cq_poller *poller = this->cq_poller;
+	struct fi_cq_data_entry cqe_buffers[poller->max_batch_size()];
 
-	for (uint16_t rail_id = 0; rail_id != this->num_rails; ++rail_id) {
+	/* Probe degraded rails again once their cool-down ended */
+	if (this->rail_health && this->rail_health->has_degraded_rails() &&
+	    this->rail_health->update()) {
+		apply_rail_health(this);
+	}
+
+	poller->begin_poll();
+	while ((rail_id = poller->next_rail()) >= 0) {
 		nccl_net_ofi_rdma_cq_rail_t *rail = this->rdma_endpoint_get_cq_rail(rail_id);
+		size_t count = poller->batch_size(rail_id);
+		size_t num_compls;
+		bool drained;
 
-		ret = ofi_process_cq_rail(device, rail);
+		ret = ofi_process_cq_rail(this, device, rail, cqe_buffers, count,
+					  &num_compls, &drained);
 		if (ret != 0) {
 			goto exit;
 		}
+		poller->report_read(rail_id, count, num_compls, drained);
+	}
+
+	if (this->cq_wait) {
+		this->cq_wait->report_progress(poller->num_poll_compls());
+	}
+
+	/* Release rx buffer memory grown by bursts while the endpoint is idle,
+	   rather than when buffers are released */
+	if (poller->num_poll_compls() == 0) {
+		this->shrink_idle_rx_windows();
+		this->ctrl_rx_buff_fl->trim_excess();
+		if (this->eager_rx_buff_fl != NULL) {
+			this->eager_rx_buff_fl->trim_excess();
+		}
+		this->rx_buff_reqs_fl->trim_excess();
+	}
+
+	/* Peers may wait for control messages held back for batching */
+	ret = this->flush_ctrl_batches();
+	if (OFI_UNLIKELY(ret != 0)) {
+		goto exit;
+	}
+
+	ret = this->process_eager_ctrl_sends();
+	if (OFI_UNLIKELY(ret != 0)) {
+		goto exit;
 	}
 
 	/* Process any pending requests */
@@ -1725,7 +2076,7 @@ static inline void zero_nccl_ofi_req(nccl_net_ofi_rdma_req *req)
  * @brief	Free request by returning request back into freelist
  */
 static inline int free_base_req(uint64_t *num_inflight_reqs,
-					 nccl_ofi_freelist *nccl_ofi_reqs_fl,
+					 nccl_ofi_freelist_mt *nccl_ofi_reqs_fl,
 					 nccl_net_ofi_rdma_req *req,
 					 bool dec_inflight_reqs)
 {
@@ -1798,14 +2149,11 @@ static inline int free_send_req(nccl_net_ofi_rdma_req *req,
 	send_data = get_send_data(req);
 
 	if (!send_data->eager && dec_inflight_reqs) {
-		/* free is going to be called inside of test(), which will
-		   happen in a time when NCCL guarantees no other thread will
-		   be accessing the communicator.  So no mutex protections are
-		   required if we do it here.  Better would be to do this as
-		   soon as we get the CQE for this request, but that would
-		   require atomics or locks, which isn't worth it today.  But
-		   if we ever refactor the locking strategy, we should revisit
-		   this. */
+		/* free is going to be called inside of test(), which holds
+		   the communicator lock, as does send() when it reads the
+		   counter.  Doing this as soon as we get the CQE for this
+		   request would make the completion handler, which only
+		   holds the endpoint lock, race with send(). */
 		(s_comm->num_inflight_writes)--;
 	}
 
@@ -1854,6 +2202,32 @@ static inline int free_recv_req(nccl_net_ofi_rdma_req *req,
 			     req, dec_inflight_reqs);
 }
 
+/*
+ * @brief	Free grouped receive request and its receive requests
+ *
+ * Only the receive requests of the group count as inflight requests.
+ */
+static inline int free_recv_group_req(nccl_net_ofi_rdma_req *req,
+				      bool dec_inflight_reqs)
+{
+	assert(req->type == NCCL_OFI_RDMA_RECV_GROUP);
+	int ret = 0;
+	nccl_net_ofi_rdma_recv_comm *r_comm =
+		(nccl_net_ofi_rdma_recv_comm *)req->comm;
+	rdma_req_recv_group_data_t *recv_group_data = get_recv_group_data(req);
+
+	for (int i = 0; i < recv_group_data->num_recvs; i++) {
+		ret = recv_group_data->recv_reqs[i]->free(dec_inflight_reqs);
+		if (ret) {
+			NCCL_OFI_WARN("Failed to free receive request of grouped receive");
+			return ret;
+		}
+	}
+
+	return free_base_req(&r_comm->num_inflight_reqs, r_comm->nccl_ofi_reqs_fl,
+			     req, false);
+}
+
 /*
  * @brief	Free receive segments request
  */
@@ -2010,10 +2384,7 @@ int nccl_net_ofi_rdma_ep_t::handle_rx_eagain(nccl_net_ofi_rdma_ep_rail_t *rail,
 					     size_t num_buffs_failed)
 {
 	/* Add to pending reqs queue */
-	nccl_net_ofi_mutex_lock(&this->pending_reqs_lock);
-	this->pending_reqs_queue.push_back(req);
-	nccl_net_ofi_mutex_unlock(&this->pending_reqs_lock);
-	NCCL_OFI_TRACE_PENDING_INSERT(req);
+	this->add_pending_req(req);
 
 	nccl_net_ofi_mutex_lock(&rail->rx_buff_mutex);
 
@@ -2032,9 +2403,12 @@ int nccl_net_ofi_rdma_ep_t::post_rx_buffs_on_rail(nccl_net_ofi_rdma_ep_rail_t *r
 
 	nccl_net_ofi_mutex_lock(&rail->rx_buff_mutex);
 
-	size_t buffers_needed = rail->max_rx_buff_posted -
-				rail->num_rx_buff_posted;
-	rail->num_rx_buff_posted = rail->max_rx_buff_posted;
+	/* The window may have shrunk below the posted count */
+	size_t buffers_needed = 0;
+	if (rail->num_rx_buff_posted < rail->max_rx_buff_posted) {
+		buffers_needed = rail->max_rx_buff_posted - rail->num_rx_buff_posted;
+		rail->num_rx_buff_posted = rail->max_rx_buff_posted;
+	}
 
 	nccl_net_ofi_mutex_unlock(&rail->rx_buff_mutex);
 
@@ -2230,6 +2604,14 @@ static int finish_connect(nccl_net_ofi_rdma_send_comm *s_comm)
 		return -EINVAL;
 	}
 
+	if (conn_resp->max_group_receives != rdma_max_group_receives()) {
+		NCCL_OFI_WARN("Unexpected number of remote grouped receives for dev %d. Expected %u but got %u. "
+			      "OFI_NCCL_RDMA_MAX_GROUP_RECEIVES must be set on all ranks.",
+			      dev_id, rdma_max_group_receives(),
+			      (unsigned int)conn_resp->max_group_receives);
+		return -EINVAL;
+	}
+
 	/* Validate received comm ID */
 	if (OFI_UNLIKELY(conn_resp->comm_id >= device->num_comm_ids)) {
 		NCCL_OFI_WARN("Received an invalid communicator ID %u for device %d", conn_resp->comm_id,
@@ -2284,10 +2666,48 @@ static inline bool has_flush_completed(nccl_net_ofi_rdma_req *req)
  * @brief Check the contents of the control mailbox to check if the
  * control message has arrived or not
  */
+/*
+ * @brief	Number of buffers of the grouped receive of a control message
+ */
+static inline uint16_t ctrl_msg_group_size(const nccl_net_ofi_ctrl_msg_t *ctrl_msg)
+{
+	/* Compact control messages are never part of a grouped receive */
+	if (ctrl_msg->hdr.flags & NCCL_OFI_RDMA_FLAG_COMPACT) {
+		return 1;
+	}
+	return ctrl_msg->group_size;
+}
+
 static inline bool has_ctrl_msg(nccl_net_ofi_rdma_send_comm* s_comm, uint16_t seq_num)
 {
 	uint16_t slot = seq_num % NCCL_OFI_CTRL_MAILBOX_SIZE;
-	return (READ_ONCE(s_comm->ctrl_mailbox[slot].msg_seq_num) == ((uint64_t)seq_num & MSG_SEQ_NUM_MASK));
+	return (READ_ONCE(s_comm->ctrl_mailbox[slot].hdr.msg_seq_num) == ((uint64_t)seq_num & MSG_SEQ_NUM_MASK));
+}
+
+/*
+ * @brief Find the buffer of the grouped receive at next_msg_seq_num whose tag
+ * matches a send
+ *
+ * Buffers already matched by a send and buffers whose control message did
+ * not arrive yet are skipped.
+ *
+ * @return	sequence number of the matching buffer, or -1 if there is none yet
+ */
+static inline int match_group_recv(nccl_net_ofi_rdma_send_comm *s_comm, uint16_t group_size, int tag)
+{
+	for (uint16_t i = 0; i < group_size; i++) {
+		uint16_t msg_seq_num = (s_comm->next_msg_seq_num + i) & MSG_SEQ_NUM_MASK;
+
+		if ((s_comm->group_matched_mask & (1U << i)) || !has_ctrl_msg(s_comm, msg_seq_num)) {
+			continue;
+		}
+		/* Read the tag after the sequence number */
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (s_comm->ctrl_mailbox[msg_seq_num % NCCL_OFI_CTRL_MAILBOX_SIZE].tag == tag) {
+			return msg_seq_num;
+		}
+	}
+	return -1;
 }
 
 /*
@@ -2296,7 +2716,7 @@ static inline bool has_ctrl_msg(nccl_net_ofi_rdma_send_comm* s_comm, uint16_t se
 static inline uint32_t get_ctrl_msg_buff_len(nccl_net_ofi_rdma_send_comm* s_comm, uint16_t seq_num)
 {
 	uint16_t slot = seq_num % NCCL_OFI_CTRL_MAILBOX_SIZE;
-	return (s_comm->ctrl_mailbox[slot].buff_len);
+	return (s_comm->ctrl_mailbox[slot].hdr.buff_len);
 }
 
 /*
@@ -2327,12 +2747,225 @@ static inline int update_send_request(nccl_net_ofi_rdma_send_comm* s_comm, nccl_
 			return ret;
 		}
 		s_comm->n_ctrl_received += 1;
+
+		if (s_comm->eager_threshold) {
+			s_comm->eager_threshold->report_eager_ctrl_delay(s_comm->eager_threshold->now() -
+									 send_data->eager_post_ns);
+		}
 	}
 
 	return ret;
 }
 
+/*
+ * @brief	Complete an eager send whose message was sent if its control
+ *		message arrived, or wait for the control message along with
+ *		the completions of the endpoint
+ *
+ * Must be called with the endpoint lock held.
+ */
+static int complete_eager_send(nccl_net_ofi_rdma_send_comm *s_comm, nccl_net_ofi_rdma_req *req)
+{
+	int ret = update_send_request(s_comm, req);
+	if (OFI_UNLIKELY(ret != 0) || req->state == NCCL_OFI_RDMA_REQ_COMPLETED ||
+	    req->state == NCCL_OFI_RDMA_REQ_ERROR) {
+		return ret;
+	}
+
+	if (s_comm->eager_ctrl_reqs.empty()) {
+		s_comm->get_ep()->eager_ctrl_comms.push_back(&s_comm->eager_ctrl_node);
+	}
+	s_comm->eager_ctrl_reqs.push_back(req);
+
+	return 0;
+}
+
+/*
+ * @brief	Report the sizes of a completed grouped receive and mark its
+ *		messages as complete in the message buffer
+ *
+ * @param	sizes
+ *		Output array of received sizes, one per buffer; may be NULL
+ */
+static inline int complete_recv_group(nccl_net_ofi_rdma_req *req, int *sizes)
+{
+	rdma_req_recv_group_data_t *recv_group_data = get_recv_group_data(req);
+	nccl_ofi_msgbuff *msgbuff = ((nccl_net_ofi_rdma_recv_comm *)req->comm)->msgbuff;
+
+	for (int i = 0; i < recv_group_data->num_recvs; i++) {
+		nccl_net_ofi_rdma_req *recv_req = recv_group_data->recv_reqs[i];
+		nccl_ofi_msgbuff_status_t stat;
+
+		if (sizes) {
+			sizes[i] = recv_req->size;
+		}
 
+		nccl_ofi_msgbuff_result_t mb_res = msgbuff->complete(recv_req->msg_seq_num, &stat);
+		if (OFI_UNLIKELY(mb_res != NCCL_OFI_MSGBUFF_SUCCESS)) {
+			NCCL_OFI_WARN("Invalid result of msgbuff_complete for msg %hu",
+				      recv_req->msg_seq_num);
+			return -EINVAL;
+		}
+
+		NCCL_OFI_TRACE_RECV_END(recv_req->dev_id, req->comm, recv_req);
+	}
+
+	return 0;
+}
+
+/*
+ * @brief	Block on the completion queues of an idle endpoint, then
+ *		process them
+ *
+ * Does nothing unless the endpoint has been idle for the spin window.
+ * Requests waiting for resources are retried by polling, so the endpoint
+ * does not block while they are pending.
+ *
+ * Must be called with the communicator lock and the endpoint lock held.
+ * Both are released while blocking, so that other threads can post and
+ * test requests on the endpoint, and taken again to process completions.
+ *
+ * @return	0, on success
+ *		error, on others
+ */
+static int rdma_ep_wait_for_completions(nccl_net_ofi_rdma_ep_t *ep, std::mutex &comm_lock)
+{
+	if (!ep->cq_wait || !ep->cq_wait->should_block()) {
+		return 0;
+	}
+
+	if (ep->has_pending_reqs()) {
+		return 0;
+	}
+
+	int ret = ep->cq_wait->trywait();
+	if (ret == 0) {
+		ep->ep_lock.unlock();
+		comm_lock.unlock();
+
+		ret = ep->cq_wait->wait();
+
+		comm_lock.lock();
+		ep->ep_lock.lock();
+		if (OFI_UNLIKELY(ret != 0)) {
+			return ret;
+		}
+
+		CHECK_ENDPOINT_ACTIVE(ep, "test");
+	} else if (OFI_UNLIKELY(ret != -FI_EAGAIN)) {
+		return ret;
+	}
+
+	return ep->ofi_process_cq();
+}
+
+/*
+ * @brief	Lock serializing the calls on the communicator of a request
+ */
+static inline std::mutex &rdma_req_comm_lock(nccl_net_ofi_rdma_req *req)
+{
+	if (req->comm->type == NCCL_NET_OFI_SEND_COMM) {
+		return ((nccl_net_ofi_rdma_send_comm *)req->comm)->comm_lock;
+	}
+	assert(req->comm->type == NCCL_NET_OFI_RECV_COMM);
+	return ((nccl_net_ofi_rdma_recv_comm *)req->comm)->comm_lock;
+}
+
+/*
+ * @brief	Process completions of the endpoint, and update the state of
+ *		a request that is neither completed nor errored out
+ *
+ * Must be called with the communicator lock and the endpoint lock held.
+ * Both may be released and taken again while blocking for completions.
+ *
+ * @param	done
+ *		Set to 1 if a flush is complete, but owned by the completion
+ *		handler of its read, which frees it
+ * @return	0, on success
+ *		error, on others
+ */
+static int rdma_req_test_progress(nccl_net_ofi_rdma_req *req, nccl_net_ofi_rdma_ep_t *ep,
+				  int *done, int *size_p)
+{
+	int ret = 0;
+	nccl_net_ofi_comm *base_comm = req->comm;
+
+	CHECK_ENDPOINT_ACTIVE(ep, "test");
+
+	if (base_comm->type == NCCL_NET_OFI_RECV_COMM) {
+		ret = ((nccl_net_ofi_rdma_recv_comm *)base_comm)->flush_ctrl_batch(false);
+		if (OFI_UNLIKELY(ret != 0)) {
+			return ret;
+		}
+	}
+
+#if HAVE_GPU
+	if (req->type == NCCL_OFI_RDMA_FLUSH) {
+		/*
+		 * Check if the flush is complete and mark it as complete
+		 * if the host buffers have been populated with the sentinel value.
+		 * Increment num_pending_flush_comps to indicate we are still waiting,
+		 * on the request's completion event. The request will be freed once
+		 * all completions are processed.
+		 */
+		if (has_flush_completed(req))
+		{
+			req->state = NCCL_OFI_RDMA_REQ_COMPLETED;
+			size_t req_size = req->size;
+
+			if (size_p) {
+				*size_p = req_size;
+			}
+
+			auto *r_comm = reinterpret_cast<nccl_net_ofi_rdma_recv_comm *>(req->comm);
+			r_comm->num_pending_flush_comps++;
+			*done = 1;
+			return 0;
+		}
+	}
+#endif
+	/* The progress thread processes the completions of the endpoints
+	 * it owns; draining here would only compete with it for the
+	 * endpoint lock */
+	if (!ep->progress_thread_owned) {
+		ret = ep->ofi_process_cq();
+		if (OFI_UNLIKELY(ret != 0))
+			return ret;
+	}
+
+	/* Receives complete with completion queue events, so wait
+	 * for them on the completion queues once the endpoint is
+	 * idle. Sends complete when the control message is written
+	 * to memory, which needs spinning. */
+	if ((req->type == NCCL_OFI_RDMA_RECV ||
+	     req->type == NCCL_OFI_RDMA_RECV_GROUP) &&
+	    req->state != NCCL_OFI_RDMA_REQ_COMPLETED &&
+	    req->state != NCCL_OFI_RDMA_REQ_ERROR && ep->cq_wait) {
+		/* Control messages queued for batching must be sent
+		 * before blocking, as the sender waits for them */
+		ret = ((nccl_net_ofi_rdma_recv_comm *)base_comm)->flush_ctrl_batch(true);
+		if (OFI_UNLIKELY(ret != 0)) {
+			return ret;
+		}
+
+		ret = rdma_ep_wait_for_completions(ep, rdma_req_comm_lock(req));
+		if (OFI_UNLIKELY(ret != 0)) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Only the communicator lock is held while the request is tested. The
+ * endpoint lock is taken to process completions, and to complete the
+ * request once the endpoint is known to be active and return it to the
+ * freelists, which completion handlers share. The completion handlers
+ * update the state of the request, whichever thread processes the
+ * completions, so a request completed by another thread is seen without
+ * the endpoint lock.
+ */
 int nccl_net_ofi_rdma_req::test(int *done, int *size_p)
 {
 	int ret = 0;
@@ -2341,6 +2974,7 @@ int nccl_net_ofi_rdma_req::test(int *done, int *size_p)
 	       this->type == NCCL_OFI_RDMA_READ ||
 	       this->type == NCCL_OFI_RDMA_SEND ||
 	       this->type == NCCL_OFI_RDMA_RECV ||
+	       this->type == NCCL_OFI_RDMA_RECV_GROUP ||
 	       this->type == NCCL_OFI_RDMA_FLUSH);
 
 	/* Retrieve and validate comm */
@@ -2351,76 +2985,41 @@ int nccl_net_ofi_rdma_req::test(int *done, int *size_p)
 	nccl_net_ofi_rdma_ep_t *ep = (nccl_net_ofi_rdma_ep_t *)base_comm->ep.get();
 	assert(ep != NULL);
 
-	std::lock_guard eplock(ep->ep_lock);
-
-	CHECK_ENDPOINT_ACTIVE(ep, "test");
+	std::lock_guard commlock(rdma_req_comm_lock(this));
 
 	/* If the current request is not complete and not errored out,
-	* check if it is a flush(only if cuda) and the corresponding read is complete
-	* If not, process more completions since they could result in the
-	* request getting completed.
-	*/
+	 * process more completions since they could result in the
+	 * request getting completed.
+	 */
 	if (this->state != NCCL_OFI_RDMA_REQ_COMPLETED
 		&& OFI_LIKELY(this->state != NCCL_OFI_RDMA_REQ_ERROR)) {
-#if HAVE_GPU
-		if (this->type == NCCL_OFI_RDMA_FLUSH) {
-			/*
-			 * Check if the flush is complete and mark it as complete
-			 * if the host buffers have been populated with the sentinel value.
-			 * Increment num_pending_flush_comps to indicate we are still waiting,
-			 * on the request's completion event. The request will be freed once
-			 * all completions are processed.
-			 */
-			if (has_flush_completed(this))
-			{
-				this->state = NCCL_OFI_RDMA_REQ_COMPLETED;
-				size_t req_size = this->size;
-
-				if (size_p) {
-					*size_p = req_size;
-				}
-
-				auto *r_comm = reinterpret_cast<nccl_net_ofi_rdma_recv_comm *>(this->comm);
-				r_comm->num_pending_flush_comps++;
-				*done = 1;
-				goto exit;
-			}
-		}
-#endif
-		ret = ep->ofi_process_cq();
-		if (OFI_UNLIKELY(ret != 0))
-			goto exit;
-
-		/* In case of eager sends if the control message has not arrived
-		 * when the message was being sent, we do not increase the
-		 * number of completions. To ensure that the request is marked
-		 * complete, we check for the control message being received
-		 * here and increase the number of completions if it has.
-		 * Also update the message size if required
-		*/
-		if (this->type == NCCL_OFI_RDMA_SEND) {
-			ret = update_send_request((nccl_net_ofi_rdma_send_comm *)base_comm, this);
-			if (ret != 0) {
-				goto exit;
-			}
+		ep->ep_lock.lock();
+		ret = rdma_req_test_progress(this, ep, done, size_p);
+		ep->ep_lock.unlock();
+		if (OFI_UNLIKELY(ret != 0) || *done) {
+			return ret;
 		}
 	}
 
 	/* Determine whether the request has finished without error and free if done */
 	if (OFI_LIKELY(this->state == NCCL_OFI_RDMA_REQ_COMPLETED)) {
+		std::lock_guard eplock(ep->ep_lock);
 
-		size_t req_size;
-		nccl_net_ofi_mutex_lock(&this->req_lock);
-
-		req_size = this->size;
+		/* Check before completing the message buffer entries, so that
+		 * a request of an inactive endpoint is left untouched */
+		CHECK_ENDPOINT_ACTIVE(ep, "test");
 
-		nccl_net_ofi_mutex_unlock(&this->req_lock);
+		size_t req_size = this->size;
 
-		if (size_p) {
+		if (this->type == NCCL_OFI_RDMA_RECV_GROUP) {
+			/* Sizes and message buffer are per buffer of the group */
+			ret = complete_recv_group(this, size_p);
+			if (OFI_UNLIKELY(ret != 0)) {
+				return ret;
+			}
+		} else if (size_p) {
 			*size_p = req_size;
 		}
-		/* Mark as done */
-		*done = 1;
 
 		if (this->type == NCCL_OFI_RDMA_RECV) {
 			/* Mark as complete in message buffer */
@@ -2430,8 +3029,7 @@ int nccl_net_ofi_rdma_req::test(int *done, int *size_p)
 			nccl_ofi_msgbuff_result_t mb_res = msgbuff->complete(this->msg_seq_num, &stat);
 			if (OFI_UNLIKELY(mb_res != NCCL_OFI_MSGBUFF_SUCCESS)) {
 				NCCL_OFI_WARN("Invalid result of msgbuff_complete for msg %hu", this->msg_seq_num);
-				ret = -EINVAL;
-				goto exit;
+				return -EINVAL;
 			}
 		}
 
@@ -2441,13 +3039,14 @@ int nccl_net_ofi_rdma_req::test(int *done, int *size_p)
 			NCCL_OFI_TRACE_RECV_END(this->dev_id, base_comm, this);
 		}
 
+		/* Mark as done */
+		*done = 1;
+
 		this->free(true);
 	} else if (OFI_UNLIKELY(this->state == NCCL_OFI_RDMA_REQ_ERROR)) {
 		ret = -EINVAL;
-		goto exit;
 	}
 
- exit:
 	return ret;
 }
 
@@ -2475,6 +3074,8 @@ int nccl_net_ofi_rdma_req::free(bool dec_inflight_reqs)
 		return eager_rx_buff_req_free(this, dec_inflight_reqs);
 	case NCCL_OFI_RDMA_FLUSH:
 		return free_flush_req(this, dec_inflight_reqs);
+	case NCCL_OFI_RDMA_RECV_GROUP:
+		return free_recv_group_req(this, dec_inflight_reqs);
 	default:
 		NCCL_OFI_WARN("Unexpected request type: %d", this->type);
 		return -EINVAL;
@@ -2492,10 +3093,26 @@ void nccl_net_ofi_rdma_domain_t::dereg_mr_on_device(nccl_net_ofi_rdma_mr_handle_
 		this->mr_rkey_pool->free_id(mr_handle->mr_key);
 	}
 
+	if (mr_handle->device_copy_handle) {
+		int ret = this->device_copy->deregister_region(mr_handle->device_copy_handle);
+		if (ret != 0) {
+			NCCL_OFI_WARN("Device copy deregistration failed: %d", ret);
+		}
+	}
+
 	delete mr_handle;
 }
 
 
+int nccl_net_ofi_rdma_domain_t::mr_cache_dereg_fn(void *domain_void_ptr, void *handle)
+{
+	auto *domain = static_cast<nccl_net_ofi_rdma_domain_t *>(domain_void_ptr);
+
+	domain->dereg_mr_on_device(static_cast<nccl_net_ofi_rdma_mr_handle_t *>(handle));
+	return 0;
+}
+
+
 int nccl_net_ofi_rdma_domain_t::dereg_mr(nccl_net_ofi_rdma_mr_handle_t *mr_handle)
 {
 	if (OFI_UNLIKELY(mr_handle == NULL)) {
@@ -2601,6 +3218,21 @@ int nccl_net_ofi_rdma_domain_t::reg_mr_on_device(nccl_ofi_mr_ckey_ref ckey,
 	 * For virtual address mode, base_addr is 0 so offset equals the virtual address.
 	 * For offset mode, base_addr is the actual buffer address. */
 	ret_handle->base_addr = virt_addr_mr ? 0 : nccl_ofi_mr_ckey_baseaddr(ckey);
+	ret_handle->type = type;
+
+	/* Map CUDA buffers for eager copies with the CPU. Eager copies
+	 * fall back to RDMA reads if the mapping fails. */
+	if (this->device_copy && type == NCCL_PTR_CUDA && ckey->type == NCCL_OFI_MR_CKEY_IOVEC) {
+		int copy_ret = this->device_copy->register_region(ckey->iovec.iov_base,
+								  ckey->iovec.iov_len,
+								  ret_handle->device_copy_handle);
+		if (copy_ret == 0) {
+			ret_handle->device_copy_base = (uintptr_t)ckey->iovec.iov_base;
+		} else {
+			NCCL_OFI_TRACE(NCCL_NET, "Device copy registration failed: %d", copy_ret);
+			ret_handle->device_copy_handle = NULL;
+		}
+	}
 
 	*mhandle = ret_handle;
 	return 0;
@@ -2613,6 +3245,7 @@ int nccl_net_ofi_rdma_domain_t::reg_mr_on_device(nccl_ofi_mr_ckey_ref ckey,
 
 int nccl_net_ofi_rdma_domain_t::reg_mr(nccl_ofi_mr_ckey_ref ckey,
 				       int type,
+				       bool retain_idle,
 				       nccl_net_ofi_rdma_mr_handle_t **mhandle)
 {
 	int ret = 0;
@@ -2635,14 +3268,39 @@ int nccl_net_ofi_rdma_domain_t::reg_mr(nccl_ofi_mr_ckey_ref ckey,
 		}
 		/* Cache miss */
 
-		ret = this->reg_mr_on_device(ckey, type, &ret_handle);
-		if (OFI_UNLIKELY(ret != 0)) {
-			return ret;
+		const nccl_ofi_mr_ckey_t *reg_ckey = ckey;
+#if HAVE_GPU
+		/* Register neighbouring buffers of the same allocation together */
+		nccl_ofi_mr_ckey_t merged_ckey;
+		uintptr_t alloc_base;
+		size_t alloc_size;
+		if (type == NCCL_PTR_CUDA && this->mr_cache->max_merge_size != 0 &&
+		    ckey->type == NCCL_OFI_MR_CKEY_IOVEC &&
+		    nccl_net_ofi_gpu_get_address_range(ckey->iovec.iov_base, &alloc_base, &alloc_size) == 0 &&
+		    nccl_ofi_mr_cache_merge_key(this->mr_cache, ckey, endpoint_mr,
+						alloc_base, alloc_size, &merged_ckey)) {
+			ret = this->reg_mr_on_device(&merged_ckey, type, &ret_handle);
+			if (ret == 0) {
+				reg_ckey = &merged_ckey;
+			} else {
+				NCCL_OFI_INFO(NCCL_NET,
+					      "Merged registration failed (%d), registering buffer alone",
+					      ret);
+			}
+		}
+#endif
+
+		if (ret_handle == NULL) {
+			ret = this->reg_mr_on_device(ckey, type, &ret_handle);
+			if (OFI_UNLIKELY(ret != 0)) {
+				return ret;
+			}
 		}
 
 		ret = nccl_ofi_mr_cache_insert_entry(this->mr_cache,
-						     ckey,
+						     reg_ckey,
 						     endpoint_mr,
+						     retain_idle,
 						     ret_handle);
 		if (OFI_UNLIKELY(ret != 0)) {
 			if (this->dereg_mr_no_lock(ret_handle) != 0) {
@@ -2675,7 +3333,7 @@ int nccl_net_ofi_rdma_domain_t::reg_internal_mr(void *data,
 	 * passing nullptr
 	 */
 	const nccl_ofi_mr_ckey_t ckey = nccl_ofi_mr_ckey_mk_vec(data, size, nullptr);
-	return this->reg_mr(&ckey, type, mhandle);
+	return this->reg_mr(&ckey, type, false, mhandle);
 }
 
 #if HAVE_DECL_FI_MR_DMABUF
@@ -2691,36 +3349,53 @@ int nccl_net_ofi_rdma_domain_t::reg_internal_mr_dma_buf(void *data,
 	 * passing nullptr
 	 */
 	const nccl_ofi_mr_ckey_t ckey = nccl_ofi_mr_ckey_mk_dmabuf(fd, offset, size, data, nullptr);
-	return this->reg_mr(&ckey, type, mhandle);
+	return this->reg_mr(&ckey, type, false, mhandle);
 }
 #endif
 
-int nccl_net_ofi_rdma_send_comm::regMr(nccl_ofi_mr_ckey_ref ckey,
-                                       int type_param, void **mhandle)
+/*
+ * @brief	Register a buffer of a communicator of the endpoint
+ *
+ * Hits on registrations in use are served by the shared lookup of the MR
+ * cache, without taking the domain lock. The domain lock is only taken to
+ * look up again, register and insert on a miss.
+ */
+static int rdma_comm_reg_mr(nccl_net_ofi_rdma_ep_t *endpoint, nccl_ofi_mr_ckey_ref ckey,
+			    int type, void **mhandle)
 {
-	nccl_net_ofi_rdma_ep_t *endpoint = (nccl_net_ofi_rdma_ep_t *)this->ep.get();
-    nccl_net_ofi_rdma_domain_t *domain = endpoint->rdma_endpoint_get_domain();
+	nccl_net_ofi_rdma_domain_t *domain = endpoint->rdma_endpoint_get_domain();
 	assert(domain != NULL);
 
+	if (domain->mr_cache) {
+		void *handle = nccl_ofi_mr_cache_lookup_shared(domain->mr_cache, ckey, endpoint_mr);
+		if (handle) {
+			*mhandle = handle;
+			return 0;
+		}
+	}
+
 	std::lock_guard domain_lock(domain->domain_lock);
 
+	/* Freed host pages can be reused unnoticed, see
+	 * OFI_NCCL_MR_CACHE_LAZY_DEREG */
 	return domain->reg_mr(ckey,
-			      type_param,
+			      type,
+			      type != NCCL_PTR_HOST,
 			      (nccl_net_ofi_rdma_mr_handle_t **)mhandle);
 }
 
+int nccl_net_ofi_rdma_send_comm::regMr(nccl_ofi_mr_ckey_ref ckey,
+                                       int type_param, void **mhandle)
+{
+	return rdma_comm_reg_mr((nccl_net_ofi_rdma_ep_t *)this->ep.get(), ckey, type_param,
+				mhandle);
+}
+
 int nccl_net_ofi_rdma_recv_comm::regMr(nccl_ofi_mr_ckey_ref ckey,
 								       int type_param, void **mhandle)
 {
-	nccl_net_ofi_rdma_ep_t *endpoint = (nccl_net_ofi_rdma_ep_t *)this->ep.get();
-	nccl_net_ofi_rdma_domain_t *domain = endpoint->rdma_endpoint_get_domain();
-	assert(domain != NULL);
-
-	std::lock_guard domain_lock(domain->domain_lock);
-
-	return domain->reg_mr(ckey,
-			      type_param,
-			      (nccl_net_ofi_rdma_mr_handle_t **)mhandle);
+	return rdma_comm_reg_mr((nccl_net_ofi_rdma_ep_t *)this->ep.get(), ckey, type_param,
+				mhandle);
 }
 
 typedef struct {
@@ -2798,7 +3473,7 @@ int nccl_net_ofi_rdma_recv_comm::deregMr(nccl_net_ofi_mr_handle_t *mhandle)
 /*
  * @brief	Assign an allocated rdma request buffer
  */
-static inline nccl_net_ofi_rdma_req *allocate_req(nccl_ofi_freelist *fl)
+static inline nccl_net_ofi_rdma_req *allocate_req(nccl_ofi_freelist_mt *fl)
 {
 	assert(fl != NULL);
 
@@ -2852,6 +3527,82 @@ static inline int insert_recv_segms_req(
 	return 0;
 }
 
+/*
+ * @brief	Describe the destination buffer of a control message with the
+ *		MR key table
+ *
+ * The control message is made compact if the sender knows the mr keys
+ * of the buffer from an MR key table entry. Otherwise, it defines an
+ * entry for the keys, unless it is part of a grouped receive, which the
+ * sender may read out of order.
+ *
+ * @param	ctrl_msg
+ *		Full control message, except for its sequence number
+ * @return	MR key table entry defined by the control message, or -1
+ */
+static int ctrl_msg_set_key_entry(nccl_net_ofi_rdma_recv_comm *r_comm,
+				  nccl_net_ofi_ctrl_msg_t *ctrl_msg,
+				  uint16_t msg_seq_num)
+{
+	size_t keys_size = r_comm->num_rails * sizeof(uint64_t);
+	int idx = -1;
+
+	if (!ofi_nccl_rdma_compact_ctrl_msg() || ctrl_msg->group_size > 1) {
+		return -1;
+	}
+
+	for (int i = 0; i < NCCL_OFI_CTRL_KEY_TABLE_SIZE; i++) {
+		nccl_net_ofi_ctrl_key_entry_t *entry = &r_comm->ctrl_key_table[i];
+		if (!entry->valid) {
+			if (idx < 0) {
+				idx = i;
+			}
+			continue;
+		}
+		if (memcmp(entry->mr_key, ctrl_msg->mr_key, keys_size) != 0) {
+			continue;
+		}
+
+		int64_t delta = (int64_t)(ctrl_msg->buff_offset - entry->buff_offset);
+		if (!entry->acked) {
+			/* Define the entry again; the sender stores the
+			 * latest definition it reads */
+			idx = i;
+			break;
+		}
+		if (delta < INT32_MIN || delta > INT32_MAX) {
+			/* Too far from the entry for a compact message */
+			return -1;
+		}
+
+		ctrl_msg->hdr.flags |= NCCL_OFI_RDMA_FLAG_COMPACT;
+		ctrl_msg->hdr.key_idx = (uint8_t)i;
+		ctrl_msg->hdr.buff_delta = (int32_t)delta;
+		r_comm->num_ctrl_key_compact++;
+		return -1;
+	}
+
+	if (idx < 0) {
+		/* Replace entries in turn. Compact control messages
+		 * referring to the old definition are read by the
+		 * sender before this one. */
+		idx = r_comm->ctrl_key_next;
+		r_comm->ctrl_key_next = (r_comm->ctrl_key_next + 1) % NCCL_OFI_CTRL_KEY_TABLE_SIZE;
+	}
+
+	nccl_net_ofi_ctrl_key_entry_t *entry = &r_comm->ctrl_key_table[idx];
+	entry->buff_offset = ctrl_msg->buff_offset;
+	memcpy(entry->mr_key, ctrl_msg->mr_key, keys_size);
+	entry->msg_seq_num = msg_seq_num;
+	entry->acked = false;
+	entry->valid = true;
+
+	ctrl_msg->hdr.flags |= NCCL_OFI_RDMA_FLAG_KEY_DEFINE;
+	ctrl_msg->hdr.key_idx = (uint8_t)idx;
+	r_comm->num_ctrl_key_define++;
+	return idx;
+}
+
 /**
  * @brief	Allocate a new recv req from freelist
  */
@@ -2861,7 +3612,8 @@ int nccl_net_ofi_rdma_recv_comm::allocate_recv_req(
 				size_t size,
 				nccl_net_ofi_rdma_mr_handle_t *buff_mr_handle,
 				nccl_net_ofi_rdma_req **ret_req,
-				bool recv_completion_optional)
+				bool recv_completion_optional,
+				int tag, uint16_t group_size)
 {
 	int ret = 0;
 	rdma_req_recv_data_t *recv_data;
@@ -2887,6 +3639,10 @@ int nccl_net_ofi_rdma_recv_comm::allocate_recv_req(
 	recv_data->dst_buff = buff;
 	recv_data->dst_len = size;
 	recv_data->dest_mr_handle = buff_mr_handle;
+	recv_data->ctrl_batch_next = NULL;
+	recv_data->ctrl_batch_len = 1;
+	recv_data->ctrl_rail_id = 0;
+	recv_data->group_req = NULL;
 
 	ret = insert_recv_segms_req(this, device, dev_id_arg, msg_seq_num, buff, size, req);
 	if (ret) {
@@ -2903,13 +3659,13 @@ int nccl_net_ofi_rdma_recv_comm::allocate_recv_req(
 	* been received. Also, since the size of the mailbox is less than MSG_SEQ_NUM_MASK+1
 	* wrap around works fine too */
 	uint16_t slot = req->msg_seq_num % NCCL_OFI_CTRL_MAILBOX_SIZE;
-	this->ctrl_mailbox[slot].msg_seq_num = req->msg_seq_num & MSG_SEQ_NUM_MASK;
+	nccl_net_ofi_ctrl_msg_t *ctrl_msg = &this->ctrl_mailbox[slot];
 	/* Calculate offset from MR base address. For virtual address mode, base_addr is 0. */
-	this->ctrl_mailbox[slot].buff_offset = (uintptr_t)buff - buff_mr_handle->base_addr;
-	this->ctrl_mailbox[slot].buff_len = size;
-	if (recv_completion_optional) {
-		this->ctrl_mailbox[slot].flags |= NCCL_OFI_RDMA_FLAG_RECV_COMPLETION_OPT;
-	}
+	ctrl_msg->buff_offset = (uintptr_t)buff - buff_mr_handle->base_addr;
+	ctrl_msg->tag = tag;
+	ctrl_msg->group_size = group_size;
+	ctrl_msg->hdr.buff_len = size;
+	ctrl_msg->hdr.flags = recv_completion_optional ? NCCL_OFI_RDMA_FLAG_RECV_COMPLETION_OPT : 0;
 
 	uint16_t rail_id = 0;
 	for (; rail_id < this->num_rails; rail_id++) {
@@ -2920,9 +3676,20 @@ int nccl_net_ofi_rdma_recv_comm::allocate_recv_req(
 			return -ENOENT;
 		}
 
-		this->ctrl_mailbox[slot].mr_key[rail_id] = rkey;
+		ctrl_msg->mr_key[rail_id] = rkey;
 	}
 
+	recv_data->ctrl_key_idx = ctrl_msg_set_key_entry(this, ctrl_msg, req->msg_seq_num);
+	if (recv_data->ctrl_key_idx >= 0 && recv_completion_optional) {
+		/* The MR key table entry is acked by the write completion of
+		 * the sender, so a control message defining an entry asks
+		 * for the completion even if it is optional. Entries are
+		 * only defined until the table converges. */
+		recv_data->total_num_compls = 2;
+		ctrl_msg->hdr.flags &= ~NCCL_OFI_RDMA_FLAG_RECV_COMPLETION_OPT;
+	}
+	ctrl_msg->hdr.msg_seq_num = req->msg_seq_num & MSG_SEQ_NUM_MASK;
+
 	*ret_req = req;
 
 	return 0;
@@ -2973,18 +3740,12 @@ static inline int insert_rdma_recv_req_into_msgbuff(nccl_net_ofi_rdma_recv_comm
 int nccl_net_ofi_rdma_ep_t::process_cq_if_pending()
 {
 	/* Process the CQ if there are any pending requests */
-	nccl_net_ofi_mutex_lock(&this->pending_reqs_lock);
-	bool is_deque_empty = this->pending_reqs_queue.empty();
-	nccl_net_ofi_mutex_unlock(&this->pending_reqs_lock);
-	if (!is_deque_empty) {
+	if (this->has_pending_reqs()) {
 		int ret = this->ofi_process_cq();
 		if (ret != 0) {
 			return ret;
 		}
-		nccl_net_ofi_mutex_lock(&this->pending_reqs_lock);
-		is_deque_empty = this->pending_reqs_queue.empty();
-		nccl_net_ofi_mutex_unlock(&this->pending_reqs_lock);
-		if (!is_deque_empty) {
+		if (this->has_pending_reqs()) {
 			/* Network is still busy. */
 			return -EAGAIN;
 		}
@@ -3014,17 +3775,32 @@ int nccl_net_ofi_rdma_recv_comm::recv(int n, void **buffers,
 		recv_completion_optional = true;
 	}
 
+	std::lock_guard commlock(this->comm_lock);
+
 	if (this->comm_active == false) {
 		NCCL_OFI_WARN("Called irecv on inactive communicator");
 		ret = -EINVAL;
 		return ret;
 	}
 
+	if (OFI_UNLIKELY(n > (int)rdma_max_group_receives())) {
+		NCCL_OFI_WARN("Grouped receive of %d buffers, but only %u are supported",
+			      n, rdma_max_group_receives());
+		return -EINVAL;
+	}
+
 	/* Since the control mailbox is 2 * NCCL_OFI_MAX_REQUESTS in size this check ensures
 	 * that the receiver only has NCCL_OFI_MAX_REQUESTS pending at any point
 	 * in time and the sender control mailbox for a request that is not complete will
 	 * never be overwritten */
-	if (OFI_UNLIKELY(this->num_inflight_reqs == NCCL_OFI_MAX_REQUESTS)) {
+	if (OFI_UNLIKELY(this->num_inflight_reqs + n > NCCL_OFI_MAX_REQUESTS)) {
+		if (rdma_max_group_receives() > 1) {
+			/* Every buffer of a grouped receive counts as an
+			 * inflight request, so NCCL can legitimately reach
+			 * the limit. Let it retry later. */
+			*base_req = NULL;
+			return 0;
+		}
 		ret = -ENOSPC;
 		NCCL_OFI_WARN("Can not support more than %d inflight requests",
 			      NCCL_OFI_MAX_REQUESTS);
@@ -3057,6 +3833,30 @@ int nccl_net_ofi_rdma_recv_comm::recv(int n, void **buffers,
 		goto error;
 	}
 
+	/* NCCL versions prior to 2.24 require special handling for 0 byte
+	 * messages when using user buffer registration.  NCCL passes the base
+	 * pointer from the user buffer, but passes the registration from the
+	 * channel buffer, to avoid an MR cache lookup.  This is fine with
+	 * InfiniBand, where the spec says the SGE is not used for a 0 byte
+	 * message, but is a problem for EFA, which validates the pointer / MR
+	 * even for a 0 byte transfer.
+	 *
+	 * To handle this case, we use the flush buffer (note we still move 0
+	 * bytes of data, we just need a valid SGE) instead of the provided base
+	 * pointer and MR
+	 */
+	for (i = 0 ; i < n ; i++) {
+		if (sizes[i] == 0) {
+			buffers[i] = domain->flush_buff.buffer;
+			mr_handles[i] = domain->flush_buff.mr_handle;
+		}
+	}
+
+	if (n > 1) {
+		return this->recv_group(n, buffers, sizes, tags, mr_handles, base_req,
+					recv_completion_optional);
+	}
+
 	msg_seq_num = this->next_msg_seq_num;
 
 	eager = false;
@@ -3091,33 +3891,10 @@ int nccl_net_ofi_rdma_recv_comm::recv(int n, void **buffers,
 		goto error;
 	}
 
-	/*
-	 * TODO: Use NCCL provided tags when using grouped receives aka
-	 * props->maxRecvs > 1.
-	 */
-
-	/* NCCL versions prior to 2.24 require special handling for 0 byte
-	 * messages when using user buffer registration.  NCCL passes the base
-	 * pointer from the user buffer, but passes the registration from the
-	 * channel buffer, to avoid an MR cache lookup.  This is fine with
-	 * InfiniBand, where the spec says the SGE is not used for a 0 byte
-	 * message, but is a problem for EFA, which validates the pointer / MR
-	 * even for a 0 byte transfer.
-	 *
-	 * To handle this case, we use the flush buffer (note we still move 0
-	 * bytes of data, we just need a valid SGE) instead of the provided base
-	 * pointer and MR
-	 */
-	for (i = 0 ; i < n ; i++) {
-		if (sizes[i] == 0) {
-			buffers[i] = domain->flush_buff.buffer;
-			mr_handles[i] = domain->flush_buff.mr_handle;
-		}
-	}
-
 	ret = this->allocate_recv_req(device, device_id, msg_seq_num,
 					buffers[0], sizes[0],
-					mr_handles[0], &req, recv_completion_optional);
+					mr_handles[0], &req, recv_completion_optional,
+					tags[0], 1);
 	if (ret != 0) {
 		goto error;
 	}
@@ -3155,9 +3932,16 @@ int nccl_net_ofi_rdma_recv_comm::recv(int n, void **buffers,
 
 	/* Send ctrl msg */
 	this->n_ctrl_sent += 1;
-	ret = receive_progress(req, true);
+	ret = this->queue_ctrl_msg(req);
 	if (OFI_UNLIKELY(ret != 0)) {
-		/* TODO: Remove req from message buffer */
+		if (!eager) {
+			/* The sender does not know about the message yet */
+			goto remove_req;
+		}
+		/* The message was already received into the eager buffer
+		   and cannot be withdrawn anymore. The request stays
+		   inflight, and the communicator is not usable anymore. */
+		req = NULL;
 		goto error;
 	}
 
@@ -3173,7 +3957,10 @@ int nccl_net_ofi_rdma_recv_comm::recv(int n, void **buffers,
 			ret = receive_progress(recv_data->eager_copy_req, true);
 			if (ret != 0) {
 				NCCL_OFI_WARN("Failed to issue eager read");
-				/* TODO: Remove req from message buffer */
+				/* The message was already received into the
+				   eager buffer and cannot be withdrawn
+				   anymore, see above */
+				req = NULL;
 				goto error;
 			}
 		}
@@ -3186,6 +3973,12 @@ int nccl_net_ofi_rdma_recv_comm::recv(int n, void **buffers,
 
 	goto exit;
 
+ remove_req:
+	mb_res = this->msgbuff->remove(req->msg_seq_num, &msg_stat);
+	if (OFI_UNLIKELY(mb_res != NCCL_OFI_MSGBUFF_SUCCESS)) {
+		NCCL_OFI_WARN("Unexpected result of msgbuff remove for msg %hu", req->msg_seq_num);
+	}
+	(this->num_inflight_reqs)--;
  free_req:
  error:
 	if (req)
@@ -3195,6 +3988,349 @@ int nccl_net_ofi_rdma_recv_comm::recv(int n, void **buffers,
 	return ret;
 }
 
+/*
+ * @brief	Post a grouped receive
+ *
+ * Each of the n buffers is received by its own receive request, using
+ * consecutive message sequence numbers and control messages. The control
+ * messages carry the tag of the buffer and the size of the group, so the
+ * sender can match each send to the buffer with the same tag, in any
+ * order. A parent request, returned to NCCL, completes when all buffers
+ * are received.
+ *
+ * Must be called with the endpoint lock held.
+ */
+int nccl_net_ofi_rdma_recv_comm::recv_group(int n, void **buffers, size_t *sizes, int *tags,
+					     nccl_net_ofi_rdma_mr_handle_t **mr_handles,
+					     nccl_net_ofi_req **base_req,
+					     bool recv_completion_optional)
+{
+	int ret = 0;
+	nccl_net_ofi_rdma_ep_t *endpoint = this->get_ep();
+	nccl_net_ofi_rdma_device_t *device = endpoint->rdma_endpoint_get_device();
+	rdma_req_recv_group_data_t *recv_group_data = NULL;
+	nccl_ofi_msgbuff_status_t msg_stat;
+	nccl_ofi_msgbuff_result_t mb_res;
+	int num_inserted = 0;
+	int num_queued = 0;
+
+	assert(n > 1 && n <= NCCL_OFI_MAX_RECVS);
+
+	/* Eager messages are disabled with grouped receives, so none of the
+	 * messages of the group may have arrived yet */
+	for (int i = 0; i < n; i++) {
+		uint16_t msg_seq_num = (this->next_msg_seq_num + i) & MSG_SEQ_NUM_MASK;
+		void *elem;
+		nccl_ofi_msgbuff_elemtype_t elem_type;
+
+		mb_res = this->msgbuff->retrieve(msg_seq_num, &elem, &elem_type, &msg_stat);
+		if (OFI_UNLIKELY(mb_res != NCCL_OFI_MSGBUFF_INVALID_IDX ||
+				 msg_stat != NCCL_OFI_MSGBUFF_NOTSTARTED)) {
+			NCCL_OFI_WARN("Message %hu of grouped receive has invalid status %d. "
+				      "OFI_NCCL_RDMA_MAX_GROUP_RECEIVES must be set on all ranks.",
+				      msg_seq_num, (int)msg_stat);
+			return -EINVAL;
+		}
+	}
+
+	nccl_net_ofi_rdma_req *req = allocate_req(this->nccl_ofi_reqs_fl);
+	if (OFI_UNLIKELY(req == NULL)) {
+		NCCL_OFI_WARN("Unable to get NCCL OFI grouped receive request for device %d",
+			      this->dev_id);
+		return -ENOMEM;
+	}
+	req->comm = this;
+	req->dev_id = this->dev_id;
+	req->type = NCCL_OFI_RDMA_RECV_GROUP;
+	req->msg_seq_num = this->next_msg_seq_num;
+
+	recv_group_data = get_recv_group_data(req);
+	recv_group_data->num_recvs = 0;
+
+	for (int i = 0; i < n; i++) {
+		uint16_t msg_seq_num = (this->next_msg_seq_num + i) & MSG_SEQ_NUM_MASK;
+		nccl_net_ofi_rdma_req *recv_req = NULL;
+
+		ret = this->allocate_recv_req(device, this->dev_id, msg_seq_num,
+					      buffers[i], sizes[i], mr_handles[i], &recv_req,
+					      recv_completion_optional, tags[i], (uint16_t)n);
+		if (OFI_UNLIKELY(ret != 0)) {
+			goto error;
+		}
+		get_recv_data(recv_req)->group_req = req;
+		recv_group_data->recv_reqs[recv_group_data->num_recvs++] = recv_req;
+	}
+
+	for (int i = 0; i < n; i++) {
+		nccl_net_ofi_rdma_req *recv_req = recv_group_data->recv_reqs[i];
+
+		mb_res = this->msgbuff->insert(recv_req->msg_seq_num, recv_req,
+					       NCCL_OFI_MSGBUFF_REQ, &msg_stat);
+		if (OFI_UNLIKELY(mb_res != NCCL_OFI_MSGBUFF_SUCCESS)) {
+			NCCL_OFI_WARN("Unexpected result of nccl_ofi_msgbuff_insert for msg %hu",
+				      recv_req->msg_seq_num);
+			ret = -EINVAL;
+			goto error;
+		}
+		num_inserted++;
+	}
+
+	for (int i = 0; i < n; i++) {
+		nccl_net_ofi_rdma_req *recv_req = recv_group_data->recv_reqs[i];
+
+		NCCL_OFI_TRACE_RECV(this->dev_id, this, sizes[i], recv_req, base_req);
+
+		/* Send ctrl msg */
+		ret = this->queue_ctrl_msg(recv_req);
+		if (OFI_UNLIKELY(ret != 0)) {
+			goto error;
+		}
+		this->n_ctrl_sent += 1;
+		/* Every buffer uses a slot of the sender's control mailbox */
+		this->num_inflight_reqs += 1;
+		num_queued++;
+	}
+
+	/* Return request to NCCL */
+	*base_req = (nccl_net_ofi_req *)req;
+	this->next_msg_seq_num = (this->next_msg_seq_num + n) & MSG_SEQ_NUM_MASK;
+
+	return 0;
+
+ error:
+	/*
+	 * Withdraw the buffers whose control message was not handed to the
+	 * sender. Control messages already posted cannot be recalled: their
+	 * receive requests stay inflight, and the communicator is not usable
+	 * anymore.
+	 */
+	for (int i = 0; i < num_queued; i++) {
+		get_recv_data(recv_group_data->recv_reqs[i])->group_req = NULL;
+	}
+	for (int i = num_queued; i < recv_group_data->num_recvs; i++) {
+		nccl_net_ofi_rdma_req *recv_req = recv_group_data->recv_reqs[i];
+
+		if (i < num_inserted) {
+			mb_res = this->msgbuff->remove(recv_req->msg_seq_num, &msg_stat);
+			assert(mb_res == NCCL_OFI_MSGBUFF_SUCCESS);
+		}
+		recv_req->free(false);
+	}
+	recv_group_data->num_recvs = 0;
+	req->free(false);
+	*base_req = NULL;
+	return ret;
+}
+
+static inline uint64_t ctrl_batch_now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * @brief	Queue the control message of a receive request
+ *
+ * Control messages of consecutive receives use contiguous slots of the
+ * sender's mailbox, so a batch of them is written with one RDMA write.
+ * The batch is written when it is full or the next message does not
+ * continue it because the mailbox wrapped around. Otherwise it is written
+ * by flush_ctrl_batch(), when a request of the communicator is tested or
+ * the endpoint makes progress.
+ *
+ * Must be called with the endpoint lock held.
+ */
+int nccl_net_ofi_rdma_recv_comm::queue_ctrl_msg(nccl_net_ofi_rdma_req *req)
+{
+	unsigned int batch_max = std::min(ofi_nccl_rdma_ctrl_batch_max(),
+					  (unsigned int)NCCL_OFI_CTRL_MAILBOX_SIZE);
+	uint16_t slot = req->msg_seq_num % NCCL_OFI_CTRL_MAILBOX_SIZE;
+	int ret;
+
+	if (batch_max <= 1) {
+		return receive_progress(req, true);
+	}
+
+	if (this->ctrl_batch_head != NULL) {
+		nccl_net_ofi_rdma_req *head = this->ctrl_batch_head;
+		uint16_t head_slot = head->msg_seq_num % NCCL_OFI_CTRL_MAILBOX_SIZE;
+
+		if (head_slot + get_recv_data(head)->ctrl_batch_len != slot) {
+			ret = this->flush_ctrl_batch(true);
+			if (OFI_UNLIKELY(ret != 0)) {
+				return ret;
+			}
+		}
+	}
+
+	if (this->ctrl_batch_head == NULL) {
+		this->ctrl_batch_head = req;
+		this->get_ep()->ctrl_batch_comms.push_back(&this->ctrl_batch_node);
+		if (ofi_nccl_rdma_ctrl_batch_timeout_us() > 0) {
+			this->ctrl_batch_start_ns = ctrl_batch_now_ns();
+		}
+	} else {
+		get_recv_data(this->ctrl_batch_tail)->ctrl_batch_next = req;
+		get_recv_data(this->ctrl_batch_head)->ctrl_batch_len++;
+	}
+	this->ctrl_batch_tail = req;
+
+	if (get_recv_data(this->ctrl_batch_head)->ctrl_batch_len >= batch_max) {
+		return this->flush_ctrl_batch(true);
+	}
+
+	return 0;
+}
+
+/*
+ * @brief	Write the queued control messages to the sender
+ *
+ * @param	force
+ *		Write the batch even if it was queued less than
+ *		OFI_NCCL_RDMA_CTRL_BATCH_TIMEOUT_US ago
+ *
+ * Must be called with the endpoint lock held.
+ */
+int nccl_net_ofi_rdma_recv_comm::flush_ctrl_batch(bool force)
+{
+	nccl_net_ofi_rdma_req *head = this->ctrl_batch_head;
+	uint64_t timeout_ns = ofi_nccl_rdma_ctrl_batch_timeout_us() * 1000ULL;
+
+	if (head == NULL) {
+		return 0;
+	}
+	if (!force && timeout_ns > 0 &&
+	    ctrl_batch_now_ns() - this->ctrl_batch_start_ns < timeout_ns) {
+		return 0;
+	}
+
+	this->ctrl_batch_head = NULL;
+	this->ctrl_batch_tail = NULL;
+	this->ctrl_batch_node.remove();
+
+	return receive_progress(head, true);
+}
+
+int nccl_net_ofi_rdma_ep_t::flush_ctrl_batches()
+{
+	nccl_ofi_dlist_node *pos;
+
+	nccl_ofi_dlist_for_each_safe(&this->ctrl_batch_comms, pos) {
+		nccl_net_ofi_rdma_recv_comm *r_comm =
+			nccl_ofi_dlist_entry(pos, &nccl_net_ofi_rdma_recv_comm::ctrl_batch_node);
+		int ret = r_comm->flush_ctrl_batch(false);
+		if (OFI_UNLIKELY(ret != 0)) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * @brief	Shrink the rx buffer window of a rail if its epoch ended
+ *		without consumptions
+ *
+ * @param	num_to_post
+ *		Incremented by the number of buffers the rail may still post
+ *		to fill its window
+ *
+ * @return	true, if the rx buffer freelist of the rail should be
+ *		trimmed
+ */
+static bool shrink_idle_rx_window(nccl_net_ofi_rdma_ep_rail_t *rail, size_t *num_to_post)
+{
+	bool trim = false;
+
+	if (!rail->rx_window) {
+		return false;
+	}
+
+	nccl_net_ofi_mutex_lock(&rail->rx_buff_mutex);
+
+	if (rail->rx_window->report_idle()) {
+		rail->rx_buff_trim_pending = true;
+		rail->max_rx_buff_posted = rail->rx_window->size();
+		rail->min_rx_buff_posted = rail->rx_window->low_watermark();
+		NCCL_OFI_TRACE(NCCL_NET, "Idle rail %u rx buffer window shrank to %zu (refill below %zu)",
+			       rail->rail_id, rail->max_rx_buff_posted, rail->min_rx_buff_posted);
+	}
+
+	if (rail->rx_buff_trim_pending) {
+		trim = true;
+		/* Buffers posted above the window are freed as they are
+		 * consumed, keep trimming until the last one was */
+		if (rail->num_rx_buff_posted <= rail->max_rx_buff_posted) {
+			rail->rx_buff_trim_pending = false;
+		}
+	}
+
+	if (rail->num_rx_buff_posted < rail->max_rx_buff_posted) {
+		*num_to_post += rail->max_rx_buff_posted - rail->num_rx_buff_posted;
+	}
+
+	nccl_net_ofi_mutex_unlock(&rail->rx_buff_mutex);
+
+	return trim;
+}
+
+
+void nccl_net_ofi_rdma_ep_t::shrink_idle_rx_windows()
+{
+	size_t num_to_post = 0;
+	bool trim = false;
+
+	for (uint16_t rail_id = 0; rail_id < this->num_control_rails; ++rail_id) {
+		trim |= shrink_idle_rx_window(this->rdma_endpoint_get_control_rail(rail_id),
+					      &num_to_post);
+	}
+	/* Keep the free buffers the windows may still post */
+	if (trim) {
+		this->ctrl_rx_buff_fl->trim(num_to_post);
+	}
+
+	num_to_post = 0;
+	trim = false;
+	for (uint16_t rail_id = 0; rail_id < this->num_rails; ++rail_id) {
+		trim |= shrink_idle_rx_window(this->rdma_endpoint_get_rail(rail_id), &num_to_post);
+	}
+	if (trim && this->eager_rx_buff_fl != NULL) {
+		this->eager_rx_buff_fl->trim(num_to_post);
+	}
+}
+
+
+int nccl_net_ofi_rdma_ep_t::process_eager_ctrl_sends()
+{
+	nccl_ofi_dlist_node *pos;
+
+	nccl_ofi_dlist_for_each_safe(&this->eager_ctrl_comms, pos) {
+		nccl_net_ofi_rdma_send_comm *s_comm =
+			nccl_ofi_dlist_entry(pos, &nccl_net_ofi_rdma_send_comm::eager_ctrl_node);
+		std::deque<nccl_net_ofi_rdma_req *> &reqs = s_comm->eager_ctrl_reqs;
+
+		for (auto it = reqs.begin(); it != reqs.end();) {
+			nccl_net_ofi_rdma_req *req = *it;
+			int ret = update_send_request(s_comm, req);
+			if (OFI_UNLIKELY(ret != 0)) {
+				return ret;
+			}
+			if (req->state == NCCL_OFI_RDMA_REQ_COMPLETED ||
+			    req->state == NCCL_OFI_RDMA_REQ_ERROR) {
+				it = reqs.erase(it);
+			} else {
+				++it;
+			}
+		}
+
+		if (reqs.empty()) {
+			s_comm->eager_ctrl_node.remove();
+		}
+	}
+
+	return 0;
+}
+
 int nccl_net_ofi_rdma_domain_t::dealloc_and_dereg_flush_buff()
 {
 	int ret = 0;
@@ -3378,11 +4514,28 @@ static int recv_comm_destroy(nccl_net_ofi_rdma_recv_comm *r_comm)
 	device = ep->rdma_endpoint_get_device();
 	assert(device != NULL);
 
+	if (r_comm->num_ctrl_key_define > NCCL_OFI_CTRL_KEY_TABLE_SIZE &&
+	    r_comm->num_ctrl_key_define > r_comm->num_ctrl_key_compact) {
+		/* The sender did not ack most definitions, so most control
+		 * messages carried the full MR keys */
+		NCCL_OFI_INFO(NCCL_NET, "MR key table of r_comm %u did not converge: %lu definitions, %lu compact control messages",
+			      r_comm->local_comm_id, r_comm->num_ctrl_key_define,
+			      r_comm->num_ctrl_key_compact);
+	}
+
 	if (r_comm->receiver != nullptr) {
 		delete r_comm->receiver;
 		r_comm->receiver = nullptr;
 	}
 
+	/* Control messages still queued for batching are not sent anymore */
+	{
+		std::lock_guard eplock(ep->ep_lock);
+		if (r_comm->ctrl_batch_node.on_list()) {
+			r_comm->ctrl_batch_node.remove();
+		}
+	}
+
 	if (r_comm->send_close_req != NULL) {
 		ret = r_comm->send_close_req->free(false);
 		if (ret != 0) {
@@ -3507,6 +4660,11 @@ static inline int progress_closing_recv_comm(nccl_net_ofi_rdma_recv_comm *r_comm
 		return COMM_READY_TO_DESTROY;
 	}
 	if (r_comm->send_close_req == NULL) {
+		ret = r_comm->flush_ctrl_batch(true);
+		if (ret != 0) {
+			return ret;
+		}
+
 		/* Waiting for all ctrls to complete */
 		uint64_t n_ctrl_sent = r_comm->n_ctrl_sent;
 		bool all_ctrl_msgs_delivered =
@@ -3536,9 +4694,7 @@ static inline int progress_closing_recv_comm(nccl_net_ofi_rdma_recv_comm *r_comm
 	} else /* (r_comm->send_close_req != NULL) */ {
 
 		/* Waiting for close message delivery */
-		nccl_net_ofi_mutex_lock(&r_comm->send_close_req->req_lock);
 		nccl_net_ofi_rdma_req_state_t state = r_comm->send_close_req->state;
-		nccl_net_ofi_mutex_unlock(&r_comm->send_close_req->req_lock);
 
 		if (state == NCCL_OFI_RDMA_REQ_ERROR) {
 			NCCL_OFI_WARN("Send close message complete with error");
@@ -3596,6 +4752,7 @@ nccl_net_ofi_rdma_send_comm::~nccl_net_ofi_rdma_send_comm() {
 	if (this->ctrl_mailbox) {
 		free(this->ctrl_mailbox);
 	}
+	delete this->eager_threshold;
 }
 
 static int send_comm_destroy(nccl_net_ofi_rdma_send_comm *s_comm)
@@ -3607,10 +4764,21 @@ static int send_comm_destroy(nccl_net_ofi_rdma_send_comm *s_comm)
 		s_comm->connector = nullptr;
 	}
 
+	nccl_net_ofi_rdma_ep_t *ep = (nccl_net_ofi_rdma_ep_t *)s_comm->ep.get();
+
+	/* Eager sends still waiting for their control message are not
+	 * completed anymore */
+	{
+		std::lock_guard eplock(ep->ep_lock);
+		if (s_comm->eager_ctrl_node.on_list()) {
+			s_comm->eager_ctrl_node.remove();
+		}
+		s_comm->eager_ctrl_reqs.clear();
+	}
+
 	/* Release request freelist */
 	delete s_comm->nccl_ofi_reqs_fl;
 
-	nccl_net_ofi_rdma_ep_t *ep = (nccl_net_ofi_rdma_ep_t *)s_comm->ep.get();
 	nccl_net_ofi_rdma_device_t *device = ep->rdma_endpoint_get_device();
 	device->rdma_device_set_comm(s_comm->local_comm_id, NULL);
 
@@ -3872,6 +5040,7 @@ int nccl_net_ofi_rdma_recv_comm::flush(int n, void **buffers,
 	bool network_busy = false;
 	nccl_net_ofi_rdma_ep_t *endpoint = this->get_ep();
 
+	std::lock_guard commlock(this->comm_lock);
 	std::lock_guard eplock(endpoint->ep_lock);
 
 	CHECK_ENDPOINT_ACTIVE(endpoint, "flush");
@@ -3948,11 +5117,8 @@ int nccl_net_ofi_rdma_recv_comm::flush(int n, void **buffers,
 		}
 	} else {
 		/* Add to pending reqs queue */
-		nccl_net_ofi_mutex_lock(&endpoint->pending_reqs_lock);
-		endpoint->pending_reqs_queue.push_back(req);
-		nccl_net_ofi_mutex_unlock(&endpoint->pending_reqs_lock);
+		endpoint->add_pending_req(req);
 		ret = 0;
-		NCCL_OFI_TRACE_PENDING_INSERT(req);
 	}
 
 	(this->num_inflight_reqs)++;
@@ -4010,6 +5176,13 @@ nccl_net_ofi_rdma_recv_comm::nccl_net_ofi_rdma_recv_comm()
 	ctrl_mr_handle = nullptr;
 	remote_mailbox_addr = 0;
 	remote_mr_key = {};
+	ctrl_key_table = {};
+	ctrl_key_next = 0;
+	num_ctrl_key_define = 0;
+	num_ctrl_key_compact = 0;
+	ctrl_batch_head = nullptr;
+	ctrl_batch_tail = nullptr;
+	ctrl_batch_start_ns = 0;
 
 	const size_t ctrl_mailbox_size = sizeof(nccl_net_ofi_ctrl_msg_t) * NCCL_OFI_CTRL_MAILBOX_SIZE;
 	ctrl_mailbox = (nccl_net_ofi_ctrl_msg_t *)aligned_alloc(system_page_size, ctrl_mailbox_size);
@@ -4088,6 +5261,8 @@ int nccl_net_ofi_rdma_recv_comm::read(void* dest, size_t size, void* mhandle,
 	nccl_net_ofi_rdma_req *req = NULL;
 	nccl_net_ofi_rdma_ep_t *endpoint = NULL;
 
+	std::lock_guard commlock(this->comm_lock);
+
 	if (this->comm_active == false) {
 		NCCL_OFI_WARN("Called iread on inactive communicator");
 		*base_req = NULL;
@@ -4173,26 +5348,7 @@ static int rdma_fl_req_entry_init(void *entry)
 	assert(req);
 	zero_nccl_ofi_req(req);
 
-	/* Initialize mutex for request access */
-	int ret = nccl_net_ofi_mutex_init(&req->req_lock, NULL);
-	if (ret != 0) {
-		NCCL_OFI_WARN("Unable to initialize mutex");
-		return ret;
-	}
-
-	return ret;
-}
-
-
-// TODO: Templatize freelist to eliminate this wrapper function.
-/**
- * Freelist callback to finalize RDMA request
- */
-static void rdma_fl_req_entry_fini(void *entry)
-{
-	nccl_net_ofi_rdma_req *req = static_cast<nccl_net_ofi_rdma_req *>(entry);
-	assert(req);
-	nccl_net_ofi_mutex_destroy(&req->req_lock);
+	return 0;
 }
 
 
@@ -4356,11 +5512,12 @@ static nccl_net_ofi_rdma_recv_comm *prepare_recv_comm(nccl_net_ofi_rdma_domain_t
 	/* Allocate request freelist */
 	/* Maximum freelist entries is 4*NCCL_OFI_MAX_REQUESTS because each receive request
 	   can have associated reqs for send_ctrl, recv_segms, and eager_copy */
-	r_comm->nccl_ofi_reqs_fl = new nccl_ofi_freelist(sizeof(nccl_net_ofi_rdma_req), 16, 16,
-							 4 * NCCL_OFI_MAX_REQUESTS,
-							 rdma_fl_req_entry_init, rdma_fl_req_entry_fini,
-							 "Recv Communicator Requests",
-							 true);
+	r_comm->nccl_ofi_reqs_fl = new nccl_ofi_freelist_mt(sizeof(nccl_net_ofi_rdma_req), 16, 16,
+							    RDMA_REQ_FL_MAX_ENTRIES(4 * NCCL_OFI_MAX_REQUESTS),
+							    RDMA_REQ_FL_MAGAZINE_SIZE,
+							    rdma_fl_req_entry_init, NULL,
+							    "Recv Communicator Requests",
+							    true, alignof(nccl_net_ofi_rdma_req));
 
 	/* Allocate message buffer with initial sequence number NCCL_OFI_RDMA_MSG_SEQ_NUM_START */
 	try {
@@ -4436,6 +5593,7 @@ void nccl_net_ofi_rdma_ep_t::prepare_conn_resp(nccl_net_ofi_rdma_recv_comm *r_co
 	/* Set number of rails to be sent back to remote for verification */
 	conn_resp->num_rails = this->num_rails;
 	conn_resp->num_control_rails = this->num_control_rails;
+	conn_resp->max_group_receives = (uint16_t)rdma_max_group_receives();
 
 	/* Set libfabric endpoint names for each rail */
 	for (uint16_t rail_id = 0; rail_id != this->num_rails; ++rail_id) {
@@ -4530,6 +5688,16 @@ static int accept_wait_for_connection(nccl_net_ofi_rdma_domain_t *domain,
 		goto exit;
 	}
 
+	/* Both sides agree on grouped receives, and thus on eager messages */
+	if (conn_msg->max_group_receives != rdma_max_group_receives()) {
+		NCCL_OFI_WARN("Unexpected number of remote grouped receives for dev %d. Expected %u but got %u. "
+			      "OFI_NCCL_RDMA_MAX_GROUP_RECEIVES must be set on all ranks.",
+				dev_id, rdma_max_group_receives(),
+				(unsigned int)conn_msg->max_group_receives);
+		ret = -EINVAL;
+		goto exit;
+	}
+
 	/* Prepare receive communicator object for the received peer connection */
 	r_comm = prepare_recv_comm(domain, l_comm_ep, conn_msg);
 	if (OFI_UNLIKELY(r_comm == NULL)) {
@@ -4844,10 +6012,9 @@ static int alloc_rdma_send_req(nccl_net_ofi_rdma_send_comm *s_comm,
 	   remote length received in the control message.
 	 */
 	if (eager) {
-		send_data->schedule = scheduler->get_schedule(size, device->num_rails);
-		if (OFI_UNLIKELY(send_data->schedule == NULL)) {
-			return -EINVAL;
-		}
+		send_data->schedule = scheduler->get_schedule(size, device->num_rails,
+							      send_data->schedule_buf.get());
+		schedule_set_start_time(ep, send_data->schedule);
 
 		/* Set expected number of completions. Since this is an eager send, the ctrl msg
 		   has not arrived, so we expect one extra completion for the ctrl msg recv. */
@@ -5015,61 +6182,86 @@ static int post_rx_buffer(nccl_net_ofi_rdma_req *req,
 }
 
 /*
- * @brief	This function helps progress the send request by submitting it
- *		to the network. This can be invoked when submitting a new request
- *		or processing pending requests list.
+ * @brief	Post the operations of a send request that are not posted yet
+ *
+ * Only touches the send request and the provider, so that a thread safe
+ * domain posts them without the endpoint lock. The caller reports
+ * -FI_EAGAIN to the rail the request waits for.
  *
  * @return	0, if successfully sent
- *              -EINVAL   Invalid request
- * 		-FI_EAGAIN, if need to retry the xfer
- * 		-1, error
+ *		-FI_EAGAIN, if need to retry the xfer
+ *		error, on others
  */
-static int send_progress(nccl_net_ofi_rdma_req *req)
+static int post_send_req(nccl_net_ofi_rdma_req *req)
 {
-	ssize_t ret = 0;;
+	ssize_t ret = 0;
 	nccl_net_ofi_rdma_send_comm *s_comm = (nccl_net_ofi_rdma_send_comm *)req->comm;
+	rdma_req_send_data_t *send_data = get_send_data(req);
 
-	assert(req != NULL);
+	// Get Schedule
+	nccl_net_ofi_schedule_t *schedule = send_data->schedule;
+	if (OFI_UNLIKELY(schedule == NULL)) {
+		NCCL_OFI_WARN("Schedule for req %p is NULL", req);
+		return -ENOTSUP;;
+	}
 
-	if (req->type == NCCL_OFI_RDMA_SEND) { // Post RDMA write
-		rdma_req_send_data_t *send_data = get_send_data(req);
+	assert(!(send_data->eager) || schedule->num_xfer_infos == 1);
 
-		// Get Schedule
-		nccl_net_ofi_schedule_t *schedule = send_data->schedule;
-		if (OFI_UNLIKELY(schedule == NULL)) {
-			NCCL_OFI_WARN("Schedule for req %p is NULL", req);
-			return -ENOTSUP;;
-		}
+	nccl_net_ofi_xfer_info_t *xfers = schedule->rail_xfer_infos;
 
-		assert(!(send_data->eager) || schedule->num_xfer_infos == 1);
+	if (send_data->eager) {
+		/* Get xfer information from the schedule */
+		nccl_net_ofi_xfer_info_t *xfer_info = &xfers[0];
 
-		nccl_net_ofi_xfer_info_t *xfers = schedule->rail_xfer_infos;
+		/* Get communicator rail information to xfer the req */
+		nccl_net_ofi_rdma_send_comm_rail_t *comm_rail =
+			s_comm->get_data_rail(xfer_info->rail_id);
 
-		if (send_data->eager) {
+		ret = post_rdma_eager_send(req, comm_rail, xfer_info);
+	} else {
+		for (uint16_t rail_it = send_data->xferred_rail_id; rail_it < schedule->num_xfer_infos; rail_it++) {
 			/* Get xfer information from the schedule */
-			nccl_net_ofi_xfer_info_t *xfer_info = &xfers[0];
-
+			nccl_net_ofi_xfer_info_t *xfer_info = &xfers[rail_it];
 			/* Get communicator rail information to xfer the req */
 			nccl_net_ofi_rdma_send_comm_rail_t *comm_rail =
 				s_comm->get_data_rail(xfer_info->rail_id);
 
-			ret = post_rdma_eager_send(req, comm_rail, xfer_info);
-		} else {
-			for (uint16_t rail_it = send_data->xferred_rail_id; rail_it < schedule->num_xfer_infos; rail_it++) {
-				/* Get xfer information from the schedule */
-				nccl_net_ofi_xfer_info_t *xfer_info = &xfers[rail_it];
-				/* Get communicator rail information to xfer the req */
-				nccl_net_ofi_rdma_send_comm_rail_t *comm_rail =
-					s_comm->get_data_rail(xfer_info->rail_id);
-
-				ret = post_rdma_write(req, comm_rail, xfer_info, send_data->no_target_completion);
-
-				if (ret == 0) // Successfully sent the xfer with this rail
-					send_data->xferred_rail_id++;
-				else
-					break;
+			ret = post_rdma_write(req, comm_rail, xfer_info, send_data->no_target_completion);
+
+			if (ret == 0) { // Successfully sent the xfer with this rail
+				send_data->xferred_rail_id++;
+			} else {
+				break;
 			}
 		}
+	}
+
+	return ret;
+}
+
+/*
+ * @brief	This function helps progress the send request by submitting it
+ *		to the network. This can be invoked when submitting a new request
+ *		or processing pending requests list.
+ *
+ * @return	0, if successfully sent
+ *              -EINVAL   Invalid request
+ * 		-FI_EAGAIN, if need to retry the xfer
+ * 		-1, error
+ */
+static int send_progress(nccl_net_ofi_rdma_req *req)
+{
+	ssize_t ret = 0;;
+	nccl_net_ofi_rdma_send_comm *s_comm = (nccl_net_ofi_rdma_send_comm *)req->comm;
+
+	assert(req != NULL);
+
+	if (req->type == NCCL_OFI_RDMA_SEND) { // Post RDMA write
+		ret = post_send_req(req);
+		if (ret == -FI_EAGAIN) {
+			rail_notify_eagain((nccl_net_ofi_rdma_ep_t *)s_comm->ep.get(),
+					   pending_req_rail_id(req));
+		}
 	} else if (req->type == NCCL_OFI_RDMA_WRITE) { // Post RMA write
 		ret = post_rma_write(req);
 		if (ret == 0) {
@@ -5118,6 +6310,20 @@ static ssize_t send_ctrl_post(nccl_net_ofi_rdma_recv_comm *r_comm,
 	return rc;
 }
 
+/*
+ * @brief	Trace the start of the control message writes of a batch
+ *
+ * @param	req
+ *		Receive request heading the batch
+ */
+static inline void trace_write_ctrl_start(nccl_net_ofi_rdma_req *req, uint16_t rail_id)
+{
+	for (; req != NULL; req = get_recv_data(req)->ctrl_batch_next) {
+		NCCL_OFI_TRACE_WRITE_CTRL_START(req->dev_id, rail_id, req->comm, req,
+						req->msg_seq_num);
+	}
+}
+
 static int post_rdma_ctrl(nccl_net_ofi_rdma_req *req)
 {
 	assert(req->type == NCCL_OFI_RDMA_RECV);
@@ -5128,14 +6334,14 @@ static int post_rdma_ctrl(nccl_net_ofi_rdma_req *req)
 	nccl_net_ofi_scheduler *scheduler = ep->scheduler;
 	uint16_t rail_id;
 	size_t ctrl_msg_len = nccl_net_ofi_rdma_ctrl_msg_size();
+	nccl_net_ofi_schedule_buf<MAX_NUM_RAILS> schedule_buf;
 	nccl_net_ofi_schedule_t *schedule = NULL;
 
 	if (ep->num_control_rails > 1) {
-		schedule = scheduler->get_schedule(ctrl_msg_len, ep->num_control_rails);
+		schedule = scheduler->get_schedule(ctrl_msg_len, ep->num_control_rails,
+						   schedule_buf.get());
 
-		if (OFI_UNLIKELY(!(schedule))) {
-			return -EINVAL;
-		} else if (OFI_UNLIKELY(schedule->num_xfer_infos != 1)) {
+		if (OFI_UNLIKELY(schedule->num_xfer_infos != 1)) {
 			NCCL_OFI_WARN(
 				"Invalid schedule for outgoing control message. Expected one rail, but got "
 				"%zu", schedule->num_xfer_infos);
@@ -5149,20 +6355,50 @@ static int post_rdma_ctrl(nccl_net_ofi_rdma_req *req)
 		rail_id = 0;
 	}
 
+	get_recv_data(req)->ctrl_rail_id = rail_id;
+
 	uint16_t slot = req->msg_seq_num % NCCL_OFI_CTRL_MAILBOX_SIZE;
-	void *desc = fi_mr_desc(r_comm->ctrl_mr_handle->mr[rail_id].get());
+	uint16_t batch_len = get_recv_data(req)->ctrl_batch_len;
 	nccl_net_ofi_rdma_recv_comm_rail_t *comm_rail = r_comm->get_control_rail(rail_id);
+	nccl_net_ofi_ctrl_msg_t *ctrl_msg = &r_comm->ctrl_mailbox[slot];
+	const void *buf = ctrl_msg;
+	uint64_t remote_addr = r_comm->remote_mailbox_addr + slot * sizeof(nccl_net_ofi_ctrl_msg_t);
+	ssize_t rc;
 
-	ssize_t rc = fi_write(comm_rail->local_ep, &r_comm->ctrl_mailbox[slot],
-			ctrl_msg_len, desc,
-			comm_rail->remote_addr,
-			r_comm->remote_mailbox_addr + slot * sizeof(nccl_net_ofi_ctrl_msg_t),
-			r_comm->remote_mr_key[rail_id], rdma_req_get_ofi_context(req, rail_id));
-
-	if (rc == 0) {
-		NCCL_OFI_TRACE_WRITE_CTRL_START(req->dev_id,
-			rail_id,
-			req->comm, req, req->msg_seq_num);
+	if (batch_len > 1) {
+		/* The slots of a batch are contiguous. Compact messages
+		 * are written with their full slot, which is valid too. */
+		ctrl_msg_len = batch_len * sizeof(nccl_net_ofi_ctrl_msg_t);
+	} else if (ctrl_msg->hdr.flags & NCCL_OFI_RDMA_FLAG_COMPACT) {
+		buf = &ctrl_msg->hdr;
+		ctrl_msg_len = sizeof(ctrl_msg->hdr);
+		remote_addr += offsetof(nccl_net_ofi_ctrl_msg_t, hdr);
+	}
+
+	if (ofi_nccl_rdma_compact_ctrl_msg() && ctrl_msg_len <= max_write_inline_size) {
+		/* Inline writes neither need a registered buffer nor
+		 * generate a completion */
+		rc = fi_inject_write(comm_rail->local_ep, buf, ctrl_msg_len,
+				     comm_rail->remote_addr, remote_addr,
+				     r_comm->remote_mr_key[rail_id]);
+		if (rc == 0) {
+			trace_write_ctrl_start(req, rail_id);
+			rc = set_write_ctrl_batch_completed(req, rail_id);
+		} else if (rc != -FI_EAGAIN) {
+			NCCL_OFI_WARN("Error posting inline RDMA ctrl write. RC: %zd, Error: %s",
+				      rc, fi_strerror(-rc));
+		}
+	} else {
+		void *desc = fi_mr_desc(r_comm->ctrl_mr_handle->mr[rail_id].get());
+		rc = fi_write(comm_rail->local_ep, buf, ctrl_msg_len, desc,
+			      comm_rail->remote_addr, remote_addr,
+			      r_comm->remote_mr_key[rail_id], rdma_req_get_ofi_context(req, rail_id));
+		if (rc == 0) {
+			trace_write_ctrl_start(req, rail_id);
+		}
+	}
+	if (rc == -FI_EAGAIN) {
+		rail_notify_eagain(ep, rail_id);
 	}
 
 	if (schedule) {
@@ -5194,6 +6430,46 @@ static int post_close_msg(nccl_net_ofi_rdma_req *req)
 	return rc;
 }
 
+/*
+ * @brief	Copy eager data into the receive buffer with the CPU
+ *
+ * Host buffers are copied with memcpy, and small messages into CUDA
+ * buffers mapped for device copies with the device copy context.
+ *
+ * @return	true, if the data was copied
+ *		false, if the data must be copied with an RDMA read
+ */
+static inline bool eager_copy_cpu(nccl_net_ofi_rdma_recv_comm *r_comm,
+				  rdma_req_recv_data_t *recv_data,
+				  const void *rx_buff, size_t len)
+{
+	nccl_net_ofi_rdma_mr_handle_t *dest_mr_handle = recv_data->dest_mr_handle;
+
+	if (dest_mr_handle->type == NCCL_PTR_HOST) {
+		if (!ofi_nccl_eager_host_copy()) {
+			return false;
+		}
+		memcpy(recv_data->dst_buff, rx_buff, len);
+		return true;
+	}
+
+	if (dest_mr_handle->device_copy_handle == NULL ||
+	    len > ofi_nccl_eager_device_copy_max_size()) {
+		return false;
+	}
+
+	nccl_net_ofi_rdma_ep_t *ep = (nccl_net_ofi_rdma_ep_t *)r_comm->ep.get();
+	nccl_ofi_device_copy *device_copy = ep->rdma_endpoint_get_domain()->device_copy;
+	size_t offset = (uintptr_t)recv_data->dst_buff - dest_mr_handle->device_copy_base;
+	int ret = device_copy->copy_to_device(rx_buff, *dest_mr_handle->device_copy_handle,
+					      offset, len);
+	if (OFI_UNLIKELY(ret != 0)) {
+		NCCL_OFI_TRACE(NCCL_NET, "Device copy failed (%d), using RDMA read", ret);
+		return false;
+	}
+	return true;
+}
+
 static int post_eager_copy(nccl_net_ofi_rdma_req *req)
 {
 	nccl_net_ofi_rdma_recv_comm *r_comm = (nccl_net_ofi_rdma_recv_comm *)req->comm;
@@ -5208,6 +6484,14 @@ static int post_eager_copy(nccl_net_ofi_rdma_req *req)
 		rx_buff_data->recv_len = recv_data->dst_len;
 	}
 
+	void *rx_buff = rx_buff_data->rx_buff_fl_elem->ptr;
+
+	/* Copy with the CPU when possible, avoiding a loopback read
+	   through the NIC. The copy completes immediately. */
+	if (eager_copy_cpu(r_comm, recv_data, rx_buff, rx_buff_data->recv_len)) {
+		return set_eager_copy_completed(req);
+	}
+
 	// Get communicator rail information to xfer the req
 	nccl_net_ofi_rdma_recv_comm_rail_t *comm_rail;
 	uint16_t rx_rail_id = rx_buff_data->rail->rail_id;
@@ -5223,7 +6507,6 @@ static int post_eager_copy(nccl_net_ofi_rdma_req *req)
 	assert(rx_rail_id < dest_mr_handle->num_rails);
 	void *desc = fi_mr_desc(dest_mr_handle->mr[rx_rail_id].get());
 
-	void *rx_buff = rx_buff_data->rx_buff_fl_elem->ptr;
 	uint64_t rx_key = fi_mr_key(rx_mr_handle->mr[rx_rail_id].get());
 	if (rx_key == FI_KEY_NOTAVAIL) {
 		NCCL_OFI_WARN("Failed to get rx_key");
@@ -5367,10 +6650,7 @@ static inline int check_post_rx_buff_req(nccl_net_ofi_rdma_req *rx_buff_req)
 		ret = send_progress(rx_buff_req);
 		if (ret == -FI_EAGAIN) {
 			/* Place in pending requests queue for next try */
-			nccl_net_ofi_mutex_lock(&ep->pending_reqs_lock);
-			ep->pending_reqs_queue.push_back(rx_buff_req);
-			nccl_net_ofi_mutex_unlock(&ep->pending_reqs_lock);
-			NCCL_OFI_TRACE_PENDING_INSERT(rx_buff_req);
+			ep->add_pending_req(rx_buff_req);
 
 			return 0;
 		} else if (OFI_UNLIKELY(ret != 0)) {
@@ -5404,22 +6684,26 @@ int nccl_net_ofi_rdma_send_comm::send(void *data, size_t size, int tag,
 	nccl_net_ofi_rdma_domain_t *domain = NULL;
 	nccl_net_ofi_rdma_req *req = NULL;
 	uint16_t msg_seq_num = s_comm->next_msg_seq_num;
+	uint16_t group_size = 1;
 	bool have_ctrl = false;
 	bool eager = false;
+	ssize_t eager_send_size;
 
 	assert(s_comm != NULL);
 
+	std::lock_guard commlock(s_comm->comm_lock);
+
 	if (s_comm->comm_active == false) {
 		NCCL_OFI_WARN("Called isend on inactive communicator");
 		ret = -EINVAL;
 		return ret;
 	}
 
-	/* Support only NCCL_OFI_MAX_REQUESTS inflight requests. */
-	if (OFI_UNLIKELY(s_comm->num_inflight_reqs == NCCL_OFI_MAX_SEND_REQUESTS)) {
+	/* Support only rdma_max_send_requests() inflight requests. */
+	if (OFI_UNLIKELY(s_comm->num_inflight_reqs == rdma_max_send_requests())) {
 		ret = -EINVAL;
-		NCCL_OFI_WARN("Can not support more than %d inflight requests",
-			      NCCL_OFI_MAX_SEND_REQUESTS);
+		NCCL_OFI_WARN("Can not support more than %u inflight requests",
+			      rdma_max_send_requests());
 		return ret;
 	}
 
@@ -5429,7 +6713,7 @@ int nccl_net_ofi_rdma_send_comm::send(void *data, size_t size, int tag,
 	domain = endpoint->rdma_endpoint_get_domain();
 	assert(domain != NULL);
 
-	std::lock_guard eplock(endpoint->ep_lock);
+	std::unique_lock eplock(endpoint->ep_lock);
 
 	CHECK_ENDPOINT_ACTIVE(endpoint, "send");
 
@@ -5463,22 +6747,49 @@ int nccl_net_ofi_rdma_send_comm::send(void *data, size_t size, int tag,
 
 	have_ctrl = has_ctrl_msg(s_comm, msg_seq_num);
 
+	if (s_comm->eager_threshold) {
+		s_comm->eager_threshold->report_attempt(have_ctrl);
+		eager_send_size = s_comm->eager_threshold->threshold();
+	} else {
+		eager_send_size = endpoint->eager_send_size;
+	}
+
 	/* Determine if this should be sent eagerly. */
-	if (!have_ctrl && (ssize_t)size <= endpoint->eager_send_size && s_comm->num_inflight_writes == 0) {
+	if (!have_ctrl && (ssize_t)size <= eager_send_size && s_comm->num_inflight_writes == 0) {
 		eager = true;
 	}
 
 	/* Check if the control message for the next message is present */
 	if (!have_ctrl) {
 		if (!eager) {
+			/* The receiver may itself wait for control messages
+			 * of this endpoint held back for batching */
+			ret = endpoint->flush_ctrl_batches();
 			*base_req = NULL;
-			ret = 0;
 			goto error;
 		}
 	} else {
 		/* Memory synchronization point to ensure that the data in the control msg is not
 		 * read before the sequence number is checked */
 		std::atomic_thread_fence(std::memory_order_acquire);
+
+		group_size = ctrl_msg_group_size(&s_comm->ctrl_mailbox[msg_seq_num % NCCL_OFI_CTRL_MAILBOX_SIZE]);
+		if (group_size > 1) {
+			if (OFI_UNLIKELY(group_size > NCCL_OFI_MAX_RECVS)) {
+				NCCL_OFI_WARN("Invalid grouped receive size %hu", group_size);
+				ret = -EINVAL;
+				goto error;
+			}
+
+			/* Send to the buffer of the grouped receive with our tag */
+			int matched_seq_num = match_group_recv(s_comm, group_size, tag);
+			if (matched_seq_num < 0) {
+				ret = endpoint->flush_ctrl_batches();
+				*base_req = NULL;
+				goto error;
+			}
+			msg_seq_num = (uint16_t)matched_seq_num;
+		}
 		s_comm->n_ctrl_received += 1;
 	}
 
@@ -5509,21 +6820,41 @@ int nccl_net_ofi_rdma_send_comm::send(void *data, size_t size, int tag,
 
 	if (!eager) {
 		(s_comm->num_inflight_writes)++;
+	} else if (s_comm->eager_threshold) {
+		get_send_data(req)->eager_post_ns = s_comm->eager_threshold->now();
 	}
 
 	NCCL_OFI_TRACE_SEND(req->dev_id, size, s_comm, msg_seq_num, req, base_req);
 
+	/* The eager threshold is shared with the completion handlers */
+	if (s_comm->eager_threshold) {
+		s_comm->eager_threshold->report_posted();
+	}
+
 	/* Try posting RDMA write for received RDMA control messages */
 	if (have_ctrl || eager) {
-
-		ret = send_progress(req);
+		if (thread_safe_domain) {
+			/* The provider serializes the operations, and the
+			 * completion handlers of the operations already
+			 * posted only update the completion count and state
+			 * of the request, so the endpoint lock is released
+			 * while posting. It is taken again to queue the
+			 * request if the provider is busy. */
+			eplock.unlock();
+			ret = post_send_req(req);
+			if (ret != 0) {
+				eplock.lock();
+				if (ret == -FI_EAGAIN) {
+					rail_notify_eagain(endpoint, pending_req_rail_id(req));
+				}
+			}
+		} else {
+			ret = send_progress(req);
+		}
 		if (ret == -FI_EAGAIN) {
 			/* Add to pending reqs queue */
-			nccl_net_ofi_mutex_lock(&endpoint->pending_reqs_lock);
-			endpoint->pending_reqs_queue.push_back(req);
-			nccl_net_ofi_mutex_unlock(&endpoint->pending_reqs_lock);
+			endpoint->add_pending_req(req);
 			ret = 0;
-			NCCL_OFI_TRACE_PENDING_INSERT(req);
 		} else if (OFI_UNLIKELY(ret != 0)) {
 			/* TODO: Remove req from message buffer */
 			ret = -ENOTSUP;
@@ -5533,8 +6864,17 @@ int nccl_net_ofi_rdma_send_comm::send(void *data, size_t size, int tag,
 
 	/* Return request to NCCL */
 	*base_req = req;
-	/* Increment next_msg_seq_num for next call */
-	s_comm->next_msg_seq_num = (s_comm->next_msg_seq_num + 1) & MSG_SEQ_NUM_MASK;
+	/* Increment next_msg_seq_num for next call, once all buffers of a
+	 * grouped receive are matched */
+	if (group_size > 1) {
+		uint16_t group_idx = (msg_seq_num - s_comm->next_msg_seq_num) & MSG_SEQ_NUM_MASK;
+		s_comm->group_matched_mask |= 1U << group_idx;
+		if (s_comm->group_matched_mask != (1U << group_size) - 1) {
+			goto exit;
+		}
+		s_comm->group_matched_mask = 0;
+	}
+	s_comm->next_msg_seq_num = (s_comm->next_msg_seq_num + group_size) & MSG_SEQ_NUM_MASK;
 
 	goto exit;
 
@@ -5610,6 +6950,7 @@ void nccl_net_ofi_rdma_ep_t::prepare_send_connect_message(uint32_t local_comm_id
 	/* Set number of rails to be sent back to remote for verification */
 	conn_msg->num_rails = this->num_rails;
 	conn_msg->num_control_rails = this->num_control_rails;
+	conn_msg->max_group_receives = (uint16_t)rdma_max_group_receives();
 
 	/* Set libfabric endpoint names for each control rail */
 	for (uint16_t rail_id = 0; rail_id != this->num_control_rails; ++rail_id) {
@@ -5645,6 +6986,7 @@ nccl_net_ofi_rdma_send_comm::nccl_net_ofi_rdma_send_comm()
 	local_comm_id = 0;
 	remote_comm_id = 0;
 	next_msg_seq_num = 0;
+	group_matched_mask = 0;
 	num_rails = 0;
 	num_control_rails = 0;
 	received_close_message = false;
@@ -5656,6 +6998,8 @@ nccl_net_ofi_rdma_send_comm::nccl_net_ofi_rdma_send_comm()
 	connector = nullptr;
 	ctrl_mailbox = nullptr;
 	ctrl_mr_handle = nullptr;
+	ctrl_key_table = {};
+	eager_threshold = nullptr;
 
 	const size_t ctrl_mailbox_size = sizeof(nccl_net_ofi_ctrl_msg_t) * NCCL_OFI_CTRL_MAILBOX_SIZE;
 	ctrl_mailbox = (nccl_net_ofi_ctrl_msg_t *)aligned_alloc(system_page_size, ctrl_mailbox_size);
@@ -5667,6 +7011,64 @@ nccl_net_ofi_rdma_send_comm::nccl_net_ofi_rdma_send_comm()
 }
 
 
+/*
+ * @brief	Start the rx buffer window of a rail at the floor, if
+ *		autoscaling, with the static bounds of the rail as the ceiling
+ *		and low watermark
+ */
+static void init_rx_window(nccl_net_ofi_rdma_ep_rail_t *rail, uint16_t num_rails)
+{
+	if (!ofi_nccl_rdma_rx_buff_autoscale() || rail->max_rx_buff_posted == 0) {
+		return;
+	}
+
+	size_t window_floor = std::max(NCCL_OFI_DIV_CEIL(ofi_nccl_rdma_rx_buff_window_floor(), num_rails),
+				       (size_t)1);
+	rail->rx_window = std::make_unique<nccl_ofi_rx_window>(
+		window_floor, rail->max_rx_buff_posted, rail->min_rx_buff_posted,
+		(uint64_t)ofi_nccl_rdma_rx_buff_window_epoch_us() * 1000);
+	rail->max_rx_buff_posted = rail->rx_window->size();
+	rail->min_rx_buff_posted = rail->rx_window->low_watermark();
+}
+
+
+/*
+ * @brief	Report the statistics of an endpoint freelist
+ */
+static void report_freelist(const nccl_ofi_freelist *fl, const char *kind)
+{
+	nccl_ofi_freelist::stats stats;
+
+	fl->get_stats(&stats);
+	NCCL_OFI_INFO(NCCL_NET,
+		      "%s freelist: %zu entries (peak %zu), %zu in use (peak %zu), %zu bytes (peak %zu), "
+		      "%zu blocks of %zu entries trimmed",
+		      kind, stats.num_allocated_entries, stats.peak_allocated_entries,
+		      stats.num_in_use_entries, stats.peak_in_use_entries, stats.memory_size,
+		      stats.peak_memory_size, stats.num_trimmed_blocks, stats.num_trimmed_entries);
+}
+
+
+/*
+ * @brief	Report the rx buffer window statistics of a rail
+ */
+static void report_rx_window(nccl_net_ofi_rdma_ep_rail_t *rail, const char *kind)
+{
+	const nccl_ofi_rx_window *window = rail->rx_window.get();
+	if (window == nullptr || window->num_consumed == 0) {
+		return;
+	}
+
+	NCCL_OFI_INFO(NCCL_NET,
+		      "Rail %u %s rx buffers: window %zu (peak %zu), %" PRIu64
+		      " consumed (%.0f/s in the last epoch), %" PRIu64 " underruns, %" PRIu64
+		      " grows, %" PRIu64 " shrinks",
+		      rail->rail_id, kind, window->size(), window->peak_size(),
+		      window->num_consumed, window->consume_rate(), window->num_underruns,
+		      window->num_grows, window->num_shrinks);
+}
+
+
 int nccl_net_ofi_rdma_ep_t::init_rx_buffers()
 {
 	int ret = 0;
@@ -5680,11 +7082,13 @@ int nccl_net_ofi_rdma_ep_t::init_rx_buffers()
 	const bool enable_freelist_leak_detection = false;
 
 	/* We maintain this for only connection close messages */
-	this->rx_buff_reqs_fl = new nccl_ofi_freelist(sizeof(nccl_net_ofi_rdma_req),
-						      ofi_nccl_rdma_min_posted_control_buffers(), 16, 0,
-						      rdma_fl_req_entry_init, rdma_fl_req_entry_fini,
-						      "Rx Buffer Requests",
-						      enable_freelist_leak_detection);
+	this->rx_buff_reqs_fl = new nccl_ofi_freelist_mt(sizeof(nccl_net_ofi_rdma_req),
+							 ofi_nccl_rdma_min_posted_control_buffers(), 16, 0,
+							 RDMA_REQ_FL_MAGAZINE_SIZE,
+							 rdma_fl_req_entry_init, NULL,
+							 "Rx Buffer Requests",
+							 enable_freelist_leak_detection,
+							 alignof(nccl_net_ofi_rdma_req));
 
 	this->ctrl_rx_buff_fl = new nccl_ofi_freelist(this->ctrl_rx_buff_size,
 						      ofi_nccl_rdma_min_posted_control_buffers(), 16, 0,
@@ -5720,7 +7124,9 @@ int nccl_net_ofi_rdma_ep_t::init_rx_buffers()
 		rail->max_rx_buff_posted = NCCL_OFI_DIV_CEIL(
 			ofi_nccl_rdma_max_posted_control_buffers(), this->num_control_rails
 		);
+		init_rx_window(rail, this->num_control_rails);
 		rail->num_rx_buff_posted = 0;
+		rail->rx_buff_trim_pending = false;
 		nccl_net_ofi_mutex_init(&rail->rx_buff_mutex, NULL);
 		rail->rx_buff_req_alloc = ctrl_rx_buff_req_alloc;
 	}
@@ -5734,11 +7140,13 @@ int nccl_net_ofi_rdma_ep_t::init_rx_buffers()
 			rail->max_rx_buff_posted = NCCL_OFI_DIV_CEIL(
 				ofi_nccl_rdma_max_posted_eager_buffers(), this->num_rails
 				);
+			init_rx_window(rail, this->num_rails);
 		} else {
 			rail->min_rx_buff_posted = 0;
 			rail->max_rx_buff_posted = 0;
 		}
 		rail->num_rx_buff_posted = 0;
+		rail->rx_buff_trim_pending = false;
 		nccl_net_ofi_mutex_init(&rail->rx_buff_mutex, NULL);
 		rail->rx_buff_req_alloc = eager_rx_buff_req_alloc;
 	}
@@ -5752,21 +7160,28 @@ int nccl_net_ofi_rdma_ep_t::fini_rx_buffers()
 	int ret = 0;
 	nccl_net_ofi_rdma_ep_rail_t *rail;
 
+	report_freelist(this->ctrl_rx_buff_fl, "Ctrl rx buffer");
 	delete this->ctrl_rx_buff_fl;
 
 	if (this->eager_rx_buff_fl != NULL) {
+		report_freelist(this->eager_rx_buff_fl, "Eager rx buffer");
 		delete this->eager_rx_buff_fl;
 	}
 
+	report_freelist(this->rx_buff_reqs_fl, "Rx buffer request");
 	delete this->rx_buff_reqs_fl;
 
 	for (uint16_t rail_id = 0; rail_id < this->num_rails; ++rail_id) {
 		rail = this->rdma_endpoint_get_rail(rail_id);
+		report_rx_window(rail, "eager");
+		rail->rx_window.reset();
 		nccl_net_ofi_mutex_destroy(&rail->rx_buff_mutex);
 	}
 
 	for (uint16_t rail_id = 0; rail_id < this->num_control_rails; ++rail_id) {
 		rail = this->rdma_endpoint_get_control_rail(rail_id);
+		report_rx_window(rail, "control");
+		rail->rx_window.reset();
 		nccl_net_ofi_mutex_destroy(&rail->rx_buff_mutex);
 	}
 
@@ -5802,17 +7217,19 @@ static int rma_write_impl(nccl_net_ofi_send_comm *send_comm, void* src, size_t s
 
 	assert(s_comm != NULL);
 
+	std::lock_guard commlock(s_comm->comm_lock);
+
 	if (s_comm->comm_active == false) {
 		NCCL_OFI_WARN("Called iwrite on inactive communicator");
 		*base_req = NULL;
 		return -EINVAL;
 	}
 
-	/* Support only NCCL_OFI_MAX_REQUESTS inflight requests. */
-	if (OFI_UNLIKELY(s_comm->num_inflight_reqs == NCCL_OFI_MAX_SEND_REQUESTS)) {
+	/* Support only rdma_max_send_requests() inflight requests. */
+	if (OFI_UNLIKELY(s_comm->num_inflight_reqs == rdma_max_send_requests())) {
 		ret = -EINVAL;
-		NCCL_OFI_WARN("Can not support more than %d inflight requests",
-			      NCCL_OFI_MAX_SEND_REQUESTS);
+		NCCL_OFI_WARN("Can not support more than %u inflight requests",
+			      rdma_max_send_requests());
 		*base_req = NULL;
 		return ret;
 	}
@@ -5852,11 +7269,8 @@ static int rma_write_impl(nccl_net_ofi_send_comm *send_comm, void* src, size_t s
 	ret = send_progress(req);
 	if (ret == -FI_EAGAIN) {
 		/* Add to pending reqs queue */
-		nccl_net_ofi_mutex_lock(&ep->pending_reqs_lock);
-		ep->pending_reqs_queue.push_back(req);
-		nccl_net_ofi_mutex_unlock(&ep->pending_reqs_lock);
+		ep->add_pending_req(req);
 		ret = 0;
-		NCCL_OFI_TRACE_PENDING_INSERT(req);
 	} else if (OFI_UNLIKELY(ret != 0)) {
 		ret = -ENOTSUP;
 		goto error;
@@ -5937,6 +7351,11 @@ int nccl_net_ofi_rdma_ep_t::create_send_comm(nccl_net_ofi_rdma_send_comm **s_com
 	ret_s_comm->comm_active = true;
 	ret_s_comm->next_msg_seq_num = NCCL_OFI_RDMA_MSG_SEQ_NUM_START;
 
+	if (ofi_nccl_eager_adaptive() && this->eager_send_size >= 0) {
+		ret_s_comm->eager_threshold = new nccl_ofi_eager_threshold(this->eager_send_size,
+									   this->eager_threshold_max_size);
+	}
+
 	/* The connect() API function acquired the endpoint we are using via
 	   get_ep(). Store shared_ptr in the comm to keep ep alive. */
 	ret_s_comm->ep = shared_from_this();
@@ -5958,11 +7377,12 @@ int nccl_net_ofi_rdma_ep_t::create_send_comm(nccl_net_ofi_rdma_send_comm **s_com
 	ret_s_comm->num_control_rails = num_control_rails;
 
 	/* Allocate request free list */
-	ret_s_comm->nccl_ofi_reqs_fl = new nccl_ofi_freelist(sizeof(nccl_net_ofi_rdma_req), 16, 16,
-							     NCCL_OFI_MAX_SEND_REQUESTS,
-							     rdma_fl_req_entry_init, rdma_fl_req_entry_fini,
-							     "Send Communicator Requests",
-							     true);
+	ret_s_comm->nccl_ofi_reqs_fl = new nccl_ofi_freelist_mt(sizeof(nccl_net_ofi_rdma_req), 16, 16,
+								RDMA_REQ_FL_MAX_ENTRIES(rdma_max_send_requests()),
+								RDMA_REQ_FL_MAGAZINE_SIZE,
+								rdma_fl_req_entry_init, NULL,
+								"Send Communicator Requests",
+								true, alignof(nccl_net_ofi_rdma_req));
 
 	/* Allocate control mailbox */
 	ret = domain_ptr->reg_internal_mr(ret_s_comm->ctrl_mailbox, sizeof(nccl_net_ofi_ctrl_msg_t) * NCCL_OFI_CTRL_MAILBOX_SIZE,
@@ -6219,7 +7639,7 @@ int nccl_net_ofi_rdma_ep_t::init_rail_ofi_resources(nccl_net_ofi_rdma_device_t *
 		struct fi_cq_attr cq_attr = {};
 		cq_attr.format = FI_CQ_FORMAT_DATA;
 		cq_attr.size = ofi_nccl_cq_size();
-		auto cq_result = nccl_ofi_ofiutils_cq_create(domain_rail->domain, &cq_attr);
+		auto cq_result = nccl_ofi_ofiutils_cq_create_waitable(domain_rail->domain, &cq_attr);
 		if (OFI_UNLIKELY(cq_result.is_failure())) {
 			NCCL_OFI_WARN("Couldn't open CQ. RC: %d, ERROR: %s",
 				      cq_result.error_code, fi_strerror(-cq_result.error_code));
@@ -6228,6 +7648,23 @@ int nccl_net_ofi_rdma_ep_t::init_rail_ofi_resources(nccl_net_ofi_rdma_device_t *
 
 		cq_rail->rail_id = rail_id;
 		cq_rail->cq = std::move(cq_result.resource);
+
+		/* Blocking needs the wait objects of the queues of all rails */
+		if (this->cq_wait) {
+			ret = -FI_ENOSYS;
+			if (cq_attr.wait_obj == FI_WAIT_FD) {
+				ret = this->cq_wait->add_cq(device->rdma_device_get_rail(rail_id)->fabric.get(),
+							    cq_rail->cq.get());
+			}
+			if (ret != 0) {
+				NCCL_OFI_INFO(NCCL_INIT | NCCL_NET,
+					      "No wait object on the CQ of rail %u, spinning instead. RC: %d",
+					      rail_id, ret);
+				delete this->cq_wait;
+				this->cq_wait = nullptr;
+				ret = 0;
+			}
+		}
 	}
 
 	/* Initialize libfabric resources of endpoint rails */
@@ -6269,6 +7706,11 @@ nccl_net_ofi_rdma_ep_t::~nccl_net_ofi_rdma_ep_t()
 {
 	nccl_net_ofi_rdma_device_t *device = this->rdma_endpoint_get_device();
 
+	if (device->progress_thread) {
+		device->progress_thread->remove(this);
+		this->progress_thread_owned = false;
+	}
+
 	if (this->cm) {
 		delete this->cm;
 		this->cm = nullptr;
@@ -6279,6 +7721,34 @@ nccl_net_ofi_rdma_ep_t::~nccl_net_ofi_rdma_ep_t()
 		this->scheduler = nullptr;
 	}
 
+	if (this->rail_health) {
+		delete this->rail_health;
+		this->rail_health = nullptr;
+	}
+
+	if (this->cq_poller) {
+		for (uint16_t rail_id = 0; rail_id < this->num_rails; rail_id++) {
+			const nccl_ofi_cq_poller::rail &r = this->cq_poller->rails[rail_id];
+			if (r.num_reads == 0) {
+				continue;
+			}
+			NCCL_OFI_INFO(NCCL_NET,
+				      "Rail %u CQ: %" PRIu64 " completions in %" PRIu64
+				      " reads (%.2f per read), %" PRIu64 " empty reads, %" PRIu64
+				      " polls stopped by the budget",
+				      rail_id, r.num_compls, r.num_reads,
+				      (double)r.num_compls / r.num_reads, r.num_empty_reads,
+				      r.num_budget_stops);
+		}
+		delete this->cq_poller;
+		this->cq_poller = nullptr;
+	}
+
+	if (this->cq_wait) {
+		delete this->cq_wait;
+		this->cq_wait = nullptr;
+	}
+
 	/* Ideally we would "un-post" the rx buffers, but this
 	 * should be accomplished by closing the endpoint. */
 	this->release_rdma_ep_resources(device->dev_id);
@@ -6346,6 +7816,35 @@ std::shared_ptr<nccl_net_ofi_ep_t> nccl_net_ofi_rdma_domain_t::create_endpoint()
 }
 
 
+/*
+ * @brief	Make progress on an endpoint from the progress thread
+ *
+ * Skips the endpoint if an application thread holds it or waits for it.
+ * If processing fails, the endpoint is left to application threads.
+ *
+ * @return	number of completions processed, or negative errno
+ */
+static int rdma_ep_progress(void *ctx)
+{
+	nccl_net_ofi_rdma_ep_t *ep = (nccl_net_ofi_rdma_ep_t *)ctx;
+	int ret = 0;
+
+	if (ep->ep_lock.has_waiters() || !ep->ep_lock.trylock()) {
+		return 0;
+	}
+	if (ep->ep_active) {
+		ret = ep->ofi_process_cq();
+		if (ret == 0) {
+			ret = (int)ep->cq_poller->num_poll_compls();
+		} else {
+			ep->progress_thread_owned = false;
+		}
+	}
+	ep->ep_lock.unlock();
+
+	return ret;
+}
+
 nccl_net_ofi_rdma_ep_t::nccl_net_ofi_rdma_ep_t(std::shared_ptr<nccl_net_ofi_rdma_domain_t> domain_arg)
 	: nccl_net_ofi_ep_t(domain_arg)
 {
@@ -6375,6 +7874,17 @@ nccl_net_ofi_rdma_ep_t::nccl_net_ofi_rdma_ep_t(std::shared_ptr<nccl_net_ofi_rdma
 
 	this->cq_rails.resize(this->num_rails);
 
+	this->pending_reqs_queues.resize(this->num_rails);
+
+	this->cq_poller = new nccl_ofi_cq_poller(this->num_rails, cq_read_count,
+						 ofi_nccl_cq_read_max_count(),
+						 ofi_nccl_cq_poll_budget());
+
+	if (ofi_nccl_cq_wait()) {
+		this->cq_wait = new nccl_ofi_cq_wait(ofi_nccl_cq_wait_spin_us() * 1000ULL,
+						     ofi_nccl_cq_wait_timeout_ms());
+	}
+
 	ret = nccl_net_ofi_mutex_init(&this->pending_reqs_lock, NULL);
 	if (ret != 0) {
 		NCCL_OFI_WARN("Mutex initialization failed: %s", strerror(ret));
@@ -6384,11 +7894,23 @@ nccl_net_ofi_rdma_ep_t::nccl_net_ofi_rdma_ep_t(std::shared_ptr<nccl_net_ofi_rdma
 	this->ctrl_rx_buff_size = std::max({sizeof(nccl_ofi_rdma_connection_info_t),
 				      sizeof(nccl_net_ofi_rdma_close_msg_t)});
 	this->eager_send_size = ofi_nccl_eager_max_size();
+	if (rdma_max_group_receives() > 1 && this->eager_send_size >= 0) {
+		/* Eager messages do not carry a tag, so the sender could not
+		   match them to the buffers of a grouped receive */
+		NCCL_OFI_INFO(NCCL_INIT | NCCL_NET,
+			      "Disabling eager messages, as grouped receives are enabled");
+		this->eager_send_size = -1;
+	}
+	this->eager_threshold_max_size = this->eager_send_size;
+	if (ofi_nccl_eager_adaptive() && this->eager_send_size >= 0) {
+		this->eager_threshold_max_size = std::max(this->eager_send_size,
+							  (ssize_t)ofi_nccl_eager_adaptive_max_size());
+	}
 	/* Work around EFA provider bug around posting 0 byte rx buffers by not
 	   posting 0 byte rx buffers.  Note that if eager_send_size is -1
 	   (disabled), eager_rx_buff_size will also be -1. */
-	this->eager_rx_buff_size = (this->eager_send_size == 0) ?
-		EAGER_RX_BUFFER_ALIGNMENT : this->eager_send_size;
+	this->eager_rx_buff_size = (this->eager_threshold_max_size == 0) ?
+		EAGER_RX_BUFFER_ALIGNMENT : this->eager_threshold_max_size;
 
 	ret = this->init_rail_ofi_resources(device, domain_arg.get());
 	if (ret != 0) {
@@ -6406,12 +7928,32 @@ nccl_net_ofi_rdma_ep_t::nccl_net_ofi_rdma_ep_t(std::shared_ptr<nccl_net_ofi_rdma
 		(*domain_arg, *this, sizeof(nccl_ofi_rdma_connection_info_t));
 
 	/* Create scheduler */
-	this->scheduler = new nccl_net_ofi_threshold_scheduler(this->num_rails);
+	if (ofi_nccl_scheduler() == SCHEDULER::ADAPTIVE) {
+		this->scheduler = new nccl_net_ofi_adaptive_scheduler(this->num_rails);
+	} else {
+		this->scheduler = new nccl_net_ofi_threshold_scheduler(this->num_rails);
+	}
+
+	if (ofi_nccl_rail_health()) {
+		this->rail_health = new nccl_ofi_rail_health(this->num_rails);
+	}
+
+	if (device->progress_thread) {
+		this->progress_thread_owned = true;
+		device->progress_thread->add(this, rdma_ep_progress);
+	}
 }
 
 
 nccl_net_ofi_rdma_domain_t::~nccl_net_ofi_rdma_domain_t()
 {
+	if (this->mr_cache) {
+		pthread_wrapper mr_cache_lock(&this->mr_cache->lock);
+		if (nccl_ofi_mr_cache_purge_idle(this->mr_cache) != 0) {
+			NCCL_OFI_WARN("Failed to deregister idle MR cache entries");
+		}
+	}
+
 	int err_code = this->dealloc_and_dereg_flush_buff();
 	if (err_code != 0) {
 		NCCL_OFI_WARN("Failed to deregister flush buffer pool");
@@ -6443,6 +7985,29 @@ nccl_net_ofi_rdma_domain_t::nccl_net_ofi_rdma_domain_t(nccl_net_ofi_rdma_device_
 	}
 
 	this->num_rails = device_arg->num_rails;
+	this->device_copy = NULL;
+
+#if HAVE_CUDA
+	if (ofi_nccl_eager_device_copy_max_size() != 0) {
+		try {
+			this->device_copy = &get_device_copy();
+		} catch (const std::exception &e) {
+			NCCL_OFI_INFO(NCCL_INIT | NCCL_NET,
+				      "Eager copies into CUDA buffers use RDMA reads: %s", e.what());
+		}
+	}
+#endif
+
+	if (this->mr_cache && ofi_nccl_mr_cache_lazy_dereg()) {
+		nccl_ofi_mr_cache_enable_lazy_dereg(this->mr_cache,
+						    ofi_nccl_mr_cache_max_idle_entries(),
+						    ofi_nccl_mr_cache_max_idle_size(),
+						    mr_cache_dereg_fn, this);
+	}
+
+	if (this->mr_cache && ofi_nccl_mr_cache_merge_max_size() != 0) {
+		nccl_ofi_mr_cache_enable_merge(this->mr_cache, ofi_nccl_mr_cache_merge_max_size());
+	}
 
 	for (uint16_t i = 0; i < this->num_rails ; i++) {
 		nccl_net_ofi_rdma_device_rail_t *device_rail = device_arg->rdma_device_get_rail(i);
@@ -6563,6 +8128,11 @@ nccl_net_ofi_rdma_device_t::~nccl_net_ofi_rdma_device_t()
 	}
 	this->release_all_domain_and_ep();
 
+	if (this->progress_thread) {
+		delete this->progress_thread;
+		this->progress_thread = nullptr;
+	}
+
 #if HAVE_NVTX_TRACING
 	if (ofi_nccl_nvtx_trace_dimension() == NVTX_TRACE_DIMENSION::PER_DEV) {
 		for (int i = 0; i < this->num_rails; ++i) {
@@ -6575,6 +8145,35 @@ nccl_net_ofi_rdma_device_t::~nccl_net_ofi_rdma_device_t()
 }
 
 
+/*
+ * @brief	Choose the CPU of the progress thread of a device
+ *
+ * @return	CPU, or -1 to not pin the thread
+ */
+static int rdma_progress_thread_cpu(int dev_id, nccl_ofi_topo_t *topo, struct fi_info *info)
+{
+	cpu_set_t cpus;
+
+	if (ofi_nccl_progress_thread_cpu() >= 0) {
+		return ofi_nccl_progress_thread_cpu();
+	}
+
+	CPU_ZERO(&cpus);
+	if (nccl_ofi_topo_get_local_cpus(topo, info, &cpus) != 0) {
+		return -1;
+	}
+
+	/* Devices sharing CPUs take different ones from the end */
+	int skip = dev_id % CPU_COUNT(&cpus);
+	for (int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+		if (CPU_ISSET(cpu, &cpus) && skip-- == 0) {
+			return cpu;
+		}
+	}
+
+	return -1;
+}
+
 /**
  * Create an rdma device object
  */
@@ -6649,6 +8248,14 @@ nccl_net_ofi_rdma_device_t::nccl_net_ofi_rdma_device_t(nccl_net_ofi_plugin_t *pl
 		NCCL_OFI_INFO(NCCL_INIT | NCCL_NET, "Created device with %zu rails", length);
 	}
 
+	/* Allocate resources of the device close to its NICs */
+	this->numa_node = nccl_ofi_topo_get_numa_node(topo, info_list);
+	if (this->numa_node != NCCL_OFI_NUMA_NODE_ANY) {
+		NCCL_OFI_INFO(NCCL_INIT | NCCL_NET, "Device %d is local to NUMA node %d",
+			      device_id, this->numa_node);
+	}
+	nccl_ofi_numa_scope numa_scope(this->numa_node);
+
 	/* Set NIC information */
 	this->num_rails = length;
 
@@ -6669,6 +8276,16 @@ nccl_net_ofi_rdma_device_t::nccl_net_ofi_rdma_device_t(nccl_net_ofi_plugin_t *pl
 		throw std::runtime_error("RDMA device constructor: connection prep failed");
 	}
 
+	if (ofi_nccl_progress_thread()) {
+		int cpu = rdma_progress_thread_cpu(device_id, topo, info_list);
+
+		this->progress_thread = new nccl_ofi_progress_thread(
+			cpu, ofi_nccl_progress_thread_spin_count(),
+			ofi_nccl_progress_thread_max_sleep_us() * 1000ULL);
+		NCCL_OFI_INFO(NCCL_INIT | NCCL_NET, "Started progress thread for device %d on CPU %d",
+			      device_id, cpu);
+	}
+
 	/* NVTX domain */
 #if HAVE_NVTX_TRACING
 	if (ofi_nccl_nvtx_trace_dimension() == NVTX_TRACE_DIMENSION::PER_DEV) {
@@ -6706,7 +8323,8 @@ static void get_hints(struct fi_info *hints)
 	hints->domain_attr->mr_mode = FI_MR_LOCAL | FI_MR_HMEM | FI_MR_VIRT_ADDR |
 		FI_MR_ALLOCATED | FI_MR_PROV_KEY;
 	hints->domain_attr->mr_key_size = (size_t) ofi_nccl_mr_key_size();
-	hints->domain_attr->threading = FI_THREAD_COMPLETION;
+	hints->domain_attr->threading = ofi_nccl_rdma_thread_safe_domain() ?
+		FI_THREAD_SAFE : FI_THREAD_COMPLETION;
 
 	/* We hard poll for completion, but if a provider is faster with async
 	 * progress, then we don't really care and should let it do that. At
@@ -6901,6 +8519,18 @@ int nccl_net_ofi_rdma_init(const char *provider_filter,
 		return -ENOTSUP;
 	}
 
+	if ((ssize_t)ofi_nccl_eager_adaptive_max_size() > (ssize_t)ofi_nccl_min_stripe_size()) {
+		NCCL_OFI_WARN("Invalid value for EAGER_ADAPTIVE_MAX_SIZE");
+		return -ENOTSUP;
+	}
+
+	/* The progress thread drains the completion queues, so test()
+	 * would block on queues with nothing left to wake it up */
+	if (ofi_nccl_progress_thread() && ofi_nccl_cq_wait()) {
+		NCCL_OFI_WARN("CQ_WAIT is not supported with PROGRESS_THREAD; disabling CQ_WAIT");
+		ofi_nccl_cq_wait.set(false);
+	}
+
 	/* We requested 4 bytes for cq_data_size. getinfo should not have
 	   returned a provider that doesn't meet this requirement, but double
 	   check here. */
@@ -6949,6 +8579,7 @@ int nccl_net_ofi_rdma_init(const char *provider_filter,
 		return -ENOTSUP;
 	}
 	early_completion = ofi_nccl_early_completion.get();
+	thread_safe_domain = ofi_nccl_rdma_thread_safe_domain();
 
 	if (early_completion && ofi_nccl_eager_max_size() != -1) {
 		NCCL_OFI_WARN("Conflicted configuration of EARLY_COMPLETION and EAGER_MAX_SIZE");
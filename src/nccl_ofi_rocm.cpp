@@ -126,6 +126,18 @@ int nccl_net_ofi_gpu_mem_copy_host_to_device(void *dst, void *src, size_t size)
 	return ret == hipSuccess ? 0 : -EINVAL;
 }
 
+int nccl_net_ofi_gpu_get_address_range(void *ptr, uintptr_t *base, size_t *size)
+{
+	hipDeviceptr_t d_base;
+	hipError_t ret = hipMemGetAddressRange(&d_base, size, (hipDeviceptr_t)ptr);
+	if (ret != hipSuccess) {
+		return -EINVAL;
+	}
+
+	*base = (uintptr_t)d_base;
+	return 0;
+}
+
 int nccl_net_ofi_gpu_get_dma_buf_fd(void *aligned_ptr, size_t aligned_size, int *fd, size_t *offset)
 {
 #if HAVE_DECL_HIPMEMRANGEHANDLETYPEDMABUFFD
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "nccl_ofi_rx_window.h"
+
+static uint64_t steady_clock_ns(void)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+nccl_ofi_rx_window::nccl_ofi_rx_window(size_t floor_arg, size_t ceiling_arg,
+				       size_t ceiling_low_watermark_arg, uint64_t epoch_ns_arg,
+				       clock_fn_t clock_fn_arg)
+	: num_consumed(0),
+	  num_underruns(0),
+	  num_grows(0),
+	  num_shrinks(0),
+	  clock_fn(clock_fn_arg ? clock_fn_arg : steady_clock_ns),
+	  floor(std::min(floor_arg, ceiling_arg)),
+	  ceiling(ceiling_arg),
+	  ceiling_low_watermark(std::min(ceiling_low_watermark_arg, ceiling_arg)),
+	  epoch_ns(std::max(epoch_ns_arg, (uint64_t)1)),
+	  window(floor),
+	  peak_window(floor),
+	  last_rate(0),
+	  epoch_start_ns(0),
+	  epoch_consumed(0),
+	  epoch_peak_missing(0)
+{
+}
+
+size_t nccl_ofi_rx_window::low_watermark() const
+{
+	if (this->ceiling == 0) {
+		return 0;
+	}
+	/* Round up, so a rail with a small window still refills */
+	return (this->window * this->ceiling_low_watermark + this->ceiling - 1) / this->ceiling;
+}
+
+bool nccl_ofi_rx_window::report_consumed(size_t num_posted)
+{
+	size_t old_window = this->window;
+	uint64_t now_ns = this->clock_fn();
+	/* Measured against the window the buffers were posted for, before
+	 * the end of an epoch resizes it */
+	size_t num_missing = (this->window > num_posted) ? this->window - num_posted : 0;
+
+	if (this->epoch_start_ns == 0) {
+		this->epoch_start_ns = now_ns;
+	} else if (now_ns - this->epoch_start_ns >= this->epoch_ns) {
+		end_epoch(now_ns);
+	}
+
+	this->num_consumed++;
+	this->epoch_consumed++;
+	this->epoch_peak_missing = std::max(this->epoch_peak_missing, num_missing);
+
+	if (num_posted == 0) {
+		this->num_underruns++;
+		resize(std::max(this->window * 2, (size_t)1));
+	}
+
+	return this->window != old_window;
+}
+
+bool nccl_ofi_rx_window::report_idle()
+{
+	size_t old_window = this->window;
+
+	/* Nothing to shrink before the first consumption */
+	if (this->epoch_start_ns == 0) {
+		return false;
+	}
+
+	uint64_t now_ns = this->clock_fn();
+	if (now_ns - this->epoch_start_ns >= this->epoch_ns) {
+		end_epoch(now_ns);
+	}
+
+	return this->window != old_window;
+}
+
+void nccl_ofi_rx_window::end_epoch(uint64_t now_ns)
+{
+	uint64_t elapsed_ns = now_ns - this->epoch_start_ns;
+
+	this->last_rate = (double)this->epoch_consumed * 1e9 / elapsed_ns;
+
+	/* Scale the consumption to one epoch, as an epoch ends at the first
+	 * consumption or idle check after it, possibly long after its end */
+	size_t demand = (size_t)((double)this->epoch_consumed * this->epoch_ns / elapsed_ns);
+	demand = std::max(demand, 2 * this->epoch_peak_missing);
+
+	if (demand > this->window) {
+		resize(demand);
+	} else if (demand < this->window / 2) {
+		resize(std::max(demand, this->window / 2));
+	}
+
+	this->epoch_start_ns = now_ns;
+	this->epoch_consumed = 0;
+	this->epoch_peak_missing = 0;
+}
+
+void nccl_ofi_rx_window::resize(size_t new_window)
+{
+	new_window = std::min(std::max(new_window, this->floor), this->ceiling);
+
+	if (new_window > this->window) {
+		this->num_grows++;
+	} else if (new_window < this->window) {
+		this->num_shrinks++;
+	}
+
+	this->window = new_window;
+	this->peak_window = std::max(this->peak_window, new_window);
+}
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <chrono>
 #include <errno.h>
 #include <pthread.h>
 #include <stdexcept>
@@ -34,17 +35,17 @@ static inline size_t sizeof_schedule(int num_rails)
  * The function then adjusts the number of stripes to be the largest factor of
  * the number of rails that is less than or equal to the initial number of stripes.
  *
+ * Only used to build the schedule tables.
+ *
  * @param	size
  * 		The size of the message being transmitted.
- * @param 	scheduler_p
- * 		Pointer to threshold scheduler
  * @param 	num_rails
  * 		The number of available rails for transmission.
  *
  * @return	Returns the adjusted number of stripes.
  *
  */
-inline int nccl_net_ofi_threshold_scheduler::get_num_stripes(size_t size, int num_rails)
+int nccl_net_ofi_threshold_scheduler::get_num_stripes(size_t size, int num_rails)
 {
 	/* Number of stripes is at least 1 for zero-sized messages and at most equal to num of rails */
 	int num_stripes = (int)std::max(1UL, std::min(NCCL_OFI_DIV_CEIL(size,
@@ -63,27 +64,77 @@ inline int nccl_net_ofi_threshold_scheduler::get_num_stripes(size_t size, int nu
 	return num_stripes;
 }
 
+/*
+ * @brief	Rails among the first `num_rails' ones that schedules have to
+ *		avoid, or 0 if all of them are excluded
+ */
+static inline uint64_t excluded_rails_of(const nccl_net_ofi_scheduler *scheduler, int num_rails)
+{
+	uint64_t all = (num_rails >= 64) ? ~0ULL : ((1ULL << num_rails) - 1);
+	uint64_t excluded = scheduler->excluded_rails & all;
+
+	return excluded == all ? 0 : excluded;
+}
+
+/*
+ * Internal: Assign `num_stripes' stripes of at most `max_stripe_size'
+ * bytes to the rails listed in `rail_ids'. The last rail may get
+ * assigned less data.
+ */
+static inline void fill_stripes(nccl_net_ofi_schedule_t *schedule, const uint16_t *rail_ids,
+				int num_stripes, size_t size, size_t max_stripe_size)
+{
+	size_t left = size;
+	size_t offset = 0;
+
+	for (int stripe_idx = 0; stripe_idx < num_stripes; ++stripe_idx) {
+		size_t stripe_size = std::min(left, max_stripe_size);
+
+		schedule->rail_xfer_infos[stripe_idx].rail_id = rail_ids[stripe_idx];
+		schedule->rail_xfer_infos[stripe_idx].offset = offset;
+		schedule->rail_xfer_infos[stripe_idx].msg_size = stripe_size;
+
+		offset += stripe_size;
+		left -= stripe_size;
+	}
+	schedule->num_xfer_infos = num_stripes;
+}
+
+/*
+ * Internal: Specialization of fill_stripes() for a number of stripes
+ * known at compile time, so that the stripe size is computed with
+ * shifts and the loop is unrolled.
+ */
+template <int num_stripes>
+static inline void fill_stripes(nccl_net_ofi_schedule_t *schedule, const uint16_t *rail_ids,
+				size_t size, size_t align)
+{
+	size_t max_stripe_size = NCCL_OFI_DIV_CEIL(NCCL_OFI_DIV_CEIL(size, num_stripes), align) * align;
+
+	fill_stripes(schedule, rail_ids, num_stripes, size, max_stripe_size);
+}
+
 /*
  * Internal: Set schedule that multiplexes messages to all rails.
  *
  * A mininal stripe size `max_stripe_size' is calculated (multiple of
  * `align') that is sufficient to assign the whole message. Rails are
- * filled from low id to large id. The last rail may get assigned less
- * data. The number of rails are calculated based on the ratio of
- * (`data_size` / `min_stripe_size`)
- * 
+ * filled in round-robin order starting at the current phase. The last
+ * rail may get assigned less data. The number of rails is looked up
+ * from the ratio of (`data_size` / `min_stripe_size`) in the schedule
+ * table of `num_rails'.
+ *
  * The caller must ensure serialized access.
  */
-static inline int set_schedule_by_threshold(nccl_net_ofi_threshold_scheduler *scheduler,
-					    size_t size,
-					    int num_rails,
-					    size_t align,
-					    nccl_net_ofi_schedule_t *schedule)
+static inline void set_schedule_by_threshold(nccl_net_ofi_threshold_scheduler *scheduler,
+					     size_t size,
+					     int num_rails,
+					     size_t align,
+					     size_t size_class,
+					     nccl_net_ofi_schedule_t *schedule)
 {
-	int ret = 0;
-	int num_stripes = 0;
-
 	assert(num_rails > 0);
+	assert((size_t)num_rails <= scheduler->tables.size());
 
 	if (size < scheduler->max_small_msg_size) {
 		int curr_rail_id = scheduler->rr_small_counter;
@@ -95,41 +146,85 @@ static inline int set_schedule_by_threshold(nccl_net_ofi_threshold_scheduler *sc
 		schedule->rail_xfer_infos[0].offset = 0;
 		schedule->rail_xfer_infos[0].msg_size = size;
 		NCCL_OFI_TRACE(NCCL_NET, "scheduler: short size %lu rail %d", size, curr_rail_id);
-	} else {
-		num_stripes = scheduler->get_num_stripes(size, num_rails);
-		assert(num_stripes <= num_rails);
+		return;
+	}
 
-		int curr_rail_id = scheduler->rr_counter;
-		scheduler->rr_counter = (scheduler->rr_counter + num_stripes) % num_rails;
+	const nccl_net_ofi_threshold_scheduler::schedule_table &table = scheduler->tables[num_rails - 1];
+	int num_stripes = table.num_stripes[std::min(size_class, (size_t)num_rails)];
+	assert(num_stripes <= num_rails);
 
-		/* Number of bytes left to assign */
-		size_t left = size;
-		/* Offset into message */
-		size_t offset = 0;
+	/* The phase may have been advanced with another number of rails */
+	unsigned int phase = scheduler->rr_counter % num_rails;
+	const uint16_t *rail_ids = &table.rail_ids[phase * num_rails];
+	scheduler->rr_counter = table.next_phase[phase * (num_rails + 1) + num_stripes];
 
-		/* Calculate max stripe size as a multiple of 128 for alignment.
-		 * Split message size across stripes, ensuring each stripe is within max_stripe_size and LL128 aligned */
-		size_t max_stripe_size = NCCL_OFI_DIV_CEIL(NCCL_OFI_DIV_CEIL(size, num_stripes), align) * align;
+	NCCL_OFI_TRACE(NCCL_NET, "scheduler: long size %lu start rail %d num_rails %d", size, rail_ids[0], num_stripes);
 
-		schedule->num_xfer_infos = num_stripes;
+	switch (num_stripes) {
+	case 1:
+		fill_stripes<1>(schedule, rail_ids, size, align);
+		break;
+	case 2:
+		fill_stripes<2>(schedule, rail_ids, size, align);
+		break;
+	case 4:
+		fill_stripes<4>(schedule, rail_ids, size, align);
+		break;
+	default:
+		fill_stripes(schedule, rail_ids, num_stripes, size,
+			     NCCL_OFI_DIV_CEIL(NCCL_OFI_DIV_CEIL(size, num_stripes), align) * align);
+		break;
+	}
+}
 
-		NCCL_OFI_TRACE(NCCL_NET, "scheduler: long size %lu start rail %d num_rails %d", size, curr_rail_id, num_stripes);
-		/* Compute stripes and assign to rails */
-		for (int stripe_idx = 0; stripe_idx < num_stripes; ++stripe_idx) {
-			size_t stripe_size = std::min(left, max_stripe_size);
+/*
+ * Internal: Set schedule like set_schedule_by_threshold(), but only
+ * using the rails not in `excluded'. Schedules are computed without
+ * the schedule tables, as rails are only excluded while they are
+ * degraded.
+ *
+ * The caller must ensure serialized access.
+ */
+static void set_schedule_by_threshold_excluding(nccl_net_ofi_threshold_scheduler *scheduler,
+						size_t size,
+						int num_rails,
+						size_t align,
+						uint64_t excluded,
+						nccl_net_ofi_schedule_t *schedule)
+{
+	uint16_t usable[64];
+	int num_usable = 0;
 
-			schedule->rail_xfer_infos[stripe_idx].rail_id = curr_rail_id;
-			schedule->rail_xfer_infos[stripe_idx].offset = offset;
-			schedule->rail_xfer_infos[stripe_idx].msg_size = stripe_size;
+	for (int rail_id = 0; rail_id < num_rails; rail_id++) {
+		if (!(excluded & (1ULL << rail_id))) {
+			usable[num_usable++] = rail_id;
+		}
+	}
+	assert(num_usable > 0);
 
-			offset += stripe_size;
-			left -= stripe_size;
+	if (size < scheduler->max_small_msg_size) {
+		int curr_rail_id = usable[scheduler->rr_small_counter % num_usable];
+		scheduler->rr_small_counter = (scheduler->rr_small_counter + 1) % num_rails;
 
-			curr_rail_id = (curr_rail_id + 1) % num_rails;
-		}
+		schedule->num_xfer_infos = 1;
+		schedule->rail_xfer_infos[0].rail_id = curr_rail_id;
+		schedule->rail_xfer_infos[0].offset = 0;
+		schedule->rail_xfer_infos[0].msg_size = size;
+		return;
+	}
+
+	int num_stripes = scheduler->get_num_stripes(size, num_usable);
+	uint16_t rail_ids[64];
+	unsigned int phase = scheduler->rr_counter % num_usable;
+	for (int stripe_idx = 0; stripe_idx < num_stripes; stripe_idx++) {
+		rail_ids[stripe_idx] = usable[(phase + stripe_idx) % num_usable];
 	}
+	scheduler->rr_counter = (scheduler->rr_counter + num_stripes) % num_rails;
 
-	return ret;
+	NCCL_OFI_TRACE(NCCL_NET, "scheduler: long size %lu start rail %d num_rails %d (excluding 0x%lx)",
+		       size, rail_ids[0], num_stripes, (unsigned long)excluded);
+	fill_stripes(schedule, rail_ids, num_stripes, size,
+		     NCCL_OFI_DIV_CEIL(NCCL_OFI_DIV_CEIL(size, num_stripes), align) * align);
 }
 
 void nccl_net_ofi_release_schedule(nccl_net_ofi_scheduler *scheduler_p,
@@ -138,58 +233,86 @@ void nccl_net_ofi_release_schedule(nccl_net_ofi_scheduler *scheduler_p,
 	assert(scheduler_p != NULL);
 	assert(scheduler_p->schedule_fl != NULL);
 
-	scheduler_p->schedule_fl->entry_free(schedule->elem);
+	if (scheduler_p->wants_feedback) {
+		scheduler_p->retire_schedule(schedule);
+	}
+	if (schedule->elem != NULL) {
+		scheduler_p->schedule_fl->entry_free(schedule->elem);
+	}
+}
+
+nccl_net_ofi_schedule_t *nccl_net_ofi_scheduler::get_schedule(size_t size, int num_rails)
+{
+	nccl_net_ofi_schedule_t *schedule;
+
+	nccl_ofi_freelist::fl_entry *elem = this->schedule_fl->entry_alloc();
+	if (OFI_UNLIKELY(!elem)) {
+		NCCL_OFI_WARN("Failed to allocate schedule");
+		return NULL;
+	}
+
+	schedule = (nccl_net_ofi_schedule_t *)elem->ptr;
+	assert(schedule);
+	schedule->elem = elem;
+
+	this->set_schedule(size, num_rails, schedule);
+
+	return schedule;
+}
+
+nccl_net_ofi_schedule_t *nccl_net_ofi_scheduler::get_schedule(size_t size, int num_rails,
+							      nccl_net_ofi_schedule_t *storage)
+{
+	assert(storage != NULL);
+	storage->elem = NULL;
+
+	this->set_schedule(size, num_rails, storage);
+
+	return storage;
 }
 
 /*
- * @brief	Create schedule for a message by myltiplexing message or
+ * @brief	Set schedule for a message by myltiplexing message or
  *		assigning the message round-robin depending on the message size.
  *
- * Messages smaller or equal to `ROUND_ROBIN_THRESHOLD' bytes are
- * assigned round-robin; larger messages are multiplexed.
+ * Messages smaller than `max_small_msg_size' bytes are assigned
+ * round-robin; larger messages are multiplexed.
  * 
  * The caller must ensure serialized access.
  *
- * @param	scheduler_p
- *		Pointer to threshold scheduler
  * @param	size
  *		Size of the message in bytes
  * @param	num_rails
- *		Number of rails. This parameter must match the number of rails
+ *		Number of rails. Must not exceed the number of rails
  *		provided to the scheduler initialization routine.
- *
- * @return	schedule, on success
- *		NULL, on others
+ * @param	schedule
+ *		Schedule to set
  */
-nccl_net_ofi_schedule_t *nccl_net_ofi_threshold_scheduler::get_schedule(size_t size,
-									int num_rails)
+void nccl_net_ofi_threshold_scheduler::set_schedule(size_t size, int num_rails,
+						    nccl_net_ofi_schedule_t *schedule)
 {
-	nccl_net_ofi_schedule_t *schedule;
 	/* Align stripes to LL128 requirement */
 	size_t align = 128;
-	int ret;
+	size_t size_class;
 
-	nccl_ofi_freelist::fl_entry *elem = this->schedule_fl->entry_alloc();
-	if (OFI_UNLIKELY(!elem)) {
-		NCCL_OFI_WARN("Failed to allocate schedule");
-		return NULL;
+	uint64_t excluded = excluded_rails_of(this, num_rails);
+	if (OFI_UNLIKELY(excluded != 0)) {
+		set_schedule_by_threshold_excluding(this, size, num_rails, align, excluded, schedule);
+		return;
 	}
 
-	schedule = (nccl_net_ofi_schedule_t *)elem->ptr;
-	assert(schedule);
-	schedule->elem = elem;
-
-	ret = set_schedule_by_threshold(this, size, num_rails, align,
-					schedule);
-	if (OFI_UNLIKELY(ret)) {
-		nccl_net_ofi_release_schedule(this, schedule);
-		schedule = NULL;
+	if (this->min_stripe_shift >= 0) {
+		size_class = (size + this->min_stripe_size - 1) >> this->min_stripe_shift;
+	} else {
+		size_class = NCCL_OFI_DIV_CEIL(size, this->min_stripe_size);
 	}
 
-	return schedule;
+	set_schedule_by_threshold(this, size, num_rails, align, size_class, schedule);
 }
 
 nccl_net_ofi_scheduler::nccl_net_ofi_scheduler(int num_rails)
+	: excluded_rails(0),
+	  wants_feedback(false)
 {
 	this->schedule_fl = new nccl_ofi_freelist(sizeof_schedule(num_rails), 16, 16, 0, NULL, NULL,
 						  "Scheduler", true);
@@ -205,6 +328,282 @@ nccl_net_ofi_threshold_scheduler::nccl_net_ofi_threshold_scheduler(int num_rails
 	  rr_small_counter(0),
 	  rr_counter(0),
 	  max_small_msg_size(ofi_nccl_sched_max_small_msg_size()),
-	  min_stripe_size(ofi_nccl_min_stripe_size())
+	  min_stripe_size(ofi_nccl_min_stripe_size()),
+	  min_stripe_shift(-1)
+{
+	if (this->min_stripe_size == 0) {
+		throw std::runtime_error("Minimum stripe size must not be 0");
+	}
+	if ((this->min_stripe_size & (this->min_stripe_size - 1)) == 0) {
+		this->min_stripe_shift = __builtin_ctzl(this->min_stripe_size);
+	}
+
+	/* Build the schedule tables. Schedules are sized by the table of
+	 * the number of rails they are created for, which may be smaller
+	 * than `num_rails' (e.g. for control messages). */
+	this->tables.resize(num_rails);
+	for (int n = 1; n <= num_rails; n++) {
+		schedule_table &table = this->tables[n - 1];
+
+		table.num_stripes.resize(n + 1);
+		for (int size_class = 0; size_class <= n; size_class++) {
+			table.num_stripes[size_class] =
+				this->get_num_stripes(size_class * this->min_stripe_size, n);
+		}
+
+		table.rail_ids.resize(n * n);
+		table.next_phase.resize(n * (n + 1));
+		for (int phase = 0; phase < n; phase++) {
+			for (int stripe = 0; stripe < n; stripe++) {
+				table.rail_ids[phase * n + stripe] = (phase + stripe) % n;
+			}
+			for (int stripes = 0; stripes <= n; stripes++) {
+				table.next_phase[phase * (n + 1) + stripes] = (phase + stripes) % n;
+			}
+		}
+	}
+}
+
+/* Weight of a new sample in the moving averages of the adaptive scheduler */
+#define ADAPTIVE_EWMA_WEIGHT (0.125)
+
+/* Lower bound of the effective rate of a rail relative to its measured
+ * rate, so that rails returning -FI_EAGAIN keep getting probed */
+#define ADAPTIVE_MIN_RATE_FRACTION (0.05)
+
+static uint64_t steady_clock_ns(void)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline double ewma(double avg, double sample)
+{
+	return avg + ADAPTIVE_EWMA_WEIGHT * (sample - avg);
+}
+
+double nccl_net_ofi_adaptive_scheduler::effective_rate(int rail_id, int num_rails) const
+{
+	const rail_state &rail = this->rails[rail_id];
+	double rate = rail.rate;
+
+	if (rate == 0.0) {
+		/* Rails without completions yet are assumed to be as
+		 * fast as the average measured rail */
+		double sum = 0.0;
+		int num_measured = 0;
+		for (int i = 0; i < num_rails; ++i) {
+			if (this->rails[i].rate > 0.0) {
+				sum += this->rails[i].rate;
+				num_measured++;
+			}
+		}
+		rate = num_measured ? sum / num_measured : 1.0;
+	}
+
+	return rate * std::max(ADAPTIVE_MIN_RATE_FRACTION, 1.0 - rail.eagain_rate);
+}
+
+/*
+ * Internal: Set schedule that splits a message across the rails
+ * expected to become idle first.
+ *
+ * Each rail is expected to drain its outstanding bytes plus a stripe
+ * `s_i' at time (outstanding_i + s_i) / rate_i. Rails are considered
+ * in order of the time they become idle, and added as long as they
+ * become idle before the message, striped across the rails selected
+ * so far, would complete. Stripes are then sized so that all of them
+ * complete at the same time, and aligned to `align' bytes. The number
+ * of stripes is bounded by the ratio of (`size' / `min_stripe_size').
+ *
+ * The caller must ensure serialized access.
+ */
+static inline void set_schedule_by_feedback(nccl_net_ofi_adaptive_scheduler *scheduler,
+					    size_t size,
+					    int num_rails,
+					    size_t align,
+					    nccl_net_ofi_schedule_t *schedule)
+{
+	std::vector<nccl_net_ofi_adaptive_scheduler::rail_state> &rails = scheduler->rails;
+	double rate[64];
+	int order[64];
+
+	assert(num_rails > 0 && num_rails <= 64);
+	assert((size_t)num_rails <= rails.size());
+
+	int max_stripes = (int)std::max(1UL, std::min(NCCL_OFI_DIV_CEIL(size, scheduler->min_stripe_size),
+						      static_cast<long unsigned>(num_rails)));
+
+	/* Rotate the starting rail, so that rails with equal state are
+	 * used round-robin. Excluded rails are left out. */
+	uint64_t excluded = excluded_rails_of(scheduler, num_rails);
+	int num_usable = 0;
+	for (int i = 0; i < num_rails; ++i) {
+		rate[i] = scheduler->effective_rate(i, num_rails);
+	}
+	for (int i = 0; i < num_rails; ++i) {
+		int rail_id = (scheduler->rr_counter + i) % num_rails;
+		if (!(excluded & (1ULL << rail_id))) {
+			order[num_usable++] = rail_id;
+		}
+	}
+	/* excluded_rails_of() never excludes all rails */
+	if (OFI_UNLIKELY(num_usable == 0)) {
+		order[num_usable++] = 0;
+	}
+	std::stable_sort(order, order + num_usable, [&](int a, int b) {
+		return rails[a].outstanding_bytes / rate[a] < rails[b].outstanding_bytes / rate[b];
+	});
+	max_stripes = std::min(max_stripes, num_usable);
+
+	/* Select rails */
+	int num_stripes = 1;
+	double sum_rate = rate[order[0]];
+	double sum_outstanding = rails[order[0]].outstanding_bytes;
+	double finish = (size + sum_outstanding) / sum_rate;
+	while (num_stripes < max_stripes) {
+		int rail_id = order[num_stripes];
+		if (rails[rail_id].outstanding_bytes / rate[rail_id] >= finish) {
+			break;
+		}
+		sum_rate += rate[rail_id];
+		sum_outstanding += rails[rail_id].outstanding_bytes;
+		finish = (size + sum_outstanding) / sum_rate;
+		num_stripes++;
+	}
+	scheduler->rr_counter = (scheduler->rr_counter + num_stripes) % num_rails;
+
+	/* Size stripes. The last rail gets the bytes left after
+	 * alignment. */
+	size_t left = size;
+	size_t offset = 0;
+	size_t num_xfer_infos = 0;
+	for (int stripe_idx = 0; stripe_idx < num_stripes; ++stripe_idx) {
+		int rail_id = order[stripe_idx];
+		size_t stripe_size = left;
+
+		if (stripe_idx != num_stripes - 1) {
+			double share = finish * rate[rail_id] - rails[rail_id].outstanding_bytes;
+			stripe_size = share > 0.0 ? ((size_t)share / align) * align : 0;
+			stripe_size = std::min(left, stripe_size);
+		}
+		/* Zero-sized messages still need one stripe */
+		if (stripe_size == 0 && (left != 0 || num_xfer_infos != 0)) {
+			continue;
+		}
+
+		schedule->rail_xfer_infos[num_xfer_infos].rail_id = rail_id;
+		schedule->rail_xfer_infos[num_xfer_infos].offset = offset;
+		schedule->rail_xfer_infos[num_xfer_infos].msg_size = stripe_size;
+		schedule->pending_stripes |= 1ULL << num_xfer_infos;
+		rails[rail_id].outstanding_bytes += stripe_size;
+
+		num_xfer_infos++;
+		offset += stripe_size;
+		left -= stripe_size;
+	}
+	schedule->num_xfer_infos = num_xfer_infos;
+
+	NCCL_OFI_TRACE(NCCL_NET, "scheduler: adaptive size %lu first rail %d num_stripes %zu",
+		       size, order[0], num_xfer_infos);
+}
+
+void nccl_net_ofi_adaptive_scheduler::set_schedule(size_t size, int num_rails,
+						   nccl_net_ofi_schedule_t *schedule)
+{
+	/* Align stripes to LL128 requirement */
+	size_t align = 128;
+
+	schedule->start_ns = this->clock_fn();
+	schedule->pending_stripes = 0;
+
+	if (size < this->max_small_msg_size) {
+		uint64_t excluded = excluded_rails_of(this, num_rails);
+		int curr_rail_id = this->rr_small_counter % num_rails;
+		while (excluded & (1ULL << curr_rail_id)) {
+			curr_rail_id = (curr_rail_id + 1) % num_rails;
+		}
+		this->rr_small_counter = (curr_rail_id + 1) % num_rails;
+
+		schedule->num_xfer_infos = 1;
+		schedule->rail_xfer_infos[0].rail_id = curr_rail_id;
+		schedule->rail_xfer_infos[0].offset = 0;
+		schedule->rail_xfer_infos[0].msg_size = size;
+		NCCL_OFI_TRACE(NCCL_NET, "scheduler: short size %lu rail %d", size, curr_rail_id);
+	} else {
+		set_schedule_by_feedback(this, size, num_rails, align, schedule);
+	}
+}
+
+void nccl_net_ofi_adaptive_scheduler::notify_completion(nccl_net_ofi_schedule_t *schedule,
+							uint16_t rail_id)
+{
+	size_t stripe_idx;
+
+	for (stripe_idx = 0; stripe_idx < schedule->num_xfer_infos; ++stripe_idx) {
+		if ((schedule->pending_stripes & (1ULL << stripe_idx)) &&
+		    schedule->rail_xfer_infos[stripe_idx].rail_id == rail_id) {
+			break;
+		}
+	}
+	if (stripe_idx == schedule->num_xfer_infos) {
+		/* Not a stripe accounted by the scheduler */
+		return;
+	}
+	schedule->pending_stripes &= ~(1ULL << stripe_idx);
+
+	uint64_t now = this->clock_fn();
+	size_t bytes = schedule->rail_xfer_infos[stripe_idx].msg_size;
+	rail_state &rail = this->rails[rail_id];
+
+	assert(rail.outstanding_bytes >= bytes);
+	rail.outstanding_bytes -= bytes;
+
+	/* Stripes of a rail are served in order: the rail worked on
+	 * this stripe since it was scheduled or since the previous
+	 * completion, whichever is later */
+	uint64_t busy_since = std::max(schedule->start_ns, rail.last_completion_ns);
+	if (bytes != 0 && now > busy_since) {
+		double sample = (double)bytes / (double)(now - busy_since);
+		rail.rate = rail.rate == 0.0 ? sample : ewma(rail.rate, sample);
+	}
+	rail.latency_ns = ewma(rail.latency_ns, (double)(now - schedule->start_ns));
+	rail.eagain_rate = ewma(rail.eagain_rate, 0.0);
+	rail.last_completion_ns = now;
+}
+
+void nccl_net_ofi_adaptive_scheduler::notify_eagain(uint16_t rail_id)
+{
+	rail_state &rail = this->rails[rail_id];
+
+	rail.eagain_rate = ewma(rail.eagain_rate, 1.0);
+}
+
+void nccl_net_ofi_adaptive_scheduler::retire_schedule(nccl_net_ofi_schedule_t *schedule)
+{
+	for (size_t stripe_idx = 0; schedule->pending_stripes != 0; ++stripe_idx) {
+		if (schedule->pending_stripes & (1ULL << stripe_idx)) {
+			nccl_net_ofi_xfer_info_t *xfer = &schedule->rail_xfer_infos[stripe_idx];
+			rail_state &rail = this->rails[xfer->rail_id];
+
+			assert(rail.outstanding_bytes >= xfer->msg_size);
+			rail.outstanding_bytes -= xfer->msg_size;
+			schedule->pending_stripes &= ~(1ULL << stripe_idx);
+		}
+	}
+}
+
+nccl_net_ofi_adaptive_scheduler::nccl_net_ofi_adaptive_scheduler(int num_rails, clock_fn_t clock_fn_arg)
+	: nccl_net_ofi_scheduler(num_rails),
+	  rails(num_rails, rail_state{0, 0.0, 0.0, 0.0, 0}),
+	  rr_small_counter(0),
+	  rr_counter(0),
+	  max_small_msg_size(ofi_nccl_sched_max_small_msg_size()),
+	  min_stripe_size(ofi_nccl_min_stripe_size()),
+	  clock_fn(clock_fn_arg ? clock_fn_arg : steady_clock_ns)
 {
+	if (num_rails > 64) {
+		throw std::runtime_error("Adaptive scheduler supports at most 64 rails");
+	}
+	this->wants_feedback = true;
 }
@@ -266,10 +266,13 @@ static inline int sendrecv_process_completions(struct fi_cq_tagged_entry *cq_ent
  * @brief	Process completion entries for the given completion quque.
  *		This also updates several request fileds like size, status, etc
  *
+ * @param	num_compls_p
+ *		Incremented by the number of completions processed, if not NULL
+ *
  * @return	0, on success
  *		error, on others
  */
-static int sendrecv_cq_process(struct fid_cq *cq)
+static int sendrecv_cq_process(struct fid_cq *cq, size_t *num_compls_p = NULL)
 {
 	ssize_t rc = 0;
 	int ret = 0;
@@ -283,6 +286,9 @@ static int sendrecv_cq_process(struct fid_cq *cq)
 				cqe_tagged_buffers, rc);
 			if (OFI_UNLIKELY(ret != 0))
 				goto exit;
+			if (num_compls_p) {
+				*num_compls_p += rc;
+			}
 		}
 		else if (OFI_UNLIKELY(rc == -FI_EAVAIL)) {
 			/*
@@ -464,9 +470,40 @@ int nccl_net_ofi_sendrecv_req::test(int *done, int *size_p)
 
 	/* Process more completions unless the current request is completed */
 	if (this->state != NCCL_OFI_SENDRECV_REQ_COMPLETED) {
-		ret = sendrecv_cq_process(ep->cq.get());
+		size_t num_compls = 0;
+		ret = sendrecv_cq_process(ep->cq.get(), &num_compls);
 		if (OFI_UNLIKELY(ret != 0))
 			goto exit;
+
+		if (ep->cq_wait) {
+			ep->cq_wait->report_progress(num_compls);
+
+			/* Block on the completion queue rather than spinning
+			 * once the endpoint is idle */
+			if (this->state == NCCL_OFI_SENDRECV_REQ_PENDING &&
+			    ep->cq_wait->should_block()) {
+				ret = ep->cq_wait->trywait();
+				if (ret == 0) {
+					/* Let other threads use the endpoint
+					 * while this one sleeps */
+					ep->ep_lock.unlock();
+					ret = ep->cq_wait->wait();
+					ep->ep_lock.lock();
+					if (OFI_UNLIKELY(ret != 0))
+						goto exit;
+
+					CHECK_ENDPOINT_ACTIVE(ep, "sendrecv_req_test");
+				} else if (OFI_UNLIKELY(ret != -FI_EAGAIN)) {
+					goto exit;
+				}
+
+				num_compls = 0;
+				ret = sendrecv_cq_process(ep->cq.get(), &num_compls);
+				if (OFI_UNLIKELY(ret != 0))
+					goto exit;
+				ep->cq_wait->report_progress(num_compls);
+			}
+		}
 	}
 
 	/* Determine whether the request has finished and free if done */
@@ -744,6 +781,19 @@ static void sendrecv_comm_mr_base_dereg(nccl_net_ofi_sendrecv_mr_handle_t *mr_ha
 }
 
 
+/*
+ * @brief	MR cache callback deregistering evicted idle entries
+ */
+static int sendrecv_mr_cache_dereg_fn(void *domain_void_ptr, void *handle)
+{
+	auto *domain = static_cast<nccl_net_ofi_sendrecv_domain_t *>(domain_void_ptr);
+
+	sendrecv_comm_mr_base_dereg(static_cast<nccl_net_ofi_sendrecv_mr_handle_t *>(handle),
+				    domain->mr_rkey_pool, NULL);
+	return 0;
+}
+
+
 static int sendrecv_comm_mr_base_reg(nccl_net_ofi_comm *base_comm,
 				     nccl_ofi_mr_ckey_ref ckey,
 				     int type,
@@ -769,6 +819,16 @@ static int sendrecv_comm_mr_base_reg(nccl_net_ofi_comm *base_comm,
 	nccl_net_ofi_sendrecv_domain_t *domain = ep->sendrecv_endpoint_get_domain();
 	assert(domain != NULL);
 
+	/* Hits on registrations in use need neither the domain nor the cache
+	 * lock */
+	if (domain->mr_cache) {
+		*mr_handle = static_cast<nccl_net_ofi_sendrecv_mr_handle_t *>(
+			nccl_ofi_mr_cache_lookup_shared(domain->mr_cache, ckey, endpoint_mr));
+		if (*mr_handle) {
+			return 0;
+		}
+	}
+
 	std::lock_guard domain_lock(domain->domain_lock);
 
 	int dev_id = device->dev_id;
@@ -802,7 +862,10 @@ static int sendrecv_comm_mr_base_reg(nccl_net_ofi_comm *base_comm,
 	}
 
 	if (mr_cache) {
-		ret = nccl_ofi_mr_cache_insert_entry(mr_cache, ckey, endpoint_mr, ret_handle);
+		/* Freed host pages can be reused unnoticed, see
+		 * OFI_NCCL_MR_CACHE_LAZY_DEREG */
+		ret = nccl_ofi_mr_cache_insert_entry(mr_cache, ckey, endpoint_mr,
+						     type != NCCL_PTR_HOST, ret_handle);
 		if (OFI_UNLIKELY(ret != 0)) {
 			/* MR cache insert failed. Deregister memory region without
 			 * trying to delete MR cache entry.
@@ -1707,11 +1770,12 @@ int nccl_net_ofi_sendrecv_send_comm::send(void *data, size_t size, int tag_param
 
 	CHECK_ENDPOINT_ACTIVE(endpoint, "send");
 
-	/* Support only NCCL_OFI_MAX_REQUESTS inflight requests. */
-	if (OFI_UNLIKELY(this->num_inflight_reqs == NCCL_OFI_MAX_SEND_REQUESTS)) {
+	/* Support only NCCL_OFI_MAX_REQUESTS inflight requests. Receives
+	 * are not grouped, so there are no more sends than receives. */
+	if (OFI_UNLIKELY(this->num_inflight_reqs == NCCL_OFI_MAX_REQUESTS)) {
 		ret = -EINVAL;
 		NCCL_OFI_WARN("Can not support more than %d inflight requests",
-			      NCCL_OFI_MAX_SEND_REQUESTS);
+			      NCCL_OFI_MAX_REQUESTS);
 		goto error;
 	}
 
@@ -1877,7 +1941,7 @@ int nccl_net_ofi_sendrecv_send_comm::create(nccl_net_ofi_conn_handle_t *handle,
 	}
 
 	/* Pre-allocated buffers for data path */
-	ret_s_comm->nccl_ofi_reqs_fl = new nccl_ofi_freelist(req_size, 16, 16, NCCL_OFI_MAX_SEND_REQUESTS,
+	ret_s_comm->nccl_ofi_reqs_fl = new nccl_ofi_freelist(req_size, 16, 16, NCCL_OFI_MAX_REQUESTS,
 							     sendrecv_fl_req_entry_init, NULL,
 							     "Sendrecv Send Communicator Requests",
 							     true);
@@ -2011,6 +2075,11 @@ nccl_net_ofi_sendrecv_ep_t::~nccl_net_ofi_sendrecv_ep_t()
 		this->cm = nullptr;
 	}
 
+	if (this->cq_wait) {
+		delete this->cq_wait;
+		this->cq_wait = nullptr;
+	}
+
 	int dev_id = this->domain->get_device()->dev_id;
 	nccl_ofi_ofiutils_ep_release(this->ofi_ep, this->av, dev_id);
 }
@@ -2044,7 +2113,7 @@ nccl_net_ofi_sendrecv_ep_t::nccl_net_ofi_sendrecv_ep_t(
 	struct fi_cq_attr cq_attr = {};
 	cq_attr.format = FI_CQ_FORMAT_TAGGED;
 	cq_attr.size = ofi_nccl_cq_size();
-	auto cq_result =  nccl_ofi_ofiutils_cq_create(ofi_domain, &cq_attr);
+	auto cq_result =  nccl_ofi_ofiutils_cq_create_waitable(ofi_domain, &cq_attr);
 	if (OFI_UNLIKELY(cq_result.is_failure())) {
 		NCCL_OFI_WARN("Couldn't open CQ. RC: %d, ERROR: %s",
 			       cq_result.error_code, fi_strerror(-cq_result.error_code));
@@ -2052,6 +2121,19 @@ nccl_net_ofi_sendrecv_ep_t::nccl_net_ofi_sendrecv_ep_t(
 	}
 	this->cq = std::move(cq_result.resource);
 
+	if (cq_attr.wait_obj == FI_WAIT_FD) {
+		this->cq_wait = new nccl_ofi_cq_wait(ofi_nccl_cq_wait_spin_us() * 1000ULL,
+						     ofi_nccl_cq_wait_timeout_ms());
+		int ret = this->cq_wait->add_cq(device->fabric.get(), this->cq.get());
+		if (ret != 0) {
+			NCCL_OFI_INFO(NCCL_INIT | NCCL_NET,
+				      "Unable to get the wait object of the CQ, spinning instead. RC: %d",
+				      ret);
+			delete this->cq_wait;
+			this->cq_wait = nullptr;
+		}
+	}
+
 	auto av_result = nccl_ofi_ofiutils_av_create(ofi_domain);
 	if (OFI_UNLIKELY(av_result.is_failure())) {
 		throw std::runtime_error("sendrecv endpoint constructor: failed to init av");
@@ -2072,6 +2154,14 @@ nccl_net_ofi_sendrecv_ep_t::nccl_net_ofi_sendrecv_ep_t(
 
 nccl_net_ofi_sendrecv_domain_t::~nccl_net_ofi_sendrecv_domain_t()
 {
+	if (this->mr_cache) {
+		nccl_net_ofi_mutex_lock(&this->mr_cache->lock);
+		if (nccl_ofi_mr_cache_purge_idle(this->mr_cache) != 0) {
+			NCCL_OFI_WARN("Failed to deregister idle MR cache entries");
+		}
+		nccl_net_ofi_mutex_unlock(&this->mr_cache->lock);
+	}
+
 	/* Check for leaked endpoints. With weak_ptr entries, expired
 	 * entries are harmless (stale cache). But a live weak_ptr
 	 * means a comm still holds a shared_ptr to an ep, which
@@ -2099,6 +2189,14 @@ nccl_net_ofi_sendrecv_domain_t::nccl_net_ofi_sendrecv_domain_t(nccl_net_ofi_send
 		throw std::runtime_error("SENDRECV domain constructor: domain creation failed");
 	}
 	this->domain = std::move(domain_result.resource);
+
+	/* Endpoint-scoped MRs are never kept idle by the MR cache */
+	if (this->mr_cache && !endpoint_mr && ofi_nccl_mr_cache_lazy_dereg()) {
+		nccl_ofi_mr_cache_enable_lazy_dereg(this->mr_cache,
+						    ofi_nccl_mr_cache_max_idle_entries(),
+						    ofi_nccl_mr_cache_max_idle_size(),
+						    sendrecv_mr_cache_dereg_fn, this);
+	}
 }
 
 
@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <string.h>
 #include <hwloc.h>
+#include <hwloc/glibc-sched.h>
 #include <rdma/fabric.h>
 #include <errno.h>
 #include <stdlib.h>
@@ -1825,3 +1826,56 @@ bool nccl_ofi_topo_has_efa_ena_devices(nccl_ofi_topo_t* topo) {
 	}
 	return false;
 }
+
+/*
+ * @brief	Return the closest non-I/O ancestor of the PCI device of a NIC
+ *
+ * @return	ancestor object, if found and not the machine itself
+ *		NULL, on others
+ */
+static hwloc_obj_t get_nic_local_ancestor(nccl_ofi_topo_t *topo, struct fi_info *info)
+{
+	hwloc_obj_t pcidev = NULL;
+
+	if (topo == nullptr || topo->topo == nullptr || info == nullptr) {
+		return NULL;
+	}
+
+	if (get_hwloc_pcidev_by_fi_info(topo->topo, info, &pcidev) != 0 || pcidev == NULL) {
+		return NULL;
+	}
+
+	hwloc_obj_t ancestor = hwloc_get_non_io_ancestor_obj(topo->topo, pcidev);
+	if (ancestor == NULL || ancestor->parent == NULL) {
+		return NULL;
+	}
+
+	return ancestor;
+}
+
+int nccl_ofi_topo_get_numa_node(nccl_ofi_topo_t *topo, struct fi_info *info)
+{
+	hwloc_obj_t ancestor = get_nic_local_ancestor(topo, info);
+	if (ancestor == NULL || ancestor->nodeset == NULL ||
+	    hwloc_bitmap_iszero(ancestor->nodeset)) {
+		return -1;
+	}
+
+	return hwloc_bitmap_first(ancestor->nodeset);
+}
+
+int nccl_ofi_topo_get_local_cpus(nccl_ofi_topo_t *topo, struct fi_info *info, cpu_set_t *cpus)
+{
+	hwloc_obj_t ancestor = get_nic_local_ancestor(topo, info);
+	if (ancestor == NULL || ancestor->cpuset == NULL ||
+	    hwloc_bitmap_iszero(ancestor->cpuset)) {
+		return -1;
+	}
+
+	if (hwloc_cpuset_to_glibc_sched_affinity(topo->topo, ancestor->cpuset,
+						 cpus, sizeof(*cpus)) != 0) {
+		return -1;
+	}
+
+	return CPU_COUNT(cpus) > 0 ? 0 : -1;
+}
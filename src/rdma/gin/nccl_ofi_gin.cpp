@@ -478,8 +478,9 @@ int nccl_ofi_rdma_gin_put_comm::iputSignal(uint64_t srcOff, nccl_ofi_gin_symm_mr
 		void *src = static_cast<uint8_t *>(src_mr->input_address) + srcOff;
 		auto *src_mhandle = src_mr->local_handle;
 
+		nccl_net_ofi_schedule_buf<MAX_NUM_RAILS> schedule_buf;
 		const auto schedule =
-			scheduler->get_schedule(size, gin_ep.get_num_rails());
+			scheduler->get_schedule(size, gin_ep.get_num_rails(), schedule_buf.get());
 		auto &xfers = schedule->rail_xfer_infos;
 
 		nseg += schedule->num_xfer_infos;
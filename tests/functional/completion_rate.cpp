@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+/*
+ * Benchmark of the request completion rate
+ *
+ * Rank 0 sends windows of NUM_REQUESTS small messages to rank 1 on the
+ * first device, and both ranks test their requests until the window
+ * completes. Small messages keep the network time low, so the rate is
+ * bounded by the cost of posting, completing and testing requests in the
+ * plugin. Each rank reports its completed requests per second and the
+ * time per request. Compare builds to measure changes to the completion
+ * path:
+ *
+ *   mpirun -np 2 ./completion_rate
+ *
+ * Optional arguments: number of windows, message size in bytes.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "functional_test.h"
+
+static size_t num_windows = 10000;
+static size_t msg_size = 8;
+
+class CompletionRateTest : public TestScenario {
+
+public:
+	explicit CompletionRateTest()
+		: TestScenario("Request Completion Rate Benchmark", 0, 1) {}
+
+	void run(ThreadContext& ctx) override {
+		/* Host buffers, so no flush is needed */
+		void* comm = (ctx.rank == 0) ? ctx.scomms[0] : ctx.rcomms[0];
+		void* bufs[NUM_REQUESTS] = {};
+		void* mhandles[NUM_REQUESTS] = {};
+		void* reqs[NUM_REQUESTS] = {};
+
+		for (size_t i = 0; i < NUM_REQUESTS; i++) {
+			OFINCCLTHROW(allocate_buff(&bufs[i], msg_size, NCCL_PTR_HOST));
+			OFINCCLTHROW(initialize_buff(bufs[i], msg_size, NCCL_PTR_HOST));
+			OFINCCLTHROW(ext_net->regMr(comm, bufs[i], msg_size, NCCL_PTR_HOST, &mhandles[i]));
+		}
+
+		MPITHROW(MPI_Barrier(ctx.thread_comm));
+		auto start = std::chrono::steady_clock::now();
+
+		for (size_t window = 0; window < num_windows; window++) {
+			for (size_t i = 0; i < NUM_REQUESTS; i++) {
+				if (ctx.rank == 0) {
+					post_send(ext_net, comm, bufs[i], msg_size, TAG, mhandles[i], &reqs[i]);
+				} else {
+					size_t size = msg_size;
+					int tag = TAG;
+					post_recv(ext_net, comm, 1, &bufs[i], &size, &tag, &mhandles[i],
+						  &reqs[i]);
+				}
+			}
+
+			/* Test the requests round-robin, as NCCL does */
+			size_t num_done = 0;
+			while (num_done < NUM_REQUESTS) {
+				for (size_t i = 0; i < NUM_REQUESTS; i++) {
+					if (reqs[i] == nullptr) {
+						continue;
+					}
+					int done = 0;
+					OFINCCLTHROW(ext_net->test(reqs[i], &done, nullptr));
+					if (done) {
+						reqs[i] = nullptr;
+						num_done++;
+					}
+				}
+			}
+		}
+
+		double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+								  start).count();
+		double num_reqs = (double)num_windows * NUM_REQUESTS;
+		NCCL_OFI_INFO(NCCL_NET,
+			      "Rank %d: %.0f %s requests of %zu bytes in %.3f s: "
+			      "%.0f requests/s, %.1f ns per request",
+			      ctx.rank, num_reqs, (ctx.rank == 0) ? "send" : "receive", msg_size,
+			      elapsed_s, num_reqs / elapsed_s, elapsed_s * 1e9 / num_reqs);
+
+		for (size_t i = 0; i < NUM_REQUESTS; i++) {
+			OFINCCLTHROW(ext_net->deregMr(comm, mhandles[i]));
+			OFINCCLTHROW(deallocate_buffer(bufs[i], NCCL_PTR_HOST));
+		}
+	}
+
+private:
+	static constexpr int TAG = 1;
+};
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1) {
+		num_windows = std::max(1L, strtol(argv[1], nullptr, 10));
+	}
+	if (argc > 2) {
+		msg_size = std::max(1L, strtol(argv[2], nullptr, 10));
+	}
+
+	TestSuite suite;
+	CompletionRateTest test;
+	suite.add(&test);
+	return suite.run_all();
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+/*
+ * Benchmark of the idle CPU usage and wake-up latency of the completion
+ * queue progress modes
+ *
+ * Rank 0 sends a ping to rank 1 after an idle gap, and rank 1 answers with
+ * a pong as soon as the receive completes. Rank 1 tests its receive in a
+ * loop during the gap, as the NCCL proxy thread does on an idle
+ * communicator. Rank 0 reports the round-trip times, which include the
+ * wake-up latency of rank 1, and the CPU usage of both ranks.
+ *
+ * Compare spinning and blocking on loopback with the tcp provider:
+ *
+ *   FI_PROVIDER=tcp OFI_NCCL_CQ_WAIT=0 mpirun -np 2 ./cq_wait_latency
+ *   FI_PROVIDER=tcp OFI_NCCL_CQ_WAIT=1 mpirun -np 2 ./cq_wait_latency
+ *
+ * Optional arguments: number of iterations, idle gap in microseconds.
+ */
+
+#include "config.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "functional_test.h"
+
+static size_t num_iters = 200;
+static unsigned int idle_gap_us = 5000;
+
+class CqWaitLatencyTest : public TestScenario {
+
+public:
+	explicit CqWaitLatencyTest()
+		: TestScenario("CQ Wait Latency Benchmark", 0, 1) {}
+
+	void run(ThreadContext& ctx) override {
+		/* Host buffers, so no flush is needed */
+		void* send_buf = nullptr;
+		void* recv_buf = nullptr;
+		void* send_mhandle = nullptr;
+		void* recv_mhandle = nullptr;
+		void* scomm = ctx.scomms[0];
+		void* rcomm = ctx.rcomms[0];
+		std::vector<double> rtts_us;
+
+		OFINCCLTHROW(allocate_buff(&send_buf, MSG_SIZE, NCCL_PTR_HOST));
+		OFINCCLTHROW(allocate_buff(&recv_buf, MSG_SIZE, NCCL_PTR_HOST));
+		OFINCCLTHROW(initialize_buff(send_buf, MSG_SIZE, NCCL_PTR_HOST));
+		OFINCCLTHROW(ext_net->regMr(scomm, send_buf, MSG_SIZE, NCCL_PTR_HOST, &send_mhandle));
+		OFINCCLTHROW(ext_net->regMr(rcomm, recv_buf, MSG_SIZE, NCCL_PTR_HOST, &recv_mhandle));
+
+		MPITHROW(MPI_Barrier(ctx.thread_comm));
+		auto wall_start = std::chrono::steady_clock::now();
+		double cpu_start = process_cpu_seconds();
+
+		for (size_t iter = 0; iter < num_iters; iter++) {
+			if (ctx.rank == 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(idle_gap_us));
+
+				void* recv_req = nullptr;
+				size_t size = MSG_SIZE;
+				int tag = TAG;
+				auto start = std::chrono::steady_clock::now();
+				post_recv(ext_net, rcomm, 1, &recv_buf, &size, &tag, &recv_mhandle, &recv_req);
+				exchange(scomm, send_buf, send_mhandle, recv_req);
+				auto end = std::chrono::steady_clock::now();
+				rtts_us.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+			} else {
+				void* recv_req = nullptr;
+				size_t size = MSG_SIZE;
+				int tag = TAG;
+				post_recv(ext_net, rcomm, 1, &recv_buf, &size, &tag, &recv_mhandle, &recv_req);
+				wait(recv_req);
+				exchange(scomm, send_buf, send_mhandle, nullptr);
+			}
+		}
+
+		double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+							      wall_start).count();
+		double rank_cpu_util = (process_cpu_seconds() - cpu_start) / wall_s;
+		double cpu_util[2] = {};
+		MPITHROW(MPI_Gather(&rank_cpu_util, 1, MPI_DOUBLE, cpu_util, 1, MPI_DOUBLE, 0,
+				    ctx.thread_comm));
+
+		if (ctx.rank == 0) {
+			std::sort(rtts_us.begin(), rtts_us.end());
+			double sum = 0;
+			for (double rtt : rtts_us) {
+				sum += rtt;
+			}
+			NCCL_OFI_INFO(NCCL_NET,
+				      "%zu round trips of %zu bytes after %u us idle gaps: "
+				      "RTT min %.1f us, avg %.1f us, p99 %.1f us, max %.1f us",
+				      num_iters, MSG_SIZE, idle_gap_us, rtts_us.front(),
+				      sum / rtts_us.size(), rtts_us[rtts_us.size() * 99 / 100],
+				      rtts_us.back());
+			NCCL_OFI_INFO(NCCL_NET,
+				      "CPU utilization: rank 0 (pinging) %.1f%%, rank 1 (waiting) %.1f%%",
+				      cpu_util[0] * 100, cpu_util[1] * 100);
+		}
+
+		OFINCCLTHROW(ext_net->deregMr(scomm, send_mhandle));
+		OFINCCLTHROW(ext_net->deregMr(rcomm, recv_mhandle));
+		OFINCCLTHROW(deallocate_buffer(send_buf, NCCL_PTR_HOST));
+		OFINCCLTHROW(deallocate_buffer(recv_buf, NCCL_PTR_HOST));
+	}
+
+private:
+	static constexpr size_t MSG_SIZE = 64;
+	static constexpr int TAG = 1;
+
+	/* User and system CPU time of the process, including the threads
+	 * of the plugin */
+	static double process_cpu_seconds() {
+		struct rusage usage = {};
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+			usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+	}
+
+	void wait(void* request) {
+		int done = 0;
+		while (!done) {
+			OFINCCLTHROW(ext_net->test(request, &done, nullptr));
+		}
+	}
+
+	/* Send the message, then wait for the send and `recv_req' */
+	void exchange(void* scomm, void* send_buf, void* send_mhandle, void* recv_req) {
+		void* send_req = nullptr;
+		post_send(ext_net, scomm, send_buf, MSG_SIZE, TAG, send_mhandle, &send_req);
+		wait(send_req);
+		if (recv_req != nullptr) {
+			wait(recv_req);
+		}
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1) {
+		num_iters = std::max(1L, strtol(argv[1], nullptr, 10));
+	}
+	if (argc > 2) {
+		idle_gap_us = strtoul(argv[2], nullptr, 10);
+	}
+
+	TestSuite suite;
+	CqWaitLatencyTest test;
+	suite.add(&test);
+	return suite.run_all();
+}
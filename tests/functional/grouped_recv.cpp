@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+/*
+ * This test validates grouped receives, which the RDMA protocol only
+ * supports with OFI_NCCL_RDMA_MAX_GROUP_RECEIVES larger than 1. The test
+ * sets it to the maximum unless it is set in the environment.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "functional_test.h"
+
+/*
+ * Grouped receives: rank 1 receives into several buffers with one irecv,
+ * rank 0 sends to them with one isend per buffer, in reverse tag order, so
+ * the plugin has to match sends to buffers by tag. Skipped if the plugin
+ * does not support grouped receives.
+ */
+class GroupedReceiveTest : public TestScenario {
+
+public:
+	explicit GroupedReceiveTest(size_t num_threads = 0)
+		: TestScenario("NCCL Grouped Receive Test", num_threads, 1) {}
+
+	void run(ThreadContext& ctx) override {
+		test_nccl_properties_t props = {};
+		OFINCCLTHROW(ext_net->getProperties(0, &props));
+
+		if (props.maxRecvs < 2) {
+			if (ctx.rank == 0) {
+				NCCL_OFI_INFO(NCCL_NET, "Skipping grouped receive test, maxRecvs is %d",
+					      props.maxRecvs);
+			}
+			return;
+		}
+
+		auto gdr_support = get_support_gdr(ext_net);
+		int num_recvs = std::min(props.maxRecvs, MAX_TEST_RECVS);
+
+		for (size_t dev_idx = 0; dev_idx < ctx.lcomms.size(); dev_idx++) {
+			int physical_dev = ctx.device_map[dev_idx];
+			int buffer_type = gdr_support[physical_dev] ? NCCL_PTR_CUDA : NCCL_PTR_HOST;
+
+			for (size_t size : SIZES) {
+				/* Every buffer count up to the maximum */
+				for (int n = 2; n <= num_recvs; n++) {
+					grouped_transfer(ctx, dev_idx, buffer_type, n, size);
+				}
+			}
+		}
+	}
+
+private:
+	static constexpr int MAX_TEST_RECVS = 8;
+	static constexpr int NUM_GROUPS = 4;
+
+	/* Sizes below and above the eager and striping thresholds */
+	std::vector<size_t> SIZES { 0, 512, 16 * 1024, 1024 * 1024 };
+
+	static int buffer_tag(int buf_idx) { return 100 + buf_idx; }
+	static int buffer_value(int group, int buf_idx) { return 'a' + (group * MAX_TEST_RECVS + buf_idx) % 26; }
+
+	void grouped_transfer(ThreadContext& ctx, size_t dev_idx, int buffer_type, int n, size_t size) {
+		void* buffers[NUM_GROUPS][MAX_TEST_RECVS] = {};
+		void* mhandles[NUM_GROUPS][MAX_TEST_RECVS] = {};
+		void* requests[NUM_GROUPS][MAX_TEST_RECVS] = {};
+		/* Registration needs a non-empty buffer */
+		size_t alloc_size = std::max(size, (size_t)1);
+		void* comm = (ctx.rank == 0) ? ctx.scomms[dev_idx] : ctx.rcomms[dev_idx];
+
+		for (int group = 0; group < NUM_GROUPS; group++) {
+			for (int i = 0; i < n; i++) {
+				OFINCCLTHROW(allocate_buff(&buffers[group][i], alloc_size, buffer_type));
+				OFINCCLTHROW(initialize_buff(buffers[group][i], alloc_size, buffer_type,
+							     (ctx.rank == 0) ? buffer_value(group, i) : 0));
+				OFINCCLTHROW(ext_net->regMr(comm, buffers[group][i], alloc_size,
+							    buffer_type, &mhandles[group][i]));
+			}
+		}
+
+		if (ctx.rank == 0) {
+			for (int group = 0; group < NUM_GROUPS; group++) {
+				for (int i = n - 1; i >= 0; i--) {
+					post_send(ext_net, comm, buffers[group][i], size, buffer_tag(i),
+						  mhandles[group][i], &requests[group][i]);
+				}
+			}
+		} else {
+			for (int group = 0; group < NUM_GROUPS; group++) {
+				size_t sizes[MAX_TEST_RECVS];
+				int tags[MAX_TEST_RECVS];
+				for (int i = 0; i < n; i++) {
+					sizes[i] = size;
+					tags[i] = buffer_tag(i);
+				}
+				post_recv(ext_net, comm, n, buffers[group], sizes, tags,
+					  mhandles[group], &requests[group][0]);
+			}
+		}
+
+		/* Rank 0 has a request per send, rank 1 one per group */
+		bool all_done = false;
+		while (!all_done) {
+			all_done = true;
+			for (int group = 0; group < NUM_GROUPS; group++) {
+				for (int i = 0; i < n; i++) {
+					if (requests[group][i] == nullptr) {
+						continue;
+					}
+
+					int done = 0;
+					int recv_sizes[MAX_TEST_RECVS] = {};
+					OFINCCLTHROW(ext_net->test(requests[group][i], &done, recv_sizes));
+					if (!done) {
+						all_done = false;
+						continue;
+					}
+					requests[group][i] = nullptr;
+
+					if (ctx.rank == 1) {
+						for (int j = 0; j < n; j++) {
+							if (recv_sizes[j] != (int)size) {
+								throw std::runtime_error(
+									"Grouped receive reported size " +
+									std::to_string(recv_sizes[j]) +
+									" for buffer " + std::to_string(j) +
+									", expected " + std::to_string(size));
+							}
+						}
+					}
+				}
+			}
+		}
+
+		if (ctx.rank == 1) {
+			char *expected_buf = nullptr;
+			OFINCCLTHROW(allocate_buff((void **)&expected_buf, alloc_size, NCCL_PTR_HOST));
+			for (int group = 0; group < NUM_GROUPS; group++) {
+				if (buffer_type == NCCL_PTR_CUDA && size != 0) {
+					int flush_sizes[MAX_TEST_RECVS];
+					void* flush_req = nullptr;
+					std::fill(flush_sizes, flush_sizes + n, (int)size);
+					OFINCCLTHROW(ext_net->iflush(comm, n, buffers[group], flush_sizes,
+								     mhandles[group], &flush_req));
+					int flush_done = (flush_req == nullptr);
+					while (!flush_done) {
+						OFINCCLTHROW(ext_net->test(flush_req, &flush_done, nullptr));
+					}
+				}
+
+				/* Each buffer must hold the data of the send with its tag */
+				for (int i = 0; i < n && size != 0; i++) {
+					OFINCCLTHROW(initialize_buff(expected_buf, size, NCCL_PTR_HOST,
+								     buffer_value(group, i)));
+					OFINCCLTHROW(validate_data((char *)buffers[group][i], expected_buf,
+								   size, buffer_type));
+				}
+			}
+			OFINCCLTHROW(deallocate_buffer(expected_buf, NCCL_PTR_HOST));
+		}
+
+		for (int group = 0; group < NUM_GROUPS; group++) {
+			for (int i = 0; i < n; i++) {
+				OFINCCLTHROW(ext_net->deregMr(comm, mhandles[group][i]));
+				OFINCCLTHROW(deallocate_buffer(buffers[group][i], buffer_type));
+			}
+		}
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	/* Read by the plugin at initialization, must be the same on all ranks */
+	if (setenv("OFI_NCCL_RDMA_MAX_GROUP_RECEIVES", "8", 0) != 0) {
+		NCCL_OFI_WARN("Failed to set OFI_NCCL_RDMA_MAX_GROUP_RECEIVES");
+		return 1;
+	}
+
+	TestSuite suite;
+	GroupedReceiveTest test;
+	suite.add(&test);
+	return suite.run_all();
+}
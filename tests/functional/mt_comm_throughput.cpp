@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+/*
+ * Test of communicators of one endpoint driven by concurrent threads
+ *
+ * All connections are created by the main thread, so they share its
+ * endpoint, as the communicators of the NCCL channels of a device do.
+ * Rank 0 streams windows of messages on every connection to rank 1. The
+ * connections are first driven round-robin by the main thread, then by
+ * one thread each, and rank 0 reports the message rate of both phases.
+ * Every message carries a pattern identifying its connection, window and
+ * slot. Rank 1 checks the size and the data of each message, and both
+ * ranks fail if a request does not complete in time.
+ *
+ *   mpirun -np 2 ./mt_comm_throughput
+ *
+ * Optional arguments: number of connections, number of windows, message
+ * size in bytes.
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "functional_test.h"
+
+static size_t num_conns = 4;
+static size_t num_windows = 1000;
+static size_t msg_size = 4096;
+
+class MtCommThroughputTest : public TestScenario {
+
+public:
+	explicit MtCommThroughputTest()
+		: TestScenario("Multi-threaded Communicator Throughput Benchmark", 0, 1) {}
+
+	void setup(ThreadContext& ctx) override {
+		MPI_Comm_rank(ctx.thread_comm, &ctx.rank);
+		ctx.peer_rank = (ctx.rank == 0) ? 1 : 0;
+		OFINCCLTHROW(ext_net->devices(&ctx.ndev));
+
+		/* Every connection uses the first device of the rank */
+		int physical_dev = (ctx.rank == 1) ? ctx.ndev - 1 : 0;
+		ctx.device_map.assign(num_conns, physical_dev);
+
+		ctx.lcomms.resize(num_conns, nullptr);
+		ctx.scomms.resize(num_conns, nullptr);
+		ctx.rcomms.resize(num_conns, nullptr);
+		ctx.shandles.resize(num_conns, nullptr);
+		ctx.rhandles.resize(num_conns, nullptr);
+
+		for (size_t idx = 0; idx < num_conns; idx++) {
+			ctx.setup_connection(idx, 2);
+		}
+	}
+
+	void run(ThreadContext& ctx) override {
+		std::vector<Conn> conns(num_conns);
+
+		for (size_t idx = 0; idx < num_conns; idx++) {
+			Conn& conn = conns[idx];
+			conn.comm = (ctx.rank == 0) ? ctx.scomms[idx] : ctx.rcomms[idx];
+			OFINCCLTHROW(allocate_buff((void**)&conn.expected_buf, msg_size, NCCL_PTR_HOST));
+			for (size_t i = 0; i < WINDOW; i++) {
+				OFINCCLTHROW(allocate_buff(&conn.bufs[i], msg_size, NCCL_PTR_HOST));
+				OFINCCLTHROW(ext_net->regMr(conn.comm, conn.bufs[i], msg_size,
+							    NCCL_PTR_HOST, &conn.mhandles[i]));
+			}
+		}
+
+		/* One thread drives every connection */
+		MPITHROW(MPI_Barrier(ctx.thread_comm));
+		auto start = std::chrono::steady_clock::now();
+		drive(ctx, conns, 0, num_conns, 0);
+		double serial_s = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+								 start).count();
+
+		/* One thread per connection */
+		MPITHROW(MPI_Barrier(ctx.thread_comm));
+		std::vector<std::thread> threads;
+		std::vector<std::exception_ptr> errors(num_conns);
+		start = std::chrono::steady_clock::now();
+		for (size_t idx = 0; idx < num_conns; idx++) {
+			threads.emplace_back([&, idx]() {
+				try {
+					drive(ctx, conns, idx, idx + 1, num_windows);
+				} catch (...) {
+					errors[idx] = std::current_exception();
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		double threaded_s = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+								  start).count();
+		for (auto& error : errors) {
+			if (error) {
+				std::rethrow_exception(error);
+			}
+		}
+
+		for (size_t idx = 0; idx < num_conns; idx++) {
+			if (conns[idx].num_completed != 2 * num_windows * WINDOW) {
+				throw std::runtime_error("Connection " + std::to_string(idx) + " completed " +
+							 std::to_string(conns[idx].num_completed) + " messages");
+			}
+		}
+
+		if (ctx.rank == 0) {
+			double num_msgs = (double)num_conns * num_windows * WINDOW;
+			NCCL_OFI_INFO(NCCL_NET,
+				      "%zu connections, %.0f messages of %zu bytes: "
+				      "1 thread %.0f msg/s, %zu threads %.0f msg/s (%.2fx)",
+				      num_conns, num_msgs, msg_size, num_msgs / serial_s,
+				      num_conns, num_msgs / threaded_s, serial_s / threaded_s);
+		}
+
+		for (auto& conn : conns) {
+			for (size_t i = 0; i < WINDOW; i++) {
+				OFINCCLTHROW(ext_net->deregMr(conn.comm, conn.mhandles[i]));
+				OFINCCLTHROW(deallocate_buffer(conn.bufs[i], NCCL_PTR_HOST));
+			}
+			OFINCCLTHROW(deallocate_buffer(conn.expected_buf, NCCL_PTR_HOST));
+		}
+	}
+
+private:
+	static constexpr size_t WINDOW = 8;
+	static constexpr int TAG = 1;
+	/* Longest wait for a request before the test fails */
+	static constexpr std::chrono::seconds COMPLETION_TIMEOUT{60};
+
+	/* Send communicator on rank 0, receive communicator on rank 1 */
+	struct Conn {
+		void* comm = nullptr;
+		void* bufs[WINDOW] = {};
+		void* mhandles[WINDOW] = {};
+		void* reqs[WINDOW] = {};
+		/* Pattern of the message being checked, on rank 1 */
+		char* expected_buf = nullptr;
+		/* Messages sent or received and checked */
+		size_t num_completed = 0;
+	};
+
+	/* Byte pattern of a message, distinct for neighbouring connections,
+	 * windows and slots. Never 0, which unwritten buffers may hold. */
+	static int msg_value(size_t idx, size_t window, size_t i) {
+		return 1 + (int)((idx * 67 + window * WINDOW + i) % 251);
+	}
+
+	/* Test a request until it completes, or fail after COMPLETION_TIMEOUT */
+	void wait(void* req, int* size) {
+		auto deadline = std::chrono::steady_clock::now() + COMPLETION_TIMEOUT;
+		int done = 0;
+		while (!done) {
+			OFINCCLTHROW(ext_net->test(req, &done, size));
+			if (!done && std::chrono::steady_clock::now() > deadline) {
+				throw std::runtime_error("Request did not complete");
+			}
+		}
+	}
+
+	/* Stream the windows of connections [first, last), numbering them
+	 * from first_window */
+	void drive(ThreadContext& ctx, std::vector<Conn>& conns, size_t first, size_t last,
+		   size_t first_window) {
+		for (size_t window = first_window; window < first_window + num_windows; window++) {
+			for (size_t idx = first; idx < last; idx++) {
+				Conn& conn = conns[idx];
+				for (size_t i = 0; i < WINDOW; i++) {
+					if (ctx.rank == 0) {
+						OFINCCLTHROW(initialize_buff(conn.bufs[i], msg_size, NCCL_PTR_HOST,
+									     msg_value(idx, window, i)));
+						post_send(ext_net, conn.comm, conn.bufs[i], msg_size, TAG,
+							  conn.mhandles[i], &conn.reqs[i]);
+					} else {
+						size_t size = msg_size;
+						int tag = TAG;
+						post_recv(ext_net, conn.comm, 1, &conn.bufs[i], &size, &tag,
+							  &conn.mhandles[i], &conn.reqs[i]);
+					}
+				}
+			}
+
+			for (size_t idx = first; idx < last; idx++) {
+				Conn& conn = conns[idx];
+				for (size_t i = 0; i < WINDOW; i++) {
+					int size = -1;
+					wait(conn.reqs[i], &size);
+
+					if (ctx.rank == 1) {
+						if (size != (int)msg_size) {
+							throw std::runtime_error("Received " + std::to_string(size) +
+										 " bytes instead of " +
+										 std::to_string(msg_size));
+						}
+						OFINCCLTHROW(initialize_buff(conn.expected_buf, msg_size,
+									     NCCL_PTR_HOST,
+									     msg_value(idx, window, i)));
+						OFINCCLTHROW(validate_data((char*)conn.bufs[i], conn.expected_buf,
+									   msg_size, NCCL_PTR_HOST));
+					}
+					conn.num_completed++;
+				}
+			}
+		}
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1) {
+		num_conns = std::max(1L, strtol(argv[1], nullptr, 10));
+	}
+	if (argc > 2) {
+		num_windows = std::max(1L, strtol(argv[2], nullptr, 10));
+	}
+	if (argc > 3) {
+		msg_size = std::max(1L, strtol(argv[3], nullptr, 10));
+	}
+
+	TestSuite suite;
+	MtCommThroughputTest test;
+	suite.add(&test);
+	return suite.run_all();
+}
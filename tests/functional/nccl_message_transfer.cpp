@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2018 Amazon.com, Inc. or its affiliates. All rights reserved.
+ * Copyright (c) 2018-2026 Amazon.com, Inc. or its affiliates. All rights reserved.
  */
 
 /*
@@ -56,13 +56,132 @@ class MessageTransferTest : public TestScenario {
 	};
 };
 
+/*
+ * Both ranks post their receives, then their sends, and wait for the sends
+ * to complete before testing any receive. The sends are above the eager
+ * threshold and need the control messages of the peer's receives, so the
+ * plugin must not hold these back until a receive is tested (e.g. with
+ * OFI_NCCL_RDMA_CTRL_BATCH_MAX).
+ */
+class SendFirstWaitTest : public TestScenario {
+
+public:
+	explicit SendFirstWaitTest(size_t num_threads = 0)
+		: TestScenario("NCCL Send First Wait Test", num_threads, 1) {}
+
+	void run(ThreadContext& ctx) override {
+		auto gdr_support = get_support_gdr(ext_net);
+
+		for (size_t dev_idx = 0; dev_idx < ctx.lcomms.size(); dev_idx++) {
+			int physical_dev = ctx.device_map[dev_idx];
+			int buffer_type = gdr_support[physical_dev] ? NCCL_PTR_CUDA : NCCL_PTR_HOST;
+
+			exchange(ctx, dev_idx, buffer_type);
+		}
+	}
+
+private:
+	static constexpr int NUM_MSGS = 4;
+	static constexpr int TAG = 1;
+	static constexpr size_t DATA_SIZE = 1024 * 1024;
+
+	static int buffer_value(int rank, int msg_idx) { return 'a' + (rank * NUM_MSGS + msg_idx) % 26; }
+
+	void wait_all(void** requests) {
+		bool all_done = false;
+		while (!all_done) {
+			all_done = true;
+			for (int i = 0; i < NUM_MSGS; i++) {
+				if (requests[i] == nullptr) {
+					continue;
+				}
+				int done = 0;
+				OFINCCLTHROW(ext_net->test(requests[i], &done, nullptr));
+				if (done) {
+					requests[i] = nullptr;
+				} else {
+					all_done = false;
+				}
+			}
+		}
+	}
+
+	void exchange(ThreadContext& ctx, size_t dev_idx, int buffer_type) {
+		void* send_bufs[NUM_MSGS] = {};
+		void* recv_bufs[NUM_MSGS] = {};
+		void* send_mhandles[NUM_MSGS] = {};
+		void* recv_mhandles[NUM_MSGS] = {};
+		void* send_requests[NUM_MSGS] = {};
+		void* recv_requests[NUM_MSGS] = {};
+		auto sComm = ctx.scomms[dev_idx];
+		auto rComm = ctx.rcomms[dev_idx];
+
+		for (int i = 0; i < NUM_MSGS; i++) {
+			OFINCCLTHROW(allocate_buff(&send_bufs[i], DATA_SIZE, buffer_type));
+			OFINCCLTHROW(initialize_buff(send_bufs[i], DATA_SIZE, buffer_type,
+						     buffer_value(ctx.rank, i)));
+			OFINCCLTHROW(ext_net->regMr(sComm, send_bufs[i], DATA_SIZE, buffer_type,
+						    &send_mhandles[i]));
+			OFINCCLTHROW(allocate_buff(&recv_bufs[i], DATA_SIZE, buffer_type));
+			OFINCCLTHROW(initialize_buff(recv_bufs[i], DATA_SIZE, buffer_type, 0));
+			OFINCCLTHROW(ext_net->regMr(rComm, recv_bufs[i], DATA_SIZE, buffer_type,
+						    &recv_mhandles[i]));
+		}
+
+		for (int i = 0; i < NUM_MSGS; i++) {
+			size_t sizes[] = {DATA_SIZE};
+			int tags[] = {TAG};
+			post_recv(ext_net, rComm, 1, &recv_bufs[i], sizes, tags, &recv_mhandles[i],
+				  &recv_requests[i]);
+		}
+
+		/* Posting a send already needs the peer's control message */
+		for (int i = 0; i < NUM_MSGS; i++) {
+			post_send(ext_net, sComm, send_bufs[i], DATA_SIZE, TAG, send_mhandles[i],
+				  &send_requests[i]);
+		}
+		wait_all(send_requests);
+		wait_all(recv_requests);
+
+		char *expected_buf = nullptr;
+		OFINCCLTHROW(allocate_buff((void **)&expected_buf, DATA_SIZE, NCCL_PTR_HOST));
+		for (int i = 0; i < NUM_MSGS; i++) {
+			if (buffer_type == NCCL_PTR_CUDA) {
+				int flush_sizes[] = {(int)DATA_SIZE};
+				void* flush_req = nullptr;
+				OFINCCLTHROW(ext_net->iflush(rComm, 1, &recv_bufs[i], flush_sizes,
+							     &recv_mhandles[i], &flush_req));
+				int flush_done = (flush_req == nullptr);
+				while (!flush_done) {
+					OFINCCLTHROW(ext_net->test(flush_req, &flush_done, nullptr));
+				}
+			}
+
+			OFINCCLTHROW(initialize_buff(expected_buf, DATA_SIZE, NCCL_PTR_HOST,
+						     buffer_value(ctx.peer_rank, i)));
+			OFINCCLTHROW(validate_data((char *)recv_bufs[i], expected_buf, DATA_SIZE,
+						   buffer_type));
+		}
+		OFINCCLTHROW(deallocate_buffer(expected_buf, NCCL_PTR_HOST));
+
+		for (int i = 0; i < NUM_MSGS; i++) {
+			OFINCCLTHROW(ext_net->deregMr(sComm, send_mhandles[i]));
+			OFINCCLTHROW(deallocate_buffer(send_bufs[i], buffer_type));
+			OFINCCLTHROW(ext_net->deregMr(rComm, recv_mhandles[i]));
+			OFINCCLTHROW(deallocate_buffer(recv_bufs[i], buffer_type));
+		}
+	}
+};
+
 int main(int argc, char* argv[])
 {
 	TestSuite suite;
 	MessageTransferTest test;
 	MessageTransferTest mt_test(4);
+	SendFirstWaitTest send_first_test;
 	suite.add(&test);
 	suite.add(&mt_test);
+	suite.add(&send_first_test);
 	return suite.run_all();
 }
 
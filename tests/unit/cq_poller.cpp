@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "unit_test.h"
+#include "nccl_ofi_assert.h"
+#include "nccl_ofi_cq_poller.h"
+
+/*
+ * Poll queues holding `depths' entries, as the endpoint does, and return
+ * the number of entries read from each rail
+ */
+static std::vector<size_t> poll(nccl_ofi_cq_poller &poller, std::vector<size_t> &depths)
+{
+	std::vector<size_t> num_read(depths.size(), 0);
+	int rail_id;
+
+	poller.begin_poll();
+	while ((rail_id = poller.next_rail()) >= 0) {
+		size_t count = poller.batch_size(rail_id);
+		size_t num_compls = std::min(count, depths[rail_id]);
+
+		depths[rail_id] -= num_compls;
+		num_read[rail_id] += num_compls;
+		poller.report_read(rail_id, count, num_compls, num_compls < count);
+	}
+
+	return num_read;
+}
+
+
+/* Without a budget, all queues are drained */
+static void drain_test()
+{
+	nccl_ofi_cq_poller poller(3, 4, 64, 0);
+	std::vector<size_t> depths = {1000, 10, 0};
+
+	std::vector<size_t> num_read = poll(poller, depths);
+	assert_always(num_read[0] == 1000 && num_read[1] == 10 && num_read[2] == 0);
+	assert_always(poller.rails[0].num_compls == 1000);
+	assert_always(poller.rails[2].num_empty_reads == 1);
+	assert_always(poller.rails[0].num_budget_stops == 0);
+}
+
+
+/* A deep queue does not starve the others, and polls rotate the rail
+ * read first */
+static void fairness_test()
+{
+	nccl_ofi_cq_poller poller(2, 4, 4, 16);
+	std::vector<size_t> depths = {1000, 1000};
+
+	std::vector<size_t> num_read = poll(poller, depths);
+	assert_always(num_read[0] == 8 && num_read[1] == 8);
+	assert_always(poller.rails[0].num_budget_stops == 1);
+	assert_always(poller.rails[1].num_budget_stops == 1);
+
+	/* With a budget not a multiple of the batch, the rail read first
+	 * gets more */
+	nccl_ofi_cq_poller odd_poller(2, 4, 4, 6);
+	num_read = poll(odd_poller, depths);
+	assert_always(num_read[0] == 4 && num_read[1] == 2);
+	num_read = poll(odd_poller, depths);
+	assert_always(num_read[0] == 2 && num_read[1] == 4);
+}
+
+
+/* Batches grow with the depth of the queue and shrink when it empties */
+static void batch_size_test()
+{
+	nccl_ofi_cq_poller poller(1, 4, 64, 0);
+	std::vector<size_t> depths = {1000};
+
+	poll(poller, depths);
+	assert_always(poller.rails[0].batch_size == 64);
+	/* 4 + 8 + 16 + 32 entries were read while growing */
+	assert_always(poller.rails[0].num_reads == 4 + (1000 - 60) / 64 + 1);
+
+	for (int i = 0; i < 8; i++) {
+		depths[0] = 1;
+		poll(poller, depths);
+	}
+	assert_always(poller.rails[0].batch_size == 4);
+
+	/* Reads cut short by the budget do not shrink batches */
+	nccl_ofi_cq_poller budget_poller(1, 4, 64, 70);
+	depths[0] = 1000;
+	poll(budget_poller, depths);
+	assert_always(budget_poller.rails[0].batch_size == 64);
+}
+
+
+int main(int argc, char *argv[])
+{
+	unit_test_init();
+
+	drain_test();
+	fairness_test();
+	batch_size_test();
+
+	printf("Test completed successfully\n");
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include "unit_test.h"
+#include "nccl_ofi_assert.h"
+#include "nccl_ofi_cq_wait.h"
+
+#define US (1000ULL)
+
+static uint64_t fake_now_ns = 0;
+
+static uint64_t fake_clock(void)
+{
+	return fake_now_ns;
+}
+
+
+/* The spin window starts at the first progress call without
+ * completions, and restarts after completions */
+static void spin_window_test()
+{
+	nccl_ofi_cq_wait wait(10 * US, 1, fake_clock);
+
+	fake_now_ns = 1 * US;
+	assert_always(!wait.spin_window_expired());
+
+	wait.report_progress(0);
+	fake_now_ns += 5 * US;
+	wait.report_progress(0);
+	assert_always(!wait.spin_window_expired());
+
+	/* Later idle calls do not move the start of the window */
+	fake_now_ns += 5 * US;
+	assert_always(wait.spin_window_expired());
+
+	/* Completions end the idle period */
+	wait.report_progress(3);
+	assert_always(!wait.spin_window_expired());
+	fake_now_ns += 100 * US;
+	assert_always(!wait.spin_window_expired());
+
+	wait.report_progress(0);
+	fake_now_ns += 9 * US;
+	assert_always(!wait.spin_window_expired());
+	fake_now_ns += 1 * US;
+	assert_always(wait.spin_window_expired());
+}
+
+
+/* A zero spin window blocks from the first idle call */
+static void zero_spin_test()
+{
+	nccl_ofi_cq_wait wait(0, 1, fake_clock);
+
+	fake_now_ns = 1 * US;
+	assert_always(!wait.spin_window_expired());
+	wait.report_progress(0);
+	assert_always(wait.spin_window_expired());
+}
+
+
+/* Without completion queues, waits never block */
+static void no_cq_test()
+{
+	nccl_ofi_cq_wait wait(10 * US, 1, fake_clock);
+
+	fake_now_ns = 1 * US;
+	wait.report_progress(0);
+	fake_now_ns += 100 * US;
+	wait.report_progress(0);
+	assert_always(wait.spin_window_expired());
+	assert_always(!wait.should_block());
+}
+
+
+/* Without completion queues, nothing is pending, and waiting only
+ * sleeps for the timeout */
+static void no_cq_wait_test()
+{
+	nccl_ofi_cq_wait wait(0, 1, fake_clock);
+
+	assert_always(wait.trywait() == 0);
+	assert_always(wait.wait() == 0);
+	assert_always(wait.block() == 0);
+}
+
+
+int main(int argc, char *argv[])
+{
+	unit_test_init();
+
+	spin_window_test();
+	zero_spin_test();
+	no_cq_test();
+	no_cq_wait_test();
+
+	printf("Test completed successfully\n");
+
+	return 0;
+}
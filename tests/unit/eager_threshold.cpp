@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include "unit_test.h"
+#include "nccl_ofi_assert.h"
+#include "nccl_ofi_eager_threshold.h"
+
+#define US (1000ULL)
+
+/* Messages per threshold update */
+#define EPOCH (32)
+
+static uint64_t now_ns = 1;
+
+static uint64_t test_clock(void)
+{
+	return now_ns;
+}
+
+
+/* Send an epoch of messages whose control messages arrive `wait_ns'
+ * after the first attempt, or before it if 0. Messages are sent eagerly
+ * when allowed, completing after `eager_ns'. */
+static void send_epoch(nccl_ofi_eager_threshold &threshold, size_t size,
+		       uint64_t wait_ns, uint64_t eager_ns)
+{
+	for (int i = 0; i < EPOCH; i++) {
+		bool ctrl_ready = (wait_ns == 0);
+		threshold.report_attempt(ctrl_ready);
+
+		if (!ctrl_ready && (ssize_t)size <= threshold.threshold()) {
+			uint64_t post_ns = now_ns;
+			threshold.report_posted();
+			now_ns += eager_ns;
+			threshold.report_eager_completion(now_ns - post_ns);
+			if (wait_ns > eager_ns) {
+				now_ns += wait_ns - eager_ns;
+			}
+			threshold.report_eager_ctrl_delay(now_ns - post_ns);
+			continue;
+		}
+
+		if (!ctrl_ready) {
+			/* NCCL retries until the control message arrives */
+			now_ns += wait_ns / 2;
+			threshold.report_attempt(false);
+			now_ns += wait_ns - wait_ns / 2;
+			threshold.report_attempt(true);
+		}
+		threshold.report_posted();
+		now_ns += eager_ns;
+	}
+}
+
+
+/* Control messages arriving early shrink the threshold to 0 */
+static void ctrl_ready_test()
+{
+	nccl_ofi_eager_threshold threshold(8192, 8192, test_clock);
+
+	assert_always(threshold.threshold() == 8192);
+	send_epoch(threshold, 1024, 0, 10 * US);
+	assert_always(threshold.threshold() == 4096);
+	for (int i = 0; i < 8; i++) {
+		send_epoch(threshold, 1024, 0, 10 * US);
+	}
+	assert_always(threshold.threshold() == 0);
+}
+
+
+/* Late control messages grow the threshold back, until messages are sent
+ * eagerly */
+static void late_ctrl_test()
+{
+	nccl_ofi_eager_threshold threshold(8192, 8192, test_clock);
+
+	for (int i = 0; i < 8; i++) {
+		send_epoch(threshold, 1024, 0, 10 * US);
+	}
+	assert_always(threshold.threshold() == 0);
+
+	/* The waits of messages not sent eagerly are measured */
+	send_epoch(threshold, 1024, 100 * US, 10 * US);
+	assert_always(threshold.threshold() == 256);
+	assert_always(threshold.ctrl_wait_ns >= 99.0 * US);
+
+	for (int i = 0; i < 8; i++) {
+		send_epoch(threshold, 1024, 100 * US, 10 * US);
+	}
+	assert_always(threshold.threshold() == 1024);
+
+	/* Larger messages waiting grow it up to the maximum */
+	for (int i = 0; i < 8; i++) {
+		send_epoch(threshold, 16384, 100 * US, 10 * US);
+	}
+	assert_always(threshold.threshold() == 8192);
+}
+
+
+/* The threshold rises above its initial size when control messages are
+ * slow to arrive, up to the maximum */
+static void above_initial_test()
+{
+	nccl_ofi_eager_threshold threshold(8192, 32768, test_clock);
+
+	assert_always(threshold.threshold() == 8192);
+	send_epoch(threshold, 16384, 100 * US, 10 * US);
+	assert_always(threshold.threshold() == 16384);
+
+	/* Messages are now sent eagerly, and nothing waits anymore */
+	for (int i = 0; i < 8; i++) {
+		send_epoch(threshold, 16384, 100 * US, 10 * US);
+	}
+	assert_always(threshold.threshold() == 16384);
+	assert_always(threshold.eager_ctrl_delay_ns >= 99.0 * US);
+
+	for (int i = 0; i < 8; i++) {
+		send_epoch(threshold, 65536, 100 * US, 10 * US);
+	}
+	assert_always(threshold.threshold() == 32768);
+}
+
+
+/* Waits not much longer than eager sends do not grow the threshold */
+static void short_wait_test()
+{
+	nccl_ofi_eager_threshold threshold(1024, 8192, test_clock);
+
+	/* Learn the eager latency */
+	send_epoch(threshold, 1024, 100 * US, 10 * US);
+	assert_always(threshold.threshold() == 1024);
+
+	for (int i = 0; i < 8; i++) {
+		send_epoch(threshold, 4096, 12 * US, 10 * US);
+	}
+	assert_always(threshold.threshold() == 1024);
+
+	send_epoch(threshold, 4096, 100 * US, 10 * US);
+	assert_always(threshold.threshold() == 2048);
+}
+
+
+/* Slow eager completions shrink the threshold */
+static void slow_eager_test()
+{
+	nccl_ofi_eager_threshold threshold(8192, 8192, test_clock);
+
+	send_epoch(threshold, 1024, 1000 * US, 10 * US);
+	assert_always(threshold.threshold() == 8192);
+
+	/* The peer runs out of rx buffers */
+	send_epoch(threshold, 1024, 1000 * US, 100 * US);
+	assert_always(threshold.threshold() == 4096);
+}
+
+
+int main(int argc, char *argv[])
+{
+	unit_test_init();
+
+	ctrl_ready_test();
+	late_ctrl_test();
+	above_initial_test();
+	short_wait_test();
+	slow_eager_test();
+
+	printf("Test completed successfully\n");
+
+	return 0;
+}
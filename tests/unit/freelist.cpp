@@ -6,9 +6,15 @@
 
 #include <stdio.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "unit_test.h"
 #include "nccl_ofi.h"
 #include "nccl_ofi_freelist.h"
+#include "nccl_ofi_math.h"
+#include "nccl_ofi_param.h"
 
 void *simple_base;
 size_t simple_size;
@@ -67,6 +73,375 @@ struct random_freelisted_item {
 	char buf[419];
 };
 
+static std::atomic<size_t> mt_num_regs(0);
+
+static int regmr_counting(void *opaque, void *data, size_t size, void **handle)
+{
+	*handle = (void *)(++mt_num_regs);
+	return 0;
+}
+
+static int deregmr_counting(void *handle)
+{
+	mt_num_regs--;
+	return 0;
+}
+
+/* Entries held by a thread of run_freelist_mt() at a time */
+static const size_t mt_batch = 24;
+
+/*
+ * Threads allocating and releasing entries concurrently from a thread-safe
+ * freelist never get the same entry, and some entries are released by other
+ * threads than the one that allocated them.
+ */
+static void run_freelist_mt(nccl_ofi_freelist_mt *freelist, size_t num_threads,
+			    size_t num_iters, std::atomic<size_t> *num_errors)
+{
+	const size_t batch = mt_batch;
+	std::vector<std::thread> threads;
+	std::vector<nccl_ofi_freelist::fl_entry *> handoff(num_threads * batch, nullptr);
+
+	for (size_t t = 0; t < num_threads; ++t) {
+		threads.push_back(std::thread([&, t]() {
+			nccl_ofi_freelist::fl_entry *entries[batch];
+			for (size_t i = 0; i < num_iters; ++i) {
+				for (size_t j = 0; j < batch; ++j) {
+					entries[j] = freelist->entry_alloc();
+					if (entries[j] == nullptr) {
+						num_errors->fetch_add(1);
+						return;
+					}
+					if (entries[j]->mr_handle == nullptr) {
+						num_errors->fetch_add(1);
+					}
+					*(size_t *)entries[j]->ptr = t * batch + j;
+				}
+				for (size_t j = 0; j < batch; ++j) {
+					if (*(size_t *)entries[j]->ptr != t * batch + j) {
+						num_errors->fetch_add(1);
+					}
+				}
+				/* Keep one entry for the next thread to release */
+				for (size_t j = 1; j < batch; ++j) {
+					freelist->entry_free(entries[j]);
+				}
+				auto *prev = __atomic_exchange_n(&handoff[((t + 1) % num_threads) * batch + (i % batch)],
+								 entries[0], __ATOMIC_ACQ_REL);
+				if (prev != nullptr) {
+					freelist->entry_free(prev);
+				}
+			}
+		}));
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	for (auto *entry : handoff) {
+		if (entry != nullptr) {
+			freelist->entry_free(entry);
+		}
+	}
+}
+
+static void test_freelist_mt()
+{
+	const size_t num_iters = 20000;
+	const size_t num_threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+	const size_t magazine_size = 16;
+	std::atomic<size_t> num_errors(0);
+	nccl_ofi_freelist::stats stats;
+
+	auto *freelist = new nccl_ofi_freelist_mt(sizeof(size_t), 8, 8, 0, magazine_size, NULL, NULL,
+						  regmr_counting, deregmr_counting, NULL, 1,
+						  "Test MT", true);
+
+	for (size_t threads : { (size_t)1, num_threads }) {
+		run_freelist_mt(freelist, threads, num_iters, &num_errors);
+		if (num_errors != 0) {
+			NCCL_OFI_WARN("%zu errors in concurrent freelist accesses with %zu threads",
+				      num_errors.load(), threads);
+			exit(1);
+		}
+
+		/* At most 2 * mt_batch entries per thread are in use at a
+		   time, in its batch and in the handoff slots, and a thread
+		   caches at most two magazines. Released entries must be
+		   reused rather than taken from the underlying freelist. */
+		freelist->get_stats(&stats);
+		if (stats.peak_in_use_entries > threads * 2 * (mt_batch + magazine_size) + magazine_size) {
+			NCCL_OFI_WARN("Thread-safe freelist used up to %zu entries with %zu threads",
+				      stats.peak_in_use_entries, threads);
+			exit(1);
+		}
+	}
+
+	delete freelist;
+	if (mt_num_regs != 0) {
+		NCCL_OFI_WARN("Freelist blocks not deregistered");
+		exit(1);
+	}
+
+	/* Bounded freelist: entries cached by a thread are reused */
+	freelist = new nccl_ofi_freelist_mt(sizeof(size_t), 8, 8, 64, 4, NULL, NULL,
+					    "Test MT bounded", true);
+	for (size_t i = 0; i < 1000; ++i) {
+		std::vector<nccl_ofi_freelist::fl_entry *> entries;
+		for (size_t j = 0; j < 64; ++j) {
+			entries.push_back(freelist->entry_alloc());
+			if (entries.back() == nullptr) {
+				NCCL_OFI_WARN("Bounded thread-safe freelist allocation failed");
+				exit(1);
+			}
+		}
+		for (auto *entry : entries) {
+			freelist->entry_free(entry);
+		}
+	}
+	delete freelist;
+}
+
+/*
+ * Fully idle blocks are deregistered and released by trim() and, with a
+ * trim watermark, by trim_excess(), but not while entries are released.
+ * Blocks with an entry in use are kept.
+ */
+static void test_trim()
+{
+	nccl_ofi_freelist::stats stats;
+	std::vector<nccl_ofi_freelist::fl_entry *> entries;
+
+	/* One entry per block */
+	auto *freelist = new nccl_ofi_freelist(4096, 1, 1, 0, NULL, NULL,
+					       regmr_counting, deregmr_counting, NULL,
+					       1, "Test trim", true);
+	for (size_t i = 0; i < 16; i++) {
+		entries.push_back(freelist->entry_alloc());
+		if (entries.back() == NULL) {
+			NCCL_OFI_WARN("allocation unexpectedly failed");
+			exit(1);
+		}
+	}
+
+	freelist->set_trim_watermark(8);
+	for (auto *entry : entries) {
+		freelist->entry_free(entry);
+	}
+	entries.clear();
+	if (mt_num_regs != 16) {
+		NCCL_OFI_WARN("Blocks released while releasing entries");
+		exit(1);
+	}
+
+	if (freelist->trim_excess() == 0 || freelist->trim_excess() != 0) {
+		NCCL_OFI_WARN("Unexpected number of blocks released above and below the watermark");
+		exit(1);
+	}
+
+	freelist->get_stats(&stats);
+	if (stats.num_allocated_entries > 8 || stats.num_trimmed_blocks == 0 ||
+	    stats.num_allocated_entries + stats.num_trimmed_entries != 16 ||
+	    stats.peak_allocated_entries != 16 || stats.peak_in_use_entries != 16 ||
+	    stats.memory_size != stats.num_allocated_entries * 4096 ||
+	    stats.peak_memory_size != 16 * 4096 ||
+	    mt_num_regs != stats.num_allocated_entries) {
+		NCCL_OFI_WARN("Unexpected statistics after watermark trim: %zu allocated, %zu trimmed, %zu registrations",
+			      stats.num_allocated_entries, stats.num_trimmed_entries, mt_num_regs.load());
+		exit(1);
+	}
+
+	freelist->trim(0);
+	freelist->get_stats(&stats);
+	if (stats.num_allocated_entries != 0 || stats.memory_size != 0 || mt_num_regs != 0) {
+		NCCL_OFI_WARN("Idle blocks left after trim");
+		exit(1);
+	}
+
+	/* The freelist grows back */
+	entries.push_back(freelist->entry_alloc());
+	if (entries.back() == NULL || mt_num_regs != 1) {
+		NCCL_OFI_WARN("Freelist did not grow after trim");
+		exit(1);
+	}
+	freelist->entry_free(entries.back());
+	entries.clear();
+	delete freelist;
+
+	/* Four entries per block, without automatic trimming */
+	freelist = new nccl_ofi_freelist(1024, 4, 4, 0, NULL, NULL,
+					 regmr_counting, deregmr_counting, NULL,
+					 1, "Test trim in use", true);
+	for (size_t i = 0; i < 8; i++) {
+		entries.push_back(freelist->entry_alloc());
+	}
+	for (size_t i = 1; i < 8; i++) {
+		if (i != 4) {
+			freelist->entry_free(entries[i]);
+		}
+	}
+	if (freelist->trim(0) != 0 || mt_num_regs != 2) {
+		NCCL_OFI_WARN("Block with entries in use was trimmed");
+		exit(1);
+	}
+
+	freelist->entry_free(entries[4]);
+	if (freelist->trim(0) != 1 || mt_num_regs != 1) {
+		NCCL_OFI_WARN("Idle block was not trimmed");
+		exit(1);
+	}
+
+	/* Remaining free entries are still usable */
+	for (size_t i = 1; i < 4; i++) {
+		entries[i] = freelist->entry_alloc();
+	}
+	if (mt_num_regs != 1) {
+		NCCL_OFI_WARN("Free entries of the remaining block were lost");
+		exit(1);
+	}
+	for (size_t i = 0; i < 4; i++) {
+		freelist->entry_free(entries[i]);
+	}
+	delete freelist;
+	if (mt_num_regs != 0) {
+		NCCL_OFI_WARN("Freelist blocks not deregistered");
+		exit(1);
+	}
+	entries.clear();
+
+	/* Entries of full magazines in the depot of a thread-safe freelist
+	   are released, those cached by the thread are kept */
+	auto *freelist_mt = new nccl_ofi_freelist_mt(4096, 1, 1, 0, 2, NULL, NULL,
+						     regmr_counting, deregmr_counting, NULL,
+						     1, "Test trim MT", true);
+	freelist_mt->set_trim_watermark(2);
+	for (size_t i = 0; i < 16; i++) {
+		entries.push_back(freelist_mt->entry_alloc());
+	}
+	for (auto *entry : entries) {
+		freelist_mt->entry_free(entry);
+	}
+	entries.clear();
+	/* The thread caches two magazines of 2 entries, and 1 free entry is
+	   left below the watermark */
+	if (freelist_mt->trim_excess() == 0 || mt_num_regs != 2 * 2 + 1) {
+		NCCL_OFI_WARN("Unexpected blocks left after thread-safe trim: %zu", mt_num_regs.load());
+		exit(1);
+	}
+	delete freelist_mt;
+	if (mt_num_regs != 0) {
+		NCCL_OFI_WARN("Freelist blocks not deregistered");
+		exit(1);
+	}
+}
+
+static void *last_reg_base = NULL;
+static size_t last_reg_size = 0;
+
+static int regmr_recording(void *opaque, void *data, size_t size, void **handle)
+{
+	last_reg_base = data;
+	last_reg_size = size;
+	return regmr_counting(opaque, data, size, handle);
+}
+
+/*
+ * With huge pages enabled, freelist blocks of at least half a huge page are
+ * huge page aligned and filled with entries, while small blocks still use
+ * regular pages. The hugetlb pool is usually empty, which exercises the
+ * fallback to transparent huge pages.
+ */
+static void test_hugepages()
+{
+	const size_t huge_page_size = 2 * 1024 * 1024;
+	const size_t entry_size = 4096;
+	std::vector<nccl_ofi_freelist::fl_entry *> entries;
+
+	ofi_nccl_mr_buffer_hugepages.set(HUGEPAGES::HUGETLB);
+	nccl_net_ofi_mr_buffer_init();
+	if (nccl_net_ofi_mr_buffer_size(huge_page_size / 2 + 1) != huge_page_size) {
+		printf("2 MiB huge pages are not available, skipping huge page test\n");
+		return;
+	}
+
+	/* Small blocks are not rounded up to huge pages */
+	auto *freelist = new nccl_ofi_freelist(entry_size, 1, 300, 0, NULL, NULL,
+					       regmr_recording, deregmr_counting, NULL,
+					       1, "Test huge pages", true);
+	if (last_reg_size != entry_size) {
+		NCCL_OFI_WARN("Unexpected initial block size %zu", last_reg_size);
+		exit(1);
+	}
+
+	/* Growth by 300 entries is rounded up to a huge page of entries */
+	for (size_t i = 0; i < 2; i++) {
+		entries.push_back(freelist->entry_alloc());
+	}
+	void *huge_base = last_reg_base;
+	if (last_reg_size != huge_page_size || !NCCL_OFI_IS_PTR_ALIGNED(huge_base, huge_page_size)) {
+		NCCL_OFI_WARN("Unexpected huge block %p of size %zu", huge_base, last_reg_size);
+		exit(1);
+	}
+
+	for (size_t i = 1; i < huge_page_size / entry_size; i++) {
+		entries.push_back(freelist->entry_alloc());
+		if (last_reg_base != huge_base) {
+			NCCL_OFI_WARN("Huge block exhausted after %zu entries", i);
+			exit(1);
+		}
+	}
+
+	/* The next allocation grows the freelist again */
+	entries.push_back(freelist->entry_alloc());
+	if (last_reg_base == huge_base || mt_num_regs != 3) {
+		NCCL_OFI_WARN("Freelist did not grow after huge block was exhausted");
+		exit(1);
+	}
+
+	for (auto *entry : entries) {
+		if (entry == NULL) {
+			NCCL_OFI_WARN("allocation unexpectedly failed");
+			exit(1);
+		}
+		freelist->entry_free(entry);
+	}
+	delete freelist;
+	if (mt_num_regs != 0) {
+		NCCL_OFI_WARN("Freelist blocks not deregistered");
+		exit(1);
+	}
+}
+
+/*
+ * Entries of a simple freelist are aligned to the requested alignment, even
+ * if the entry size is not a multiple of it
+ */
+static void test_alignment()
+{
+	const size_t alignment = 64;
+	std::vector<nccl_ofi_freelist::fl_entry *> entries;
+
+	auto *freelist = new nccl_ofi_freelist(72, 8, 8, 0, NULL, NULL,
+					       "Test alignment", true, alignment);
+	for (size_t i = 0; i < 32; i++) {
+		nccl_ofi_freelist::fl_entry *entry = freelist->entry_alloc();
+		if (entry == NULL) {
+			NCCL_OFI_WARN("allocation unexpectedly failed");
+			exit(1);
+		}
+		if (!NCCL_OFI_IS_PTR_ALIGNED(entry->ptr, alignment)) {
+			NCCL_OFI_WARN("Entry %p is not %zu byte aligned", entry->ptr, alignment);
+			exit(1);
+		}
+		entries.push_back(entry);
+	}
+
+	for (auto *entry : entries) {
+		freelist->entry_free(entry);
+	}
+	delete freelist;
+}
+
 int main(int argc, char *argv[])
 {
 	nccl_ofi_freelist *freelist;
@@ -253,6 +628,11 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
+	test_freelist_mt();
+	test_trim();
+	test_alignment();
+	test_hugepages();
+
 	printf("Test completed successfully\n");
 
 	return 0;
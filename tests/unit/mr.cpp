@@ -5,10 +5,20 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 #include "unit_test.h"
 #include "nccl_ofi.h"
+#include "nccl_ofi_memmon.h"
 #include "nccl_ofi_mr.h"
+#include "nccl_ofi_pthread.h"
 
 static inline bool test_lookup_impl(nccl_ofi_mr_cache_t *cache, void *addr, size_t size,
 		 void *expected_val)
@@ -40,7 +50,7 @@ static inline bool test_insert_impl(nccl_ofi_mr_cache_t *cache, void *addr, size
 	 * passing nullptr
 	 */
 	nccl_ofi_mr_ckey_t ckey = nccl_ofi_mr_ckey_mk_vec(addr, size, nullptr);
-	int ret = nccl_ofi_mr_cache_insert_entry(cache, &ckey, false, handle);
+	int ret = nccl_ofi_mr_cache_insert_entry(cache, &ckey, false, true, handle);
 	if (ret != expected_ret) {
 		NCCL_OFI_WARN("nccl_ofi_mr_cache_insert_entry returned unexpected result. Expected: %d. Actual: %d",
 			expected_ret, ret);
@@ -70,6 +80,434 @@ static inline bool test_delete_impl(nccl_ofi_mr_cache_t *cache, void *handle, in
 		exit(1);                                      \
 	}
 
+static void *last_evicted_handle = NULL;
+static size_t num_evicted = 0;
+
+static int dereg_fn(void *opaque, void *handle)
+{
+	last_evicted_handle = handle;
+	num_evicted++;
+	return 0;
+}
+
+static void test_lazy_dereg(size_t page_size)
+{
+	const size_t max_idle_entries = 4;
+	const size_t max_idle_bytes = 6 * page_size;
+
+	nccl_ofi_mr_cache_t *cache = nccl_ofi_mr_cache_init(16, page_size);
+	if (!cache) {
+		NCCL_OFI_WARN("nccl_ofi_mr_cache_init failed");
+		exit(1);
+	}
+	nccl_ofi_mr_cache_enable_lazy_dereg(cache, max_idle_entries, max_idle_bytes,
+					    dereg_fn, NULL);
+
+	/* Unused entry stays registered and is reused */
+	test_insert(cache, (void *)(1 * page_size), 1, (void *)1, 0);
+	test_delete(cache, (void *)1, 0);
+	test_delete(cache, (void *)1, -ENOENT);
+	test_lookup(cache, (void *)(1 * page_size), 1, (void *)1);
+	if (cache->idle_hit_count != 1 || cache->idle_entries != 0) {
+		NCCL_OFI_WARN("Unexpected idle hit count %u and idle entries %zu",
+			      cache->idle_hit_count, cache->idle_entries);
+		exit(1);
+	}
+	test_delete(cache, (void *)1, 0);
+
+	/* Entry budget: the least recently used entry is evicted */
+	for (size_t i = 2; i <= max_idle_entries + 1; ++i) {
+		test_insert(cache, (void *)(i * 2 * page_size), 1, (void *)i, 0);
+		test_delete(cache, (void *)i, 0);
+	}
+	if (num_evicted != 1 || last_evicted_handle != (void *)1) {
+		NCCL_OFI_WARN("Expected eviction of handle 1, got %zu evictions, last %p",
+			      num_evicted, last_evicted_handle);
+		exit(1);
+	}
+	test_lookup(cache, (void *)(1 * page_size), 1, NULL);
+	test_lookup(cache, (void *)(2 * 2 * page_size), 1, (void *)2);
+	test_delete(cache, (void *)2, 0);
+
+	/* Byte budget: a large idle entry pushes out the oldest ones */
+	test_insert(cache, (void *)(64 * page_size), 4 * page_size, (void *)100, 0);
+	test_delete(cache, (void *)100, 0);
+	if (cache->idle_bytes > max_idle_bytes || cache->idle_entries != 3 ||
+	    last_evicted_handle != (void *)4) {
+		NCCL_OFI_WARN("Unexpected idle bytes %zu, idle entries %zu, last eviction %p",
+			      cache->idle_bytes, cache->idle_entries, last_evicted_handle);
+		exit(1);
+	}
+
+	/* Covered idle entries are evicted */
+	test_insert(cache, (void *)(10 * page_size), 3 * page_size, (void *)101, 0);
+	if (last_evicted_handle != (void *)5) {
+		NCCL_OFI_WARN("Expected eviction of covered handle 5, got %p", last_evicted_handle);
+		exit(1);
+	}
+
+	/* Entries not inserted with retain_idle are deleted immediately */
+	nccl_ofi_mr_ckey_t ckey = nccl_ofi_mr_ckey_mk_vec((void *)(32 * page_size), 1, nullptr);
+	if (nccl_ofi_mr_cache_insert_entry(cache, &ckey, false, false, (void *)102) != 0) {
+		NCCL_OFI_WARN("Insert failed");
+		exit(1);
+	}
+	test_delete(cache, (void *)102, 1);
+
+	test_delete(cache, (void *)101, 0);
+	nccl_ofi_mr_cache_purge_idle(cache);
+	if (cache->idle_entries != 0 || cache->idle_bytes != 0 || !cache->handles.empty() ||
+	    cache->eviction_count != num_evicted) {
+		NCCL_OFI_WARN("Idle entries left after purge");
+		exit(1);
+	}
+
+	nccl_ofi_mr_cache_finalize(cache);
+}
+
+/**
+ * Entries over host memory released with munmap() or madvise() are dropped by
+ * the memory monitor
+ */
+static void test_monitor(size_t cache_page_size)
+{
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	const size_t num_pages = 8;
+
+	nccl_ofi_mr_cache_t *cache = nccl_ofi_mr_cache_init(16, cache_page_size);
+	if (!cache) {
+		NCCL_OFI_WARN("nccl_ofi_mr_cache_init failed");
+		exit(1);
+	}
+	nccl_ofi_mr_cache_enable_lazy_dereg(cache, 0, 0, dereg_fn, NULL);
+	if (nccl_ofi_mr_cache_enable_monitor(cache) != 0) {
+		NCCL_OFI_WARN("nccl_ofi_mr_cache_enable_monitor failed");
+		exit(1);
+	}
+
+	char *buf = (char *)mmap(NULL, num_pages * page_size, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		NCCL_OFI_WARN("mmap failed");
+		exit(1);
+	}
+	num_evicted = 0;
+
+	/* Idle entry on pages 0-1, entry in use on pages 4-5, idle entry on
+	 * pages 6-7 */
+	test_insert(cache, buf, 2 * page_size, (void *)200, 0);
+	test_delete(cache, (void *)200, 0);
+	test_insert(cache, buf + 4 * page_size, 2 * page_size, (void *)201, 0);
+	test_insert(cache, buf + 6 * page_size, 2 * page_size, (void *)202, 0);
+	test_delete(cache, (void *)202, 0);
+
+	/* Releasing part of a registered range invalidates the entry */
+	uint64_t seq = nccl_ofi_memmon_seq();
+	munmap(buf + page_size, page_size);
+	madvise(buf + 7 * page_size, page_size, MADV_DONTNEED);
+	if (nccl_ofi_memmon_seq() != seq + 2) {
+		NCCL_OFI_WARN("munmap() and madvise() were not observed by the memory monitor");
+		exit(1);
+	}
+
+	test_lookup(cache, buf, page_size, NULL);
+	test_lookup(cache, buf + 6 * page_size, page_size, NULL);
+	if (num_evicted != 2 || cache->invalidation_count != 2) {
+		NCCL_OFI_WARN("Expected 2 invalidated idle entries, got %zu evictions and %u invalidations",
+			      num_evicted, cache->invalidation_count);
+		exit(1);
+	}
+	test_lookup(cache, buf + 4 * page_size, page_size, (void *)201);
+	test_delete(cache, (void *)201, 0);
+
+	/* Entries in use stay registered until released by their user */
+	munmap(buf + 2 * page_size, 4 * page_size);
+	test_lookup(cache, buf + 4 * page_size, page_size, NULL);
+	test_delete(cache, (void *)201, 1);
+	if (num_evicted != 2 || cache->invalidation_count != 3) {
+		NCCL_OFI_WARN("Expected entry in use to be invalidated without eviction");
+		exit(1);
+	}
+
+	/* Ranges lost from the invalidation log drop all entries */
+	test_insert(cache, (void *)(4096 * page_size), page_size, (void *)203, 0);
+	test_delete(cache, (void *)203, 0);
+	for (size_t i = 0; i < 2 * 4096; ++i) {
+		nccl_ofi_memmon_invalidate((void *)page_size, page_size);
+	}
+	test_lookup(cache, (void *)(4096 * page_size), page_size, NULL);
+	if (num_evicted != 3 || last_evicted_handle != (void *)203) {
+		NCCL_OFI_WARN("Expected eviction of handle 203 after log overflow");
+		exit(1);
+	}
+
+	munmap(buf, page_size);
+	munmap(buf + 6 * page_size, 2 * page_size);
+	nccl_ofi_mr_cache_finalize(cache);
+}
+
+/**
+ * Invalidation reaches all partly overlapping entries covering the range,
+ * not only the last one starting before it
+ */
+static void test_invalidate_partial_overlap(size_t page_size)
+{
+	nccl_ofi_mr_cache_t *cache = nccl_ofi_mr_cache_init(16, page_size);
+	if (!cache) {
+		NCCL_OFI_WARN("nccl_ofi_mr_cache_init failed");
+		exit(1);
+	}
+	nccl_ofi_mr_cache_enable_lazy_dereg(cache, 0, 0, dereg_fn, NULL);
+
+	/* Entry on pages 2-3, entries A on pages 16-25 and B on pages 21-30,
+	 * which overlap without containing each other, entry on pages 40-41 */
+	test_insert(cache, (void *)(2 * page_size), 2 * page_size, (void *)600, 0);
+	test_insert(cache, (void *)(16 * page_size), 10 * page_size, (void *)601, 0);
+	test_insert(cache, (void *)(21 * page_size), 10 * page_size, (void *)602, 0);
+	test_insert(cache, (void *)(40 * page_size), 2 * page_size, (void *)603, 0);
+	test_lookup(cache, (void *)(17 * page_size), page_size, (void *)601);
+	test_lookup(cache, (void *)(27 * page_size), page_size, (void *)602);
+	test_delete(cache, (void *)601, 0);
+	test_delete(cache, (void *)602, 0);
+	test_delete(cache, (void *)601, 0);
+	test_delete(cache, (void *)602, 0);
+
+	num_evicted = 0;
+	nccl_ofi_mr_cache_invalidate(cache, 23 * page_size, page_size);
+	if (num_evicted != 2 || cache->invalidation_count != 2) {
+		NCCL_OFI_WARN("Expected both overlapping entries to be invalidated, got %zu evictions and %u invalidations",
+			      num_evicted, cache->invalidation_count);
+		exit(1);
+	}
+	test_lookup(cache, (void *)(16 * page_size), page_size, NULL);
+	test_lookup(cache, (void *)(21 * page_size), page_size, NULL);
+	test_lookup(cache, (void *)(2 * page_size), page_size, (void *)600);
+	test_lookup(cache, (void *)(40 * page_size), page_size, (void *)603);
+
+	test_delete(cache, (void *)600, 0);
+	test_delete(cache, (void *)600, 0);
+	test_delete(cache, (void *)603, 0);
+	test_delete(cache, (void *)603, 0);
+	nccl_ofi_mr_cache_purge_idle(cache);
+	nccl_ofi_mr_cache_finalize(cache);
+}
+
+static inline bool test_merge_impl(nccl_ofi_mr_cache_t *cache, size_t page_size,
+				   size_t first_page, size_t num_pages,
+				   size_t bound_page, size_t bound_pages,
+				   size_t expected_first_page, size_t expected_num_pages)
+{
+	nccl_ofi_mr_ckey_t ckey =
+		nccl_ofi_mr_ckey_mk_vec((void *)(first_page * page_size), num_pages * page_size, nullptr);
+	nccl_ofi_mr_ckey_t merged_ckey;
+	bool merged = nccl_ofi_mr_cache_merge_key(cache, &ckey, false, bound_page * page_size,
+						  bound_pages * page_size, &merged_ckey);
+	bool expected_merged = (expected_first_page != first_page || expected_num_pages != num_pages);
+	if (merged != expected_merged) {
+		NCCL_OFI_WARN("nccl_ofi_mr_cache_merge_key returned %d, expected %d", merged, expected_merged);
+		return false;
+	}
+	if (merged && (nccl_ofi_mr_ckey_baseaddr(&merged_ckey) != expected_first_page * page_size ||
+		       nccl_ofi_mr_ckey_len(&merged_ckey) != expected_num_pages * page_size)) {
+		NCCL_OFI_WARN("Unexpected merged range. Expected: [%zu, %zu]. Actual: [%lu, %lu]",
+			      expected_first_page * page_size, expected_num_pages * page_size,
+			      nccl_ofi_mr_ckey_baseaddr(&merged_ckey), nccl_ofi_mr_ckey_len(&merged_ckey));
+		return false;
+	}
+	return true;
+}
+#define test_merge(cache, page_size, first_page, num_pages, bound_page, bound_pages,           \
+		   expected_first_page, expected_num_pages)                                     \
+	if (!test_merge_impl(cache, page_size, first_page, num_pages, bound_page, bound_pages, \
+			     expected_first_page, expected_num_pages)) {                        \
+		NCCL_OFI_WARN("test_merge fail");                                               \
+		exit(1);                                                                        \
+	}
+
+/**
+ * Adjacent and overlapping registrations of one allocation are merged
+ */
+static void test_merge_registrations(size_t page_size)
+{
+	nccl_ofi_mr_cache_t *cache = nccl_ofi_mr_cache_init(16, page_size);
+	if (!cache) {
+		NCCL_OFI_WARN("nccl_ofi_mr_cache_init failed");
+		exit(1);
+	}
+	nccl_ofi_mr_cache_enable_lazy_dereg(cache, 0, 0, dereg_fn, NULL);
+
+	/* Entry in use on pages 2-3, idle entry on pages 6-7 */
+	test_insert(cache, (void *)(2 * page_size), 2 * page_size, (void *)400, 0);
+	test_insert(cache, (void *)(6 * page_size), 2 * page_size, (void *)401, 0);
+	test_delete(cache, (void *)401, 0);
+
+	/* Merging is disabled by default */
+	test_merge(cache, page_size, 4, 2, 0, 64, 4, 2);
+
+	nccl_ofi_mr_cache_enable_merge(cache, 8 * page_size);
+
+	/* Pages 4-5 close the gap between both entries */
+	test_merge(cache, page_size, 4, 2, 0, 64, 2, 6);
+	/* Overlapping the end of an entry */
+	test_merge(cache, page_size, 7, 2, 0, 64, 6, 3);
+	/* Only entries within the allocation are merged */
+	test_merge(cache, page_size, 4, 2, 4, 60, 4, 4);
+	test_merge(cache, page_size, 4, 2, 1, 6, 2, 4);
+	/* Nothing to merge with */
+	test_merge(cache, page_size, 10, 2, 0, 64, 10, 2);
+	/* Merged registrations are limited in size */
+	test_merge(cache, page_size, 4, 6, 0, 64, 2, 8);
+	test_merge(cache, page_size, 4, 7, 0, 64, 4, 7);
+
+	/* The merged registration replaces both entries */
+	num_evicted = 0;
+	test_insert(cache, (void *)(2 * page_size), 6 * page_size, (void *)402, 0);
+	if (num_evicted != 1 || last_evicted_handle != (void *)401) {
+		NCCL_OFI_WARN("Expected eviction of covered idle handle 401");
+		exit(1);
+	}
+	test_lookup(cache, (void *)(3 * page_size), 1, (void *)402);
+	test_lookup(cache, (void *)(6 * page_size), 2 * page_size, (void *)402);
+	test_delete(cache, (void *)402, 0);
+	test_delete(cache, (void *)402, 0);
+	/* Covered entry in use is released through its own handle */
+	test_delete(cache, (void *)400, 1);
+	test_delete(cache, (void *)402, 0);
+
+	nccl_ofi_mr_cache_purge_idle(cache);
+	nccl_ofi_mr_cache_finalize(cache);
+}
+
+/**
+ * Run num_threads threads looking up num_iters entries each, either on the
+ * shared path or with the cache lock held
+ */
+static void run_concurrent_lookups(nccl_ofi_mr_cache_t *cache, size_t page_size,
+				     size_t num_entries, size_t num_threads, size_t num_iters,
+				     bool shared, std::atomic<size_t> *num_errors)
+{
+	std::vector<std::thread> threads;
+
+	for (size_t t = 0; t < num_threads; ++t) {
+		threads.push_back(std::thread([=]() {
+			for (size_t i = 0; i < num_iters; ++i) {
+				size_t e = (i + t) % num_entries;
+				nccl_ofi_mr_ckey_t ckey =
+					nccl_ofi_mr_ckey_mk_vec((void *)((2 * e + 1) * page_size), 1, nullptr);
+				void *handle;
+				if (shared) {
+					handle = nccl_ofi_mr_cache_lookup_shared(cache, &ckey, false);
+				} else {
+					nccl_net_ofi_mutex_lock(&cache->lock);
+					handle = nccl_ofi_mr_cache_lookup_entry(cache, &ckey, false);
+					nccl_net_ofi_mutex_unlock(&cache->lock);
+				}
+				if (handle != (void *)(300 + e)) {
+					num_errors->fetch_add(1);
+				}
+			}
+		}));
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+/**
+ * Concurrent hits on entries in use are all accounted for, on both the shared
+ * and the locked lookup paths, and shared hits proceed while the cache lock
+ * is held
+ */
+static void test_concurrent_lookup(size_t page_size)
+{
+	const size_t num_entries = 64;
+	const size_t num_iters = 200000;
+	const size_t num_threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+	std::atomic<size_t> num_errors(0);
+	size_t num_lookups = 0;
+
+	nccl_ofi_mr_cache_t *cache = nccl_ofi_mr_cache_init(num_entries, page_size);
+	if (!cache) {
+		NCCL_OFI_WARN("nccl_ofi_mr_cache_init failed");
+		exit(1);
+	}
+
+	for (size_t e = 0; e < num_entries; ++e) {
+		test_insert(cache, (void *)((2 * e + 1) * page_size), page_size, (void *)(300 + e), 0);
+	}
+
+	/* An idle entry is left to the locked path */
+	test_insert(cache, (void *)(4 * num_entries * page_size), page_size, (void *)299, 0);
+	nccl_ofi_mr_cache_enable_lazy_dereg(cache, 0, 0, dereg_fn, NULL);
+	test_delete(cache, (void *)299, 0);
+	nccl_ofi_mr_ckey_t idle_ckey =
+		nccl_ofi_mr_ckey_mk_vec((void *)(4 * num_entries * page_size), 1, nullptr);
+	if (nccl_ofi_mr_cache_lookup_shared(cache, &idle_ckey, false) != NULL) {
+		NCCL_OFI_WARN("Shared lookup revived an idle entry");
+		exit(1);
+	}
+
+	for (size_t threads : { (size_t)1, num_threads }) {
+		run_concurrent_lookups(cache, page_size, num_entries, threads, num_iters, false,
+				       &num_errors);
+		run_concurrent_lookups(cache, page_size, num_entries, threads, num_iters, true,
+				       &num_errors);
+		num_lookups += 2 * threads * num_iters;
+	}
+
+	if (num_errors != 0) {
+		NCCL_OFI_WARN("%zu concurrent lookups returned an unexpected handle", num_errors.load());
+		exit(1);
+	}
+
+	size_t total_refcnt = 0;
+	for (size_t e = 0; e < num_entries; ++e) {
+		total_refcnt += cache->handles[(void *)(300 + e)]->refcnt;
+	}
+	if (total_refcnt != num_entries + num_lookups ||
+	    cache->hit_count != num_lookups) {
+		NCCL_OFI_WARN("Expected %zu references and %zu hits, got %zu references and %u hits",
+			      num_entries + num_lookups, num_lookups, total_refcnt,
+			      cache->hit_count.load());
+		exit(1);
+	}
+
+	/*
+	 * Shared lookups do not wait for a thread holding the cache lock, as
+	 * a registration on a miss does. The readers must all finish while
+	 * the lock is still held.
+	 */
+	std::atomic<size_t> num_finished(0);
+	std::vector<std::thread> readers;
+	nccl_net_ofi_mutex_lock(&cache->lock);
+	for (size_t t = 0; t < num_threads; ++t) {
+		readers.push_back(std::thread([&, t]() {
+			nccl_ofi_mr_ckey_t ckey =
+				nccl_ofi_mr_ckey_mk_vec((void *)((2 * t + 1) * page_size), 1, nullptr);
+			if (nccl_ofi_mr_cache_lookup_shared(cache, &ckey, false) != (void *)(300 + t)) {
+				num_errors.fetch_add(1);
+			}
+			num_finished.fetch_add(1);
+		}));
+	}
+	for (int i = 0; i < 10000 && num_finished < num_threads; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	bool readers_proceeded = (num_finished == num_threads);
+	nccl_net_ofi_mutex_unlock(&cache->lock);
+	for (auto &reader : readers) {
+		reader.join();
+	}
+	if (!readers_proceeded || num_errors != 0) {
+		NCCL_OFI_WARN("Shared lookups waited for the cache lock or missed (%zu of %zu finished)",
+			      num_finished.load(), num_threads);
+		exit(1);
+	}
+
+	nccl_ofi_mr_cache_purge_idle(cache);
+	nccl_ofi_mr_cache_finalize(cache);
+}
+
 static inline bool test_make_aligned_key_impl(uintptr_t addr, size_t size, uintptr_t expected_base, size_t expected_size)
 {
 	/* TODO: To test mr_endpoint feature, pass endpoint object while creating
@@ -163,6 +601,31 @@ int main(int argc, char *argv[])
 		test_lookup(cache, (void *)(i * fake_page_size), 1, NULL);
 	}
 
+	/* Registration covering existing entries serves their lookups */
+	test_insert(cache, (void *)(8 * fake_page_size), 1, (void *)100, 0);
+	test_insert(cache, (void *)(9 * fake_page_size), 1, (void *)101, 0);
+	test_insert(cache, (void *)(8 * fake_page_size), 3 * fake_page_size, (void *)102, 0);
+	test_insert(cache, (void *)(9 * fake_page_size), 1, (void *)103, -EEXIST);
+	test_lookup(cache, (void *)(9 * fake_page_size), 2, (void *)102);
+	test_lookup(cache, (void *)(10 * fake_page_size), 2, (void *)102);
+	test_lookup(cache, (void *)(10 * fake_page_size + 4), fake_page_size, NULL);
+	/* Covered entries are still released through their handles */
+	test_delete(cache, (void *)100, 1);
+	test_delete(cache, (void *)101, 1);
+	test_lookup(cache, (void *)(8 * fake_page_size), 1, (void *)102);
+	/* Insert and three lookup hits */
+	test_delete(cache, (void *)102, 0);
+	test_delete(cache, (void *)102, 0);
+	test_delete(cache, (void *)102, 0);
+	test_delete(cache, (void *)102, 1);
+	test_lookup(cache, (void *)(8 * fake_page_size), 1, NULL);
+
+	test_lazy_dereg(fake_page_size);
+	test_monitor(fake_page_size);
+	test_invalidate_partial_overlap(fake_page_size);
+	test_merge_registrations(fake_page_size);
+	test_concurrent_lookup(fake_page_size);
+
 	/* Test of nccl_ofi_mr_ckey_mk_[vec|dmabuf] to build aligned keys */
 #if HAVE_NEURON
 	test_make_aligned_key(fake_page_size / 2, 16, fake_page_size / 2, 16);
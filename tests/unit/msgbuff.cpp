@@ -6,10 +6,89 @@
 
 #include <stdio.h>
 
+#include <atomic>
+#include <thread>
+
 #include "nccl_ofi_msgbuff.h"
 
 #include "unit_test.h"
 #include "nccl_ofi.h"
+#include "nccl_ofi_assert.h"
+
+static const uint16_t num_concurrent_msgs = 50000;
+
+static std::atomic<unsigned int> num_completed;
+
+/*
+ * One side of a message exchange, modeled after the RDMA protocol: the
+ * network side inserts received buffers, the application side inserts
+ * receive requests. Whichever side comes second finds the element of the
+ * other side and completes the message.
+ */
+static void exchange_task(nccl_ofi_msgbuff *msgbuff, uint16_t field_mask,
+			  nccl_ofi_msgbuff_elemtype_t type)
+{
+	nccl_ofi_msgbuff_elemtype_t other_type =
+		(type == NCCL_OFI_MSGBUFF_REQ) ? NCCL_OFI_MSGBUFF_BUFF : NCCL_OFI_MSGBUFF_REQ;
+
+	for (unsigned int i = 0; i < num_concurrent_msgs; i++) {
+		uint16_t seq = i & field_mask;
+		void *elem = (void *)(uintptr_t)(2 * i + 1 + (type == NCCL_OFI_MSGBUFF_BUFF));
+		nccl_ofi_msgbuff_status_t stat;
+		nccl_ofi_msgbuff_result_t ret;
+
+		while ((ret = msgbuff->insert(seq, elem, type, &stat)) ==
+			       NCCL_OFI_MSGBUFF_INVALID_IDX &&
+		       stat == NCCL_OFI_MSGBUFF_UNAVAILABLE) {
+			std::this_thread::yield();
+		}
+		if (ret == NCCL_OFI_MSGBUFF_SUCCESS) {
+			continue;
+		}
+		assert_always(stat == NCCL_OFI_MSGBUFF_INPROGRESS);
+
+		void *other_elem;
+		nccl_ofi_msgbuff_elemtype_t found_type;
+		assert_always(msgbuff->retrieve(seq, &other_elem, &found_type, &stat) ==
+			      NCCL_OFI_MSGBUFF_SUCCESS);
+		assert_always(found_type == other_type);
+		assert_always((uintptr_t)other_elem ==
+			      2 * i + 1 + (other_type == NCCL_OFI_MSGBUFF_BUFF));
+		if (type == NCCL_OFI_MSGBUFF_REQ) {
+			assert_always(msgbuff->replace(seq, elem, type, &stat) ==
+				      NCCL_OFI_MSGBUFF_SUCCESS);
+		}
+		assert_always(msgbuff->complete(seq, &stat) == NCCL_OFI_MSGBUFF_SUCCESS);
+		num_completed++;
+	}
+}
+
+/* Both sides insert every message concurrently; exactly one insert of
+ * each message wins */
+static void concurrent_test(uint16_t max_inprogress, uint16_t bit_width)
+{
+	nccl_ofi_msgbuff msgbuff(max_inprogress, bit_width, 0);
+	uint16_t field_mask = (uint16_t)((1 << bit_width) - 1);
+
+	num_completed = 0;
+	std::thread network(exchange_task, &msgbuff, field_mask, NCCL_OFI_MSGBUFF_BUFF);
+	std::thread app(exchange_task, &msgbuff, field_mask, NCCL_OFI_MSGBUFF_REQ);
+	network.join();
+	app.join();
+
+	assert_always(num_completed == num_concurrent_msgs);
+
+	/* All messages completed: the next one is not started */
+	nccl_ofi_msgbuff_status_t stat;
+	void *elem;
+	nccl_ofi_msgbuff_elemtype_t type;
+	assert_always(msgbuff.retrieve(num_concurrent_msgs & field_mask, &elem, &type, &stat) ==
+		      NCCL_OFI_MSGBUFF_INVALID_IDX);
+	assert_always(stat == NCCL_OFI_MSGBUFF_NOTSTARTED);
+	assert_always(msgbuff.retrieve((num_concurrent_msgs - 1) & field_mask, &elem, &type,
+				       &stat) == NCCL_OFI_MSGBUFF_INVALID_IDX);
+	assert_always(stat == NCCL_OFI_MSGBUFF_COMPLETED);
+}
 
 
 int main(int argc, char *argv[])
@@ -121,10 +200,39 @@ int main(int argc, char *argv[])
 		msg_seq_num = (msg_seq_num + max_inprogress) % field_size;
 	}
 
+	/** Test remove **/
+	if (msgbuff->insert(msg_seq_num, &buff_store[0], type, &stat) != NCCL_OFI_MSGBUFF_SUCCESS ||
+	    msgbuff->remove(msg_seq_num, &stat) != NCCL_OFI_MSGBUFF_SUCCESS) {
+		NCCL_OFI_WARN("msgbuff->remove failed on inprogress index");
+		return 1;
+	}
+	if (msgbuff->retrieve(msg_seq_num, (void **)&result, &type, &stat) !=
+		    NCCL_OFI_MSGBUFF_INVALID_IDX ||
+	    stat != NCCL_OFI_MSGBUFF_NOTSTARTED) {
+		NCCL_OFI_WARN("msgbuff->retrieve did not return notstarted after remove");
+		return 1;
+	}
+	if (msgbuff->remove(msg_seq_num, &stat) != NCCL_OFI_MSGBUFF_INVALID_IDX ||
+	    stat != NCCL_OFI_MSGBUFF_NOTSTARTED) {
+		NCCL_OFI_WARN("msgbuff->remove did not return notstarted");
+		return 1;
+	}
+	if (msgbuff->insert(msg_seq_num, &buff_store[1], type, &stat) != NCCL_OFI_MSGBUFF_SUCCESS ||
+	    msgbuff->complete(msg_seq_num, &stat) != NCCL_OFI_MSGBUFF_SUCCESS) {
+		NCCL_OFI_WARN("msgbuff->insert failed after remove");
+		return 1;
+	}
+
 	delete msgbuff;
 
 	free(buff_store);
 
+	concurrent_test(256, 10);
+	/* Buffer size not dividing the sequence number range */
+	concurrent_test(100, 8);
+
+	printf("Test completed successfully\n");
+
 	/** Success! **/
 	return 0;
 }
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "unit_test.h"
+#include "nccl_ofi.h"
+#include "nccl_ofi_assert.h"
+#include "nccl_ofi_numa.h"
+
+
+static int thread_policy_mode()
+{
+	int mode = -1;
+	assert_always(syscall(SYS_get_mempolicy, &mode, NULL, 0, NULL, 0) == 0);
+	return mode;
+}
+
+
+static int page_node(void *ptr)
+{
+	int node = -1;
+	assert_always(syscall(SYS_get_mempolicy, &node, NULL, 0, ptr, MPOL_F_NODE | MPOL_F_ADDR) == 0);
+	return node;
+}
+
+
+/* Scopes set the thread policy, nest, and restore the default policy */
+static void scope_test()
+{
+	assert_always(nccl_ofi_numa_current_node() == NCCL_OFI_NUMA_NODE_ANY);
+	{
+		nccl_ofi_numa_scope outer(0);
+		assert_always(nccl_ofi_numa_current_node() == 0);
+		assert_always(thread_policy_mode() == MPOL_PREFERRED);
+		{
+			nccl_ofi_numa_scope inner(NCCL_OFI_NUMA_NODE_ANY);
+			assert_always(nccl_ofi_numa_current_node() == 0);
+		}
+		{
+			nccl_ofi_numa_scope inner(0);
+			assert_always(nccl_ofi_numa_current_node() == 0);
+		}
+		assert_always(thread_policy_mode() == MPOL_PREFERRED);
+	}
+	assert_always(nccl_ofi_numa_current_node() == NCCL_OFI_NUMA_NODE_ANY);
+	assert_always(thread_policy_mode() == MPOL_DEFAULT);
+}
+
+
+/* A policy set by the application is left alone */
+static void application_policy_test()
+{
+	unsigned long mask = 1;
+	assert_always(syscall(SYS_set_mempolicy, MPOL_BIND, &mask, 8 * sizeof(mask) + 1) == 0);
+	{
+		nccl_ofi_numa_scope scope(0);
+		assert_always(nccl_ofi_numa_current_node() == NCCL_OFI_NUMA_NODE_ANY);
+		assert_always(thread_policy_mode() == MPOL_BIND);
+	}
+	assert_always(thread_policy_mode() == MPOL_BIND);
+	assert_always(syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0) == 0);
+}
+
+
+/* MR buffers are placed on the node of the scope they are allocated in */
+static void mr_buffer_test()
+{
+	const size_t size = 16 * system_page_size;
+	void *buffer = NULL;
+
+	{
+		nccl_ofi_numa_scope scope(0);
+		assert_always(nccl_net_ofi_alloc_mr_buffer(size, &buffer) == 0);
+	}
+	memset(buffer, 0, size);
+	for (size_t off = 0; off < size; off += system_page_size) {
+		assert_always(page_node((char *)buffer + off) == 0);
+	}
+	assert_always(nccl_net_ofi_dealloc_mr_buffer(buffer, size) == 0);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int mode;
+
+	unit_test_init();
+
+	if (syscall(SYS_get_mempolicy, &mode, NULL, 0, NULL, 0) != 0) {
+		printf("NUMA memory policies are not supported (%s), skipping\n", strerror(errno));
+		return 0;
+	}
+
+	scope_test();
+	application_policy_test();
+	mr_buffer_test();
+
+	printf("Test completed successfully\n");
+
+	return 0;
+}
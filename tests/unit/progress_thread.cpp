@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "unit_test.h"
+#include "nccl_ofi_assert.h"
+#include "nccl_ofi_progress_thread.h"
+
+#define US (1000ULL)
+
+
+/* Idle polls spin, then sleep for doubling times up to the maximum */
+static void backoff_test()
+{
+	nccl_ofi_progress_backoff backoff(3, 10 * US);
+
+	for (int i = 0; i < 3; i++) {
+		assert_always(backoff.report_poll(false) == 0);
+	}
+	assert_always(backoff.report_poll(false) == 1 * US);
+	assert_always(backoff.report_poll(false) == 2 * US);
+	assert_always(backoff.report_poll(false) == 4 * US);
+	assert_always(backoff.report_poll(false) == 8 * US);
+	assert_always(backoff.report_poll(false) == 10 * US);
+	assert_always(backoff.report_poll(false) == 10 * US);
+
+	/* Progress resets the backoff */
+	assert_always(backoff.report_poll(true) == 0);
+	for (int i = 0; i < 3; i++) {
+		assert_always(backoff.report_poll(false) == 0);
+	}
+	assert_always(backoff.report_poll(false) == 1 * US);
+}
+
+
+struct counter {
+	std::atomic<int> num_calls;
+	/* Value returned by the progress function */
+	int ret;
+};
+
+static int count_progress(void *ctx)
+{
+	struct counter *c = (struct counter *)ctx;
+	c->num_calls++;
+	return c->ret;
+}
+
+static void wait_for_calls(struct counter &c, int num_calls)
+{
+	while (c.num_calls.load() < num_calls) {
+		std::this_thread::sleep_for(std::chrono::microseconds(10));
+	}
+}
+
+
+/* Registered objects are polled until removed, and failing ones are no
+ * longer polled */
+static void thread_test()
+{
+	nccl_ofi_progress_thread thread(-1, 10, 10 * US);
+	struct counter active = {{0}, 1};
+	struct counter idle = {{0}, 0};
+	struct counter failing = {{0}, -5};
+
+	thread.add(&active, count_progress);
+	thread.add(&idle, count_progress);
+	thread.add(&failing, count_progress);
+	wait_for_calls(active, 100);
+	wait_for_calls(idle, 100);
+	assert_always(failing.num_calls.load() == 1);
+
+	thread.remove(&active);
+	int num_calls = active.num_calls.load();
+	wait_for_calls(idle, idle.num_calls.load() + 100);
+	assert_always(active.num_calls.load() == num_calls);
+}
+
+
+int main(int argc, char *argv[])
+{
+	unit_test_init();
+
+	backoff_test();
+	thread_test();
+
+	printf("Test completed successfully\n");
+
+	return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include "unit_test.h"
+#include "nccl_ofi.h"
+#include "nccl_ofi_assert.h"
+#include "nccl_ofi_param.h"
+#include "nccl_ofi_rail_health.h"
+#include "nccl_ofi_scheduler.h"
+
+#define MS (1000000ULL)
+
+static uint64_t now_ns = 1;
+
+static uint64_t test_clock(void)
+{
+	return now_ns;
+}
+
+
+/* Errors degrade a rail for the cool-down, after which it is probed and
+ * becomes healthy again */
+static void error_test()
+{
+	nccl_ofi_rail_health health(4, test_clock);
+
+	assert_always(health.usable_rails() == 0xf);
+	assert_always(health.report_error(2));
+	assert_always(health.usable_rails() == 0xb);
+	assert_always(health.rails[2].state == nccl_ofi_rail_health::RAIL_DEGRADED);
+	/* Degrading a degraded rail changes nothing */
+	assert_always(!health.report_error(2));
+
+	now_ns += 99 * MS;
+	assert_always(!health.update());
+	now_ns += 1 * MS;
+	assert_always(health.update());
+	assert_always(health.usable_rails() == 0xf);
+	assert_always(health.rails[2].state == nccl_ofi_rail_health::RAIL_PROBING);
+
+	/* A failed probe doubles the cool-down */
+	assert_always(health.report_error(2));
+	assert_always(health.rails[2].degraded_until_ns == now_ns + 200 * MS);
+	now_ns += 200 * MS;
+	assert_always(health.update());
+
+	for (int i = 0; i < 16; i++) {
+		assert_always(!health.report_completion(2, 0));
+	}
+	assert_always(health.rails[2].state == nccl_ofi_rail_health::RAIL_HEALTHY);
+	assert_always(health.rails[2].cooldown_ns == 100 * MS);
+	assert_always(!health.has_degraded_rails());
+}
+
+
+/* The last usable rail is never degraded */
+static void last_rail_test()
+{
+	nccl_ofi_rail_health health(2, test_clock);
+
+	assert_always(health.report_error(0));
+	assert_always(!health.report_error(1));
+	assert_always(health.usable_rails() == 0x2);
+}
+
+
+/* A rail is only degraded for EAGAIN if other rails are not saturated */
+static void eagain_test()
+{
+	nccl_ofi_rail_health health(2, test_clock);
+
+	/* Both rails saturated: the endpoint is busy, no rail is degraded */
+	for (int i = 0; i < 64; i++) {
+		assert_always(!health.report_eagain(0));
+		assert_always(!health.report_eagain(1));
+	}
+	assert_always(health.usable_rails() == 0x3);
+
+	/* Rail 1 recovers while rail 0 stays saturated */
+	for (int i = 0; i < 64; i++) {
+		health.report_completion(1, 0);
+	}
+	bool degraded = false;
+	for (int i = 0; i < 64 && !degraded; i++) {
+		degraded = health.report_eagain(0);
+	}
+	assert_always(degraded);
+	assert_always(health.usable_rails() == 0x2);
+}
+
+
+/* A rail whose completion latency is an outlier is degraded */
+static void latency_test()
+{
+	nccl_ofi_rail_health health(2, test_clock);
+	bool degraded = false;
+
+	for (int i = 0; i < 32 && !degraded; i++) {
+		uint64_t start_ns = now_ns;
+		now_ns += 100000;
+		assert_always(!health.report_completion(0, start_ns));
+		now_ns += 2 * MS;
+		degraded = health.report_completion(1, start_ns);
+	}
+	assert_always(degraded);
+	assert_always(health.usable_rails() == 0x1);
+}
+
+
+/* Schedulers route around excluded rails */
+static void scheduler_test()
+{
+	const int num_rails = 4;
+	nccl_net_ofi_scheduler *schedulers[] = {
+		new nccl_net_ofi_threshold_scheduler(num_rails),
+		new nccl_net_ofi_adaptive_scheduler(num_rails, test_clock),
+	};
+
+	for (nccl_net_ofi_scheduler *scheduler : schedulers) {
+		nccl_net_ofi_schedule_buf<num_rails> storage;
+
+		scheduler->set_excluded_rails(1ULL << 1);
+		for (size_t size : {(size_t)0, (size_t)100, (size_t)(1024 * 1024)}) {
+			for (int iter = 0; iter < 8; iter++) {
+				nccl_net_ofi_schedule_t *schedule =
+					scheduler->get_schedule(size, num_rails, storage.get());
+				size_t total = 0;
+				for (size_t idx = 0; idx < schedule->num_xfer_infos; idx++) {
+					assert_always(schedule->rail_xfer_infos[idx].rail_id != 1);
+					total += schedule->rail_xfer_infos[idx].msg_size;
+				}
+				assert_always(total == size);
+				if (size == 1024 * 1024) {
+					/* The three rails left are used */
+					assert_always(schedule->num_xfer_infos == 3);
+				}
+				nccl_net_ofi_release_schedule(scheduler, schedule);
+			}
+		}
+
+		/* Rails are used again once all are excluded */
+		scheduler->set_excluded_rails(0xf);
+		nccl_net_ofi_schedule_t *schedule =
+			scheduler->get_schedule(1024 * 1024, num_rails, storage.get());
+		assert_always(schedule->num_xfer_infos == num_rails);
+		nccl_net_ofi_release_schedule(scheduler, schedule);
+
+		delete scheduler;
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	unit_test_init();
+
+	ofi_nccl_rail_health_cooldown_ms.set(100);
+	ofi_nccl_min_stripe_size.set(4096);
+
+	error_test();
+	last_rail_test();
+	eagain_test();
+	latency_test();
+	scheduler_test();
+
+	printf("Test completed successfully\n");
+
+	return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2026 Amazon.com, Inc. or its affiliates. All rights reserved.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include "unit_test.h"
+#include "nccl_ofi_assert.h"
+#include "nccl_ofi_rx_window.h"
+
+#define US (1000ULL)
+#define EPOCH (100 * US)
+
+static uint64_t fake_now_ns = 0;
+
+static uint64_t fake_clock(void)
+{
+	return fake_now_ns;
+}
+
+
+/* Consume `num' buffers in the current epoch, each reposted at once */
+static void consume(nccl_ofi_rx_window &window, size_t num)
+{
+	for (size_t i = 0; i < num; i++) {
+		window.report_consumed(window.size() - 1);
+	}
+}
+
+
+/* The window starts at the floor and doubles when a consumption leaves
+ * no buffer posted, up to the ceiling */
+static void underrun_test()
+{
+	nccl_ofi_rx_window window(4, 32, 16, EPOCH, fake_clock);
+
+	fake_now_ns = 1 * US;
+	assert_always(window.size() == 4);
+	assert_always(window.low_watermark() == 2);
+
+	assert_always(!window.report_consumed(3));
+	assert_always(window.report_consumed(0));
+	assert_always(window.size() == 8);
+	assert_always(window.low_watermark() == 4);
+
+	assert_always(window.report_consumed(0));
+	assert_always(window.report_consumed(0));
+	assert_always(window.size() == 32);
+	assert_always(!window.report_consumed(0));
+	assert_always(window.size() == 32);
+
+	assert_always(window.num_underruns == 4);
+	assert_always(window.num_grows == 3);
+	assert_always(window.peak_size() == 32);
+}
+
+
+/* The window grows to the consumption of an epoch, and to twice the most
+ * buffers missing at once */
+static void demand_growth_test()
+{
+	nccl_ofi_rx_window window(4, 64, 32, EPOCH, fake_clock);
+
+	fake_now_ns = 1 * US;
+	consume(window, 20);
+	assert_always(window.size() == 4);
+
+	/* The first consumption after the epoch ends it */
+	fake_now_ns += EPOCH;
+	assert_always(window.report_consumed(window.size() - 1));
+	assert_always(window.size() == 20);
+	assert_always(window.consume_rate() == 20.0 * 1e9 / EPOCH);
+
+	/* Buffers held, e.g. by unexpected eager messages */
+	window.report_consumed(window.size() - 15);
+	fake_now_ns += EPOCH;
+	assert_always(window.report_consumed(window.size() - 1));
+	assert_always(window.size() == 30);
+
+	/* Capped at the ceiling */
+	consume(window, 500);
+	fake_now_ns += EPOCH;
+	window.report_consumed(window.size() - 1);
+	assert_always(window.size() == 64);
+	assert_always(window.num_underruns == 0);
+}
+
+
+/* The window halves per epoch down to the demand, and returns to the
+ * floor once traffic stops */
+static void shrink_test()
+{
+	nccl_ofi_rx_window window(4, 64, 32, EPOCH, fake_clock);
+
+	fake_now_ns = 1 * US;
+	consume(window, 64);
+	fake_now_ns += EPOCH;
+	window.report_consumed(window.size() - 1);
+	assert_always(window.size() == 64);
+
+	/* A demand above half of the window keeps it */
+	consume(window, 39);
+	fake_now_ns += EPOCH;
+	assert_always(!window.report_consumed(window.size() - 1));
+	assert_always(window.size() == 64);
+
+	/* A lower demand halves it, but not below the demand */
+	consume(window, 9);
+	fake_now_ns += EPOCH;
+	assert_always(window.report_consumed(window.size() - 1));
+	assert_always(window.size() == 32);
+	consume(window, 9);
+	fake_now_ns += EPOCH;
+	window.report_consumed(window.size() - 1);
+	assert_always(window.size() == 16);
+	consume(window, 9);
+	fake_now_ns += EPOCH;
+	assert_always(!window.report_consumed(window.size() - 1));
+	assert_always(window.size() == 16);
+
+	/* Consumption after an idle period is scaled to one epoch */
+	fake_now_ns += 100 * EPOCH;
+	window.report_consumed(window.size() - 1);
+	assert_always(window.size() == 8);
+	fake_now_ns += 100 * EPOCH;
+	window.report_consumed(window.size() - 1);
+	assert_always(window.size() == 4);
+	fake_now_ns += 100 * EPOCH;
+	assert_always(!window.report_consumed(window.size() - 1));
+	assert_always(window.size() == 4);
+
+	assert_always(window.num_shrinks == 4);
+	assert_always(window.peak_size() == 64);
+}
+
+
+/* An idle rail shrinks its window once per epoch without consumptions */
+static void idle_test()
+{
+	nccl_ofi_rx_window window(4, 64, 32, EPOCH, fake_clock);
+
+	/* Nothing to shrink before the first consumption */
+	fake_now_ns = 1 * US;
+	assert_always(!window.report_idle());
+
+	consume(window, 64);
+	fake_now_ns += EPOCH;
+	window.report_consumed(window.size() - 1);
+	assert_always(window.size() == 64);
+
+	/* Not before the end of the epoch */
+	fake_now_ns += EPOCH / 2;
+	assert_always(!window.report_idle());
+	assert_always(window.size() == 64);
+
+	fake_now_ns += EPOCH / 2;
+	assert_always(window.report_idle());
+	assert_always(window.size() == 32);
+	assert_always(window.low_watermark() == 16);
+	assert_always(!window.report_idle());
+
+	for (int i = 0; i < 10; i++) {
+		fake_now_ns += EPOCH;
+		window.report_idle();
+	}
+	assert_always(window.size() == 4);
+	assert_always(window.num_shrinks == 4);
+	assert_always(window.num_consumed == 65);
+}
+
+
+/* A floor above the ceiling is clamped, which pins the window */
+static void static_window_test()
+{
+	nccl_ofi_rx_window window(128, 32, 16, EPOCH, fake_clock);
+
+	fake_now_ns = 1 * US;
+	assert_always(window.size() == 32);
+	assert_always(window.low_watermark() == 16);
+
+	assert_always(!window.report_consumed(0));
+	fake_now_ns += 100 * EPOCH;
+	assert_always(!window.report_consumed(31));
+	assert_always(window.size() == 32);
+}
+
+
+int main(int argc, char *argv[])
+{
+	unit_test_init();
+
+	underrun_test();
+	demand_growth_test();
+	shrink_test();
+	idle_test();
+	static_window_test();
+
+	printf("Test completed successfully\n");
+
+	return 0;
+}
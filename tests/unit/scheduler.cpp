@@ -6,6 +6,9 @@
 
 #include <stdint.h>
 
+#include <queue>
+#include <vector>
+
 #include <nccl/err.h>
 #include <nccl/net.h>
 
@@ -308,6 +311,343 @@ static inline int test_threshold_scheduler()
 	return 0;
 }
 
+/*
+ * Reference implementation of the threshold scheduler, computing each
+ * schedule from scratch
+ */
+static inline void ref_threshold_schedule(size_t size, int num_rails, size_t min_stripe_size,
+					  unsigned int *rr_counter, nccl_net_ofi_schedule_t *schedule)
+{
+	size_t align = 128;
+	int num_stripes = (int)std::max(1UL, std::min(NCCL_OFI_DIV_CEIL(size, min_stripe_size),
+						      (unsigned long)num_rails));
+	for (int i = num_stripes; i > 1; i--) {
+		if ((num_rails % i) == 0) {
+			num_stripes = i;
+			break;
+		}
+	}
+
+	int rail_id = *rr_counter;
+	*rr_counter = (*rr_counter + num_stripes) % num_rails;
+	size_t max_stripe_size = NCCL_OFI_DIV_CEIL(NCCL_OFI_DIV_CEIL(size, num_stripes), align) * align;
+	size_t left = size;
+
+	schedule->num_xfer_infos = num_stripes;
+	for (int idx = 0; idx < num_stripes; idx++) {
+		schedule->rail_xfer_infos[idx].rail_id = rail_id;
+		schedule->rail_xfer_infos[idx].offset = size - left;
+		schedule->rail_xfer_infos[idx].msg_size = std::min(left, max_stripe_size);
+		left -= schedule->rail_xfer_infos[idx].msg_size;
+		rail_id = (rail_id + 1) % num_rails;
+	}
+}
+
+/* Verify that schedules looked up from the schedule tables into caller
+ * storage match schedules computed from scratch */
+static inline int test_schedule_tables()
+{
+	size_t min_stripe_size = ofi_nccl_min_stripe_size();
+	nccl_net_ofi_schedule_t *ref_schedule;
+	int ret = 0;
+
+	if (create_ref_schedule(&ref_schedule, 4)) {
+		return 1;
+	}
+
+	for (int num_rails = 1; num_rails <= 4; num_rails++) {
+		nccl_net_ofi_scheduler *scheduler = new nccl_net_ofi_threshold_scheduler(num_rails);
+		nccl_net_ofi_schedule_buf<4> storage;
+		unsigned int rr_counter = 0;
+
+		for (size_t size = 64; size <= 6 * min_stripe_size && ret == 0; size += 61) {
+			nccl_net_ofi_schedule_t *schedule = scheduler->get_schedule(size, num_rails, storage.get());
+			if (schedule != storage.get() || schedule->elem != NULL) {
+				NCCL_OFI_WARN("Schedule not placed in caller storage");
+				ret = 1;
+				break;
+			}
+			ref_threshold_schedule(size, num_rails, min_stripe_size, &rr_counter, ref_schedule);
+			ret = verify_schedule(schedule, ref_schedule);
+			if (ret) {
+				NCCL_OFI_WARN("Verification failed for size %zu and %d rails", size, num_rails);
+			}
+			nccl_net_ofi_release_schedule(scheduler, schedule);
+		}
+		delete scheduler;
+	}
+
+	free(ref_schedule);
+	return ret;
+}
+
+/*
+ * Deterministic simulation of messages striped across rails
+ *
+ * Each rail serves its stripes in order at a bandwidth given by a rail
+ * profile, and reports completion a fixed latency after serving a
+ * stripe. A window of messages is kept in flight: a new message is
+ * scheduled whenever all stripes of a message completed. Time is
+ * virtual, so results do not depend on the host.
+ */
+
+/* Virtual time of the simulation in nanoseconds */
+static uint64_t sim_now_ns = 0;
+
+static uint64_t sim_clock(void)
+{
+	return sim_now_ns;
+}
+
+/* Bandwidth of a rail in bytes per nanosecond, given the simulation time
+ * and the index of the message being scheduled */
+typedef double (*rail_profile_fn)(int rail_id, size_t msg_idx, size_t num_msgs);
+
+struct sim_result {
+	/* Bytes transferred relative to the capacity of all rails
+	 * over the duration of the simulation */
+	double efficiency;
+	/* Average over messages of the time between the first and the
+	 * last stripe completion, relative to the message duration */
+	double imbalance;
+};
+
+struct sim_event {
+	uint64_t time;
+	size_t msg_slot;
+	uint16_t rail_id;
+
+	bool operator>(const sim_event &other) const
+	{
+		if (time != other.time) {
+			return time > other.time;
+		}
+		if (msg_slot != other.msg_slot) {
+			return msg_slot > other.msg_slot;
+		}
+		return rail_id > other.rail_id;
+	}
+};
+
+struct sim_msg {
+	nccl_net_ofi_schedule_t *schedule;
+	uint64_t start_ns;
+	uint64_t first_compl_ns;
+	size_t pending;
+};
+
+static inline int verify_stripes(nccl_net_ofi_schedule_t *schedule, size_t size, int num_rails)
+{
+	size_t offset = 0;
+
+	if (schedule->num_xfer_infos == 0 || schedule->num_xfer_infos > (size_t)num_rails) {
+		NCCL_OFI_WARN("Invalid number of stripes %zu", schedule->num_xfer_infos);
+		return 1;
+	}
+	for (size_t idx = 0; idx < schedule->num_xfer_infos; idx++) {
+		nccl_net_ofi_xfer_info_t *xfer = &schedule->rail_xfer_infos[idx];
+		if (xfer->offset != offset || xfer->rail_id >= num_rails) {
+			NCCL_OFI_WARN("Invalid stripe %zu: rail %u offset %zu, expected offset %zu",
+				      idx, xfer->rail_id, xfer->offset, offset);
+			return 1;
+		}
+		if (idx + 1 != schedule->num_xfer_infos && xfer->msg_size % 128 != 0) {
+			NCCL_OFI_WARN("Stripe %zu of size %zu is not aligned", idx, xfer->msg_size);
+			return 1;
+		}
+		for (size_t other = 0; other < idx; other++) {
+			if (schedule->rail_xfer_infos[other].rail_id == xfer->rail_id) {
+				NCCL_OFI_WARN("Rail %u used twice", xfer->rail_id);
+				return 1;
+			}
+		}
+		offset += xfer->msg_size;
+	}
+	if (offset != size) {
+		NCCL_OFI_WARN("Stripes cover %zu bytes, expected %zu", offset, size);
+		return 1;
+	}
+	return 0;
+}
+
+static inline int simulate(nccl_net_ofi_scheduler *scheduler, int num_rails, rail_profile_fn profile,
+			   size_t msg_size, size_t num_msgs, size_t window, struct sim_result *result)
+{
+	const uint64_t latency_ns = 2000;
+	std::priority_queue<sim_event, std::vector<sim_event>, std::greater<sim_event>> events;
+	std::vector<uint64_t> busy_until(num_rails, 0);
+	std::vector<sim_msg> msgs(window);
+	double capacity = 0.0;
+	double imbalance = 0.0;
+	size_t num_issued = 0;
+	size_t num_completed = 0;
+	uint64_t prev_ns;
+
+	sim_now_ns = 1;
+	prev_ns = sim_now_ns;
+
+	auto issue = [&](size_t slot) -> int {
+		sim_msg &msg = msgs[slot];
+		msg.schedule = scheduler->get_schedule(msg_size, num_rails);
+		if (!msg.schedule) {
+			NCCL_OFI_WARN("Failed to get schedule");
+			return 1;
+		}
+		if (verify_stripes(msg.schedule, msg_size, num_rails)) {
+			return 1;
+		}
+		msg.start_ns = sim_now_ns;
+		msg.pending = msg.schedule->num_xfer_infos;
+		for (size_t idx = 0; idx < msg.schedule->num_xfer_infos; idx++) {
+			nccl_net_ofi_xfer_info_t *xfer = &msg.schedule->rail_xfer_infos[idx];
+			double bw = profile(xfer->rail_id, num_issued, num_msgs);
+			uint64_t start = std::max(sim_now_ns, busy_until[xfer->rail_id]);
+			busy_until[xfer->rail_id] = start + (uint64_t)(xfer->msg_size / bw);
+			events.push({busy_until[xfer->rail_id] + latency_ns, slot, xfer->rail_id});
+		}
+		num_issued++;
+		return 0;
+	};
+
+	for (size_t slot = 0; slot < window && num_issued < num_msgs; slot++) {
+		if (issue(slot)) {
+			return 1;
+		}
+	}
+
+	while (!events.empty()) {
+		sim_event event = events.top();
+		events.pop();
+
+		/* Capacity is integrated with the bandwidth of the
+		 * current phase of the profiles */
+		for (int rail_id = 0; rail_id < num_rails; rail_id++) {
+			capacity += profile(rail_id, num_issued - 1, num_msgs) * (event.time - prev_ns);
+		}
+		prev_ns = event.time;
+		sim_now_ns = event.time;
+
+		sim_msg &msg = msgs[event.msg_slot];
+		if (msg.pending == msg.schedule->num_xfer_infos) {
+			msg.first_compl_ns = sim_now_ns;
+		}
+		if (scheduler->wants_feedback) {
+			scheduler->notify_completion(msg.schedule, event.rail_id);
+		}
+		if (--msg.pending != 0) {
+			continue;
+		}
+
+		imbalance += (double)(sim_now_ns - msg.first_compl_ns) / (double)(sim_now_ns - msg.start_ns);
+		nccl_net_ofi_release_schedule(scheduler, msg.schedule);
+		num_completed++;
+		if (num_issued < num_msgs && issue(event.msg_slot)) {
+			return 1;
+		}
+	}
+
+	if (num_completed != num_msgs) {
+		NCCL_OFI_WARN("Completed %zu messages, expected %zu", num_completed, num_msgs);
+		return 1;
+	}
+
+	result->efficiency = (double)(msg_size * num_msgs) / capacity;
+	result->imbalance = imbalance / num_msgs;
+	return 0;
+}
+
+/* Rails of different speed */
+static double profile_heterogeneous(int rail_id, size_t, size_t)
+{
+	const double bw[4] = {1.0, 1.0, 0.5, 0.25};
+	return bw[rail_id];
+}
+
+/* Rails of equal speed, one of which becomes congested halfway */
+static double profile_congested(int rail_id, size_t msg_idx, size_t num_msgs)
+{
+	if (rail_id == 2 && msg_idx >= num_msgs / 2) {
+		return 0.1;
+	}
+	return 1.0;
+}
+
+static inline int test_adaptive_scheduler()
+{
+	const int num_rails = 4;
+	const size_t msg_size = 1024 * 1024;
+	const size_t num_msgs = 2000;
+	const size_t window = 8;
+	struct {
+		const char *name;
+		rail_profile_fn fn;
+	} profiles[] = {{"heterogeneous", profile_heterogeneous}, {"congested", profile_congested}};
+
+	for (auto &profile : profiles) {
+		struct sim_result threshold_result, adaptive_result;
+
+		nccl_net_ofi_scheduler *threshold = new nccl_net_ofi_threshold_scheduler(num_rails);
+		if (simulate(threshold, num_rails, profile.fn, msg_size, num_msgs, window, &threshold_result)) {
+			return 1;
+		}
+		delete threshold;
+
+		nccl_net_ofi_scheduler *adaptive = new nccl_net_ofi_adaptive_scheduler(num_rails, sim_clock);
+		if (simulate(adaptive, num_rails, profile.fn, msg_size, num_msgs, window, &adaptive_result)) {
+			return 1;
+		}
+		delete adaptive;
+
+		NCCL_OFI_INFO(NCCL_NET, "Profile %s: threshold efficiency %.3f imbalance %.3f, adaptive efficiency %.3f imbalance %.3f",
+			      profile.name, threshold_result.efficiency, threshold_result.imbalance,
+			      adaptive_result.efficiency, adaptive_result.imbalance);
+
+		if (adaptive_result.efficiency < 0.9 ||
+		    adaptive_result.efficiency < threshold_result.efficiency) {
+			NCCL_OFI_WARN("Profile %s: adaptive scheduler efficiency %.3f too low (threshold scheduler %.3f)",
+				      profile.name, adaptive_result.efficiency, threshold_result.efficiency);
+			return 1;
+		}
+		if (adaptive_result.imbalance > 0.1) {
+			NCCL_OFI_WARN("Profile %s: adaptive scheduler imbalance %.3f too high",
+				      profile.name, adaptive_result.imbalance);
+			return 1;
+		}
+	}
+
+	/* Verify that a rail returning EAGAIN gets less data */
+	nccl_net_ofi_scheduler *scheduler = new nccl_net_ofi_adaptive_scheduler(num_rails, sim_clock);
+	for (int i = 0; i < 16; i++) {
+		scheduler->notify_eagain(1);
+	}
+	nccl_net_ofi_schedule_t *schedule = scheduler->get_schedule(msg_size, num_rails);
+	if (!schedule || verify_stripes(schedule, msg_size, num_rails)) {
+		return 1;
+	}
+	size_t bytes[num_rails] = {0};
+	for (size_t idx = 0; idx < schedule->num_xfer_infos; idx++) {
+		bytes[schedule->rail_xfer_infos[idx].rail_id] += schedule->rail_xfer_infos[idx].msg_size;
+	}
+	if (bytes[1] * 4 > bytes[0]) {
+		NCCL_OFI_WARN("Rail returning EAGAIN got %zu bytes, other rail %zu bytes", bytes[1], bytes[0]);
+		return 1;
+	}
+	nccl_net_ofi_release_schedule(scheduler, schedule);
+
+	/* Released schedules no longer count as outstanding */
+	auto *adaptive = static_cast<nccl_net_ofi_adaptive_scheduler *>(scheduler);
+	for (int rail_id = 0; rail_id < num_rails; rail_id++) {
+		if (adaptive->rails[rail_id].outstanding_bytes != 0) {
+			NCCL_OFI_WARN("Rail %d has %zu outstanding bytes after release",
+				      rail_id, adaptive->rails[rail_id].outstanding_bytes);
+			return 1;
+		}
+	}
+	delete scheduler;
+
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	int ret = 0;
@@ -315,6 +655,16 @@ int main(int argc, char *argv[])
 	unit_test_init();
 
 	ret = test_threshold_scheduler();
+	if (ret) {
+		return ret;
+	}
+
+	ret = test_schedule_tables();
+	if (ret) {
+		return ret;
+	}
+
+	ret = test_adaptive_scheduler();
 
 	/** Success!? **/
 	return ret;
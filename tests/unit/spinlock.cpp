@@ -102,6 +102,27 @@ static void multi_thread_trylock_test()
 }
 
 
+static void waiters_test()
+{
+	assert_always(!spinlock.has_waiters());
+
+	spinlock.lock();
+	assert_always(!spinlock.has_waiters());
+
+	std::thread waiter([] {
+		spinlock.lock();
+		spinlock.unlock();
+	});
+	while (!spinlock.has_waiters()) {
+		std::this_thread::yield();
+	}
+	spinlock.unlock();
+	waiter.join();
+
+	assert_always(!spinlock.has_waiters());
+}
+
+
 int
 main(int argc, char *argv[])
 {
@@ -111,6 +132,7 @@ main(int argc, char *argv[])
 	single_thread_trylock_test();
 	multi_thread_lock_test();
 	multi_thread_trylock_test();
+	waiters_test();
 
 	return 0;
 }